@@ -34,6 +34,8 @@
 
 #include <memoria/core/datatypes/buffer/buffer.hpp>
 
+#include <vector>
+
 namespace memoria {
 
 template <typename Key, typename Value, typename Profile>
@@ -72,6 +74,12 @@ struct ICtrApi<Map<Key, Value>, Profile>: public CtrReferenceable<Profile> {
 
     virtual Result<CtrSharedPtr<MapIterator<Key, Value, Profile>>> find(KeyView key) const noexcept = 0;
 
+    // Looks up a batch of keys without creating an iterator per key. For
+    // each keys[i] present in the map, bit i of found is set and values[i]
+    // is assigned, other bits are cleared. Views of variable-length values
+    // point into the map's blocks and stay valid until the map is updated.
+    virtual VoidResult find_many(Span<const KeyView> keys, Span<ValueView> values, Span<uint64_t> found) const noexcept = 0;
+
     VoidResult append(ProducerFn producer_fn) noexcept {
         Producer producer(producer_fn);
         return append(producer);
@@ -93,6 +101,26 @@ struct ICtrApi<Map<Key, Value>, Profile>: public CtrReferenceable<Profile> {
 
     virtual VoidResult insert(KeyView before, io::IOVectorProducer& producer) noexcept = 0;
 
+    // Loads sorted entries into an empty map. Each producer supplies a
+    // consecutive part of the input, producers are ordered by their keys.
+    // Leaves are filled by up to the given number of threads.
+    VoidResult bulk_load(const std::vector<ProducerFn>& producer_fns, size_t threads) noexcept
+    {
+        std::vector<Producer> producers;
+        std::vector<io::IOVectorProducer*> producer_ptrs;
+
+        producers.reserve(producer_fns.size());
+        for (const auto& producer_fn: producer_fns)
+        {
+            producers.emplace_back(producer_fn);
+            producer_ptrs.push_back(&producers.back());
+        }
+
+        return bulk_load(producer_ptrs, threads);
+    }
+
+    virtual VoidResult bulk_load(const std::vector<io::IOVectorProducer*>& producers, size_t threads) noexcept = 0;
+
     virtual Result<CtrSharedPtr<MapIterator<Key, Value, Profile>>> iterator() const noexcept = 0;
 
     MapScanner<ApiTypes, Profile> scanner() const {
@@ -69,6 +69,10 @@ struct ICtrApi<Set<Key>, Profile>: public CtrReferenceable<Profile> {
 
     virtual Result<CtrSharedPtr<SetIterator<Key, Profile>>> find(KeyView key) const noexcept = 0;
 
+    // Looks up a batch of keys without creating an iterator per key. Bit i
+    // of found is set if keys[i] is in the set and cleared otherwise.
+    virtual VoidResult find_many(Span<const KeyView> keys, Span<uint64_t> found) const noexcept = 0;
+
     virtual BoolResult contains(KeyView key) noexcept  = 0;
     virtual BoolResult remove(KeyView key) noexcept    = 0;
     virtual BoolResult insert(KeyView key) noexcept    = 0;
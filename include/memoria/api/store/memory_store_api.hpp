@@ -17,6 +17,7 @@
 
 #include <memoria/core/strings/strings.hpp>
 #include <memoria/core/tools/stream.hpp>
+#include <memoria/core/tools/block_codec.hpp>
 #include <memoria/core/tools/uuid.hpp>
 #include <memoria/core/memory/memory.hpp>
 #include <memoria/core/container/logs.hpp>
@@ -54,6 +55,10 @@ public:
     static Result<StorePtr> load(InputStreamHandler* input_stream) noexcept;
     static Result<StorePtr> load(U8String file_name) noexcept;
 
+    // Loads a full image followed by delta images written by
+    // store_delta(), in the order they were written.
+    static Result<StorePtr> load_chain(const std::vector<U8String>& file_names) noexcept;
+
     static Result<StorePtr> create() noexcept;
 
     virtual int64_t active_snapshots() noexcept = 0;
@@ -61,6 +66,27 @@ public:
     virtual VoidResult store(U8String file_name, int64_t wait_duration = 0) noexcept = 0;
     virtual VoidResult store(OutputStreamHandler* output_stream, int64_t wait_duration = 0) noexcept = 0;
 
+    // Incremental checkpoint: writes only history and data created since
+    // the last store(), store_delta() or load of the store. Loading it
+    // requires all the previous images of the chain, see load_chain().
+    virtual VoidResult store_delta(U8String file_name, int64_t wait_duration = 0) noexcept = 0;
+    virtual VoidResult store_delta(OutputStreamHandler* output_stream, int64_t wait_duration = 0) noexcept = 0;
+
+    // Fuzzy checkpoint: committed snapshots are pinned and written to the
+    // file by a background thread, while other snapshots are being created,
+    // committed and dropped. Active snapshots are not in the image. The
+    // image is full or delta, like the ones of store() and store_delta().
+    // Only one checkpoint may be running at a time, store() waits for it.
+    virtual VoidResult start_checkpoint(U8String file_name, bool delta = false) noexcept = 0;
+
+    // Waits for the running checkpoint, if any, and returns its result
+    virtual VoidResult wait_checkpoint() noexcept = 0;
+
+    // Compression of data blocks in images written after the call. It is
+    // recorded per block, so images with and without compression can be
+    // loaded and mixed in a chain. Level 0 is the codec's default.
+    virtual VoidResult set_block_compression(BlockCodec codec, int32_t level = 0) noexcept = 0;
+
     virtual Result<SnapshotPtr> master() noexcept = 0;
     virtual Result<SnapshotPtr> find(const SnapshotID& snapshot_id) noexcept = 0;
     virtual Result<SnapshotPtr> find_branch(U8StringRef name) noexcept = 0;
@@ -93,6 +93,24 @@ public:
 };
 
 
+// Background reclamation of dropped snapshots' data
+struct ReclamationStat {
+    // Dropped snapshots whose data is not freed yet
+    uint64_t pending_snapshots{};
+    // Persistent tree nodes queued for the snapshot being reclaimed
+    uint64_t pending_nodes{};
+
+    uint64_t reclaimed_snapshots{};
+    uint64_t reclaimed_nodes{};
+    uint64_t reclaimed_blocks{};
+    // Data blocks and persistent tree nodes
+    uint64_t reclaimed_bytes{};
+
+    // Data-less history nodes removed by pack()
+    uint64_t packed_history_nodes{};
+};
+
+
 template <typename Profile>
 class AllocatorMemoryStat {
     using SnpID = ProfileSnapshotID<Profile>;
@@ -101,6 +119,8 @@ class AllocatorMemoryStat {
     using SnapshotMap = std::unordered_map<SnpID, SharedPtr<SnapshotMemoryStat<Profile>>>;
     SnapshotMap snapshots_;
 
+    ReclamationStat reclamation_;
+
 public:
     AllocatorMemoryStat(): total_size_(0) {}
 
@@ -109,6 +129,9 @@ public:
 
     uint64_t total_size() const {return total_size_;}
 
+    const ReclamationStat& reclamation() const {return reclamation_;}
+    void set_reclamation(const ReclamationStat& stat) {reclamation_ = stat;}
+
     template <typename... Args>
     void add_snapshot_stat(SharedPtr<SnapshotMemoryStat<Profile>> snapshot_stat)
     {
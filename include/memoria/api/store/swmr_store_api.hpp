@@ -20,6 +20,19 @@
 
 namespace memoria {
 
+// When data of a commit reaches the disk:
+//  SYNC  - before commit() returns, one data and one header flush per commit;
+//  GROUP - before commit() returns, but the next writer may begin while
+//          the commit waits for it, so concurrent commits share the
+//          same data and header flush;
+//  ASYNC - commit() returns immediately, flushes are done by a background
+//          thread. Use ISWMRStore::wait_durable() with the commit's
+//          sequence ID to wait for it.
+// In GROUP and ASYNC modes a commit is visible to readers before it's
+// durable. If its flush fails, the error is returned to the waiters and
+// the next flush, or wait for the commit, tries again.
+enum class SWMRDurability {SYNC, GROUP, ASYNC};
+
 template <typename Profile>
 struct ISWMRStoreCommitBase: IStoreSnapshotCtrOps<Profile> {
     using CommitID = int64_t;
@@ -29,7 +42,12 @@ struct ISWMRStoreCommitBase: IStoreSnapshotCtrOps<Profile> {
 
 template <typename Profile>
 struct ISWMRStoreWritableCommit: ISWMRStoreCommitBase<Profile>, IStoreWritableSnapshotCtrOps<Profile> {
+    using SequenceID = uint64_t;
+
     virtual VoidResult commit() noexcept = 0;
+
+    // Durability ticket of this commit, valid after commit()
+    virtual SequenceID sequence_id() noexcept = 0;
     virtual VoidResult rollback() noexcept = 0;
 
     virtual VoidResult set_persistent(bool persistent) noexcept = 0;
@@ -46,6 +64,7 @@ struct ISWMRStore {
     using WritableCommitPtr = SharedPtr<ISWMRStoreWritableCommit<Profile>>;
     using ReadOnlyCommitPtr = SharedPtr<ISWMRStoreReadOnlyCommit<Profile>>;
     using CommitID = int64_t;
+    using SequenceID = uint64_t;
 
     virtual ~ISWMRStore() noexcept {}
 
@@ -59,6 +78,16 @@ struct ISWMRStore {
     virtual Result<WritableCommitPtr> begin() noexcept = 0;
 
     virtual VoidResult close() noexcept = 0;
+
+    virtual VoidResult set_durability(SWMRDurability durability) noexcept = 0;
+    virtual SWMRDurability durability() noexcept = 0;
+
+    // Sequence ID of the latest commit which superblock is on disk
+    virtual SequenceID durable_sequence_id() noexcept = 0;
+
+    // Makes all finished commits durable, returns the durable sequence ID
+    virtual Result<SequenceID> flush() noexcept = 0;
+    virtual VoidResult wait_durable(SequenceID sequence_id) noexcept = 0;
 };
 
 
@@ -151,6 +151,47 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(alcmap::CtrApiName)
         return CtrSizeTResult::of();
     }
 
+    // Free runs of the leaf's bitmap at the level. Positions are level-0,
+    // sizes are in blocks of the level.
+    struct FindUnallocatedFn {
+        template <typename T>
+        Result<CtrSizeT> treeNode(
+                T&& node_so,
+                CtrSizeT leaf_pos,
+                int32_t level,
+                CtrSizeT required,
+                ArenaBuffer<AllocationMetadata<Profile>>& buffer
+        ) const noexcept
+        {
+            auto bitmap = node_so.template substream_by_idx<1>();
+
+            const auto* symbols = bitmap.data()->symbols(level);
+            size_t bm_size = bitmap.data()->size(level);
+
+            CtrSizeT found{};
+            size_t pos{};
+            while (pos < bm_size && found < required)
+            {
+                pos += CountOneFw(symbols, pos, bm_size);
+
+                size_t run = CountZeroFw(symbols, pos, bm_size);
+                if (run > 0)
+                {
+                    buffer.append_value(AllocationMetadata<Profile>{
+                        leaf_pos + (static_cast<CtrSizeT>(pos) << level),
+                        static_cast<CtrSizeT>(run),
+                        level
+                    });
+
+                    found += run;
+                    pos   += run;
+                }
+            }
+
+            return Result<CtrSizeT>::of(found);
+        }
+    };
+
     virtual VoidResult find_unallocated(
         CtrSizeT from,
         int32_t level,
@@ -159,25 +200,21 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(alcmap::CtrApiName)
     ) noexcept
     {
         auto& self = this->self();
-        auto ii = self.template ctr_select<IntList<0, 1>>(level, 1);
-        MEMORIA_RETURN_IF_ERROR(ii);
+        MEMORIA_TRY(ii, self.ctr_seek(from));
 
         CtrSizeT sum{};
-        while (!ii.get()->is_end())
+        while (!ii->is_end() && sum < required)
         {
-            MEMORIA_TRY(available, ii.get()->count_fw());
-            sum += available;
-
-            MEMORIA_TRY(level0_pos, ii.get()->level0_pos());
+            MEMORIA_TRY(leaf_pos, ii->level0_pos());
+            leaf_pos -= ii->iter_local_pos();
 
-            buffer.append_value(AllocationMetadata<Profile>{level0_pos, available, level});
+            MEMORIA_TRY(found, self.leaf_dispatcher().dispatch(
+                ii->path().leaf(), FindUnallocatedFn(), leaf_pos, level, required - sum, buffer
+            ));
+            sum += found;
 
-            if (sum < required)
-            {
-                auto res = ii.get()->template iter_select_fw<IntList<0, 1>>(level, 1);
-                MEMORIA_RETURN_IF_ERROR(res);
-            }
-            else {
+            MEMORIA_TRY(has_next, ii->next_leaf());
+            if (!has_next) {
                 break;
             }
         }
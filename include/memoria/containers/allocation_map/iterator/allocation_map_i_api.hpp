@@ -77,6 +77,9 @@ MEMORIA_V1_ITERATOR_PART_BEGIN(alcmap::ItrApiName)
         CtrSizeT remainder = size;
         while (accum < size)
         {
+            // Leaves of the previous commits are shared
+            MEMORIA_TRY_VOID(self.ctr().ctr_cow_clone_path(self.path(), 0));
+
             MEMORIA_TRY(processed, self.ctr().leaf_dispatcher().dispatch(self.path().leaf(), SetClearBitsFn(), local_pos, level, remainder, set_bits));
 
             accum += processed;
@@ -93,7 +96,7 @@ MEMORIA_V1_ITERATOR_PART_BEGIN(alcmap::ItrApiName)
                 self.iter_local_pos() = local_pos = 0;
             }
             else {
-                self.iter_local_pos() = processed << level;
+                self.iter_local_pos() = (local_pos + processed) << level;
             }
         }
 
@@ -136,7 +139,8 @@ MEMORIA_V1_ITERATOR_PART_BEGIN(alcmap::ItrApiName)
         PosWalker walker{};
         MEMORIA_TRY_VOID(self.iter_walk_up_for_refresh(self.path(), 0, self.iter_local_pos(), walker));
 
-        return ResultT::of(walker.prefix_);
+        // The walker sums sizes of preceding leaves only
+        return ResultT::of(walker.prefix_ + self.iter_local_pos());
     }
 
 
@@ -93,6 +93,11 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(map::CtrApiName)
         return memoria_static_pointer_cast<MapIterator<Key, Value, Profile>>(std::move(iter));
     }
 
+    virtual VoidResult find_many(Span<const KeyView> keys, Span<ValueView> values, Span<uint64_t> found) const noexcept
+    {
+        return self().ctr_map_find_many(keys, values, found);
+    }
+
     VoidResult append(io::IOVectorProducer& producer) noexcept
     {
         auto& self = this->self();
@@ -103,6 +108,12 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(map::CtrApiName)
         return VoidResult::of();
     }
 
+    virtual VoidResult bulk_load(const std::vector<io::IOVectorProducer*>& producers, size_t threads) noexcept
+    {
+        MEMORIA_TRY_VOID(self().ctr_bulk_load_iovector(producers, threads));
+        return VoidResult::of();
+    }
+
     virtual VoidResult prepend(io::IOVectorProducer& producer) noexcept
     {
         auto& self = this->self();
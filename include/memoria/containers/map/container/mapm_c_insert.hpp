@@ -22,6 +22,10 @@
 #include <memoria/core/container/container.hpp>
 #include <memoria/core/container/macros.hpp>
 
+#include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/span.hpp>
+
+#include <algorithm>
 #include <vector>
 
 namespace memoria {
@@ -58,6 +62,35 @@ public:
         return self().template ctr_find_max_ge<IntList<0, 1>>(0, k);
     }
 
+    VoidResult ctr_map_find_many(Span<const KeyView> keys, Span<ValueView> values, Span<uint64_t> found) const noexcept
+    {
+        auto& self = this->self();
+
+        if (values.size() < keys.size() || found.size() * 64 < keys.size()) {
+            return MEMORIA_MAKE_GENERIC_ERROR(
+                "Output buffers are too small for {} keys: values = {}, found bits = {}",
+                keys.size(), values.size(), found.size() * 64
+            );
+        }
+
+        std::fill(found.begin(), found.end(), 0);
+        uint64_t* found_bits = found.data();
+
+        return self.template ctr_find_max_ge_many<IntList<0, 1>>(0, keys, [&](size_t key_idx, const NodeBaseG& leaf, int32_t idx) -> VoidResult {
+            MEMORIA_TRY(key, self.template iter_read_leaf_entry<IntList<1>>(leaf, idx, 0));
+
+            if (std::get<0>(key) == keys[key_idx])
+            {
+                MEMORIA_TRY(value, self.template iter_read_leaf_entry<IntList<2>>(leaf, idx));
+
+                values[key_idx] = std::get<0>(value);
+                SetBit(found_bits, key_idx, 1);
+            }
+
+            return VoidResult::of();
+        });
+    }
+
 
     Result<bool> remove(const KeyView& k) noexcept
     {
@@ -78,6 +78,11 @@ public:
         return memoria_static_pointer_cast<SetIterator<Key, Profile>>(self().ctr_set_find(key));
     }
 
+    VoidResult find_many(Span<const KeyView> keys, Span<uint64_t> found) const noexcept
+    {
+        return self().ctr_set_find_many(keys, found);
+    }
+
 //    bool contains_element(KeyView key) {
 //        return false;
 //    }
@@ -22,6 +22,10 @@
 #include <memoria/core/container/container.hpp>
 #include <memoria/core/container/macros.hpp>
 
+#include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/span.hpp>
+
+#include <algorithm>
 #include <vector>
 
 namespace memoria {
@@ -56,6 +60,30 @@ public:
         return self().template ctr_find_max_ge<IntList<0, 1>>(0, k);
     }
 
+    VoidResult ctr_set_find_many(Span<const KeyView> keys, Span<uint64_t> found) const noexcept
+    {
+        auto& self = this->self();
+
+        if (found.size() * 64 < keys.size()) {
+            return MEMORIA_MAKE_GENERIC_ERROR(
+                "Output buffer is too small for {} keys: found bits = {}", keys.size(), found.size() * 64
+            );
+        }
+
+        std::fill(found.begin(), found.end(), 0);
+        uint64_t* found_bits = found.data();
+
+        return self.template ctr_find_max_ge_many<IntList<0, 1>>(0, keys, [&](size_t key_idx, const NodeBaseG& leaf, int32_t idx) -> VoidResult {
+            MEMORIA_TRY(key, self.template iter_read_leaf_entry<IntList<1>>(leaf, idx, 0));
+
+            if (std::get<0>(key) == keys[key_idx]) {
+                SetBit(found_bits, key_idx, 1);
+            }
+
+            return VoidResult::of();
+        });
+    }
+
 
 
 MEMORIA_V1_CONTAINER_PART_END
@@ -131,6 +131,11 @@ struct ICoWAllocator: IAllocatorBase<Profile> {
     virtual BoolResult unref_block(BlockG block) noexcept = 0;
     virtual VoidResult unref_ctr_root(const BlockID& root_block_id) noexcept = 0;
 
+    // Like unref_block(), for a node of the container with the given root.
+    // Stores resolving counters at commit time return false, and release
+    // the node's children themselves when its counter drops to zero.
+    virtual BoolResult unref_ctr_block(BlockG block, const BlockID& ctr_root_id) noexcept = 0;
+
     virtual VoidResult traverse_ctr(
             BlockID root_block,
             BTreeTraverseNodeHandler<Profile>& node_handler
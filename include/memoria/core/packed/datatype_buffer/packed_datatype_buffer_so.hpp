@@ -27,6 +27,7 @@
 
 #include <memoria/core/tools/span.hpp>
 #include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/arena_buffer.hpp>
 
 #include <memoria/core/iovector/io_substream_base.hpp>
 
@@ -211,6 +212,13 @@ public:
         return DataTypeTraits<DataType>::make_view(*ext_data_, data);
     }
 
+    // Rows [start, end) as a contiguous span. 1D fixed-size values are
+    // returned in place, other types are decoded into the buffer.
+    Span<const ViewType> read_batch(int32_t column, psize_t start, psize_t end, ArenaBuffer<ViewType>& buffer) const noexcept
+    {
+        return read_batch(start, end, buffer, BoolValue<DTTIs1DFixedSize<DataType>>());
+    }
+
     DataDimensionsTuple access_data(psize_t row) const noexcept
     {
         DataDimensionsTuple data{};
@@ -647,6 +655,22 @@ private:
     static VoidResult for_each_dimension_res(Fn&& fn) noexcept {
         return ForEach<0, Dimensions>::process_res_fn(fn);
     }
+
+private:
+    Span<const ViewType> read_batch(psize_t start, psize_t end, ArenaBuffer<ViewType>& buffer, BoolValue<true>) const noexcept
+    {
+        return Span<const ViewType>(data_->template dimension<0>().data() + start, end - start);
+    }
+
+    Span<const ViewType> read_batch(psize_t start, psize_t end, ArenaBuffer<ViewType>& buffer, BoolValue<false>) const noexcept
+    {
+        buffer.clear();
+        for (psize_t row = start; row < end; row++) {
+            buffer.append_value(access(row));
+        }
+
+        return buffer.span();
+    }
 };
 
 
@@ -294,13 +294,13 @@ public:
                 BitmapType* tgt_bitmap = this->symbols(c + 1);
 
                 int32_t atom_bits_size = sizeof(BitmapType) * 8;
-                int32_t bitmap_atoms_size = local_bitmap_size / atom_bits_size;
+                int32_t bitmap_atoms_size = divUp(local_bitmap_size, atom_bits_size);
 
                 for (int32_t bms = 0; bms < bitmap_atoms_size; bms += 2)
                 {
                     BitmapType a1 = src_bitmap[bms];
-                    BitmapType a2 = src_bitmap[bms + 1];
-                    BitmapType rs = a1 | (a2 << atom_bits_size / 2);
+                    BitmapType a2 = bms + 1 < bitmap_atoms_size ? src_bitmap[bms + 1] : 0;
+                    BitmapType rs = fold_pairs(a1) | (fold_pairs(a2) << atom_bits_size / 2);
                     tgt_bitmap[bms / 2] = rs;
                 }
             }
@@ -666,6 +666,19 @@ private:
         return ones & make_half_mask();
     }
 
+    // A block of the next level is allocated if any of its halves is.
+    // Bit i of the result is (bit 2i | bit 2i + 1) of the value.
+    static BitmapType fold_pairs(BitmapType value) noexcept
+    {
+        value = (value | (value >> 1)) & 0x5555555555555555ull;
+        value = (value | (value >> 1)) & 0x3333333333333333ull;
+        value = (value | (value >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+        value = (value | (value >> 4)) & 0x00FF00FF00FF00FFull;
+        value = (value | (value >> 8)) & 0x0000FFFF0000FFFFull;
+        value = (value | (value >> 16)) & 0x00000000FFFFFFFFull;
+        return value;
+    }
+
     void rebuild_bitmaps(int32_t level_from) noexcept
     {
         int32_t bitmap_size = this->size();
@@ -676,13 +689,13 @@ private:
             BitmapType* tgt_bitmap = this->symbols(c + 1);
 
             int32_t atom_bits_size = sizeof(BitmapType) * 8;
-            int32_t bitmap_atoms_size = local_bitmap_size / atom_bits_size;
+            int32_t bitmap_atoms_size = divUp(local_bitmap_size, atom_bits_size);
 
             for (int32_t bms = 0; bms < bitmap_atoms_size; bms += 2)
             {
                 BitmapType a1 = src_bitmap[bms];
-                BitmapType a2 = src_bitmap[bms + 1];
-                BitmapType rs = a1 | (a2 << atom_bits_size / 2);
+                BitmapType a2 = bms + 1 < bitmap_atoms_size ? src_bitmap[bms + 1] : 0;
+                BitmapType rs = fold_pairs(a1) | (fold_pairs(a2) << atom_bits_size / 2);
                 tgt_bitmap[bms / 2] = rs;
             }
         }
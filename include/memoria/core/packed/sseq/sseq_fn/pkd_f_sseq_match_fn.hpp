@@ -0,0 +1,314 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/types/algo/select.hpp>
+#include <memoria/core/tools/bitmap_select.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace memoria {
+
+// Rank and select of a symbol in a packed sequence of 2-8-bit symbols,
+// a window of up to 64 bits at a time. The window is XORed with the symbol
+// replicated into every field, so matching fields become zero. Adding the
+// low-bits mask to the low bits of a field carries into the field's high
+// bit unless they are all zero, and never into the next field, so the
+// zero fields are found exactly. The resulting mask has the high bit of
+// each matching field set: rank is its popcount and select finishes with
+// SelectFW() in the final window.
+//
+// 2- and 4-bit symbols never cross word boundaries and 8-bit symbols are
+// bytes, for them there are AVX2 kernels processing 256 bits per step,
+// selected at runtime.
+
+template <int32_t BitsPerSymbol>
+class SymbolMatchFn {
+
+    static_assert(BitsPerSymbol > 1 && BitsPerSymbol <= 8,
+            "SymbolMatchFn<> can only be used with 2-8-bit sequences");
+
+public:
+    using Value = IfThenElse<BitsPerSymbol == 8, uint8_t, uint64_t>;
+
+    static constexpr int32_t SymbolsPerWindow = 64 / BitsPerSymbol;
+
+private:
+    static constexpr bool HasAVX2Kernels = BitsPerSymbol == 2 || BitsPerSymbol == 4 || BitsPerSymbol == 8;
+
+    static constexpr uint64_t make_low_fields() noexcept
+    {
+        uint64_t fields = 0;
+        for (int32_t c = 0; c < SymbolsPerWindow; c++) {
+            fields |= 1ull << (c * BitsPerSymbol);
+        }
+        return fields;
+    }
+
+    // Lowest and highest bits of every field, and all bits of every field
+    // but the highest one
+    static constexpr uint64_t LowFields  = make_low_fields();
+    static constexpr uint64_t HighFields = LowFields << (BitsPerSymbol - 1);
+    static constexpr uint64_t LowBits    = HighFields - LowFields;
+
+    static constexpr uint64_t zero_fields(uint64_t x) noexcept {
+        return ~(((x & LowBits) + LowBits) | x) & HighFields;
+    }
+
+    static constexpr uint64_t valid_fields(int32_t size) noexcept
+    {
+        return size == SymbolsPerWindow ?
+                    HighFields :
+                    HighFields & ((1ull << (size * BitsPerSymbol)) - 1);
+    }
+
+    // Symbols [pos, pos + size) at the low end of a word, higher bits are
+    // unspecified.
+    static uint64_t window(const uint64_t* buf, int32_t pos, int32_t size) noexcept
+    {
+        size_t bit   = static_cast<size_t>(pos) * BitsPerSymbol;
+        size_t word  = bit >> 6;
+        size_t shift = bit & 63;
+
+        uint64_t value = buf[word] >> shift;
+        if (shift + size * BitsPerSymbol > 64) {
+            value |= buf[word + 1] << (64 - shift);
+        }
+
+        return value;
+    }
+
+    static uint64_t window(const uint8_t* buf, int32_t pos, int32_t size) noexcept
+    {
+        uint64_t value = 0;
+        std::memcpy(&value, buf + pos, size);
+        return value;
+    }
+
+    static uint64_t matches(const Value* buf, int32_t pos, int32_t size, uint64_t pattern) noexcept {
+        return zero_fields(window(buf, pos, size) ^ pattern) & valid_fields(size);
+    }
+
+public:
+    static int32_t rank_portable(const Value* buf, int32_t start, int32_t end, uint64_t symbol) noexcept
+    {
+        uint64_t pattern = symbol * LowFields;
+
+        int32_t cnt = 0;
+        for (int32_t pos = start; pos < end; pos += SymbolsPerWindow)
+        {
+            int32_t size = std::min<int32_t>(end - pos, +SymbolsPerWindow);
+            cnt += PopCnt(matches(buf, pos, size, pattern));
+        }
+
+        return cnt;
+    }
+
+    static SelectResult select_portable(const Value* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank) noexcept
+    {
+        uint64_t pattern = symbol * LowFields;
+
+        int32_t cnt = 0;
+        for (int32_t pos = start; pos < end; pos += SymbolsPerWindow)
+        {
+            int32_t size = std::min<int32_t>(end - pos, +SymbolsPerWindow);
+            uint64_t mask = matches(buf, pos, size, pattern);
+            int32_t popcnt = PopCnt(mask);
+
+            if (rank > cnt && rank <= cnt + popcnt)
+            {
+                size_t bit = SelectFW(mask, rank - cnt);
+                return SelectResult(pos + bit / BitsPerSymbol, rank, true);
+            }
+
+            cnt += popcnt;
+        }
+
+        return SelectResult(end, cnt, false);
+    }
+
+    static int32_t rank(const Value* buf, int32_t start, int32_t end, uint64_t symbol) noexcept {
+        return rank(buf, start, end, symbol, BoolValue<HasAVX2Kernels>());
+    }
+
+    static SelectResult select(const Value* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank) noexcept {
+        return select(buf, start, end, symbol, rank, BoolValue<HasAVX2Kernels>());
+    }
+
+private:
+    static int32_t rank(const Value* buf, int32_t start, int32_t end, uint64_t symbol, BoolValue<false>) noexcept {
+        return rank_portable(buf, start, end, symbol);
+    }
+
+    static SelectResult select(const Value* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank, BoolValue<false>) noexcept {
+        return select_portable(buf, start, end, symbol, rank);
+    }
+
+    static int32_t rank(const Value* buf, int32_t start, int32_t end, uint64_t symbol, BoolValue<true>) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return rank_avx2(buf, start, end, symbol);
+        }
+#endif
+        return rank_portable(buf, start, end, symbol);
+    }
+
+    static SelectResult select(const Value* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank, BoolValue<true>) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return select_avx2(buf, start, end, symbol, rank);
+        }
+#endif
+        return select_portable(buf, start, end, symbol, rank);
+    }
+
+#ifdef MMA_X86_SIMD
+    // Per 64-bit lane popcount: 4-bit lookups and a sum of bytes
+    MMA_TARGET("avx2")
+    static __m256i popcount_epi64(__m256i x) noexcept
+    {
+        const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+        );
+        const __m256i low4 = _mm256_set1_epi8(0x0F);
+
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low4));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low4));
+
+        return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+    }
+
+    MMA_TARGET("avx2")
+    static int32_t hsum_epi64(__m256i x) noexcept
+    {
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+        return static_cast<int32_t>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+    }
+
+    // Match masks of 4 whole words
+    MMA_TARGET("avx2")
+    static __m256i matches_avx2(const uint64_t* words, __m256i pattern) noexcept
+    {
+        const __m256i low_bits    = _mm256_set1_epi64x(LowBits);
+        const __m256i high_fields = _mm256_set1_epi64x(HighFields);
+
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words)), pattern);
+        __m256i y = _mm256_add_epi64(_mm256_and_si256(x, low_bits), low_bits);
+
+        return _mm256_andnot_si256(_mm256_or_si256(y, x), high_fields);
+    }
+
+    MMA_TARGET("avx2")
+    static int32_t rank_avx2(const uint64_t* buf, int32_t start, int32_t end, uint64_t symbol) noexcept
+    {
+        constexpr int32_t StepSymbols = SymbolsPerWindow * 4;
+
+        int32_t pos = std::min(end, (start + SymbolsPerWindow - 1) / SymbolsPerWindow * SymbolsPerWindow);
+        int32_t cnt = rank_portable(buf, start, pos, symbol);
+
+        const __m256i pattern = _mm256_set1_epi64x(symbol * LowFields);
+
+        __m256i counts = _mm256_setzero_si256();
+        for (; pos + StepSymbols <= end; pos += StepSymbols) {
+            counts = _mm256_add_epi64(counts, popcount_epi64(matches_avx2(buf + pos / SymbolsPerWindow, pattern)));
+        }
+
+        return cnt + hsum_epi64(counts) + rank_portable(buf, pos, end, symbol);
+    }
+
+    MMA_TARGET("avx2")
+    static SelectResult select_avx2(const uint64_t* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank) noexcept
+    {
+        constexpr int32_t StepSymbols = SymbolsPerWindow * 4;
+
+        int32_t pos = std::min(end, (start + SymbolsPerWindow - 1) / SymbolsPerWindow * SymbolsPerWindow);
+
+        SelectResult head = select_portable(buf, start, pos, symbol, rank);
+        if (head.is_found()) {
+            return head;
+        }
+
+        int32_t cnt = head.rank();
+
+        const __m256i pattern = _mm256_set1_epi64x(symbol * LowFields);
+
+        for (; pos + StepSymbols <= end; pos += StepSymbols)
+        {
+            int32_t step_cnt = hsum_epi64(popcount_epi64(matches_avx2(buf + pos / SymbolsPerWindow, pattern)));
+            if (rank > cnt && rank <= cnt + step_cnt) {
+                break;
+            }
+
+            cnt += step_cnt;
+        }
+
+        SelectResult tail = select_portable(buf, pos, end, symbol, rank - cnt);
+        return SelectResult(tail.local_pos(), cnt + tail.rank(), tail.is_found());
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static int32_t rank_avx2(const uint8_t* buf, int32_t start, int32_t end, uint64_t symbol) noexcept
+    {
+        const __m256i pattern = _mm256_set1_epi8(static_cast<char>(symbol));
+
+        int32_t cnt = 0;
+        int32_t pos = start;
+
+        for (; pos + 32 <= end; pos += 32)
+        {
+            __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + pos));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, pattern)));
+
+            cnt += _mm_popcnt_u32(mask);
+        }
+
+        return cnt + rank_portable(buf, pos, end, symbol);
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static SelectResult select_avx2(const uint8_t* buf, int32_t start, int32_t end, uint64_t symbol, int32_t rank) noexcept
+    {
+        const __m256i pattern = _mm256_set1_epi8(static_cast<char>(symbol));
+
+        int32_t cnt = 0;
+        int32_t pos = start;
+
+        for (; pos + 32 <= end; pos += 32)
+        {
+            __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + pos));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, pattern)));
+
+            int32_t popcnt = _mm_popcnt_u32(mask);
+            if (rank > cnt && rank <= cnt + popcnt) {
+                return SelectResult(pos + SelectFW(mask, rank - cnt), rank, true);
+            }
+
+            cnt += popcnt;
+        }
+
+        SelectResult tail = select_portable(buf, pos, end, symbol, rank - cnt);
+        return SelectResult(tail.local_pos(), cnt + tail.rank(), tail.is_found());
+    }
+#endif
+};
+
+}
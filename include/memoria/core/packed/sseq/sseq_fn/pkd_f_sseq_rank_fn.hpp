@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memoria/core/tools/bitmap_select.hpp>
+#include <memoria/core/packed/sseq/sseq_fn/pkd_f_sseq_match_fn.hpp>
 
 
 namespace memoria {
@@ -64,19 +65,7 @@ public:
 
     int32_t operator()(int32_t start, int32_t end, Value symbol)
     {
-        int32_t cnt = 0;
-
-        auto buf = seq_.symbols();
-
-        for (int32_t c = start * BitsPerSymbol; c < end * BitsPerSymbol; c += BitsPerSymbol)
-        {
-            if (TestBits(buf, c, symbol, BitsPerSymbol))
-            {
-                cnt++;
-            }
-        }
-
-        return cnt;
+        return SymbolMatchFn<BitsPerSymbol>::rank(seq_.symbols(), start, end, symbol);
     }
 };
 
@@ -97,19 +86,7 @@ public:
 
     int32_t operator()(int32_t start, int32_t end, int32_t symbol)
     {
-        int32_t cnt = 0;
-
-        auto buf = seq_.symbols();
-
-        for (int32_t c = start; c < end; c++)
-        {
-            if (buf[c] == symbol)
-            {
-                cnt++;
-            }
-        }
-
-        return cnt;
+        return SymbolMatchFn<BitsPerSymbol>::rank(seq_.symbols(), start, end, symbol);
     }
 };
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memoria/core/tools/bitmap_select.hpp>
+#include <memoria/core/packed/sseq/sseq_fn/pkd_f_sseq_match_fn.hpp>
 
 
 namespace memoria {
@@ -61,24 +62,7 @@ public:
 
     SelectResult operator()(int32_t start, int32_t end, Value symbol, int32_t rank)
     {
-        int32_t cnt = 0;
-
-        auto buf = seq_.symbols();
-
-        for (int32_t c = start * BitsPerSymbol; c < end * BitsPerSymbol; c += BitsPerSymbol)
-        {
-            if (TestBits(buf, c, symbol, BitsPerSymbol))
-            {
-                cnt++;
-
-                if (cnt == rank)
-                {
-                    return SelectResult(c / BitsPerSymbol, rank, true);
-                }
-            }
-        }
-
-        return SelectResult(end, cnt, false);
+        return SymbolMatchFn<BitsPerSymbol>::select(seq_.symbols(), start, end, symbol, rank);
     }
 };
 
@@ -103,23 +87,7 @@ public:
 
     SelectResult operator()(int32_t start, int32_t end, int32_t symbol, int32_t rank)
     {
-        int32_t cnt = 0;
-
-        auto buf = seq_.symbols();
-
-        for (int32_t c = start; c < end; c++)
-        {
-            if (buf[c] == symbol)
-            {
-                cnt++;
-                if (cnt == rank)
-                {
-                    return SelectResult(c, rank, true);
-                }
-            }
-        }
-
-        return SelectResult(end, cnt, false);
+        return SymbolMatchFn<BitsPerSymbol>::select(seq_.symbols(), start, end, symbol, rank);
     }
 };
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memoria/core/packed/tree/fse/packed_fse_quick_tree_base.hpp>
+#include <memoria/core/packed/tree/fse/packed_fse_tools.hpp>
 
 #include <memoria/core/tools/static_array.hpp>
 #include <memoria/profiles/common/block_operations.hpp>
@@ -27,7 +28,13 @@
 
 namespace memoria {
 
-template <typename IndexDataTypeT, int32_t kBlocks, typename ValueDataTypeT = IndexDataTypeT, int32_t kBranchingFactor = PackedTreeBranchingFactor, int32_t kValuesPerBranch = PackedTreeBranchingFactor>
+template <
+    typename IndexDataTypeT,
+    int32_t kBlocks,
+    typename ValueDataTypeT = IndexDataTypeT,
+    int32_t kBranchingFactor = PkdFQTreeShapeProvider<ValueDataTypeT>::BranchingFactor,
+    int32_t kValuesPerBranch = PkdFQTreeShapeProvider<ValueDataTypeT>::ValuesPerBranch
+>
 struct PkdFQTreeTypes {
     using IndexDataType    = IndexDataTypeT;
     using ValueDataType    = IndexDataTypeT;
@@ -43,7 +50,13 @@ struct PkdFQTreeTypes {
 template <typename Types> class PkdFQTree;
 
 
-template <typename IndexValueT, int32_t kBlocks = 1, typename ValueT = IndexValueT, int32_t kBranchingFactor = PackedTreeBranchingFactor, int32_t kValuesPerBranch = PackedTreeBranchingFactor>
+template <
+    typename IndexValueT,
+    int32_t kBlocks = 1,
+    typename ValueT = IndexValueT,
+    int32_t kBranchingFactor = PkdFQTreeShapeProvider<ValueT>::BranchingFactor,
+    int32_t kValuesPerBranch = PkdFQTreeShapeProvider<ValueT>::ValuesPerBranch
+>
 using PkdFQTreeT = PkdFQTree<PkdFQTreeTypes<IndexValueT, kBlocks, ValueT, kBranchingFactor, kValuesPerBranch>>;
 
 
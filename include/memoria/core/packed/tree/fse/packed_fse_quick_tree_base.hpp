@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memoria/core/packed/tree/fse/packed_fse_quick_tree_base_base.hpp>
+#include <memoria/core/packed/tree/fse/packed_fse_quick_tree_scan.hpp>
 
 #include <memoria/core/tools/assert.hpp>
 #include <memoria/core/tools/result.hpp>
@@ -225,6 +226,16 @@ public:
             sum_ += next_;
         }
 
+        template <typename T>
+        int32_t scan_fw(const T* values, int32_t start, int32_t end) {
+            return PkdFQTreeScanFn<IndexValue, T>::template scan_fw<false>(values, start, end, sum_, target_);
+        }
+
+        template <typename T>
+        int32_t scan_bw(const T* values, int32_t start, int32_t end) {
+            return PkdFQTreeScanFn<IndexValue, T>::template scan_bw<false>(values, start, end, sum_, target_);
+        }
+
         int32_t& local_pos() {return idx_;}
         const int32_t& local_pos() const {return idx_;}
 
@@ -259,6 +270,16 @@ public:
             sum_ += next_;
         }
 
+        template <typename T>
+        int32_t scan_fw(const T* values, int32_t start, int32_t end) {
+            return PkdFQTreeScanFn<IndexValue, T>::template scan_fw<true>(values, start, end, sum_, target_);
+        }
+
+        template <typename T>
+        int32_t scan_bw(const T* values, int32_t start, int32_t end) {
+            return PkdFQTreeScanFn<IndexValue, T>::template scan_bw<true>(values, start, end, sum_, target_);
+        }
+
         int32_t& local_pos() {return idx_;}
         const int32_t& local_pos() const {return idx_;}
 
@@ -316,18 +337,7 @@ public:
 
         if (this->element_size(block * SegmentsPerBlock + 1) == 0)
         {
-            for (int32_t c = 0; c < size; c++)
-            {
-                if (walker.compare(values[c]))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    walker.next();
-                }
-            }
-
-            return walker.idx(size);
+            return walker.idx(walker.scan_fw(values, 0, size));
         }
         else {
             TreeLayout data;
@@ -341,19 +351,7 @@ public:
             if (idx >= 0)
             {
                 idx <<= ValuesPerBranchLog2;
-
-                for (int32_t c = idx; c < size; c++)
-                {
-                    if (walker.compare(values[c]))
-                    {
-                        return walker.idx(c);
-                    }
-                    else {
-                        walker.next();
-                    }
-                }
-
-                return walker.idx(size);
+                return walker.idx(scan_window_fw(walker, values, idx, size));
             }
             else {
                 return walker.idx(size);
@@ -373,31 +371,15 @@ public:
 
         if (start >= size - ValuesPerBranch * 2)
         {
-            for (int32_t c = start; c < size; c++)
-            {
-                if (walker.compare(values[c]))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    walker.next();
-                }
-            }
-
-            return walker.idx(size);
+            return walker.idx(walker.scan_fw(values, start, size));
         }
         else {
             int32_t window_end = (start | ValuesPerBranchMask) + 1;
 
-            for (int32_t c = start; c < window_end; c++)
+            int32_t pos = walker.scan_fw(values, start, window_end);
+            if (pos < window_end)
             {
-                if (walker.compare(values[c]))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    walker.next();
-                }
+                return walker.idx(pos);
             }
 
             TreeLayout data;
@@ -416,19 +398,7 @@ public:
             if (idx >= 0)
             {
                 idx <<= ValuesPerBranchLog2;
-
-                for (int32_t c = idx; c < size; c++)
-                {
-                    if (walker.compare(values[c]))
-                    {
-                        return walker.idx(c);
-                    }
-                    else {
-                        walker.next();
-                    }
-                }
-
-                return walker.idx(size);
+                return walker.idx(scan_window_fw(walker, values, idx, size));
             }
             else {
                 return walker.idx(size);
@@ -446,31 +416,15 @@ public:
 
         if (start < ValuesPerBranch * 2)
         {
-            for (int32_t c = start; c >= 0; c--)
-            {
-                if (walker.compare(values[c]))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    walker.next();
-                }
-            }
-
-            return walker.idx(-1);
+            return walker.idx(walker.scan_bw(values, start, -1));
         }
         else {
             int32_t window_end = (start & ~ValuesPerBranchMask) - 1;
 
-            for (int32_t c = start; c > window_end; c--)
+            int32_t pos = walker.scan_bw(values, start, window_end);
+            if (pos > window_end)
             {
-                if (walker.compare(values[c]))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    walker.next();
-                }
+                return walker.idx(pos);
             }
 
             TreeLayout data;
@@ -489,19 +443,7 @@ public:
             if (idx >= 0)
             {
                 int32_t window_start = ((idx + 1) << ValuesPerBranchLog2) - 1;
-
-                for (int32_t c = window_start; c >= 0; c--)
-                {
-                    if (walker.compare(values[c]))
-                    {
-                        return walker.idx(c);
-                    }
-                    else {
-                        walker.next();
-                    }
-                }
-
-                return walker.idx(-1);
+                return walker.idx(scan_window_bw(walker, values, window_start));
             }
             else {
                 return walker.idx(-1);
@@ -511,6 +453,35 @@ public:
 
 
 
+    // The window the index has pointed to normally contains the position,
+    // the rest of the values is scanned separately. This way PkdFQTreeScanFn
+    // sees the actual length of the scan.
+    template <typename Walker>
+    int32_t scan_window_fw(Walker& walker, const Value* values, int32_t start, int32_t size) const
+    {
+        int32_t window_end = std::min(start + ValuesPerBranch, size);
+
+        int32_t pos = walker.scan_fw(values, start, window_end);
+        if (pos < window_end) {
+            return pos;
+        }
+
+        return walker.scan_fw(values, window_end, size);
+    }
+
+    template <typename Walker>
+    int32_t scan_window_bw(Walker& walker, const Value* values, int32_t start) const
+    {
+        int32_t window_end = std::max(start - ValuesPerBranch, -1);
+
+        int32_t pos = walker.scan_bw(values, start, window_end);
+        if (pos > window_end) {
+            return pos;
+        }
+
+        return walker.scan_bw(values, window_end, -1);
+    }
+
     IndexValue sum(int32_t block, int32_t start, int32_t end) const
     {
         TreeLayout layout;
@@ -25,6 +25,7 @@
 #include <memoria/core/tools/static_array.hpp>
 
 
+#include <algorithm>
 #include <type_traits>
 
 namespace memoria {
@@ -261,25 +262,20 @@ protected:
             branch_limit = branch_end;
         }
 
-        for (int32_t c = level_start + start; c < branch_limit + level_start; c++)
+        int32_t c = walker.scan_fw(data.indexes, level_start + start, branch_limit + level_start);
+        if (c < branch_limit + level_start)
         {
-            if (walker.compare(data.indexes[c]))
+            if (level < data.levels_max)
             {
-                if (level < data.levels_max)
-                {
-                    return walk_index_fw(
-                            data,
-                            (c - level_start) << BranchingFactorLog2,
-                            level + 1,
-                            std::forward<Walker>(walker)
-                    );
-                }
-                else {
-                    return c - level_start;
-                }
+                return walk_index_fw(
+                        data,
+                        (c - level_start) << BranchingFactorLog2,
+                        level + 1,
+                        std::forward<Walker>(walker)
+                );
             }
             else {
-                walker.next();
+                return c - level_start;
             }
         }
 
@@ -312,25 +308,20 @@ protected:
                 start = level_size - 1;
             }
 
-            for (int32_t c = level_start + start; c > branch_end + level_start; c--)
+            int32_t c = walker.scan_bw(data.indexes, level_start + start, branch_end + level_start);
+            if (c > branch_end + level_start)
             {
-                if (walker.compare(data.indexes[c]))
+                if (level < data.levels_max)
                 {
-                    if (level < data.levels_max)
-                    {
-                        return walk_index_bw(
-                                data,
-                                ((c - level_start + 1) << BranchingFactorLog2) - 1,
-                                level + 1,
-                                std::forward<Walker>(walker)
-                        );
-                    }
-                    else {
-                        return c - level_start;
-                    }
+                    return walk_index_bw(
+                            data,
+                            ((c - level_start + 1) << BranchingFactorLog2) - 1,
+                            level + 1,
+                            std::forward<Walker>(walker)
+                    );
                 }
                 else {
-                    walker.next();
+                    return c - level_start;
                 }
             }
 
@@ -362,28 +353,30 @@ protected:
         for (int32_t level = 1; level <= data.levels_max; level++)
         {
             int32_t level_start = data.level_starts[level];
+            int32_t level_end   = level_start + data.level_sizes[level];
+
+            // The branch the upper level has pointed to normally contains
+            // the position, the rest of the level is scanned separately.
+            int32_t branch_end = std::min(level_start + branch_start + BranchingFactor, level_end);
+
+            int32_t c = walker.scan_fw(data.indexes, level_start + branch_start, branch_end);
+            if (c == branch_end) {
+                c = walker.scan_fw(data.indexes, branch_end, level_end);
+            }
 
-            for (int c = level_start + branch_start; c < level_start + data.level_sizes[level]; c++)
+            if (c < level_end)
             {
-                if (walker.compare(data.indexes[c]))
+                if (level < data.levels_max)
                 {
-                    if (level < data.levels_max)
-                    {
-                        branch_start = (c - level_start) << BranchingFactorLog2;
-                        goto next_level;
-                    }
-                    else {
-                        return (c - level_start);
-                    }
+                    branch_start = (c - level_start) << BranchingFactorLog2;
                 }
                 else {
-                    walker.next();
+                    return (c - level_start);
                 }
             }
-
-            return -1;
-
-            next_level:;
+            else {
+                return -1;
+            }
         }
 
         return -1;
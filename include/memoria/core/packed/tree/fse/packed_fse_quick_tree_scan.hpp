@@ -0,0 +1,464 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <limits>
+#include <type_traits>
+
+namespace memoria {
+
+// Prefix-sum search over a run of values of a PkdFQTree's value block or
+// an index level: the first position where the running sum, including
+// the value at this position, becomes >= (Strict: >) the target. The sum
+// accumulates all values before it. If there is no such position, the end
+// of the run is returned and the sum includes the whole run.
+//
+// For 32- and 64-bit integers there are AVX2 kernels, selected at runtime.
+// Runs of non-negative values are skipped by their totals. Otherwise a
+// vector of values is turned into inclusive prefix sums in log2(lanes)
+// shift-and-add steps, all lanes are compared with the rest of the target
+// at once and the first matching lane is taken from the comparison mask.
+// As long as sums don't overflow, the result is the same as the one of the
+// scalar loop, negative values included. Unsigned values are compared with
+// their sign bits flipped. The kernels are only entered while the target
+// is not reached yet, so the rest of the target is positive for them.
+
+namespace pkd_fqt_ {
+
+template <typename T>
+struct SIMDScanTraits {
+    static constexpr bool Available = false;
+};
+
+#ifdef MMA_X86_SIMD
+
+struct SIMDScan64 {
+    static constexpr int32_t Lanes = 4;
+
+    MMA_TARGET("avx2")
+    static __m256i prefix_sums(__m256i x) noexcept
+    {
+        __m256i shifted = _mm256_blend_epi32(
+                    _mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)),
+                    _mm256_setzero_si256(),
+                    0x03
+        );
+        x = _mm256_add_epi64(x, shifted);
+        return _mm256_add_epi64(x, _mm256_permute2x128_si256(x, x, 0x08));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i total(__m256i x) noexcept
+    {
+        x = _mm256_add_epi64(x, _mm256_permute2x128_si256(x, x, 0x01));
+        return _mm256_add_epi64(x, _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i reverse(__m256i x) noexcept {
+        return _mm256_permute4x64_epi64(x, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i broadcast_last(__m256i x) noexcept {
+        return _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i set1(int64_t value) noexcept {
+        return _mm256_set1_epi64x(value);
+    }
+
+    MMA_TARGET("avx2")
+    static int64_t first(__m256i x) noexcept {
+        return _mm_cvtsi128_si64(_mm256_castsi256_si128(x));
+    }
+
+
+    MMA_TARGET("avx2")
+    static __m256i add(__m256i a, __m256i b) noexcept {
+        return _mm256_add_epi64(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i sub(__m256i a, __m256i b) noexcept {
+        return _mm256_sub_epi64(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i cmpgt(__m256i a, __m256i b) noexcept {
+        return _mm256_cmpgt_epi64(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static uint32_t mask(__m256i x) noexcept {
+        return _mm256_movemask_pd(_mm256_castsi256_pd(x));
+    }
+};
+
+struct SIMDScan32 {
+    static constexpr int32_t Lanes = 8;
+
+    MMA_TARGET("avx2")
+    static __m256i prefix_sums(__m256i x) noexcept
+    {
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+
+        __m256i low_total = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm256_add_epi32(x, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i total(__m256i x) noexcept
+    {
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(x, x, 0x01));
+        x = _mm256_add_epi32(x, _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm256_add_epi32(x, _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i reverse(__m256i x) noexcept {
+        return _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i broadcast_last(__m256i x) noexcept {
+        return _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i set1(int32_t value) noexcept {
+        return _mm256_set1_epi32(value);
+    }
+
+    MMA_TARGET("avx2")
+    static int32_t first(__m256i x) noexcept {
+        return _mm_cvtsi128_si32(_mm256_castsi256_si128(x));
+    }
+
+
+    MMA_TARGET("avx2")
+    static __m256i add(__m256i a, __m256i b) noexcept {
+        return _mm256_add_epi32(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i sub(__m256i a, __m256i b) noexcept {
+        return _mm256_sub_epi32(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i cmpgt(__m256i a, __m256i b) noexcept {
+        return _mm256_cmpgt_epi32(a, b);
+    }
+
+    MMA_TARGET("avx2")
+    static uint32_t mask(__m256i x) noexcept {
+        return _mm256_movemask_ps(_mm256_castsi256_ps(x));
+    }
+};
+
+template <> struct SIMDScanTraits<int64_t> {
+    static constexpr bool Available = true;
+    using Ops = SIMDScan64;
+    using SignedT = int64_t;
+    static constexpr int64_t Bias = 0;
+};
+
+template <> struct SIMDScanTraits<uint64_t> {
+    static constexpr bool Available = true;
+    using Ops = SIMDScan64;
+    using SignedT = int64_t;
+    static constexpr int64_t Bias = std::numeric_limits<int64_t>::min();
+};
+
+template <> struct SIMDScanTraits<int32_t> {
+    static constexpr bool Available = true;
+    using Ops = SIMDScan32;
+    using SignedT = int32_t;
+    static constexpr int32_t Bias = 0;
+};
+
+template <> struct SIMDScanTraits<uint32_t> {
+    static constexpr bool Available = true;
+    using Ops = SIMDScan32;
+    using SignedT = int32_t;
+    static constexpr int32_t Bias = std::numeric_limits<int32_t>::min();
+};
+
+template <typename T>
+struct SIMDScanKernels {
+    using Traits  = SIMDScanTraits<T>;
+    using Ops     = typename Traits::Ops;
+    using SignedT = typename Traits::SignedT;
+
+    static constexpr int32_t Lanes = Ops::Lanes;
+
+    // Values per step of the loop and vectors per step
+    static constexpr int32_t Step    = 16;
+    static constexpr int32_t Vectors = Step / Lanes;
+
+    // Shorter runs are faster with the scalar loop: there are too few steps
+    // to pay for the call, setup and finding the position within the step.
+    // Prefix sums of 64-bit values take twice as many shuffles.
+    static constexpr int32_t MinRunLength = Lanes == 8 ? 16 : 64;
+
+    // Lanes of the biased prefix sums matching the biased remainder
+    MMA_TARGET("avx2")
+    static uint32_t match_mask(__m256i sums, __m256i target, BoolValue<true>) noexcept {
+        return Ops::mask(Ops::cmpgt(sums, target));
+    }
+
+    MMA_TARGET("avx2")
+    static uint32_t match_mask(__m256i sums, __m256i target, BoolValue<false>) noexcept {
+        return ~Ops::mask(Ops::cmpgt(target, sums)) & ((1u << Lanes) - 1);
+    }
+
+    // The rest of the target, target - sum, is tracked instead of the sum,
+    // so that the only dependency between steps is subtracting the total of
+    // the step from it. If there are no
+    // negative values in the step, its total alone tells whether the step
+    // contains the match. Prefix sums are only computed for the step with
+    // the match or with negative values.
+    //
+    // The matching position and the sum of the values before it are taken
+    // from the masks and the prefix sums without further branching, the
+    // scalar loop would mispredict its exit a second time. If there is no
+    // match, returns the start of the tail, to be finished by the scalar
+    // loop, and the sum of all values before it.
+    template <bool Strict, bool Backward>
+    MMA_TARGET("avx2")
+    static int32_t scan(const T* values, int32_t start, int32_t end, T& sum, T target, bool& found) noexcept
+    {
+        __m256i bias  = Ops::set1(Traits::Bias);
+        __m256i rem_v = Ops::set1(static_cast<SignedT>(target - sum));
+
+        int32_t c = start;
+        while (Backward ? c - end >= Step : end - c >= Step)
+        {
+            __m256i data[Vectors];
+            __m256i any = _mm256_setzero_si256();
+            __m256i all = _mm256_setzero_si256();
+
+            for (int32_t v = 0; v < Vectors; v++)
+            {
+                data[v] = load(values, Backward ? c - v * Lanes : c + v * Lanes, BoolValue<Backward>());
+                any = _mm256_or_si256(any, data[v]);
+                all = Ops::add(all, data[v]);
+            }
+
+            __m256i rem_b = Ops::add(rem_v, bias);
+
+            // Sign bits of unsigned values are not signs
+            bool negative = Traits::Bias == 0 && Ops::mask(any);
+            if (!negative)
+            {
+                __m256i total = Ops::total(all);
+                if (!match_mask(Ops::add(total, bias), rem_b, BoolValue<Strict>()))
+                {
+                    rem_v = Ops::sub(rem_v, total);
+                    c = Backward ? c - Step : c + Step;
+                    continue;
+                }
+            }
+
+            // prefix[k] is the sum of the first k values of the step
+            SignedT prefix[Step + 1];
+            prefix[0] = 0;
+
+            __m256i carry = _mm256_setzero_si256();
+            uint32_t mask = 0;
+
+            for (int32_t v = 0; v < Vectors; v++)
+            {
+                __m256i sums = Ops::add(Ops::prefix_sums(order(data[v], BoolValue<Backward>())), carry);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(prefix + 1 + v * Lanes), sums);
+
+                mask |= match_mask(Ops::add(sums, bias), rem_b, BoolValue<Strict>()) << (v * Lanes);
+                carry = Ops::broadcast_last(sums);
+            }
+
+            if (mask)
+            {
+                int32_t lane = __builtin_ctz(mask);
+
+                sum   = target - static_cast<T>(Ops::first(rem_v)) + static_cast<T>(prefix[lane]);
+                found = true;
+
+                return Backward ? c - lane : c + lane;
+            }
+
+            rem_v = Ops::sub(rem_v, carry);
+            c = Backward ? c - Step : c + Step;
+        }
+
+        sum   = target - static_cast<T>(Ops::first(rem_v));
+        found = false;
+
+        return c;
+    }
+
+private:
+    // Lanes of values [pos, pos + Lanes) forward or (pos - Lanes, pos]
+    // backward, in memory order.
+    MMA_TARGET("avx2")
+    static __m256i load(const T* values, int32_t pos, BoolValue<false>) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + pos));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i load(const T* values, int32_t pos, BoolValue<true>) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + pos - Lanes + 1));
+    }
+
+    // The same lanes in the order of scanning
+    MMA_TARGET("avx2")
+    static __m256i order(__m256i data, BoolValue<false>) noexcept {
+        return data;
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i order(__m256i data, BoolValue<true>) noexcept {
+        return Ops::reverse(data);
+    }
+};
+
+#endif
+
+}
+
+
+template <typename IndexValue, typename Value>
+class PkdFQTreeScanFn {
+
+    using Traits = pkd_fqt_::SIMDScanTraits<Value>;
+
+    static constexpr bool HasSIMDKernels = Traits::Available && std::is_same<IndexValue, Value>::value;
+
+public:
+    template <bool Strict>
+    static bool matches(IndexValue sum, IndexValue target) noexcept {
+        return Strict ? sum > target : sum >= target;
+    }
+
+    template <bool Strict>
+    static int32_t scan_fw_portable(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target) noexcept
+    {
+        for (int32_t c = start; c < end; c++)
+        {
+            if (matches<Strict>(sum + values[c], target)) {
+                return c;
+            }
+
+            sum += values[c];
+        }
+
+        return end;
+    }
+
+    // Scans from start down to end, exclusive
+    template <bool Strict>
+    static int32_t scan_bw_portable(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target) noexcept
+    {
+        for (int32_t c = start; c > end; c--)
+        {
+            if (matches<Strict>(sum + values[c], target)) {
+                return c;
+            }
+
+            sum += values[c];
+        }
+
+        return end;
+    }
+
+    template <bool Strict>
+    static int32_t scan_fw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target) noexcept
+    {
+        return scan_fw<Strict>(values, start, end, sum, target, BoolValue<HasSIMDKernels>());
+    }
+
+    template <bool Strict>
+    static int32_t scan_bw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target) noexcept
+    {
+        return scan_bw<Strict>(values, start, end, sum, target, BoolValue<HasSIMDKernels>());
+    }
+
+private:
+    template <bool Strict>
+    static int32_t scan_fw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<false>) noexcept
+    {
+        return scan_fw_portable<Strict>(values, start, end, sum, target);
+    }
+
+    template <bool Strict>
+    static int32_t scan_bw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<false>) noexcept
+    {
+        return scan_bw_portable<Strict>(values, start, end, sum, target);
+    }
+
+#ifdef MMA_X86_SIMD
+    using Kernels = pkd_fqt_::SIMDScanKernels<Value>;
+
+    template <bool Strict>
+    static int32_t scan_fw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<true>) noexcept
+    {
+        if (end - start >= Kernels::MinRunLength && !matches<Strict>(sum, target) && CpuFeatures::get().avx2())
+        {
+            bool found;
+            start = Kernels::template scan<Strict, false>(values, start, end, sum, target, found);
+            if (found) {
+                return start;
+            }
+        }
+
+        return scan_fw_portable<Strict>(values, start, end, sum, target);
+    }
+
+    template <bool Strict>
+    static int32_t scan_bw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<true>) noexcept
+    {
+        if (start - end >= Kernels::MinRunLength && !matches<Strict>(sum, target) && CpuFeatures::get().avx2())
+        {
+            bool found;
+            start = Kernels::template scan<Strict, true>(values, start, end, sum, target, found);
+            if (found) {
+                return start;
+            }
+        }
+
+        return scan_bw_portable<Strict>(values, start, end, sum, target);
+    }
+#else
+    template <bool Strict>
+    static int32_t scan_fw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<true>) noexcept
+    {
+        return scan_fw_portable<Strict>(values, start, end, sum, target);
+    }
+
+    template <bool Strict>
+    static int32_t scan_bw(const Value* values, int32_t start, int32_t end, IndexValue& sum, IndexValue target, BoolValue<true>) noexcept
+    {
+        return scan_bw_portable<Strict>(values, start, end, sum, target);
+    }
+#endif
+};
+
+}
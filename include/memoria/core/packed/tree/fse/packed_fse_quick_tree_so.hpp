@@ -20,6 +20,8 @@
 
 #include <memoria/profiles/common/block_operations.hpp>
 #include <memoria/core/tools/static_array.hpp>
+#include <memoria/core/tools/span.hpp>
+#include <memoria/core/tools/arena_buffer.hpp>
 
 namespace memoria {
 
@@ -118,6 +120,12 @@ public:
         return data_->value(block, idx);
     }
 
+    // Values are stored contiguously per block, so the buffer is not used.
+    Span<const Value> read_batch(int32_t block, int32_t start, int32_t end, ArenaBuffer<Value>& buffer) const noexcept
+    {
+        return Span<const Value>(data_->values(block) + start, end - start);
+    }
+
     template <typename T>
     void _add(int32_t block, int32_t start, int32_t end, T& value) const
     {
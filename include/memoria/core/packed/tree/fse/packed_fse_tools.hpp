@@ -0,0 +1,32 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+
+
+namespace memoria {
+
+// Default shape of PkdFQTree for the value type. The shape is a part of the
+// tree's block format. pkd_tree_shape_bm sweeps the shapes for int64_t, it
+// found none consistently better than this one.
+template <typename Value>
+struct PkdFQTreeShapeProvider {
+    static constexpr int32_t BranchingFactor = PackedTreeBranchingFactor;
+    static constexpr int32_t ValuesPerBranch = PackedTreeBranchingFactor;
+};
+
+}
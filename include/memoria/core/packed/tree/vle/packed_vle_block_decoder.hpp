@@ -0,0 +1,633 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/i7_codec.hpp>
+#include <memoria/core/bignum/int64_codec.hpp>
+#include <memoria/core/bignum/uint64_codec.hpp>
+
+#include <cstring>
+
+namespace memoria {
+
+// Operations over runs of consecutive VLE codes of a PkdVQTree's value
+// block: skipping a number of codes, summing them, decoding them into an
+// array and prefix-sum search. Runs start at a code boundary, only codes
+// starting before the limit are taken. The number of codes passed is
+// returned in cnt, the position of the next code is the return value.
+//
+// Byte-oriented codecs, where bytes below some threshold are complete
+// codes of small values, have AVX2 kernels selected at runtime. The
+// kernels look at 32 bytes at a time and find the run of single-byte codes
+// they start with. The run is summed with SAD, widened or skipped at once,
+// a multi-byte code following it is decoded with the codec. Where runs get
+// short, the rest is decoded code by code. The format of the codes is not
+// changed.
+
+namespace pkd_vle_ {
+
+// Describes single-byte codes of a byte-oriented codec: bytes up to
+// MaxSingle are complete codes. Bytes up to PosMax hold (byte - Bias),
+// bytes above it hold (NegBase - byte).
+template <typename Codec>
+struct ByteCodeTraits {
+    static constexpr bool Available = false;
+};
+
+template <typename V>
+struct ByteCodeTraits<I7Codec<uint8_t, V>> {
+    static constexpr bool Available     = true;
+    static constexpr bool HasNegatives  = false;
+    static constexpr uint8_t MaxSingle  = 127;
+    static constexpr uint8_t PosMax     = 127;
+    static constexpr uint8_t Bias       = 0;
+    static constexpr uint8_t NegBase    = 0;
+};
+
+template <>
+struct ByteCodeTraits<ValueCodec<uint64_t>> {
+    static constexpr bool Available     = true;
+    static constexpr bool HasNegatives  = false;
+    static constexpr uint8_t MaxSingle  = ValueCodec<uint64_t>::UpperBound - 1;
+    static constexpr uint8_t PosMax     = ValueCodec<uint64_t>::UpperBound - 1;
+    static constexpr uint8_t Bias       = 1;
+    static constexpr uint8_t NegBase    = 0;
+};
+
+template <>
+struct ByteCodeTraits<ValueCodec<int64_t>> {
+    static constexpr bool Available     = true;
+    static constexpr bool HasNegatives  = true;
+    static constexpr uint8_t MaxSingle  = 251;
+    static constexpr uint8_t PosMax     = 125;
+    static constexpr uint8_t Bias       = 0;
+    static constexpr uint8_t NegBase    = 125;
+};
+
+
+#ifdef MMA_X86_SIMD
+
+template <typename Codec, typename Value>
+struct ByteCodeKernels {
+    using Traits = ByteCodeTraits<Codec>;
+    using BufferType = typename Codec::BufferType;
+
+    static constexpr size_t ChunkSize = 32;
+
+    // Kernels stop at the first run of single-byte codes shorter than this
+    static constexpr uint32_t MinRunLength = 8;
+
+    MMA_TARGET("avx2")
+    static __m256i load(const BufferType* buffer, size_t pos) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + pos));
+    }
+
+    // Bytes of the chunk that are not single-byte codes
+    MMA_TARGET("avx2")
+    static uint32_t multi_byte_mask(__m256i bytes) noexcept
+    {
+        __m256i max = _mm256_set1_epi8(static_cast<char>(Traits::MaxSingle));
+        __m256i single = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, max), bytes);
+        return ~static_cast<uint32_t>(_mm256_movemask_epi8(single));
+    }
+
+    // Bytes of the chunk that are negative values
+    MMA_TARGET("avx2")
+    static __m256i negatives(__m256i bytes) noexcept
+    {
+        __m256i pos_max = _mm256_set1_epi8(static_cast<char>(Traits::PosMax));
+        __m256i positive = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, pos_max), bytes);
+        return _mm256_xor_si256(positive, _mm256_set1_epi8(-1));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i positive_magnitudes(__m256i bytes) noexcept {
+        return _mm256_sub_epi8(bytes, _mm256_set1_epi8(static_cast<char>(Traits::Bias)));
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i negative_magnitudes(__m256i bytes) noexcept {
+        return _mm256_sub_epi8(bytes, _mm256_set1_epi8(static_cast<char>(Traits::NegBase)));
+    }
+
+    MMA_TARGET("avx2")
+    static int64_t total(__m256i sums) noexcept
+    {
+        __m128i sum2 = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        return _mm_cvtsi128_si64(_mm_add_epi64(sum2, _mm_unpackhi_epi64(sum2, sum2)));
+    }
+
+    // Sums of the positive and the negative values of the single-byte codes
+    // selected by the mask, in four 64-bit lanes each
+    MMA_TARGET("avx2")
+    static void run_sums(__m256i bytes, __m256i mask, __m256i& pos_sums, __m256i& neg_sums) noexcept
+    {
+        __m256i zero = _mm256_setzero_si256();
+
+        if (Traits::HasNegatives)
+        {
+            __m256i neg = negatives(bytes);
+            pos_sums = _mm256_sad_epu8(_mm256_and_si256(_mm256_andnot_si256(neg, mask), positive_magnitudes(bytes)), zero);
+            neg_sums = _mm256_sad_epu8(_mm256_and_si256(_mm256_and_si256(neg, mask), negative_magnitudes(bytes)), zero);
+        }
+        else {
+            pos_sums = _mm256_sad_epu8(_mm256_and_si256(mask, positive_magnitudes(bytes)), zero);
+            neg_sums = zero;
+        }
+    }
+
+    // Selects the first run bytes of a chunk
+    MMA_TARGET("avx2")
+    static __m256i run_mask(uint32_t run) noexcept
+    {
+        static const int8_t masks[ChunkSize * 2] = {
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+        };
+
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + ChunkSize - run));
+    }
+
+    // Number of single-byte codes the chunk starts with
+    MMA_TARGET("avx2")
+    static uint32_t run_length(uint32_t multi_byte) noexcept {
+        return multi_byte ? CountTrailingZeroes(multi_byte) : ChunkSize;
+    }
+
+    // Values of a chunk of single-byte codes as bytes: unsigned if the
+    // codec has no negative single-byte values, signed otherwise.
+    MMA_TARGET("avx2")
+    static __m256i chunk_values(__m256i bytes) noexcept
+    {
+        if (Traits::HasNegatives)
+        {
+            __m256i neg = negatives(bytes);
+            __m256i negv = _mm256_sub_epi8(_mm256_setzero_si256(), negative_magnitudes(bytes));
+            return _mm256_blendv_epi8(positive_magnitudes(bytes), negv, neg);
+        }
+        else {
+            return positive_magnitudes(bytes);
+        }
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i widen8(__m128i bytes) noexcept {
+        return Traits::HasNegatives ? _mm256_cvtepi8_epi64(bytes) : _mm256_cvtepu8_epi64(bytes);
+    }
+
+    MMA_TARGET("avx2")
+    static __m256i widen4(__m128i bytes) noexcept {
+        return Traits::HasNegatives ? _mm256_cvtepi8_epi32(bytes) : _mm256_cvtepu8_epi32(bytes);
+    }
+
+    MMA_TARGET("avx2")
+    static void store_values(__m256i values, Value* out, IntValue<8>) noexcept
+    {
+        alignas(32) uint8_t bytes[ChunkSize];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), values);
+
+        for (size_t c = 0; c < ChunkSize; c += 4)
+        {
+            int32_t quad;
+            std::memcpy(&quad, bytes + c, sizeof(quad));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + c), widen8(_mm_cvtsi32_si128(quad)));
+        }
+    }
+
+    MMA_TARGET("avx2")
+    static void store_values(__m256i values, Value* out, IntValue<4>) noexcept
+    {
+        __m128i lo = _mm256_castsi256_si128(values);
+        __m128i hi = _mm256_extracti128_si256(values, 1);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),      widen4(lo));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8),  widen4(_mm_srli_si128(lo, 8)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), widen4(hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 24), widen4(_mm_srli_si128(hi, 8)));
+    }
+
+    template <int32_t Size>
+    MMA_TARGET("avx2")
+    static void store_values(__m256i values, Value* out, IntValue<Size>) noexcept
+    {
+        alignas(32) uint8_t bytes[ChunkSize];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), values);
+
+        for (size_t c = 0; c < ChunkSize; c++) {
+            out[c] = Traits::HasNegatives ? static_cast<Value>(static_cast<int8_t>(bytes[c])) : static_cast<Value>(bytes[c]);
+        }
+    }
+
+    // Each step takes the run of single-byte codes a chunk starts with at
+    // once, decodes the following multi-byte code, if any, and the next
+    // step starts right after it. With short runs, a step takes longer than
+    // decoding the run code by code, so then the kernels leave the rest of
+    // the codes to the portable loops.
+
+    MMA_TARGET("avx2")
+    static size_t skip(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt) noexcept
+    {
+        Codec codec;
+
+        int32_t c = 0;
+        while (pos + ChunkSize <= limit && c + (int32_t)ChunkSize <= max)
+        {
+            uint32_t multi_byte = multi_byte_mask(load(buffer, pos));
+            uint32_t run = run_length(multi_byte);
+
+            if (run < MinRunLength) {
+                break;
+            }
+
+            pos += run;
+            c += run;
+
+            if (multi_byte)
+            {
+                pos += codec.length(buffer, pos, limit);
+                c++;
+            }
+        }
+
+        cnt = c;
+        return pos;
+    }
+
+    template <typename Sum>
+    MMA_TARGET("avx2")
+    static size_t sum(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum) noexcept
+    {
+        Codec codec;
+
+        __m256i pos_acc = _mm256_setzero_si256();
+        __m256i neg_acc = _mm256_setzero_si256();
+
+        Sum local_sum = 0;
+
+        int32_t c = 0;
+        while (pos + ChunkSize <= limit && c + (int32_t)ChunkSize <= max)
+        {
+            __m256i bytes = load(buffer, pos);
+
+            uint32_t multi_byte = multi_byte_mask(bytes);
+            uint32_t run = run_length(multi_byte);
+
+            if (run < MinRunLength) {
+                break;
+            }
+
+            __m256i pos_sums, neg_sums;
+            run_sums(bytes, run_mask(run), pos_sums, neg_sums);
+
+            pos_acc = _mm256_add_epi64(pos_acc, pos_sums);
+            neg_acc = _mm256_add_epi64(neg_acc, neg_sums);
+
+            pos += run;
+            c += run;
+
+            if (multi_byte)
+            {
+                Value value;
+                pos += codec.decode(buffer, value, pos, limit);
+                local_sum += value;
+                c++;
+            }
+        }
+
+        local_sum += static_cast<Sum>(total(pos_acc));
+        local_sum -= static_cast<Sum>(total(neg_acc));
+
+        sum += local_sum;
+
+        cnt = c;
+        return pos;
+    }
+
+    MMA_TARGET("avx2")
+    static size_t decode(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt) noexcept
+    {
+        Codec codec;
+
+        int32_t c = 0;
+        while (pos + ChunkSize <= limit && c + (int32_t)ChunkSize <= max)
+        {
+            __m256i bytes = load(buffer, pos);
+
+            uint32_t multi_byte = multi_byte_mask(bytes);
+            uint32_t run = run_length(multi_byte);
+
+            if (run < MinRunLength) {
+                break;
+            }
+
+            // Values past the run are overwritten later
+            store_values(chunk_values(bytes), values + c, IntValue<sizeof(Value)>());
+
+            pos += run;
+            c += run;
+
+            if (multi_byte)
+            {
+                pos += codec.decode(buffer, values[c], pos, limit);
+                c++;
+            }
+        }
+
+        cnt = c;
+        return pos;
+    }
+
+    // Runs of non-negative single-byte codes are skipped by their totals,
+    // the target is only looked for code by code in the run where the
+    // running sum reaches it.
+    template <bool Strict, typename IndexValue>
+    MMA_TARGET("avx2")
+    static size_t find(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found) noexcept
+    {
+        Codec codec;
+
+        IndexValue local_sum = sum;
+
+        int32_t c = 0;
+        while (pos + ChunkSize <= limit)
+        {
+            __m256i bytes = load(buffer, pos);
+
+            uint32_t multi_byte = multi_byte_mask(bytes);
+            uint32_t run = run_length(multi_byte);
+
+            if (run < MinRunLength) {
+                break;
+            }
+
+            size_t run_end  = pos + run;
+            size_t step_end = multi_byte ? run_end + 1 : run_end;
+
+            __m256i mask = run_mask(run);
+            if (!Traits::HasNegatives || _mm256_testz_si256(negatives(bytes), mask))
+            {
+                __m256i pos_sums, neg_sums;
+                run_sums(bytes, mask, pos_sums, neg_sums);
+
+                IndexValue next = local_sum + static_cast<IndexValue>(total(pos_sums));
+                if (!(Strict ? next > target : next >= target))
+                {
+                    local_sum = next;
+                    pos = run_end;
+                    c += run;
+                }
+            }
+
+            for (; pos < step_end; c++)
+            {
+                Value value;
+                size_t len = codec.decode(buffer, value, pos, limit);
+
+                if (Strict ? local_sum + value > target : local_sum + value >= target)
+                {
+                    sum = local_sum;
+                    cnt = c;
+                    found = true;
+                    return pos;
+                }
+
+                local_sum += value;
+                pos += len;
+            }
+        }
+
+        sum = local_sum;
+        cnt = c;
+        found = false;
+        return pos;
+    }
+};
+
+#endif
+
+}
+
+
+template <typename Codec, typename Value>
+class PkdVLEBlockDecoder {
+
+    using Traits = pkd_vle_::ByteCodeTraits<Codec>;
+
+    static constexpr bool HasSIMDKernels = Traits::Available;
+
+public:
+    using BufferType = typename Codec::BufferType;
+
+    static size_t skip_portable(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt) noexcept
+    {
+        Codec codec;
+
+        int32_t c;
+        for (c = 0; pos < limit && c < max; c++) {
+            pos += codec.length(buffer, pos, limit);
+        }
+
+        cnt = c;
+        return pos;
+    }
+
+    template <typename Sum>
+    static size_t sum_portable(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum) noexcept
+    {
+        Codec codec;
+
+        int32_t c;
+        for (c = 0; pos < limit && c < max; c++)
+        {
+            Value value;
+            pos += codec.decode(buffer, value, pos, limit);
+            sum += value;
+        }
+
+        cnt = c;
+        return pos;
+    }
+
+    static size_t decode_portable(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt) noexcept
+    {
+        Codec codec;
+
+        int32_t c;
+        for (c = 0; pos < limit && c < max; c++) {
+            pos += codec.decode(buffer, values[c], pos, limit);
+        }
+
+        cnt = c;
+        return pos;
+    }
+
+    // Looks for the first code where the running sum, including the code's
+    // value, becomes >= (Strict: >) the target. The sum accumulates all
+    // values before it.
+    template <bool Strict, typename IndexValue>
+    static size_t find_portable(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found) noexcept
+    {
+        Codec codec;
+
+        int32_t c;
+        for (c = 0; pos < limit; c++)
+        {
+            Value value;
+            size_t len = codec.decode(buffer, value, pos, limit);
+
+            if (Strict ? sum + value > target : sum + value >= target)
+            {
+                cnt = c;
+                found = true;
+                return pos;
+            }
+
+            sum += value;
+            pos += len;
+        }
+
+        cnt = c;
+        found = false;
+        return pos;
+    }
+
+    static size_t skip(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt) noexcept
+    {
+        return skip(buffer, pos, limit, max, cnt, BoolValue<HasSIMDKernels>());
+    }
+
+    template <typename Sum>
+    static size_t sum(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum) noexcept
+    {
+        return sum_(buffer, pos, limit, max, cnt, sum, BoolValue<HasSIMDKernels>());
+    }
+
+    static size_t decode(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt) noexcept
+    {
+        return decode(buffer, pos, limit, values, max, cnt, BoolValue<HasSIMDKernels>());
+    }
+
+    template <bool Strict, typename IndexValue>
+    static size_t find(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found) noexcept
+    {
+        return find<Strict>(buffer, pos, limit, sum, target, cnt, found, BoolValue<HasSIMDKernels>());
+    }
+
+private:
+    static size_t skip(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, BoolValue<false>) noexcept {
+        return skip_portable(buffer, pos, limit, max, cnt);
+    }
+
+    template <typename Sum>
+    static size_t sum_(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum, BoolValue<false>) noexcept {
+        return sum_portable(buffer, pos, limit, max, cnt, sum);
+    }
+
+    static size_t decode(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt, BoolValue<false>) noexcept {
+        return decode_portable(buffer, pos, limit, values, max, cnt);
+    }
+
+    template <bool Strict, typename IndexValue>
+    static size_t find(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found, BoolValue<false>) noexcept {
+        return find_portable<Strict>(buffer, pos, limit, sum, target, cnt, found);
+    }
+
+#ifdef MMA_X86_SIMD
+    using Kernels = pkd_vle_::ByteCodeKernels<Codec, Value>;
+
+    // Kernels leave the tail of the run, shorter than a chunk,
+    // to the portable code.
+
+    static size_t skip(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, BoolValue<true>) noexcept
+    {
+        int32_t head = 0;
+        if (CpuFeatures::get().avx2()) {
+            pos = Kernels::skip(buffer, pos, limit, max, head);
+        }
+
+        pos = skip_portable(buffer, pos, limit, max - head, cnt);
+        cnt += head;
+        return pos;
+    }
+
+    template <typename Sum>
+    static size_t sum_(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum, BoolValue<true>) noexcept
+    {
+        int32_t head = 0;
+        if (CpuFeatures::get().avx2()) {
+            pos = Kernels::sum(buffer, pos, limit, max, head, sum);
+        }
+
+        pos = sum_portable(buffer, pos, limit, max - head, cnt, sum);
+        cnt += head;
+        return pos;
+    }
+
+    static size_t decode(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt, BoolValue<true>) noexcept
+    {
+        int32_t head = 0;
+        if (CpuFeatures::get().avx2()) {
+            pos = Kernels::decode(buffer, pos, limit, values, max, head);
+        }
+
+        pos = decode_portable(buffer, pos, limit, values + head, max - head, cnt);
+        cnt += head;
+        return pos;
+    }
+
+    template <bool Strict, typename IndexValue>
+    static size_t find(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found, BoolValue<true>) noexcept
+    {
+        int32_t head = 0;
+        if (CpuFeatures::get().avx2())
+        {
+            pos = Kernels::template find<Strict>(buffer, pos, limit, sum, target, head, found);
+            if (found) {
+                cnt = head;
+                return pos;
+            }
+        }
+
+        pos = find_portable<Strict>(buffer, pos, limit, sum, target, cnt, found);
+        cnt += head;
+        return pos;
+    }
+#else
+    static size_t skip(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, BoolValue<true>) noexcept {
+        return skip_portable(buffer, pos, limit, max, cnt);
+    }
+
+    template <typename Sum>
+    static size_t sum_(const BufferType* buffer, size_t pos, size_t limit, int32_t max, int32_t& cnt, Sum& sum, BoolValue<true>) noexcept {
+        return sum_portable(buffer, pos, limit, max, cnt, sum);
+    }
+
+    static size_t decode(const BufferType* buffer, size_t pos, size_t limit, Value* values, int32_t max, int32_t& cnt, BoolValue<true>) noexcept {
+        return decode_portable(buffer, pos, limit, values, max, cnt);
+    }
+
+    template <bool Strict, typename IndexValue>
+    static size_t find(const BufferType* buffer, size_t pos, size_t limit, IndexValue& sum, IndexValue target, int32_t& cnt, bool& found, BoolValue<true>) noexcept {
+        return find_portable<Strict>(buffer, pos, limit, sum, target, cnt, found);
+    }
+#endif
+};
+
+}
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memoria/core/packed/tree/vle/packed_vle_quick_tree_base_base.hpp>
+#include <memoria/core/packed/tree/vle/packed_vle_block_decoder.hpp>
 #include <memoria/core/tools/assert.hpp>
 
 namespace memoria {
@@ -63,6 +64,8 @@ public:
 
     using ValueData = typename Codec::BufferType;
 
+    using BlockDecoder  = PkdVLEBlockDecoder<Codec, Value>;
+
     static const int32_t BranchingFactor        = kBranchingFactor;
     static const int32_t ValuesPerBranch        = kValuesPerBranch;
 
@@ -327,6 +330,11 @@ public:
             sum_ += next_;
         }
 
+        template <typename T>
+        size_t find_fw(const T* buffer, size_t pos, size_t limit, int32_t& cnt, bool& found) {
+            return BlockDecoder::template find<false>(buffer, pos, limit, sum_, target_, cnt, found);
+        }
+
         int32_t& local_pos() {return idx_;}
         const int32_t& local_pos() const {return idx_;}
 
@@ -404,6 +412,11 @@ public:
             sum_ += next_;
         }
 
+        template <typename T>
+        size_t find_fw(const T* buffer, size_t pos, size_t limit, int32_t& cnt, bool& found) {
+            return BlockDecoder::template find<true>(buffer, pos, limit, sum_, target_, cnt, found);
+        }
+
         int32_t& local_pos() {return idx_;}
         const int32_t& local_pos() const {return idx_;}
 
@@ -535,18 +548,11 @@ public:
             int32_t window_start = window_num << ValuesPerBranchLog2;
             if (window_start >= 0)
             {
-                Codec codec;
-
                 size_t offset = this->offset(block, window_num);
 
-                int32_t c = 0;
+                int32_t c;
                 int32_t local_idx = idx - locate_result.index_cnt;
-                size_t pos;
-                for (pos = window_start + offset; pos < data_size && c < local_idx; c++)
-                {
-                    auto len = codec.length(values, pos, data_size);
-                    pos += len;
-                }
+                size_t pos = BlockDecoder::skip(values, window_start + offset, data_size, local_idx, c);
 
                 locate_result.idx = pos;
 
@@ -582,19 +588,11 @@ public:
             int32_t window_start = (window_num << ValuesPerBranchLog2);
             if (window_start >= 0)
             {
-                Codec codec;
-
                 size_t offset = this->offset(block, window_num);
 
-                int32_t c = 0;
+                int32_t c;
                 int32_t local_idx = idx - locate_result.index_cnt;
-                for (size_t pos = window_start + offset; pos < data_size && c < local_idx; c++)
-                {
-                    Value value;
-                    auto len = codec.decode(values, value, pos, data_size);
-                    pos += len;
-                    locate_result.value_sum += value;
-                }
+                BlockDecoder::sum(values, window_start + offset, data_size, local_idx, c, locate_result.value_sum);
 
                 locate_result.idx = c + locate_result.index_cnt;
 
@@ -619,27 +617,13 @@ public:
         size_t data_size = this->data_size(block);
         int32_t size = metadata->size();
 
-        Codec codec;
-
         if (!this->has_index(block))
         {
-            size_t pos = 0;
-            for (int32_t c = 0; pos < data_size; c++)
-            {
-                Value value;
-                size_t length = codec.decode(values, value, pos, data_size);
-
-                if (walker.compare(value))
-                {
-                    return walker.idx(c);
-                }
-                else {
-                    pos += length;
-                    walker.next();
-                }
-            }
+            int32_t c;
+            bool found;
+            walker.find_fw(values, 0, data_size, c, found);
 
-            return walker.idx(size);
+            return walker.idx(found ? c : size);
         }
         else {
             TreeLayout data = this->compute_tree_layout(data_size);
@@ -655,22 +639,11 @@ public:
             {
                 size_t local_pos = (idx << ValuesPerBranchLog2) + this->offset(block, idx);
 
-                for (int32_t local_idx = state.size_sum; local_pos < data_size; local_idx++)
-                {
-                    Value value;
-                    size_t length = codec.decode(values, value, local_pos, data_size);
-
-                    if (walker.compare(value))
-                    {
-                        return walker.idx(local_idx);
-                    }
-                    else {
-                        local_pos += length;
-                        walker.next();
-                    }
-                }
+                int32_t c;
+                bool found;
+                walker.find_fw(values, local_pos, data_size, c, found);
 
-                return walker.idx(size);
+                return walker.idx(found ? state.size_sum + c : size);
             }
             else {
                 return walker.idx(size);
@@ -694,26 +667,13 @@ public:
 
         if (pos < data_size)
         {
-            Codec codec;
-
             if (layout.levels_max < 0 || data_size - pos  < ValuesPerBranch)
             {
-                for (int32_t c = start; pos < data_size; c++)
-                {
-                    Value value;
-                    auto len = codec.decode(values, value, pos, data_size);
-
-                    if (walker.compare(value))
-                    {
-                        return walker.idx(c);
-                    }
-                    else {
-                        pos += len;
-                        walker.next();
-                    }
-                }
+                int32_t c;
+                bool found;
+                walker.find_fw(values, pos, data_size, c, found);
 
-                return walker.idx(size);
+                return walker.idx(found ? start + c : size);
             }
             else {
                 WalkerState state;
@@ -722,23 +682,16 @@ public:
 
                 size_t window_end = (pos | ValuesPerBranchMask) + 1;
 
-                int32_t c = start;
-                for (c = start; pos < window_end; c++)
-                {
-                    Value value;
-                    auto len = codec.decode(values, value, pos, data_size);
+                int32_t c;
+                bool found;
+                walker.find_fw(values, pos, window_end, c, found);
 
-                    if (walker.compare(value))
-                    {
-                        return walker.idx(c);
-                    }
-                    else {
-                        state.size_sum++;
-                        pos += len;
-                        walker.next();
-                    }
+                if (found) {
+                    return walker.idx(start + c);
                 }
 
+                state.size_sum += c;
+
                 int32_t idx = this->walk_index_fw(
                         layout,
                         state,
@@ -751,22 +704,11 @@ public:
                 {
                     size_t local_pos = (idx << ValuesPerBranchLog2) + this->offset(block, idx);
 
-                    for (int32_t local_idx = state.size_sum; local_pos < data_size; local_idx++)
-                    {
-                        Value value;
-                        size_t length = codec.decode(values, value, local_pos, data_size);
-
-                        if (walker.compare(value))
-                        {
-                            return walker.idx(local_idx);
-                        }
-                        else {
-                            local_pos += length;
-                            walker.next();
-                        }
-                    }
+                    int32_t c;
+                    bool found;
+                    walker.find_fw(values, local_pos, data_size, c, found);
 
-                    return walker.idx(size);
+                    return walker.idx(found ? state.size_sum + c : size);
                 }
                 else {
                     return walker.idx(size);
@@ -787,8 +729,6 @@ public:
 
         size_t data_size = this->data_size(block);
 
-        Codec codec;
-
         TreeLayout layout = this->compute_tree_layout(data_size);
 
         auto lr = this->locate(layout, values, block, start);
@@ -799,16 +739,10 @@ public:
 
         if (pos < ValuesPerBranch)
         {
-            size_t local_pos = 0;
-
-            for (int32_t c = 0; c <= start; c++)
-            {
-                Value value;
-                local_pos += codec.decode(values, value, local_pos, data_size);
-                value_data[c] = value;
-            }
+            int32_t cnt;
+            BlockDecoder::decode(values, 0, data_size, value_data, start + 1, cnt);
 
-            for (int32_t c = start; c >= 0; c--)
+            for (int32_t c = cnt - 1; c >= 0; c--)
             {
                 if (walker.compare(value_data[c]))
                 {
@@ -829,15 +763,8 @@ public:
                 window_end = data_size;
             }
 
-            size_t local_pos = window_start;
-
             int32_t local_c;
-            for (local_c = 0; local_pos <= pos && local_c <= start; local_c++)
-            {
-                Value value;
-                local_pos += codec.decode(values, value, local_pos, data_size);
-                value_data[local_c] = value;
-            }
+            BlockDecoder::decode(values, window_start, pos + 1, value_data, start + 1, local_c);
 
             int32_t window_size_prefix = lr.index_cnt;
 
@@ -870,15 +797,8 @@ public:
                 size_t window_start = (pos2 & ~ValuesPerBranchMask) + this->offset(offsets, pos2 >> ValuesPerBranchLog2);
                 size_t window_end   = (pos2 | ValuesPerBranchMask) + 1;
 
-                size_t local_pos = window_start;
-
                 int32_t c;
-                for (c = 0; local_pos < window_end; c++)
-                {
-                    Value value;
-                    local_pos += codec.decode(values, value, local_pos, data_size);
-                    value_data[c] = value;
-                }
+                BlockDecoder::decode(values, window_start, window_end, value_data, ValuesPerBranch, c);
 
                 state.size_sum -= c;
 
@@ -934,16 +854,8 @@ public:
 
         auto values = this->values(block);
 
-        Codec codec;
-
-        size_t pos = 0;
-        for (int c = 0; c < limit; c++)
-        {
-            Value value;
-            auto len = codec.decode(values, value, pos);
-            sum += value;
-            pos += len;
-        }
+        int32_t cnt;
+        BlockDecoder::sum(values, 0, this->data_size(block), limit, cnt, sum);
 
         return sum;
     }
@@ -971,18 +883,10 @@ public:
         else {
             auto* values = this->values(block);
 
-            Codec codec;
-            size_t pos = 0;
-            size_t data_size = this->data_size(block);
-
             IndexValue sum = 0;
 
-            for(int c  = 0; pos < data_size && c < end; c++)
-            {
-                Value value;
-                pos += codec.decode(values, value, pos, data_size);
-                sum += value;
-            }
+            int32_t cnt;
+            BlockDecoder::sum(values, 0, this->data_size(block), end, cnt, sum);
 
             return sum;
         }
@@ -1126,9 +1030,7 @@ protected:
 
             int32_t level_start = layout.level_starts[levels - 1];
 
-            int32_t data_size = this->data_size(block);
-
-            Codec codec;
+            size_t data_size = this->data_size(block);
 
             size_t pos = 0;
             IndexValueT value_sum = 0;
@@ -1155,13 +1057,11 @@ protected:
                     size_cnt  = 0;
                 }
 
-                Value value;
-                auto len = codec.decode(values, value, pos, data_size);
-
-                value_sum += value;
-                size_cnt++;
+                // A window holds all codes starting in it
+                int32_t cnt;
+                pos = BlockDecoder::sum(values, pos, std::min(threshold, data_size), ValuesPerBranch, cnt, value_sum);
 
-                pos += len;
+                size_cnt += cnt;
             }
 
             indexes[level_start + idx] = value_sum;
@@ -30,6 +30,22 @@ struct PkdVLETreeShapeProvider {
     static constexpr int32_t ValuesPerBranch = BlockSize * 8 / BitsPerElement;
 };
 
+#ifdef MEMORIA_TUNED_PACKED_TREE_SHAPES
+
+// Picked with pkd_tree_shape_bm: 256-byte windows make single-entry
+// insertions and removals 15-35% faster in blocks from 4K to 64K, searches
+// stay within about 10%.
+template <>
+struct PkdVLETreeShapeProvider<ValueCodec<int64_t>> {
+    static constexpr int32_t BitsPerElement = 8;
+    static constexpr int32_t BlockSize = 256;// bytes
+
+    static constexpr int32_t BranchingFactor = PackedTreeBranchingFactor;
+    static constexpr int32_t ValuesPerBranch = BlockSize * 8 / BitsPerElement;
+};
+
+#endif
+
 template <
     typename IndexValueT,
     int32_t kBlocks,
@@ -29,8 +29,10 @@
 #include <memoria/core/exceptions/exceptions.hpp>
 
 #include <memoria/core/tools/msvc_intrinsics.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
 #include <memoria/core/memory/ptr_cast.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <type_traits>
@@ -40,38 +42,6 @@
 
 namespace memoria {
 
-const char kPopCountFW_LUT [] = {0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,\
-                                 0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,6,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,\
-                                 0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,7,0,1,0,2,\
-                                 0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,\
-                                 0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,6,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,\
-                                 0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,8,};
-
-const char kZeroCountFW_LUT[] = {8,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,\
-                                 2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,6,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,\
-                                 3,0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,7,0,1,0,\
-                                 2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,\
-                                 4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,6,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,\
-                                 2,0,1,0,5,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,4,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0,};
-
-const char kPopCountBW_LUT [] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,\
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,\
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,\
-                                 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,\
-                                 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,\
-                                 2,2,2,2,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,4,4,4,4,4,4,4,4,5,5,5,5,6,6,7,8,};
-
-const char kZeroCountBW_LUT[] = {8,7,6,6,5,5,5,5,4,4,4,4,4,4,4,4,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,2,2,2,2,2,2,2,2,2,2,2,2,\
-                                 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,\
-                                 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,\
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,\
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,\
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,};
-
-
-
-
-
 /**
  * Return size in bits of type T
  *
@@ -242,6 +212,159 @@ inline int32_t PopCnt(uint32_t arg, int32_t start, int32_t length) noexcept
     return PopCnt(arg & mask);
 }
 
+// Popcount of whole cells. 64-bit cells use POPCNT, or AVX2 Harley-Seal
+// carry-save adders for long runs, when the CPU has them.
+template <typename T>
+inline size_t PopCntCells(const T* cells, size_t size) noexcept
+{
+    size_t total = 0;
+
+    for (size_t c = 0; c < size; c++)
+    {
+        total += PopCnt(cells[c]);
+    }
+
+    return total;
+}
+
+namespace intrnl {
+
+#ifdef MMA_X86_SIMD
+
+MMA_TARGET("popcnt")
+inline size_t PopCntCellsPOPCNT(const uint64_t* cells, size_t size) noexcept
+{
+    uint64_t total0 = 0, total1 = 0;
+
+    size_t c = 0;
+    for (; c + 2 <= size; c += 2)
+    {
+        total0 += _mm_popcnt_u64(cells[c]);
+        total1 += _mm_popcnt_u64(cells[c + 1]);
+    }
+
+    if (c < size) {
+        total0 += _mm_popcnt_u64(cells[c]);
+    }
+
+    return total0 + total1;
+}
+
+// Per 64-bit lane popcount: 4-bit lookups and a sum of bytes
+MMA_TARGET("avx2")
+inline __m256i PopCnt256(__m256i x) noexcept
+{
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low4));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low4));
+
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+// Carry-save adder: (high, low) = a + b + c, bitwise
+MMA_TARGET("avx2")
+inline void CarrySaveAdd256(__m256i& high, __m256i& low, __m256i a, __m256i b, __m256i c) noexcept
+{
+    __m256i u = _mm256_xor_si256(a, b);
+    high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    low  = _mm256_xor_si256(u, c);
+}
+
+// Harley-Seal: 16 vectors are reduced with carry-save adders to one
+// 'sixteens' vector, so only one vector popcount is done per 4096 bits.
+MMA_TARGET("avx2,popcnt")
+inline size_t PopCntCellsAVX2(const uint64_t* cells, size_t size) noexcept
+{
+    const __m256i* data = reinterpret_cast<const __m256i*>(cells);
+    size_t vsize = size / 4;
+
+    __m256i total    = _mm256_setzero_si256();
+    __m256i ones     = _mm256_setzero_si256();
+    __m256i twos     = _mm256_setzero_si256();
+    __m256i fours    = _mm256_setzero_si256();
+    __m256i eights   = _mm256_setzero_si256();
+    __m256i sixteens = _mm256_setzero_si256();
+
+    __m256i twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+
+    size_t c = 0;
+    for (; c + 16 <= vsize; c += 16)
+    {
+        const __m256i* block = data + c;
+
+        CarrySaveAdd256(twos_a, ones, ones, _mm256_loadu_si256(block + 0), _mm256_loadu_si256(block + 1));
+        CarrySaveAdd256(twos_b, ones, ones, _mm256_loadu_si256(block + 2), _mm256_loadu_si256(block + 3));
+        CarrySaveAdd256(fours_a, twos, twos, twos_a, twos_b);
+        CarrySaveAdd256(twos_a, ones, ones, _mm256_loadu_si256(block + 4), _mm256_loadu_si256(block + 5));
+        CarrySaveAdd256(twos_b, ones, ones, _mm256_loadu_si256(block + 6), _mm256_loadu_si256(block + 7));
+        CarrySaveAdd256(fours_b, twos, twos, twos_a, twos_b);
+        CarrySaveAdd256(eights_a, fours, fours, fours_a, fours_b);
+
+        CarrySaveAdd256(twos_a, ones, ones, _mm256_loadu_si256(block + 8), _mm256_loadu_si256(block + 9));
+        CarrySaveAdd256(twos_b, ones, ones, _mm256_loadu_si256(block + 10), _mm256_loadu_si256(block + 11));
+        CarrySaveAdd256(fours_a, twos, twos, twos_a, twos_b);
+        CarrySaveAdd256(twos_a, ones, ones, _mm256_loadu_si256(block + 12), _mm256_loadu_si256(block + 13));
+        CarrySaveAdd256(twos_b, ones, ones, _mm256_loadu_si256(block + 14), _mm256_loadu_si256(block + 15));
+        CarrySaveAdd256(fours_b, twos, twos, twos_a, twos_b);
+        CarrySaveAdd256(eights_b, fours, fours, fours_a, fours_b);
+
+        CarrySaveAdd256(sixteens, eights, eights, eights_a, eights_b);
+
+        total = _mm256_add_epi64(total, PopCnt256(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(PopCnt256(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(PopCnt256(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(PopCnt256(twos), 1));
+    total = _mm256_add_epi64(total, PopCnt256(ones));
+
+    for (; c < vsize; c++) {
+        total = _mm256_add_epi64(total, PopCnt256(_mm256_loadu_si256(data + c)));
+    }
+
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+    uint64_t result = _mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1);
+
+    for (c = vsize * 4; c < size; c++) {
+        result += _mm_popcnt_u64(cells[c]);
+    }
+
+    return result;
+}
+
+#endif
+
+}
+
+inline size_t PopCntCells(const uint64_t* cells, size_t size) noexcept
+{
+#ifdef MMA_X86_SIMD
+    // Below that the Harley-Seal loop is not entered at all
+    if (size >= 64 && CpuFeatures::get().avx2() && CpuFeatures::get().popcnt()) {
+        return intrnl::PopCntCellsAVX2(cells, size);
+    }
+    else if (CpuFeatures::get().popcnt()) {
+        return intrnl::PopCntCellsPOPCNT(cells, size);
+    }
+#endif
+
+    size_t total = 0;
+
+    for (size_t c = 0; c < size; c++)
+    {
+        total += PopCnt(cells[c]);
+    }
+
+    return total;
+}
+
+
 template <typename T>
 inline size_t PopCount(const T* buffer, size_t start, size_t stop) noexcept
 {
@@ -260,9 +383,11 @@ inline size_t PopCount(const T* buffer, size_t start, size_t stop) noexcept
     else {
         total += PopCnt(buffer[start >> divisor], start & mask, prefix);
 
-        for (size_t c = (start >> divisor) + 1; c < (stop >> divisor); c++)
-        {
-            total += PopCnt(buffer[c]);
+        size_t first_cell = (start >> divisor) + 1;
+        size_t stop_cell  = stop >> divisor;
+
+        if (first_cell < stop_cell) {
+            total += PopCntCells(buffer + first_cell, stop_cell - first_cell);
         }
 
         size_t suffix = stop & mask;
@@ -688,181 +813,126 @@ void MoveBits(const T* src, T* dst, size_t src_idx, size_t dst_idx, size_t lengt
 
 
 
-namespace intrnl {
-
+// Length of the run of ones (or zeroes, if zero is true) starting at
+// 'from' and going forward, up to 'to'. A cell at a time, the run's end
+// is found with a trailing zeroes count.
 template <typename T>
-size_t CountFw(const T* buffer, size_t from, size_t to, const char *lut, bool zero) noexcept
+size_t CountFw(const T* buffer, size_t from, size_t to, bool zero) noexcept
 {
-    size_t cnt = 0;
-
-    size_t remainder = (to - from) & static_cast<size_t>(0x7); // lowest 3 bits
-    size_t c;
-
-    for (c = from; c < to - remainder; c += 8)
-    {
-        size_t tmp = GetBits(buffer, c, 8);
-        char bits = lut[tmp];
-        cnt += bits;
-        if (bits < 8)
-        {
-            return cnt;
-        }
-    }
-
-    if (remainder > 0)
-    {
-        size_t tmp = GetBits(buffer, to - remainder, remainder);
-        if (zero)
-        {
-            tmp |= static_cast<size_t>(0x1) << remainder;
-        }
-        cnt += lut[tmp];
-    }
-
-    return cnt;
-}
-
+    const size_t bitsize    = TypeBitsize<T>();
+    const size_t mask       = TypeBitmask<T>();
+    const size_t divisor    = TypeBitmaskPopCount(mask);
 
+    const T fill = zero ? 0 : static_cast<T>(-1);
 
-template <typename T>
-size_t CountBw(const T* buffer, size_t from, size_t to, const char *lut, bool zero)
-{
     size_t cnt = 0;
 
-    if (from > to)
+    for (size_t pos = from; pos < to;)
     {
-        size_t remainder = (from - to) & 0x7; // lowerst 3 bits
+        size_t offset = pos & mask;
 
-        for (int64_t c = from - 1; c > (int64_t)(to + remainder); c -= 8)
+        if (offset == 0)
         {
-            size_t tmp = GetBits(buffer, c - 7, 8);
-            char bits = lut[tmp];
-            cnt += bits;
-            if (bits < 8)
-            {
-                return cnt;
-            }
-        }
+            // Whole cells of the run
+            size_t cell      = pos >> divisor;
+            size_t stop_cell = to >> divisor;
 
-        if (remainder > 0)
-        {
-            size_t tmp = GetBits(buffer, to, remainder);
-            if (zero)
-            {
-                tmp = ((tmp << 1) | static_cast<size_t>(0x1)) << (7 - remainder);
+            while (cell < stop_cell && buffer[cell] == fill) {
+                cell++;
             }
-            else {
-                tmp = tmp << (8 - remainder);
-            }
-
-            cnt += lut[tmp];
-        }
-
-    }
-
-    return cnt;
-}
 
-}
+            cnt += (cell << divisor) - pos;
+            pos = cell << divisor;
 
-template <typename T>
-size_t CountFw(const T* buffer, size_t from, size_t to, const char *lut, bool zero) noexcept
-{
-    size_t bitsize  = TypeBitsize<T>();
-    size_t mask     = TypeBitmask<T>();
-
-    size_t extent = from + bitsize - (from & mask);
-
-    if (extent >= to)
-    {
-        return intrnl::CountFw(buffer, from, to, lut, zero);
-    }
+            if (pos >= to) {
+                break;
+            }
+        }
 
-    size_t cnt = intrnl::CountFw(buffer, from, extent, lut, zero);
+        size_t length = std::min(bitsize - offset, to - pos);
 
-    if (cnt == extent - from)
-    {
-        const size_t divisor    = TypeBitmaskPopCount(mask);
-        const size_t start_cell = extent >> divisor;
-        const size_t stop_cell  = to >> divisor;
+        T value = zero ? static_cast<T>(~buffer[pos >> divisor]) : buffer[pos >> divisor];
 
-        T value = zero ? 0 : static_cast<T>(-1);
+        // Bits above the cell are zero, so the run ends there at most
+        uint64_t stops = ~(static_cast<uint64_t>(value) >> offset);
+        size_t run = stops ? __builtin_ctzll(stops) : 64;
 
-        size_t cell;
-        for (cell = start_cell; cell < stop_cell; cell++)
-        {
-            if (buffer[cell] == value)
-            {
-                cnt += bitsize;
-            }
-            else {
-                break;
-            }
+        if (run < length) {
+            return cnt + run;
         }
 
-        cnt += intrnl::CountFw(buffer, cell<<divisor, to, lut, zero);
-
-        return cnt;
-    }
-    else {
-        return cnt;
+        cnt += length;
+        pos += length;
     }
+
+    return cnt;
 }
 
 template <typename T>
 size_t CountOneFw(const T* buffer, size_t from, size_t to) noexcept
 {
-    return CountFw(buffer, from, to, kPopCountFW_LUT, false);
+    return CountFw(buffer, from, to, false);
 }
 
 template <typename T>
 size_t CountZeroFw(const T* buffer, size_t from, size_t to) noexcept
 {
-    return CountFw(buffer, from, to, kZeroCountFW_LUT, true);
+    return CountFw(buffer, from, to, true);
 }
 
 
-
+// Length of the run of ones (or zeroes) ending at 'from' (exclusive) and
+// going backward, down to 'to'. A cell at a time, with a leading zeroes
+// count.
 template <typename T>
-size_t CountBw(const T* buffer, size_t from, size_t to, const char *lut, bool zero) noexcept
+size_t CountBw(const T* buffer, size_t from, size_t to, bool zero) noexcept
 {
-    size_t bitsize  = TypeBitsize<T>();
-    size_t mask     = TypeBitmask<T>();
-
-    size_t extent = from - (from & mask);
+    const size_t mask       = TypeBitmask<T>();
+    const size_t divisor    = TypeBitmaskPopCount(mask);
 
-    if (extent <= to || extent == 0)
-    {
-        return intrnl::CountBw(buffer, from, to, lut, zero);
-    }
+    const T fill = zero ? 0 : static_cast<T>(-1);
 
-    size_t cnt = intrnl::CountBw(buffer, from, extent, lut, zero);
+    size_t cnt = 0;
 
-    if (cnt == from - extent)
+    for (size_t pos = from; pos > to;)
     {
-        const size_t divisor    = TypeBitmaskPopCount(mask);
-        const size_t start_cell = (extent >> divisor) - 1;
-        const size_t stop_cell  = to >> divisor;
-
-        T value = zero ? 0 : static_cast<T>(-1);
-
-        size_t cell;
-        for (cell = start_cell; cell != stop_cell - 1; cell--)
+        if ((pos & mask) == 0)
         {
-            if (buffer[cell] == value)
-            {
-                cnt += bitsize;
+            // Whole cells of the run
+            size_t cell      = pos >> divisor;
+            size_t stop_cell = (to + mask) >> divisor;
+
+            while (cell > stop_cell && buffer[cell - 1] == fill) {
+                cell--;
             }
-            else {
-                return cnt + intrnl::CountBw(buffer, (cell + 1) << divisor, to, lut, zero);
+
+            cnt += pos - (cell << divisor);
+            pos = cell << divisor;
+
+            if (pos <= to) {
+                break;
             }
         }
 
-        return cnt;
-    }
-    else {
-        return cnt;
+        size_t last   = pos - 1;
+        size_t offset = last & mask;
+        size_t length = std::min(offset + 1, pos - to);
+
+        T value = zero ? static_cast<T>(~buffer[last >> divisor]) : buffer[last >> divisor];
+
+        // The last bit goes to the top, bits below the cell are zero
+        uint64_t stops = ~(static_cast<uint64_t>(value) << (63 - offset));
+        size_t run = stops ? __builtin_clzll(stops) : 64;
+
+        if (run < length) {
+            return cnt + run;
+        }
+
+        cnt += length;
+        pos -= length;
     }
+
+    return cnt;
 }
 
 namespace details {
@@ -979,13 +1049,13 @@ size_t CountTrailingZeroesLight(const T* buf, size_t pos, size_t limit) noexcept
 template <typename Buffer>
 size_t CountOneBw(const Buffer* buffer, size_t from, size_t to) noexcept
 {
-    return CountBw(buffer, from, to, kPopCountBW_LUT, false);
+    return CountBw(buffer, from, to, false);
 }
 
 template <typename Buffer>
 size_t CountZeroBw(const Buffer* buffer, size_t from, size_t to) noexcept
 {
-    return CountBw(buffer, from, to, kZeroCountBW_LUT, true);
+    return CountBw(buffer, from, to, true);
 }
 
 
@@ -35,7 +35,7 @@ inline constexpr uint64_t BroadwordLE8 (uint64_t x, uint64_t y) noexcept
     return ((((y | H8) - (x & ~H8)) ^ x ^ y) & H8 ) >> 7;
 }
 
-inline constexpr size_t SelectFW(uint64_t arg, size_t rank) noexcept
+inline constexpr size_t SelectFWPortable(uint64_t arg, size_t rank) noexcept
 {
     uint64_t v = arg;
 
@@ -81,7 +81,7 @@ inline constexpr size_t SelectFW(uint64_t arg, size_t rank) noexcept
 }
 
 
-inline constexpr size_t SelectBW(uint64_t arg, size_t rank) noexcept
+inline constexpr size_t SelectBWPortable(uint64_t arg, size_t rank) noexcept
 {
     uint64_t v = arg;
 
@@ -131,8 +131,144 @@ inline constexpr size_t SelectBW(uint64_t arg, size_t rank) noexcept
 
 
 
+#ifdef MMA_X86_SIMD
+
+// PDEP deposits the rank-th bit of a mask with only that bit set at the
+// position of the rank-th set bit of arg.
+
+MMA_TARGET("popcnt,bmi,bmi2")
+inline size_t SelectFWBMI2(uint64_t arg, size_t rank) noexcept
+{
+    size_t popcnt = _mm_popcnt_u64(arg);
+
+    if (rank > popcnt) {
+        return 100 + popcnt;
+    }
+
+    return _tzcnt_u64(_pdep_u64(1ull << (rank - 1), arg));
+}
+
+MMA_TARGET("popcnt,bmi,bmi2")
+inline size_t SelectBWBMI2(uint64_t arg, size_t rank) noexcept
+{
+    size_t popcnt = _mm_popcnt_u64(arg);
+
+    if (rank > popcnt) {
+        return 100 + popcnt;
+    }
+
+    return _tzcnt_u64(_pdep_u64(1ull << (popcnt - rank), arg));
+}
+
+#endif
+
+// Position of the rank-th set bit of arg, counting from the lowest bit, or
+// 100 + popcount(arg) if there are fewer set bits.
+inline size_t SelectFW(uint64_t arg, size_t rank) noexcept
+{
+#ifdef MMA_X86_SIMD
+    if (rank > 0 && CpuFeatures::get().bmi2() && CpuFeatures::get().popcnt()) {
+        return SelectFWBMI2(arg, rank);
+    }
+#endif
+    return SelectFWPortable(arg, rank);
+}
+
+// The same counting from the highest bit.
+inline size_t SelectBW(uint64_t arg, size_t rank) noexcept
+{
+#ifdef MMA_X86_SIMD
+    if (rank > 0 && CpuFeatures::get().bmi2() && CpuFeatures::get().popcnt()) {
+        return SelectBWBMI2(arg, rank);
+    }
+#endif
+    return SelectBWPortable(arg, rank);
+}
+
+
+
 namespace intrnl2 {
 
+// Index of the cell where the number of set (or clear, if zero is true)
+// bits reaches rank, or size if it's not reached. Bits of the cells before
+// it are added to total.
+template <typename T>
+size_t FindCellFW(const T* cells, size_t size, size_t rank, size_t& total, bool zero) noexcept
+{
+    for (size_t c = 0; c < size; c++)
+    {
+        T cell = zero ? static_cast<T>(~cells[c]) : cells[c];
+        size_t popcnt = PopCnt(cell);
+
+        if (total + popcnt >= rank) {
+            return c;
+        }
+
+        total += popcnt;
+    }
+
+    return size;
+}
+
+#ifdef MMA_X86_SIMD
+
+MMA_TARGET("popcnt")
+inline size_t FindCellFWPOPCNT(const uint64_t* cells, size_t size, size_t rank, size_t& total, bool zero) noexcept
+{
+    const uint64_t flip = zero ? static_cast<uint64_t>(-1) : 0;
+
+    size_t c = 0;
+    for (; c + 4 <= size; c += 4)
+    {
+        size_t popcnt = _mm_popcnt_u64(cells[c] ^ flip) + _mm_popcnt_u64(cells[c + 1] ^ flip) +
+                        _mm_popcnt_u64(cells[c + 2] ^ flip) + _mm_popcnt_u64(cells[c + 3] ^ flip);
+
+        if (total + popcnt >= rank) {
+            break;
+        }
+
+        total += popcnt;
+    }
+
+    for (; c < size; c++)
+    {
+        size_t popcnt = _mm_popcnt_u64(cells[c] ^ flip);
+
+        if (total + popcnt >= rank) {
+            return c;
+        }
+
+        total += popcnt;
+    }
+
+    return size;
+}
+
+#endif
+
+inline size_t FindCellFW(const uint64_t* cells, size_t size, size_t rank, size_t& total, bool zero) noexcept
+{
+#ifdef MMA_X86_SIMD
+    if (CpuFeatures::get().popcnt()) {
+        return FindCellFWPOPCNT(cells, size, rank, total, zero);
+    }
+#endif
+
+    for (size_t c = 0; c < size; c++)
+    {
+        uint64_t cell = zero ? ~cells[c] : cells[c];
+        size_t popcnt = PopCnt(cell);
+
+        if (total + popcnt >= rank) {
+            return c;
+        }
+
+        total += popcnt;
+    }
+
+    return size;
+}
+
 
 template <typename T>
 constexpr bool SelectFW(T arg, size_t& total, size_t count, size_t& stop) noexcept
@@ -265,17 +401,19 @@ SelectResult Select1FW(const T* buffer, size_t start, size_t stop, size_t rank)
     }
 
 
-    for (size_t cell = start_cell; cell < stop_cell; cell++)
+    size_t cell = stop_cell;
+    if (total < rank) {
+        cell = start_cell + intrnl2::FindCellFW(buffer + start_cell, stop_cell - start_cell, rank, total, false);
+    }
+    else if (start_cell < stop_cell) {
+        // Only rank == 0 gets here. It isn't found past the prefix, the
+        // cells are just counted.
+        total += PopCntCells(buffer + start_cell, stop_cell - start_cell);
+    }
+    if (cell < stop_cell)
     {
         result = SelectFW(buffer[cell], rank - total);
-        if (result < 100)
-        {
-            return SelectResult((cell << divisor) + result, rank, true);
-        }
-        else
-        {
-            total += result - 100;
-        }
+        return SelectResult((cell << divisor) + result, rank, true);
     }
 
     if (suffix > 0)
@@ -337,17 +475,19 @@ SelectResult Select0FW(const T* buffer, size_t start, size_t stop, size_t rank)
     }
 
 
-    for (size_t cell = start_cell; cell < stop_cell; cell++)
+    size_t cell = stop_cell;
+    if (total < rank) {
+        cell = start_cell + intrnl2::FindCellFW(buffer + start_cell, stop_cell - start_cell, rank, total, true);
+    }
+    else if (start_cell < stop_cell) {
+        // Only rank == 0 gets here. It isn't found past the prefix, the
+        // cells are just counted.
+        total += ((stop_cell - start_cell) << divisor) - PopCntCells(buffer + start_cell, stop_cell - start_cell);
+    }
+    if (cell < stop_cell)
     {
-        result = SelectFW(~buffer[cell], rank - total);
-        if (result < 100)
-        {
-            return SelectResult((cell << divisor) + result, rank, true);
-        }
-        else
-        {
-            total += result - 100;
-        }
+        result = SelectFW(static_cast<T>(~buffer[cell]), rank - total);
+        return SelectResult((cell << divisor) + result, rank, true);
     }
 
     if (suffix > 0)
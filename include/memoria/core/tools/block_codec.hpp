@@ -0,0 +1,56 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/tools/result.hpp>
+
+namespace memoria {
+
+// General-purpose compressors for serialized blocks. LZ4 is the fast one,
+// ZSTD has better ratio. Codecs are optional dependencies, see BUILD_WITH_LZ4
+// and BUILD_WITH_ZSTD. Values are stored in images, so they must not change.
+enum class BlockCodec: uint8_t {
+    NONE = 0, LZ4 = 1, ZSTD = 2
+};
+
+const char* block_codec_name(BlockCodec codec) noexcept;
+
+bool is_block_codec_available(BlockCodec codec) noexcept;
+
+// Maximal compressed size of a buffer of the given size
+size_t block_codec_bound(BlockCodec codec, size_t size) noexcept;
+
+// Level 0 is the codec's default. For LZ4, levels above 0 select LZ4-HC.
+// Returns the compressed size, capacity must be at least block_codec_bound().
+Result<size_t> compress_block(
+        BlockCodec codec,
+        int32_t level,
+        const uint8_t* src,
+        size_t size,
+        uint8_t* dst,
+        size_t capacity
+) noexcept;
+
+// Size is the exact size of the decompressed data
+VoidResult decompress_block(
+        BlockCodec codec,
+        const uint8_t* src,
+        size_t compressed_size,
+        uint8_t* dst,
+        size_t size
+) noexcept;
+
+}
@@ -0,0 +1,97 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memoria/core/config.hpp>
+
+#include <cstdlib>
+
+// Runtime-dispatched ISA extensions. Kernels are compiled with per-function
+// target attributes (MMA_TARGET), so the rest of the code base does not need
+// -mavx2 and friends, and are selected at runtime via CpuFeatures.
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(MMA_CLANG))
+#   define MMA_X86_SIMD
+#   include <immintrin.h>
+#   define MMA_TARGET(isa) __attribute__((target(isa)))
+#else
+#   define MMA_TARGET(isa)
+#endif
+
+namespace memoria {
+
+class CpuFeatures {
+    bool sse42_{};
+    bool popcnt_{};
+    bool bmi2_{};
+    bool avx2_{};
+
+    CpuFeatures() noexcept {
+        detect();
+    }
+
+public:
+    bool sse42() const noexcept {return sse42_;}
+    bool popcnt() const noexcept {return popcnt_;}
+    bool bmi2() const noexcept {return bmi2_;}
+    bool avx2() const noexcept {return avx2_;}
+
+    static const CpuFeatures& get() noexcept {
+        return instance();
+    }
+
+    // Benchmarks and tests use this to compare the portable code with
+    // the dispatched kernels. Not thread safe.
+    static void set_portable(bool portable) noexcept
+    {
+        if (portable) {
+            instance().sse42_  = false;
+            instance().popcnt_ = false;
+            instance().bmi2_   = false;
+            instance().avx2_   = false;
+        }
+        else {
+            instance().detect();
+        }
+    }
+
+private:
+    static CpuFeatures& instance() noexcept
+    {
+        static CpuFeatures features;
+        return features;
+    }
+
+    void detect() noexcept
+    {
+#ifdef MMA_X86_SIMD
+        // MEMORIA_PORTABLE_KERNELS=1 in the environment disables all
+        // ISA-specific paths.
+        const char* portable = std::getenv("MEMORIA_PORTABLE_KERNELS");
+        if (portable && portable[0] == '1') {
+            return;
+        }
+
+        __builtin_cpu_init();
+
+        sse42_  = __builtin_cpu_supports("sse4.2");
+        popcnt_ = __builtin_cpu_supports("popcnt");
+        bmi2_   = __builtin_cpu_supports("bmi2");
+        avx2_   = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+}
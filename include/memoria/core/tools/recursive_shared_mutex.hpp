@@ -0,0 +1,162 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace memoria {
+
+// Reader-writer mutex, recursive in both modes. The thread owning it
+// exclusively may also lock it shared. Shared to exclusive upgrade is
+// not supported and deadlocks.
+//
+// Writers are preferred: once a thread is waiting for exclusive
+// ownership, new readers wait for it to finish.
+class RecursiveSharedMutex {
+    struct SharedHold {
+        const RecursiveSharedMutex* mutex;
+        int64_t depth;
+    };
+
+    std::shared_mutex mutex_;
+    std::mutex writers_gate_;
+
+    std::atomic<std::thread::id> owner_{};
+    std::atomic<int64_t> writers_{0};
+
+    // Guarded by exclusive ownership
+    int64_t depth_{};
+
+public:
+    RecursiveSharedMutex() = default;
+
+    RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+    RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+    void lock()
+    {
+        if (!is_owned_by_this_thread())
+        {
+            writers_.fetch_add(1);
+            writers_gate_.lock();
+            mutex_.lock();
+            owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        }
+
+        depth_++;
+    }
+
+    bool try_lock()
+    {
+        if (!is_owned_by_this_thread())
+        {
+            if (!writers_gate_.try_lock()) {
+                return false;
+            }
+
+            if (!mutex_.try_lock())
+            {
+                writers_gate_.unlock();
+                return false;
+            }
+
+            writers_.fetch_add(1);
+            owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        }
+
+        depth_++;
+        return true;
+    }
+
+    void unlock()
+    {
+        if (--depth_ == 0)
+        {
+            owner_.store(std::thread::id{}, std::memory_order_relaxed);
+            mutex_.unlock();
+            writers_gate_.unlock();
+            writers_.fetch_sub(1);
+        }
+    }
+
+    void lock_shared()
+    {
+        if (is_owned_by_this_thread()) {
+            depth_++;
+            return;
+        }
+
+        auto& holds = shared_holds();
+        for (auto& hold: holds)
+        {
+            if (hold.mutex == this) {
+                hold.depth++;
+                return;
+            }
+        }
+
+        if (writers_.load() > 0)
+        {
+            // Wait for pending writers
+            std::lock_guard<std::mutex> gate(writers_gate_);
+        }
+
+        mutex_.lock_shared();
+        holds.push_back(SharedHold{this, 1});
+    }
+
+    void unlock_shared()
+    {
+        if (is_owned_by_this_thread()) {
+            depth_--;
+            return;
+        }
+
+        auto& holds = shared_holds();
+        for (size_t c = 0; c < holds.size(); c++)
+        {
+            if (holds[c].mutex == this)
+            {
+                if (--holds[c].depth == 0)
+                {
+                    holds.erase(holds.begin() + c);
+                    mutex_.unlock_shared();
+                }
+
+                return;
+            }
+        }
+    }
+
+private:
+    bool is_owned_by_this_thread() const noexcept {
+        return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+    // Shared locks held by the current thread, usually none or one
+    static std::vector<SharedHold>& shared_holds() noexcept
+    {
+        thread_local std::vector<SharedHold> holds;
+        return holds;
+    }
+};
+
+}
@@ -21,6 +21,8 @@
 
 #include <memoria/filesystem/path.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <limits>
 #include <memory>
@@ -121,6 +123,84 @@ public:
     virtual ~FileInputStreamHandler() noexcept {}
 };
 
+// Input stream over a memory buffer, like a memory-mapped file. The buffer
+// is not copied, so it must outlive the stream. Unlike file streams, the
+// position can be queried and moved, so parts of the buffer may be
+// indexed in one pass and read later.
+class MemoryInputStreamHandler final: public InputStreamHandler {
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_{};
+
+public:
+    MemoryInputStreamHandler(const void* data, size_t size):
+        data_(static_cast<const uint8_t*>(data)),
+        size_(size)
+    {}
+
+    using InputStreamHandler::read;
+
+    const uint8_t* data() const {return data_;}
+    size_t size() const {return size_;}
+    size_t position() const {return pos_;}
+
+    void skip(size_t length)
+    {
+        if (length > size_ - pos_) {
+            MMA_THROW(Exception()) << WhatCInfo("End Of File");
+        }
+
+        pos_ += length;
+    }
+
+    virtual int32_t available() {
+        return static_cast<int32_t>(std::min<size_t>(size_ - pos_, std::numeric_limits<int32_t>::max()));
+    }
+
+    virtual int32_t bufferSize() {return 0;}
+
+    virtual void close() {}
+
+    virtual size_t read(void* mem, size_t offset, size_t length)
+    {
+        if (length > size_ - pos_) {
+            return std::numeric_limits<size_t>::max();
+        }
+
+        std::memcpy(static_cast<uint8_t*>(mem) + offset, data_ + pos_, length);
+        pos_ += length;
+
+        return length;
+    }
+
+    virtual int8_t readByte()       {return readT<int8_t>();}
+    virtual uint8_t readUByte()     {return readT<uint8_t>();}
+    virtual int16_t readShort()     {return readT<int16_t>();}
+    virtual uint16_t readUShort()   {return readT<uint16_t>();}
+    virtual int32_t readInt()       {return readT<int32_t>();}
+    virtual uint32_t readUInt32()   {return readT<uint32_t>();}
+    virtual int64_t readInt64()     {return readT<int64_t>();}
+    virtual uint64_t readUInt64()   {return readT<uint64_t>();}
+    virtual bool readBool()         {return readT<int8_t>();}
+    virtual float readFloat()       {return readT<float>();}
+    virtual double readDouble()     {return readT<double>();}
+
+private:
+    template <typename T>
+    T readT()
+    {
+        if (sizeof(T) > size_ - pos_) {
+            MMA_THROW(Exception()) << WhatCInfo("Can't read value from InputStreamHandler");
+        }
+
+        T value;
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+
+        return value;
+    }
+};
+
 
 
 
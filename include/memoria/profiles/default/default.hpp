@@ -45,12 +45,28 @@ struct ProfileTraits<DefaultProfile<>> {
 
     static constexpr bool IsCoW = false;
 
+#ifdef MEMORIA_SEQUENTIAL_BLOCK_IDS
+    static constexpr bool SequentialBlockIDs = true;
+#else
+    static constexpr bool SequentialBlockIDs = false;
+#endif
+
     using BlockG = typename AllocatorType::BlockG;
 
     static UUID make_random_block_id() {
         return UUID::make_random();
     }
 
+    // Sequential block IDs have zero high part, random (v4) UUIDs never do,
+    // so both kinds can coexist in the same store.
+    static UUID make_sequential_block_id(uint64_t seq) {
+        return UUID(0, seq);
+    }
+
+    static uint64_t sequential_block_id_value(const UUID& id) {
+        return id.hi() == 0 ? id.lo() : 0;
+    }
+
     static UUID make_random_block_guid() {
         return UUID::make_random();
     }
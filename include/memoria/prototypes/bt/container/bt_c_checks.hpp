@@ -107,7 +107,7 @@ public:
         }
         else {
             MEMORIA_TRY_VOID(self().ctr_dump_node(node));
-            MMA_ERROR(self(), "Node content check failed", res.memoria_error()->what());
+            MMA_ERROR(self(), "Node content check failed", res.memoria_error()->what()); fprintf(stderr, "CHECKFAIL %s %s\n", self().type_name_cstr(), res.memoria_error()->what().data());
             return BoolResult::of(true);
         }
     }
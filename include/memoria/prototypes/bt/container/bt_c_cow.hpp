@@ -57,11 +57,12 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::CoWOpsName)
 
             if (level + 1 < path_size)
             {
-                new_node->header().set_references(1);
-
                 MEMORIA_TRY(parent_idx, self.ctr_get_parent_idx(path, level));
                 MEMORIA_TRY(old_child_id, self.ctr_set_child_id(path[level + 1], parent_idx, new_node->id()));
 
+                // Stores keeping counters outside of blocks don't
+                // see the block header
+                MEMORIA_TRY_VOID(self.ctr_ref_block(new_node->id()));
                 MEMORIA_TRY_VOID(self.ctr_unref_block(old_child_id));
             }
             else {
@@ -84,7 +85,7 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::CoWOpsName)
 
         MEMORIA_TRY(block, self.ctr_get_block(block_id));
 
-        MEMORIA_TRY(no_references, self.store().unref_block(block));
+        MEMORIA_TRY(no_references, self.store().unref_ctr_block(block, self.root()));
         if (no_references)
         {
             if (!block->is_leaf())
@@ -22,7 +22,12 @@
 
 #include <memoria/core/container/macros.hpp>
 
+#include <memoria/core/tools/span.hpp>
+
+#include <algorithm>
 #include <limits>
+#include <numeric>
+#include <vector>
 
 namespace memoria {
 
@@ -85,6 +90,101 @@ public:
         return self().ctr_find(walker);
     }
 
+    // Locates the first entry >= key for a batch of keys of a max-indexed
+    // substream. Keys are visited in ascending order and each search starts
+    // from the lowest node of the previous path whose subtree covers the key,
+    // so nearby keys share the upper part of the descent. fn(key_idx, leaf, idx)
+    // is called for each key having such an entry, no iterators are created.
+    template <typename LeafPath, typename KeyT, typename Fn>
+    VoidResult ctr_find_max_ge_many(int32_t index, Span<const KeyT> keys, Fn&& fn) const noexcept
+    {
+        using Walker = typename Types::template FindMaxGEWalker<Types, LeafPath>;
+
+        auto& self = this->self();
+
+        std::vector<size_t> order;
+        bool sorted = std::is_sorted(keys.begin(), keys.end());
+
+        if (!sorted)
+        {
+            MEMORIA_TRY_VOID(wrap_throwing([&] {
+                order.resize(keys.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                    return keys[a] < keys[b];
+                });
+            }));
+        }
+
+        MEMORIA_TRY(root, self.ctr_get_root_node());
+        if (!root.isSet() || keys.size() == 0) {
+            return VoidResult::of();
+        }
+
+        int32_t root_level = root->level();
+
+        TreePathT path;
+        path.resize(root_level + 1);
+        path.set(root_level, root);
+
+        int32_t level = root_level;
+
+        for (size_t c = 0; c < keys.size(); c++)
+        {
+            size_t key_idx = sorted ? c : order[c];
+
+            Walker walker(index, keys[key_idx]);
+
+            int32_t idx;
+            while (true)
+            {
+                const NodeBaseG& node = path[level];
+
+                if (level == 0)
+                {
+                    MEMORIA_TRY(result, self.leaf_dispatcher().dispatch(node, walker, WalkDirection::DOWN, 0));
+                    if (!result.out_of_range()) {
+                        idx = result.local_pos();
+                        break;
+                    }
+                }
+                else {
+                    MEMORIA_TRY(result, self.branch_dispatcher().dispatch(node, walker, WalkDirection::DOWN, 0));
+                    if (!result.out_of_range()) {
+                        idx = result.local_pos();
+                        break;
+                    }
+                }
+
+                if (level == root_level) {
+                    // This and the following keys are above the container's max
+                    return VoidResult::of();
+                }
+
+                level++;
+            }
+
+            while (level > 0)
+            {
+                MEMORIA_TRY(child, self.ctr_get_node_child(path[level], idx));
+                path.set(--level, child);
+
+                if (level > 0) {
+                    MEMORIA_TRY(result, self.branch_dispatcher().dispatch(child, walker, WalkDirection::DOWN, 0));
+                    idx = result.local_pos();
+                }
+                else {
+                    MEMORIA_TRY(result, self.leaf_dispatcher().dispatch(child, walker, WalkDirection::DOWN, 0));
+                    idx = result.local_pos();
+                }
+            }
+
+            MEMORIA_TRY_VOID(fn(key_idx, path.leaf(), idx));
+        }
+
+        return VoidResult::of();
+    }
+
     template <typename LeafPath>
     Result<IteratorPtr> ctr_rank(int32_t index, CtrSizeT pos) const noexcept
     {
@@ -22,6 +22,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 namespace memoria {
 
@@ -364,14 +367,166 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::InsertBatchCommonName)
 
 
 
+    // Fills leaves from several providers, each supplying a consecutive
+    // part of the input, on up to the given number of threads. Leaves of
+    // all providers are chained into one list in the providers' order.
+    //
+    // The allocator is not thread-safe, so blocks are created and their
+    // guards are released under a lock. Only filling runs concurrently.
+    template <typename Provider>
+    Result<LeafList> ctr_create_leaf_data_list_parallel(const std::vector<Provider*>& providers, size_t threads) noexcept
+    {
+        using ResultT = Result<LeafList>;
+        auto& self = this->self();
+
+        MEMORIA_TRY(meta, self.ctr_get_root_metadata());
+        int32_t block_size = meta.memory_block_size();
+
+        size_t partitions = providers.size();
+
+        std::vector<NodeBaseG> heads(partitions);
+        std::vector<NodeBaseG> tails(partitions);
+        std::vector<NodeBaseG> leaves(partitions);
+        std::vector<CtrSizeT> sizes(partitions);
+
+        std::mutex alloc_mutex;
+
+        auto fill_partition = [&](size_t p) -> VoidResult {
+            Provider& provider = *providers[p];
+
+            while (true)
+            {
+                MEMORIA_TRY(has_data, provider.hasData());
+
+                if (!has_data) {
+                    break;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(alloc_mutex);
+
+                    MEMORIA_TRY(node, self.ctr_create_node(0, false, true, block_size));
+
+                    if (heads[p].isSet())
+                    {
+                        tails[p]->next_leaf_id() = node->id();
+                    }
+                    else {
+                        heads[p] = node;
+                    }
+
+                    leaves[p] = node;
+                }
+
+                MEMORIA_TRY_VOID(self.ctr_layout_leaf_node(leaves[p], Position(0)));
+                MEMORIA_TRY_VOID(provider.fill(leaves[p], Position()));
+                MEMORIA_TRY_VOID(provider.iter_next_leaf(leaves[p]));
+
+                {
+                    std::lock_guard<std::mutex> lock(alloc_mutex);
+                    tails[p] = leaves[p];
+                    leaves[p] = NodeBaseG();
+                }
+
+                sizes[p]++;
+            }
+
+            return VoidResult::of();
+        };
+
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+
+        std::mutex error_mutex;
+        VoidResult error = VoidResult::of();
+
+        auto worker = [&]() noexcept {
+            while (!failed.load(std::memory_order_relaxed))
+            {
+                size_t p = next.fetch_add(1, std::memory_order_relaxed);
+                if (p >= partitions) {
+                    break;
+                }
+
+                auto res = wrap_throwing([&]() -> VoidResult {
+                    return fill_partition(p);
+                });
+
+                if (res.is_error())
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!failed.exchange(true)) {
+                        error = std::move(res);
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t c = 1; c < std::min(threads, partitions); c++)
+        {
+            try {
+                workers.emplace_back(worker);
+            }
+            catch (...) {
+                // Proceed with the threads we have
+                break;
+            }
+        }
+
+        worker();
+
+        for (auto& thread: workers) {
+            thread.join();
+        }
+
+        MEMORIA_RETURN_IF_ERROR(error);
+
+        CtrSizeT    total = 0;
+        NodeBaseG   head;
+        NodeBaseG   tail;
+
+        for (size_t p = 0; p < partitions; p++)
+        {
+            if (sizes[p] > 0)
+            {
+                if (head.isSet())
+                {
+                    tail->next_leaf_id() = heads[p]->id();
+                }
+                else {
+                    head = heads[p];
+                }
+
+                tail = tails[p];
+                total += sizes[p];
+            }
+        }
+
+        return ResultT::of(total, head, tail);
+    }
+
+
+
+
     template <typename Provider>
     VoidResult ctr_insert_data_rest(TreePathT& path, Position& end_pos, Provider& provider) noexcept
     {
-        using ResultT = VoidResult;
         auto& self = this->self();
 
         MEMORIA_TRY(leaf_list, self.ctr_create_leaf_data_list(provider));
 
+        return self.ctr_insert_leaf_list(path, leaf_list);
+    }
+
+
+    // Inserts the list of filled leaves after the path's leaf,
+    // building branch levels above them.
+    VoidResult ctr_insert_leaf_list(TreePathT& path, LeafList& leaf_list) noexcept
+    {
+        using ResultT = VoidResult;
+        auto& self = this->self();
+
         if (leaf_list.size() > 0)
         {
             ListLeafProvider list_provider(self, leaf_list.head(), leaf_list.size());
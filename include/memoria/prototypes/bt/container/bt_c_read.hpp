@@ -20,6 +20,9 @@
 #include <memoria/prototypes/bt/bt_macros.hpp>
 #include <memoria/core/container/macros.hpp>
 
+#include <memoria/core/tools/arena_buffer.hpp>
+#include <memoria/core/tools/span.hpp>
+
 
 #include <vector>
 #include <utility>
@@ -89,20 +92,23 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::ReadName)
     }
 
     template <typename SubstreamPath>
-    struct ReadSubstreamFn {
+    struct ReadSingleSubstreamFn {
 
         template <int32_t SubstreamIdx, typename StreamObj, typename Fn>
-        auto stream(const StreamObj& obj, int32_t from, int32_t to, Fn&& entry) noexcept
+        void stream(const StreamObj& obj, int32_t block, int32_t from, int32_t to, Fn&& entry)
         {
             static constexpr int32_t StreamIdx = ListHead<SubstreamPath>::Value;
 
-            obj.read(from, to, make_fn_with_next([&](int32_t block, auto&& value) {
+            using V = std::decay_t<decltype(obj.access(block, from))>;
+
+            ArenaBuffer<V> buffer;
+            for (const auto& value: obj.read_batch(block, from, to, buffer)) {
                 entry.put(bt::StreamTag<StreamIdx>(), bt::StreamTag<SubstreamIdx>(), value);
-            }));
+            }
         }
 
-        template <typename NodeSO, typename Fn>
-        Int32Result treeNode(const NodeSO& node, int32_t from, CtrSizeT to, Fn&& fn) noexcept
+        template <typename Node, typename Fn>
+        Int32Result treeNode(const Node& node, int32_t block, int32_t from, CtrSizeT to, Fn&& fn) noexcept
         {
             MEMORIA_TRY(limit, node.size(ListHead<SubstreamPath>::Value));
 
@@ -110,14 +116,16 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::ReadName)
                 limit = to;
             }
 
-            MEMORIA_TRY_VOID(node.template processStream<SubstreamPath>(*this, from, limit, std::forward<Fn>(fn)));
+            if (from < limit) {
+                MEMORIA_TRY_VOID(node.template processStream<SubstreamPath>(*this, block, from, limit, std::forward<Fn>(fn)));
+            }
 
             return Int32Result::of(limit - from);
         }
     };
 
     template <typename SubstreamPath, typename Fn>
-    Result<CtrSizeT> ctr_read_substream(Iterator& iter, int32_t block, CtrSizeT length, Fn&& fn) noexcept
+    Result<CtrSizeT> ctr_read_single_substream(Iterator& iter, int32_t block, CtrSizeT length, Fn&& fn) noexcept
     {
         CtrSizeT total = 0;
 
@@ -125,10 +133,11 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::ReadName)
         {
             auto idx = iter.iter_local_pos();
 
-            MEMORIA_TRY(processed, self().leaf_dispatcher().dispatch(iter.iter_leaf(), ReadSubstreamFn<SubstreamPath>(), idx, idx + (length - total), std::forward<Fn>(fn)));
+            MEMORIA_TRY(processed, self().leaf_dispatcher().dispatch(iter.iter_leaf(), ReadSingleSubstreamFn<SubstreamPath>(), block, idx, idx + (length - total), fn));
 
             if (processed > 0) {
-                total += iter.iter_skip_fw(processed);
+                MEMORIA_TRY(skipped, iter.template iter_skip_fw<ListHead<SubstreamPath>::Value>(processed));
+                total += skipped;
             }
             else {
                 break;
@@ -138,57 +147,10 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(bt::ReadName)
         return total;
     }
 
-
-
-
-    template <typename SubstreamPath>
-    struct ReadSingleSubstreamFn {
-
-        template <int32_t SubstreamIdx, typename StreamObj, typename Fn>
-        auto stream(const StreamObj& obj, int32_t from, int32_t to, int32_t block, Fn&& entry)
-        {
-            static constexpr int32_t StreamIdx = ListHead<SubstreamPath>::Value;
-
-            obj.read(from, to, make_fn_with_next([&](int32_t block, auto&& value) {
-                entry.put(bt::StreamTag<StreamIdx>(), bt::StreamTag<SubstreamIdx>(), value);
-            }));
-        }
-
-        template <typename Node, typename Fn>
-        Int32Result treeNode(const Node& node, int32_t from, CtrSizeT to, int32_t block, Fn&& fn) noexcept
-        {
-            MEMORIA_TRY(limit, node.size(0));
-
-            if (to < limit) {
-                limit = to;
-            }
-
-            MEMORIA_TRY_VOID(node.template processStream<SubstreamPath>(*this, from, limit, block, std::forward<Fn>(fn)));
-
-            return Int32Result::of(limit - from);
-        }
-    };
-
     template <typename SubstreamPath, typename Fn>
-    Result<CtrSizeT> ctr_read_single_substream(Iterator& iter, int32_t block, CtrSizeT length, Fn&& fn) noexcept
+    Result<CtrSizeT> ctr_read_substream(Iterator& iter, int32_t block, CtrSizeT length, Fn&& fn) noexcept
     {
-        CtrSizeT total = 0;
-
-        while (total < length)
-        {
-            auto idx = iter.iter_local_pos();
-
-            MEMORIA_TRY(processed, self().leaf_dispatcher().dispatch(iter.iter_leaf(), ReadSingleSubstreamFn<SubstreamPath>(), block, idx, idx + (length - total), std::forward<Fn>(fn)));
-
-            if (processed > 0) {
-                total += iter.iter_skip_fw(processed);
-            }
-            else {
-                break;
-            }
-        }
-
-        return total;
+        return ctr_read_single_substream<SubstreamPath>(iter, block, length, std::forward<Fn>(fn));
     }
 
 
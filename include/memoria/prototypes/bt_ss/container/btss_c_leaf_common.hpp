@@ -111,6 +111,58 @@ MEMORIA_V1_CONTAINER_PART_BEGIN(btss::LeafCommonName)
         return ResultT::of(streaming.totals());
     }
 
+    // Loads an empty container from several producers, each supplying a
+    // consecutive part of the input, in order. The root leaf is filled from
+    // the first producer, the rest of the leaves are filled by up to the
+    // given number of threads and branch levels are built afterwards.
+    Result<CtrSizeT> ctr_bulk_load_iovector(const std::vector<io::IOVectorProducer*>& producers, size_t threads) noexcept
+    {
+        using ResultT = Result<CtrSizeT>;
+        using Provider = btss::io::IOVectorBTSSInputProvider<MyType>;
+
+        auto& self = this->self();
+
+        MEMORIA_TRY(size, self.size());
+        if (size > 0) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Bulk loading is only possible into an empty container, size = {}", size);
+        }
+
+        if (producers.empty()) {
+            return ResultT::of(0);
+        }
+
+        std::vector<std::unique_ptr<io::IOVector>> iovectors;
+        std::vector<std::unique_ptr<Provider>> providers;
+        std::vector<Provider*> provider_ptrs;
+
+        for (io::IOVectorProducer* producer: producers)
+        {
+            MEMORIA_TRY(iov, LeafNode::template SparseObject<MyType>::create_iovector());
+            iovectors.push_back(std::move(iov));
+
+            providers.push_back(std::make_unique<Provider>(
+                self, producer, iovectors.back().get(), 0, std::numeric_limits<CtrSizeT>::max()
+            ));
+
+            provider_ptrs.push_back(providers.back().get());
+        }
+
+        MEMORIA_TRY(iter, self.ctr_begin());
+        TreePathT& path = iter->path();
+
+        MEMORIA_TRY_VOID(self.ctr_insert_data_into_leaf(path, Position(0), *provider_ptrs[0]));
+
+        MEMORIA_TRY(leaf_list, self.ctr_create_leaf_data_list_parallel(provider_ptrs, threads));
+        MEMORIA_TRY_VOID(self.ctr_insert_leaf_list(path, leaf_list));
+
+        CtrSizeT total = 0;
+        for (auto& provider: providers) {
+            total += provider->totals();
+        }
+
+        return ResultT::of(total);
+    }
+
     struct BTSSIOVectorProducer: io::IOVectorProducer {
         virtual bool populate(io::IOVector& io_vector)
         {
@@ -0,0 +1,279 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/exceptions/exceptions.hpp>
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace memoria {
+
+namespace _ {
+
+// Finalizer from MurmurHash3. std::hash<> for integers is identity
+// in libstdc++, that is not good enough for linear probing.
+static inline uint64_t hashed_pool_mix(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+template <typename ID>
+struct HashedPoolHash {
+    uint64_t operator()(const ID& id) const noexcept {
+        return _::hashed_pool_mix(std::hash<ID>()(id));
+    }
+};
+
+
+/**
+ * Drop-in replacement for StaticPool with O(1) get/allocate/release.
+ *
+ * Objects are kept in fixed-size chunks, so pointers returned by get() and
+ * allocate() stay valid until the object is released, regardless of how many
+ * objects are live. ID -> Object* index is an open-addressing table with linear
+ * probing and backward-shift deletion (no tombstones), allocated on cache line
+ * boundary. Empty ID (ID{}) is used as an empty slot marker.
+ */
+template <typename ID, typename Object, typename Hash = HashedPoolHash<ID>>
+class HashedPool {
+    using MyType = HashedPool<ID, Object, Hash>;
+
+    static constexpr size_t CACHE_LINE_SIZE  = 64;
+    static constexpr size_t CHUNK_SIZE       = 64;
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    struct Slot {
+        ID      id;
+        Object* object;
+    };
+
+    struct SlotsDeleter {
+        void operator()(Slot* slots) const noexcept {
+            ::operator delete(slots, std::align_val_t{CACHE_LINE_SIZE});
+        }
+    };
+
+    using SlotsPtr = std::unique_ptr<Slot[], SlotsDeleter>;
+
+    SlotsPtr slots_;
+    size_t   capacity_{};
+    size_t   mask_{};
+
+    int32_t  size_{};
+    int32_t  Max{};
+
+    std::vector<std::unique_ptr<Object[]>> chunks_;
+    std::vector<Object*> free_list_;
+
+    Hash hash_;
+
+public:
+    HashedPool()
+    {
+        init_slots(INITIAL_CAPACITY);
+    }
+
+    // Same semantics as StaticPool: copies are empty.
+    HashedPool(const MyType& other): HashedPool() {}
+
+    MyType& operator=(const MyType& other) {
+        return *this;
+    }
+
+    Object* get(const ID& id) noexcept
+    {
+        const ID EMPTY{};
+        for (size_t idx = hash_(id) & mask_;; idx = (idx + 1) & mask_)
+        {
+            const Slot& slot = slots_[idx];
+            if (slot.id == id)
+            {
+                return slot.object;
+            }
+            else if (slot.id == EMPTY)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    Object* allocate(const ID& id)
+    {
+        if (MMA_UNLIKELY((static_cast<size_t>(size_) + 1) * 2 > capacity_))
+        {
+            rehash(capacity_ * 2);
+        }
+
+        Object* object = take_object();
+
+        insert_slot(id, object);
+
+        size_++;
+        if (size_ > Max) Max = size_;
+
+        object->init();
+        return object;
+    }
+
+    void release(const ID& id)
+    {
+        const ID EMPTY{};
+        for (size_t idx = hash_(id) & mask_;; idx = (idx + 1) & mask_)
+        {
+            Slot& slot = slots_[idx];
+            if (slot.id == id)
+            {
+                free_list_.push_back(slot.object);
+                erase_slot(idx);
+                size_--;
+                return;
+            }
+            else if (slot.id == EMPTY)
+            {
+                break;
+            }
+        }
+
+        MMA_THROW(Exception()) << WhatCInfo("ID is not known in this HashedPool");
+    }
+
+    int32_t getMax() const noexcept {
+        return Max;
+    }
+
+    int32_t getUsage() const noexcept {
+        return size_;
+    }
+
+    int32_t getCapacity() const noexcept {
+        return static_cast<int32_t>(chunks_.size() * CHUNK_SIZE) - size_;
+    }
+
+    void clear() noexcept
+    {
+        const ID EMPTY{};
+        for (size_t c = 0; c < capacity_; c++)
+        {
+            if (slots_[c].id != EMPTY)
+            {
+                free_list_.push_back(slots_[c].object);
+                slots_[c].id = EMPTY;
+            }
+        }
+
+        size_ = 0;
+    }
+
+private:
+    void init_slots(size_t capacity)
+    {
+        Slot* slots = static_cast<Slot*>(
+            ::operator new(capacity * sizeof(Slot), std::align_val_t{CACHE_LINE_SIZE})
+        );
+
+        for (size_t c = 0; c < capacity; c++)
+        {
+            new (slots + c) Slot{ID{}, nullptr};
+        }
+
+        slots_    = SlotsPtr(slots);
+        capacity_ = capacity;
+        mask_     = capacity - 1;
+    }
+
+    void rehash(size_t new_capacity)
+    {
+        SlotsPtr old_slots = std::move(slots_);
+        size_t old_capacity = capacity_;
+
+        init_slots(new_capacity);
+
+        const ID EMPTY{};
+        for (size_t c = 0; c < old_capacity; c++)
+        {
+            if (old_slots[c].id != EMPTY)
+            {
+                insert_slot(old_slots[c].id, old_slots[c].object);
+            }
+        }
+    }
+
+    void insert_slot(const ID& id, Object* object) noexcept
+    {
+        const ID EMPTY{};
+        size_t idx = hash_(id) & mask_;
+        while (slots_[idx].id != EMPTY)
+        {
+            idx = (idx + 1) & mask_;
+        }
+
+        slots_[idx].id     = id;
+        slots_[idx].object = object;
+    }
+
+    void erase_slot(size_t hole) noexcept
+    {
+        const ID EMPTY{};
+
+        // Backward-shift deletion: move following entries of the probe
+        // sequence into the hole while it is on their path.
+        for (size_t idx = (hole + 1) & mask_; slots_[idx].id != EMPTY; idx = (idx + 1) & mask_)
+        {
+            size_t home = hash_(slots_[idx].id) & mask_;
+            if (((idx - home) & mask_) >= ((idx - hole) & mask_))
+            {
+                slots_[hole] = slots_[idx];
+                hole = idx;
+            }
+        }
+
+        slots_[hole].id     = EMPTY;
+        slots_[hole].object = nullptr;
+    }
+
+    Object* take_object()
+    {
+        if (free_list_.empty())
+        {
+            chunks_.emplace_back(new Object[CHUNK_SIZE]);
+            Object* chunk = chunks_.back().get();
+
+            free_list_.reserve(chunks_.size() * CHUNK_SIZE);
+            for (size_t c = CHUNK_SIZE; c > 0; c--)
+            {
+                free_list_.push_back(chunk + c - 1);
+            }
+        }
+
+        Object* object = free_list_.back();
+        free_list_.pop_back();
+        return object;
+    }
+};
+
+}
@@ -74,7 +74,7 @@ public:
 
                 while (root_provider)
                 {
-                	LockGuardT guard(root_provider_->snapshot_mutex());
+                	LockGuardT guard(root_provider->snapshot_mutex());
 
                     if (!root_provider->is_dropped())
                     {
@@ -267,6 +267,43 @@ public:
         root_provider_->root_id() = typename BlockType::BlockID{};
     }
 
+    // Incremental version of delete_tree(). Unreferences up to max_nodes
+    // nodes from the stack and deletes the ones no other tree refers to,
+    // children of deleted branch nodes are pushed to the stack. Nodes are
+    // passed to fn before deletion. Returns the number of visited nodes.
+    static size_t delete_nodes(std::vector<NodeBaseT*>& stack, size_t max_nodes, const std::function<void (NodeBaseT*)>& fn)
+    {
+        size_t visited = 0;
+
+        for (; visited < max_nodes && stack.size() > 0; visited++)
+        {
+            NodeBaseT* node = stack.back();
+            stack.pop_back();
+
+            if (node->unref() == 0)
+            {
+                fn(node);
+
+                if (node->is_leaf())
+                {
+                    to_leaf_node(node)->del();
+                }
+                else {
+                    auto branch_node = to_branch_node(node);
+
+                    for (int32_t c = 0; c < branch_node->size(); c++)
+                    {
+                        stack.push_back(branch_node->data(c));
+                    }
+
+                    branch_node->del();
+                }
+            }
+        }
+
+        return visited;
+    }
+
 
     template <typename NodeConsumer>
     void conditional_tree_traverse(NodeConsumer& node_consumer) {
@@ -518,6 +555,13 @@ protected:
 
             clone_path(path, level + 1);
 
+            // Nodes created in this snapshot are not shared, and cloning them
+            // again would leak the previous copy.
+            if (node->snapshot_id() == this->snapshot_id())
+            {
+                return;
+            }
+
             parent = to_branch_node(path[level + 1]);
 
             int32_t parent_idx = parent->find_child_node(node);
@@ -547,7 +591,11 @@ protected:
         else {
             Path next = iter.path();
 
-            split_path(iter.path(), next);
+            // Appending to the rightmost leaf (sequential block IDs): leave
+            // full nodes behind instead of half-empty ones.
+            bool append = iter.local_pos() == iter.leaf()->size() && is_rightmost_path(iter.path());
+
+            split_path(iter.path(), next, 0, append);
 
             if (iter.local_pos() >= iter.leaf()->size())
             {
@@ -622,11 +670,24 @@ protected:
         child->ref();
     }
 
-    void split_path(Path& path, Path& next, int32_t level = 0)
+    bool is_rightmost_path(const Path& path) const
+    {
+        for (int32_t c = 0; c < path.size() - 1; c++)
+        {
+            if (to_branch_node(path[c + 1])->last_child() != path[c])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void split_path(Path& path, Path& next, int32_t level = 0, bool append = false)
     {
         NodeBaseT* node = path[level];
 
-        int32_t split_at = node->size() / 2;
+        int32_t split_at = append ? node->size() - 1 : node->size() / 2;
 
         NodeBaseT* right = create_node(level, this->snapshot_id());
         split_node(node, split_at, right);
@@ -649,7 +710,7 @@ protected:
                 next[level] = right;
             }
             else {
-                split_path(path, next, level + 1);
+                split_path(path, next, level + 1, append);
 
                 if (parent_idx >= parent->size())
                 {
@@ -0,0 +1,394 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/core/tools/uuid.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace memoria {
+namespace store {
+namespace memory {
+
+// Lower bound (number of keys less than the key) over a sorted run of
+// persistent tree node keys. Generic keys are scanned one by one,
+// 128-bit (UUID) and 64-bit keys have SSE4.2/AVX2 kernels selected at
+// runtime. Kernels compare a whole vector of keys at once and stop at
+// the first vector that is not entirely less than the key: since keys
+// are sorted, 'less' lanes form a prefix, so its length is the popcount
+// of the mask, whatever the lane order is.
+
+template <typename Key>
+struct PTreeKeySearch {
+    static int32_t count_less_scalar(const Key* keys, int32_t size, const Key& key) noexcept
+    {
+        int32_t c = 0;
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+        return c;
+    }
+
+    static bool is_vectorized() noexcept {
+        return false;
+    }
+
+    static int32_t count_less(const Key* keys, int32_t size, const Key& key) noexcept {
+        return count_less_scalar(keys, size, key);
+    }
+
+    static int32_t find(const Key* index, const Key* keys, int32_t size, int32_t block_size, const Key& key) noexcept
+    {
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_scalar(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_scalar(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+};
+
+
+template <>
+struct PTreeKeySearch<UUID> {
+
+    static_assert(sizeof(UUID) == 2 * sizeof(uint64_t), "UUID must be {hi, lo} pair of uint64_t");
+
+    static int32_t count_less_scalar(const UUID* keys, int32_t size, const UUID& key) noexcept
+    {
+        int32_t c = 0;
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+        return c;
+    }
+
+#ifdef MMA_X86_SIMD
+    MMA_TARGET("sse4.2")
+    static int32_t count_less_sse42(const UUID* keys, int32_t size, const UUID& key) noexcept
+    {
+        const __m128i sign = _mm_set1_epi64x(std::numeric_limits<int64_t>::min());
+        const __m128i khi  = _mm_xor_si128(_mm_set1_epi64x(key.hi()), sign);
+        const __m128i klo  = _mm_xor_si128(_mm_set1_epi64x(key.lo()), sign);
+
+        const __m128i* data = reinterpret_cast<const __m128i*>(keys);
+
+        int32_t c = 0;
+
+        for (; c + 2 <= size; c += 2)
+        {
+            __m128i x0 = _mm_loadu_si128(data + c);
+            __m128i x1 = _mm_loadu_si128(data + c + 1);
+
+            __m128i hi = _mm_xor_si128(_mm_unpacklo_epi64(x0, x1), sign);
+            __m128i lo = _mm_xor_si128(_mm_unpackhi_epi64(x0, x1), sign);
+
+            // hi < k.hi || (hi == k.hi && lo < k.lo)
+            __m128i lt = _mm_or_si128(
+                _mm_cmpgt_epi64(khi, hi),
+                _mm_and_si128(_mm_cmpeq_epi64(khi, hi), _mm_cmpgt_epi64(klo, lo))
+            );
+
+            int32_t mask = _mm_movemask_pd(_mm_castsi128_pd(lt));
+            if (mask != 0x3) {
+                return c + (mask & 1);
+            }
+        }
+
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+
+        return c;
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static int32_t count_less_avx2(const UUID* keys, int32_t size, const UUID& key) noexcept
+    {
+        const __m256i sign = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+        const __m256i khi  = _mm256_xor_si256(_mm256_set1_epi64x(key.hi()), sign);
+        const __m256i klo  = _mm256_xor_si256(_mm256_set1_epi64x(key.lo()), sign);
+
+        const __m256i* data = reinterpret_cast<const __m256i*>(keys);
+
+        int32_t c = 0;
+
+        for (; c + 4 <= size; c += 4)
+        {
+            __m256i x0 = _mm256_loadu_si256(data + c / 2);
+            __m256i x1 = _mm256_loadu_si256(data + c / 2 + 1);
+
+            // Transpose 4 keys into hi and lo vectors. Lane order is
+            // not preserved, but it does not matter for the prefix length.
+            __m256i hi = _mm256_xor_si256(_mm256_unpacklo_epi64(x0, x1), sign);
+            __m256i lo = _mm256_xor_si256(_mm256_unpackhi_epi64(x0, x1), sign);
+
+            __m256i lt = _mm256_or_si256(
+                _mm256_cmpgt_epi64(khi, hi),
+                _mm256_and_si256(_mm256_cmpeq_epi64(khi, hi), _mm256_cmpgt_epi64(klo, lo))
+            );
+
+            int32_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(lt));
+            if (mask != 0xF) {
+                return c + __builtin_popcount(mask);
+            }
+        }
+
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+
+        return c;
+    }
+
+    // Two-level search in a node, where index[i] is the max key of the
+    // i-th block of keys. Kernels are inlined here, so there is only
+    // one dispatched call per node.
+    MMA_TARGET("sse4.2")
+    static int32_t find_sse42(const UUID* index, const UUID* keys, int32_t size, int32_t block_size, const UUID& key) noexcept
+    {
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_sse42(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_sse42(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static int32_t find_avx2(const UUID* index, const UUID* keys, int32_t size, int32_t block_size, const UUID& key) noexcept
+    {
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_avx2(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_avx2(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+#endif
+
+    // Random UUIDs are nearly always ordered by the high word, so the
+    // early-exit scalar scan is as fast as the kernels are, and in a large
+    // tree, that is memory-bound, it is a bit faster. Sequential block IDs
+    // share the high word, and here the kernels pay off.
+    static bool is_vectorized() noexcept
+    {
+#ifdef MEMORIA_SEQUENTIAL_BLOCK_IDS
+        return CpuFeatures::get().avx2() || CpuFeatures::get().sse42();
+#else
+        return false;
+#endif
+    }
+
+    static int32_t count_less(const UUID* keys, int32_t size, const UUID& key) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return count_less_avx2(keys, size, key);
+        }
+        else if (CpuFeatures::get().sse42()) {
+            return count_less_sse42(keys, size, key);
+        }
+#endif
+        return count_less_scalar(keys, size, key);
+    }
+
+    static int32_t find(const UUID* index, const UUID* keys, int32_t size, int32_t block_size, const UUID& key) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return find_avx2(index, keys, size, block_size, key);
+        }
+        else if (CpuFeatures::get().sse42()) {
+            return find_sse42(index, keys, size, block_size, key);
+        }
+#endif
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_scalar(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_scalar(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+};
+
+
+template <typename Key>
+struct PTreeKeySearch64 {
+
+    static int32_t count_less_scalar(const Key* keys, int32_t size, const Key& key) noexcept
+    {
+        int32_t c = 0;
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+        return c;
+    }
+
+#ifdef MMA_X86_SIMD
+    // Unsigned keys are compared as signed ones with flipped sign bit.
+    static constexpr int64_t SIGN_FLIP = std::is_signed<Key>::value ? 0 : std::numeric_limits<int64_t>::min();
+
+    MMA_TARGET("sse4.2")
+    static int32_t count_less_sse42(const Key* keys, int32_t size, const Key& key) noexcept
+    {
+        const __m128i sign = _mm_set1_epi64x(SIGN_FLIP);
+        const __m128i kk   = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(key)), sign);
+
+        const __m128i* data = reinterpret_cast<const __m128i*>(keys);
+
+        int32_t c = 0;
+
+        for (; c + 2 <= size; c += 2)
+        {
+            __m128i xx = _mm_xor_si128(_mm_loadu_si128(data + c / 2), sign);
+            int32_t lt = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(kk, xx)));
+            if (lt != 0x3) {
+                return c + (lt & 1);
+            }
+        }
+
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+
+        return c;
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static int32_t count_less_avx2(const Key* keys, int32_t size, const Key& key) noexcept
+    {
+        const __m256i sign = _mm256_set1_epi64x(SIGN_FLIP);
+        const __m256i kk   = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(key)), sign);
+
+        const __m256i* data = reinterpret_cast<const __m256i*>(keys);
+
+        int32_t c = 0;
+
+        for (; c + 8 <= size; c += 8)
+        {
+            __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256(data + c / 4), sign);
+            __m256i x1 = _mm256_xor_si256(_mm256_loadu_si256(data + c / 4 + 1), sign);
+
+            int32_t lt0 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(kk, x0)));
+            int32_t lt1 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(kk, x1)));
+
+            int32_t lt = lt0 | (lt1 << 4);
+            if (lt != 0xFF) {
+                return c + __builtin_popcount(lt);
+            }
+        }
+
+        while (c < size && keys[c] < key) {
+            c++;
+        }
+
+        return c;
+    }
+
+    // Two-level search in a node, where index[i] is the max key of the
+    // i-th block of keys. Kernels are inlined here, so there is only
+    // one dispatched call per node.
+    MMA_TARGET("sse4.2")
+    static int32_t find_sse42(const Key* index, const Key* keys, int32_t size, int32_t block_size, const Key& key) noexcept
+    {
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_sse42(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_sse42(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+
+    MMA_TARGET("avx2,popcnt")
+    static int32_t find_avx2(const Key* index, const Key* keys, int32_t size, int32_t block_size, const Key& key) noexcept
+    {
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_avx2(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_avx2(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+#endif
+
+    static bool is_vectorized() noexcept {
+        return CpuFeatures::get().avx2() || CpuFeatures::get().sse42();
+    }
+
+    static int32_t count_less(const Key* keys, int32_t size, const Key& key) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return count_less_avx2(keys, size, key);
+        }
+        else if (CpuFeatures::get().sse42()) {
+            return count_less_sse42(keys, size, key);
+        }
+#endif
+        return count_less_scalar(keys, size, key);
+    }
+
+    static int32_t find(const Key* index, const Key* keys, int32_t size, int32_t block_size, const Key& key) noexcept
+    {
+#ifdef MMA_X86_SIMD
+        if (CpuFeatures::get().avx2()) {
+            return find_avx2(index, keys, size, block_size, key);
+        }
+        else if (CpuFeatures::get().sse42()) {
+            return find_sse42(index, keys, size, block_size, key);
+        }
+#endif
+        int32_t index_size = (size + block_size - 1) / block_size;
+        int32_t idx = count_less_scalar(index, index_size, key);
+        if (idx < index_size)
+        {
+            int32_t start = idx * block_size;
+            return start + count_less_scalar(keys + start, std::min(block_size, size - start), key);
+        }
+
+        return size;
+    }
+};
+
+template <>
+struct PTreeKeySearch<uint64_t>: PTreeKeySearch64<uint64_t> {};
+
+template <>
+struct PTreeKeySearch<int64_t>: PTreeKeySearch64<int64_t> {};
+
+}}}
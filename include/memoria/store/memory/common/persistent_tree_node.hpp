@@ -20,6 +20,8 @@
 #include <memoria/core/tools/stream.hpp>
 #include <memoria/core/tools/md5.hpp>
 
+#include "persistent_tree_key_search.hpp"
+
 #include <atomic>
 #include <mutex>
 
@@ -214,6 +216,12 @@ public:
         return refs_;
     }
 
+    void set_references(RCType refs)
+    {
+        LockGuardT lk(mutex_);
+        refs_ = refs;
+    }
+
     void ref()
     {
         LockGuardT lk(mutex_);
@@ -236,7 +244,20 @@ public:
         return keys_[idx];
     }
 
+    // Runtime-dispatched SIMD search where PTreeKeySearch has kernels
+    // for the key type, the early-exit linear scan otherwise.
     int32_t find_key(const Key& key) const
+    {
+        using KeySearch = PTreeKeySearch<Key>;
+
+        if (!KeySearch::is_vectorized()) {
+            return find_key_scalar(key);
+        }
+
+        return KeySearch::find(index_, keys_, size_, NodeIndexSize, key);
+    }
+
+    int32_t find_key_scalar(const Key& key) const
     {
         int32_t last_idx = size_ / NodeIndexSize + (size_ % NodeIndexSize == 0 ? 0 : 1);
 
@@ -266,6 +287,10 @@ public:
         return size_;
     }
 
+    // find_key2() (branchless count) and find_key3() (binary search) are
+    // the scalar alternatives ptree_key_search_bm measures the kernels
+    // against, and find_key3() is its reference result. They don't use
+    // PTreeKeySearch on purpose. Nodes are searched by find_key() only.
     int32_t find_key2(const Key& key) const
     {
         int32_t last_idx = size_ / NodeIndexSize + (size_ % NodeIndexSize == 0 ? 0 : 1);
@@ -21,7 +21,7 @@
 #include <memoria/api/store/memory_store_api.hpp>
 
 #include <memoria/store/memory/common/store_stat.hpp>
-#include <memoria/store/memory/common/static_pool.hpp>
+#include <memoria/store/memory/common/hashed_pool.hpp>
 
 
 #include <memoria/core/container/allocator.hpp>
@@ -120,7 +120,7 @@ protected:
 
     PersistentTreeT persistent_tree_;
 
-    StaticPool<BlockID, Shared, 256> pool_;
+    HashedPool<BlockID, Shared> pool_;
 
     Logger logger_;
 
@@ -18,6 +18,8 @@
 
 
 #include <memoria/core/tools/stream.hpp>
+#include <memoria/core/tools/span.hpp>
+#include <memoria/core/tools/block_codec.hpp>
 #include <memoria/core/tools/pair.hpp>
 #include <memoria/core/tools/latch.hpp>
 #include <memoria/core/memory/memory.hpp>
@@ -42,6 +44,10 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 
 
@@ -83,6 +89,10 @@ namespace _ {
 
 		RefCntT references() const {return refs_;}
 
+        void set_references(RefCntT refs) {
+            refs_ = refs;
+        }
+
 		RefCntT unref() {
 			return --refs_;
 		}
@@ -450,11 +460,107 @@ public:
 
     using HistoryTreeNodeMap    = std::unordered_map<SnapshotID, HistoryNodeBuffer*>;
     using PersistentTreeNodeMap = std::unordered_map<BlockID, std::pair<NodeBaseBufferT*, NodeBaseT*>>;
-    using BlockMap              = std::unordered_map<BlockID, RCBlockPtr*>;
     using RCBlockSet            = std::unordered_set<const void*>;
+    using SnapshotSet           = std::unordered_set<SnapshotID>;
     using BranchMap             = std::unordered_map<U8String, HistoryNode*>;
     using ReverseBranchMap      = std::unordered_map<const HistoryNode*, U8String>;
 
+    // Blocks being loaded, by ID. Sharded, so that several
+    // threads can deserialize and register blocks at once.
+    class BlockMap {
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_map<BlockID, RCBlockPtr*> blocks;
+        };
+
+        static constexpr size_t SHARDS = 256;
+
+        std::unique_ptr<Shard[]> shards_;
+
+        Shard& shard(const BlockID& id) const noexcept {
+            return shards_[std::hash<BlockID>{}(id) % SHARDS];
+        }
+
+    public:
+        BlockMap(): shards_(new Shard[SHARDS]) {}
+
+        RCBlockPtr* find(const BlockID& id) const noexcept
+        {
+            const auto& blocks = shard(id).blocks;
+            auto ii = blocks.find(id);
+            return ii != blocks.end() ? ii->second : nullptr;
+        }
+
+        // Thread-safe
+        VoidResult insert(RCBlockPtr* block, bool replace) noexcept
+        {
+            Shard& sh = shard(block->raw_data()->uuid());
+            std::lock_guard<std::mutex> lock(sh.mutex);
+
+            auto ii = sh.blocks.find(block->raw_data()->uuid());
+            if (ii == sh.blocks.end())
+            {
+                sh.blocks[block->raw_data()->uuid()] = block;
+            }
+            else if (replace)
+            {
+                delete ii->second;
+                ii->second = block;
+            }
+            else {
+                auto id = block->raw_data()->uuid();
+                delete block;
+                return MEMORIA_MAKE_GENERIC_ERROR("Block {} was already registered", id);
+            }
+
+            return VoidResult::of();
+        }
+
+        template <typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            for (size_t c = 0; c < SHARDS; c++)
+            {
+                for (auto& entry: shards_[c].blocks) {
+                    fn(entry.second);
+                }
+            }
+        }
+
+        // Deletes blocks no longer referenced
+        void remove_unreferenced() noexcept
+        {
+            for (size_t c = 0; c < SHARDS; c++)
+            {
+                auto& blocks = shards_[c].blocks;
+                for (auto ii = blocks.begin(); ii != blocks.end();)
+                {
+                    if (ii->second->references() == 0)
+                    {
+                        delete ii->second;
+                        ii = blocks.erase(ii);
+                    }
+                    else {
+                        ++ii;
+                    }
+                }
+            }
+        }
+    };
+
+    // Data block record of an image. Data is serialized block,
+    // stored_size bytes of it, compressed by the codec.
+    struct BlockRecord {
+        typename RCBlockPtr::RefCntT references;
+        int32_t data_size;
+        int32_t block_size;
+        uint64_t ctr_hash;
+        uint64_t block_hash;
+        BlockCodec codec;
+        int32_t stored_size;
+        const uint8_t* data;
+    };
+
     friend struct HistoryNode;
 
     template <typename, typename>
@@ -494,7 +600,14 @@ protected:
         const int64_t& records() const {return records_;}
     };
 
-    enum {TYPE_UNKNOWN, TYPE_METADATA, TYPE_HISTORY_NODE, TYPE_BRANCH_NODE, TYPE_LEAF_NODE, TYPE_DATA_BLOCK, TYPE_CHECKSUM};
+    enum {
+        TYPE_UNKNOWN, TYPE_METADATA, TYPE_HISTORY_NODE, TYPE_BRANCH_NODE, TYPE_LEAF_NODE, TYPE_DATA_BLOCK, TYPE_CHECKSUM, TYPE_CHECKPOINT,
+        TYPE_COMPRESSED_DATA_BLOCK
+    };
+
+    // Image kinds, signature[9]
+    static constexpr char IMAGE_FULL  = 0;
+    static constexpr char IMAGE_DELTA = 1;
 
     Logger logger_;
 
@@ -513,6 +626,22 @@ protected:
 
     std::atomic<bool> dump_snapshot_lifecycle_{false};
 
+    // Next block ID for profiles with SequentialBlockIDs
+    std::atomic<uint64_t> next_block_id_{1};
+
+    // Snapshots whose data is in the last written (or loaded) image
+    // chain. Their persistent tree nodes and blocks are immutable, so
+    // delta images skip them.
+    SnapshotSet checkpointed_snapshots_;
+    SnapshotID last_checkpoint_id_{};
+
+    // Compression of blocks in images, see set_block_compression().
+    // Image codec is the one of the image being written.
+    BlockCodec block_codec_{BlockCodec::NONE};
+    int32_t block_codec_level_{};
+    BlockCodec image_codec_{BlockCodec::NONE};
+    int32_t image_codec_level_{};
+
 public:
     MemoryStoreBase(MaybeError& maybe_error):
         logger_("PersistentInMemAllocator")
@@ -541,6 +670,19 @@ public:
     bool is_dump_snapshot_lifecycle() const noexcept {return dump_snapshot_lifecycle_.load();}
     void set_dump_snapshot_lifecycle(bool do_dump) noexcept {dump_snapshot_lifecycle_.store(do_dump);}
 
+    // Must be called with the store locked
+    VoidResult do_set_block_compression(BlockCodec codec, int32_t level) noexcept
+    {
+        if (!is_block_codec_available(codec)) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Block codec {} is not available in this build", block_codec_name(codec));
+        }
+
+        block_codec_ = codec;
+        block_codec_level_ = level;
+
+        return VoidResult::of();
+    }
+
     auto get_root_snapshot_uuid() const noexcept {
         return history_tree_->snapshot_id();
     }
@@ -585,43 +727,68 @@ public:
 
     auto newBlockId() noexcept
     {
-        return ProfileTraits<Profile>::make_random_block_id();
+        if (ProfileTraits<Profile>::SequentialBlockIDs)
+        {
+            // Monotonic IDs make new blocks land at the right edge of the
+            // persistent tree, so commits copy only the rightmost path.
+            return ProfileTraits<Profile>::make_sequential_block_id(
+                next_block_id_.fetch_add(1, std::memory_order_relaxed)
+            );
+        }
+        else {
+            return ProfileTraits<Profile>::make_random_block_id();
+        }
     }
 
-    static Result<AllocSharedPtr<MyType>> load(InputStreamHandler *input) noexcept
+    void register_loaded_block_id(const BlockID& id) noexcept
     {
-        using ResultT = Result<AllocSharedPtr<MyType>>;
+        if (ProfileTraits<Profile>::SequentialBlockIDs)
+        {
+            uint64_t seq = ProfileTraits<Profile>::sequential_block_id_value(id);
+            // Blocks may be loaded by several threads
+            uint64_t next = next_block_id_.load(std::memory_order_relaxed);
+            while (seq >= next && !next_block_id_.compare_exchange_weak(next, seq + 1, std::memory_order_relaxed)) {}
+        }
+    }
 
-        auto alloc_ptr = MakeLocalShared<MyType>(0);
+    static Result<AllocSharedPtr<MyType>> load(InputStreamHandler *input) noexcept
+    {
+        return load_chain(std::vector<InputStreamHandler*>{input});
+    }
 
-        MyType* allocator = alloc_ptr.get();
+    // Loads a full image followed by delta images, oldest first.
+    // Persistent tree nodes and blocks are accumulated over the chain,
+    // history and metadata are taken from the last image.
+    static Result<AllocSharedPtr<MyType>> load_chain(const std::vector<InputStreamHandler*>& chain) noexcept
+    {
+        return load_images(chain.size(), 1, [&](MyType* allocator, size_t c, auto&... maps) {
+            return allocator->read_image(*chain[c], c > 0, maps...);
+        });
+    }
 
-        char signature[12] = {};
+    // Images are memory buffers, usually memory-mapped files. Data blocks
+    // are deserialized, and persistent tree leaves are linked to them,
+    // by the given number of threads.
+    static Result<AllocSharedPtr<MyType>> load_chain(const std::vector<Span<const uint8_t>>& chain, size_t threads) noexcept
+    {
+        return load_images(chain.size(), threads, [&](MyType* allocator, size_t c, auto&... maps) {
+            return allocator->read_mapped_image(chain[c], c > 0, threads, maps...);
+        });
+    }
 
-        input->read(signature, sizeof(signature));
+private:
+    template <typename ReadImageFn>
+    static Result<AllocSharedPtr<MyType>> load_images(size_t images, size_t threads, ReadImageFn&& read_image_fn) noexcept
+    {
+        using ResultT = Result<AllocSharedPtr<MyType>>;
 
-        if (!(
-                signature[0] == 'M' &&
-                signature[1] == 'E' &&
-                signature[2] == 'M' &&
-                signature[3] == 'O' &&
-                signature[4] == 'R' &&
-                signature[5] == 'I' &&
-                signature[6] == 'A'))
-        {
-            std::string sig_str(signature, 12);
-            return MEMORIA_MAKE_GENERIC_ERROR("The stream does not start from MEMORIA signature: {}", sig_str);
+        if (images == 0) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Image chain is empty");
         }
 
-        if (!(signature[7] == 0 || signature[7] == 1))
-        {
-            return MEMORIA_MAKE_GENERIC_ERROR("Endiannes filed value is out of bounds {}", (int32_t)signature[7]);
-        }
+        auto alloc_ptr = MakeLocalShared<MyType>(0);
 
-        if (signature[8] != 0)
-        {
-            return MEMORIA_MAKE_GENERIC_ERROR("This is not an in-memory container");
-        }
+        MyType* allocator = alloc_ptr.get();
 
         allocator->master_ = allocator->history_tree_ = nullptr;
 
@@ -633,82 +800,36 @@ public:
 
         AllocatorMetadata metadata;
 
-        Checksum checksum;
-
-        bool proceed = true;
+        SnapshotID checkpoint_id{};
 
-        while (proceed)
+        for (size_t c = 0; c < images; c++)
         {
-            uint8_t type;
-            *input >> type;
-
-            switch (type)
+            for (auto& entry: history_node_map)
             {
-                case TYPE_METADATA:     allocator->read_metadata(*input, metadata); break;
-                case TYPE_DATA_BLOCK:   {
-                    MEMORIA_TRY_VOID(allocator->read_data_block(*input, block_map)); break;
-                }
-                case TYPE_LEAF_NODE:    allocator->read_leaf_node(*input, ptree_node_map); break;
-                case TYPE_BRANCH_NODE:  allocator->read_branch_node(*input, ptree_node_map); break;
-                case TYPE_HISTORY_NODE: allocator->read_history_node(*input, history_node_map); break;
-                case TYPE_CHECKSUM:     allocator->read_checksum(*input, checksum); proceed = false; break;
-                default:
-                    return MEMORIA_MAKE_GENERIC_ERROR("Unknown record type: {}", (int32_t)type);
+                auto node = entry.second;
+                delete node;
             }
+            history_node_map.clear();
+            metadata = AllocatorMetadata{};
 
-            allocator->records_++;
+            MEMORIA_TRY_VOID(read_image_fn(allocator, c, checkpoint_id, metadata, history_node_map, ptree_node_map, block_map));
         }
 
-        if (allocator->records_ != checksum.records())
-        {
-            return MEMORIA_MAKE_GENERIC_ERROR("Invalid records checksum: actual={}, expected={}", allocator->records_, checksum.records());
-        }
-
-        for (auto& entry: ptree_node_map)
-        {
-            auto buffer = entry.second.first;
-            auto node   = entry.second.second;
+        std::vector<std::pair<NodeBaseBufferT*, NodeBaseT*>> nodes;
+        nodes.reserve(ptree_node_map.size());
 
-            if (buffer->is_leaf())
-            {
-                LeafNodeBufferT* leaf_buffer = static_cast<LeafNodeBufferT*>(buffer);
-                LeafNodeT* leaf_node         = static_cast<LeafNodeT*>(node);
-
-                for (int32_t c = 0; c < leaf_node->size(); c++)
-                {
-                    const auto& descr = leaf_buffer->data(c);
-
-                    auto block_iter = block_map.find(descr.block_ptr());
+        for (auto& entry: ptree_node_map) {
+            nodes.push_back(entry.second);
+        }
 
-                    if (block_iter != block_map.end())
-                    {
-                        leaf_node->data(c) = typename LeafNodeT::Value(block_iter->second, descr.snapshot_id());
-                    }
-                    else {
-                        return MEMORIA_MAKE_GENERIC_ERROR("Specified uuid {} is not found in the block map", descr.block_ptr());
-                    }
-                }
+        MEMORIA_TRY_VOID(parallel_for(nodes.size(), threads, [&](size_t from, size_t to) noexcept -> VoidResult {
+            for (size_t c = from; c < to; c++) {
+                MEMORIA_TRY_VOID(link_node(nodes[c], ptree_node_map, block_map));
             }
-            else {
-                BranchNodeBufferT* branch_buffer = static_cast<BranchNodeBufferT*>(buffer);
-                BranchNodeT* branch_node         = static_cast<BranchNodeT*>(node);
-
-                for (int32_t c = 0; c < branch_node->size(); c++)
-                {
-                    const auto& node_id = branch_buffer->data(c);
-
-                    auto iter = ptree_node_map.find(node_id);
+            return VoidResult::of();
+        }));
 
-                    if (iter != ptree_node_map.end())
-                    {
-                        branch_node->data(c) = iter->second.second;
-                    }
-                    else {
-                        return MEMORIA_MAKE_GENERIC_ERROR("Specified uuid {} is not found in the persistent tree node map", node_id);
-                    }
-                }
-            }
-        }
+        allocator->rebuild_references(history_node_map, ptree_node_map, block_map);
 
         allocator->history_tree_ = allocator->build_history_tree(metadata.root(), nullptr, history_node_map, ptree_node_map);
 
@@ -754,6 +875,19 @@ public:
             delete node;
         }
 
+        // The next delta image continues this chain
+        if (!checkpoint_id.is_null())
+        {
+            for (auto& entry: allocator->snapshot_map_)
+            {
+                if (entry.second->is_committed() || entry.second->is_dropped()) {
+                    allocator->checkpointed_snapshots_.insert(entry.first);
+                }
+            }
+
+            allocator->last_checkpoint_id_ = checkpoint_id;
+        }
+
         allocator->do_delete_dropped();
         MEMORIA_TRY_VOID(allocator->pack());
 
@@ -930,6 +1064,332 @@ protected:
         }
     }
 
+    // The image is scanned once, blocks are deserialized afterwards
+    // by several threads, directly from the image.
+    VoidResult read_mapped_image(
+            Span<const uint8_t> image,
+            bool delta,
+            size_t threads,
+            SnapshotID& checkpoint_id,
+            AllocatorMetadata& metadata,
+            HistoryTreeNodeMap& history_node_map,
+            PersistentTreeNodeMap& ptree_node_map,
+            BlockMap& block_map
+    ) noexcept
+    {
+        return wrap_throwing([&]() -> VoidResult {
+            MemoryInputStreamHandler in(image.data(), image.size());
+            std::vector<BlockRecord> blocks;
+
+            MEMORIA_TRY_VOID(read_image(in, delta, checkpoint_id, metadata, history_node_map, ptree_node_map, block_map, &blocks));
+
+            return parallel_for(blocks.size(), threads, [&](size_t from, size_t to) noexcept -> VoidResult {
+                for (size_t c = from; c < to; c++) {
+                    MEMORIA_TRY_VOID(load_block(blocks[c], block_map, delta));
+                }
+                return VoidResult::of();
+            });
+        });
+    }
+
+    // Calls fn for consecutive ranges of [0, size) from the given
+    // number of threads, until the first error.
+    template <typename Fn>
+    static VoidResult parallel_for(size_t size, size_t threads, Fn&& fn) noexcept
+    {
+        constexpr size_t CHUNK = 256;
+
+        if (threads <= 1 || size <= CHUNK) {
+            return wrap_throwing([&]() -> VoidResult {
+                return fn(0, size);
+            });
+        }
+
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+
+        std::mutex error_mutex;
+        VoidResult error = VoidResult::of();
+
+        auto worker = [&]() noexcept {
+            while (!failed.load(std::memory_order_relaxed))
+            {
+                size_t from = next.fetch_add(CHUNK, std::memory_order_relaxed);
+                if (from >= size) {
+                    break;
+                }
+
+                auto res = wrap_throwing([&]() -> VoidResult {
+                    return fn(from, std::min(from + CHUNK, size));
+                });
+
+                if (res.is_error())
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!failed.exchange(true)) {
+                        error = std::move(res);
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t c = 1; c < threads; c++)
+        {
+            try {
+                workers.emplace_back(worker);
+            }
+            catch (...) {
+                // Proceed with the threads we have
+                break;
+            }
+        }
+
+        worker();
+
+        for (auto& thread: workers) {
+            thread.join();
+        }
+
+        return error;
+    }
+
+    static VoidResult link_node(
+            const std::pair<NodeBaseBufferT*, NodeBaseT*>& entry,
+            const PersistentTreeNodeMap& ptree_node_map,
+            const BlockMap& block_map
+    ) noexcept
+    {
+        auto buffer = entry.first;
+        auto node   = entry.second;
+
+        if (buffer->is_leaf())
+        {
+            LeafNodeBufferT* leaf_buffer = static_cast<LeafNodeBufferT*>(buffer);
+            LeafNodeT* leaf_node         = static_cast<LeafNodeT*>(node);
+
+            for (int32_t c = 0; c < leaf_node->size(); c++)
+            {
+                const auto& descr = leaf_buffer->data(c);
+
+                RCBlockPtr* block = block_map.find(descr.block_ptr());
+                if (block)
+                {
+                    leaf_node->data(c) = typename LeafNodeT::Value(block, descr.snapshot_id());
+                }
+                else {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Specified uuid {} is not found in the block map", descr.block_ptr());
+                }
+            }
+        }
+        else {
+            BranchNodeBufferT* branch_buffer = static_cast<BranchNodeBufferT*>(buffer);
+            BranchNodeT* branch_node         = static_cast<BranchNodeT*>(node);
+
+            for (int32_t c = 0; c < branch_node->size(); c++)
+            {
+                const auto& node_id = branch_buffer->data(c);
+
+                auto iter = ptree_node_map.find(node_id);
+                if (iter != ptree_node_map.end())
+                {
+                    branch_node->data(c) = iter->second.second;
+                }
+                else {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Specified uuid {} is not found in the persistent tree node map", node_id);
+                }
+            }
+        }
+
+        return VoidResult::of();
+    }
+
+    // Data blocks of memory-mapped images are only indexed here,
+    // see read_mapped_image().
+    template <typename InputStreamT>
+    VoidResult read_image(
+            InputStreamT& in,
+            bool delta,
+            SnapshotID& checkpoint_id,
+            AllocatorMetadata& metadata,
+            HistoryTreeNodeMap& history_node_map,
+            PersistentTreeNodeMap& ptree_node_map,
+            BlockMap& block_map,
+            std::vector<BlockRecord>* block_index = nullptr
+    ) noexcept
+    {
+        char signature[12] = {};
+
+        in.read(signature, sizeof(signature));
+
+        if (!(
+                signature[0] == 'M' &&
+                signature[1] == 'E' &&
+                signature[2] == 'M' &&
+                signature[3] == 'O' &&
+                signature[4] == 'R' &&
+                signature[5] == 'I' &&
+                signature[6] == 'A'))
+        {
+            std::string sig_str(signature, 12);
+            return MEMORIA_MAKE_GENERIC_ERROR("The stream does not start from MEMORIA signature: {}", sig_str);
+        }
+
+        if (!(signature[7] == 0 || signature[7] == 1))
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("Endiannes filed value is out of bounds {}", (int32_t)signature[7]);
+        }
+
+        if (signature[8] != 0)
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("This is not an in-memory container");
+        }
+
+        if (signature[9] != (delta ? IMAGE_DELTA : IMAGE_FULL))
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR(
+                delta ? "Image chain must continue with delta images" : "Image chain must start from a full image"
+            );
+        }
+
+        SnapshotID parent_checkpoint_id = checkpoint_id;
+        checkpoint_id = SnapshotID{};
+
+        Checksum checksum;
+
+        records_ = 0;
+
+        bool proceed = true;
+
+        while (proceed)
+        {
+            uint8_t type;
+            in >> type;
+
+            switch (type)
+            {
+                case TYPE_METADATA:     read_metadata(in, metadata); break;
+                case TYPE_DATA_BLOCK:
+                case TYPE_COMPRESSED_DATA_BLOCK: {
+                    bool compressed = type == TYPE_COMPRESSED_DATA_BLOCK;
+                    if constexpr (std::is_same_v<InputStreamT, MemoryInputStreamHandler>) {
+                        index_data_block(in, compressed, *block_index);
+                    }
+                    else {
+                        MEMORIA_TRY_VOID(read_data_block(in, compressed, block_map, delta));
+                    }
+                    break;
+                }
+                case TYPE_LEAF_NODE:    read_leaf_node(in, ptree_node_map, delta); break;
+                case TYPE_BRANCH_NODE:  read_branch_node(in, ptree_node_map, delta); break;
+                case TYPE_HISTORY_NODE: read_history_node(in, history_node_map); break;
+                case TYPE_CHECKPOINT:   {
+                    SnapshotID image_parent_id;
+                    in >> checkpoint_id;
+                    in >> image_parent_id;
+
+                    if (delta && image_parent_id != parent_checkpoint_id)
+                    {
+                        return MEMORIA_MAKE_GENERIC_ERROR(
+                            "Delta image {} follows {}, but the previous image is {}",
+                            checkpoint_id, image_parent_id, parent_checkpoint_id
+                        );
+                    }
+                    break;
+                }
+                case TYPE_CHECKSUM:     read_checksum(in, checksum); proceed = false; break;
+                default:
+                    return MEMORIA_MAKE_GENERIC_ERROR("Unknown record type: {}", (int32_t)type);
+            }
+
+            records_++;
+        }
+
+        if (records_ != checksum.records())
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("Invalid records checksum: actual={}, expected={}", records_, checksum.records());
+        }
+
+        if (delta && checkpoint_id.is_null())
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("Delta image has no checkpoint record");
+        }
+
+        return VoidResult::of();
+    }
+
+    // Reference counters stored in images may be stale: in older images of
+    // a chain, and in images written while other snapshots were changing
+    // the counters. So they are recomputed from the history of the last
+    // image. Nodes and blocks released after they had been stored are freed.
+    void rebuild_references(
+            const HistoryTreeNodeMap& history_node_map,
+            PersistentTreeNodeMap& ptree_node_map,
+            BlockMap& block_map
+    )
+    {
+        for (auto& entry: ptree_node_map) {
+            entry.second.second->set_references(0);
+        }
+
+        block_map.for_each([](RCBlockPtr* block) {
+            block->set_references(0);
+        });
+
+        std::unordered_set<const NodeBaseT*> visited;
+
+        for (const auto& entry: history_node_map)
+        {
+            const auto& root_id = entry.second->root();
+            if (!root_id.is_null())
+            {
+                auto ii = ptree_node_map.find(root_id);
+                if (ii != ptree_node_map.end())
+                {
+                    ii->second.second->ref();
+                    ref_children(ii->second.second, visited);
+                }
+            }
+        }
+
+        for (auto ii = ptree_node_map.begin(); ii != ptree_node_map.end();)
+        {
+            if (ii->second.second->references() == 0)
+            {
+                delete_node_buffers(ii->second);
+                ii = ptree_node_map.erase(ii);
+            }
+            else {
+                ++ii;
+            }
+        }
+
+        block_map.remove_unreferenced();
+    }
+
+    void ref_children(NodeBaseT* node, std::unordered_set<const NodeBaseT*>& visited)
+    {
+        if (visited.insert(node).second)
+        {
+            if (node->is_leaf())
+            {
+                LeafNodeT* leaf = static_cast<LeafNodeT*>(node);
+                for (int32_t c = 0; c < leaf->size(); c++) {
+                    leaf->data(c).block_ptr()->ref();
+                }
+            }
+            else {
+                BranchNodeT* branch = static_cast<BranchNodeT*>(node);
+                for (int32_t c = 0; c < branch->size(); c++)
+                {
+                    NodeBaseT* child = branch->data(c);
+                    child->ref();
+                    ref_children(child, visited);
+                }
+            }
+        }
+    }
+
     void read_metadata(InputStreamHandler& in, AllocatorMetadata& metadata)
     {
         in >> metadata.master();
@@ -956,53 +1416,100 @@ protected:
         in >> checksum.records();
     }
 
-    VoidResult read_data_block(InputStreamHandler& in, BlockMap& map) noexcept
+    // Records of delta images replace ones with the same ID
+    // read from the previous images of the chain.
+    VoidResult read_data_block(InputStreamHandler& in, bool compressed, BlockMap& map, bool replace = false) noexcept
     {
-        typename RCBlockPtr::RefCntT references;
+        BlockRecord record;
+        read_block_record_header(in, compressed, record);
 
-    	in >> references;
+        auto block_data = allocate_system<uint8_t>(record.stored_size);
+        in.read(block_data.get(), 0, record.stored_size);
 
-    	int32_t block_data_size;
-        in >> block_data_size;
+        record.data = block_data.get();
 
-        int32_t block_size;
-        in >> block_size;
+        return load_block(record, map, replace);
+    }
 
-        uint64_t ctr_hash;
-        in >> ctr_hash;
+    void read_block_record_header(InputStreamHandler& in, bool compressed, BlockRecord& record)
+    {
+        in >> record.references;
+        in >> record.data_size;
+        in >> record.block_size;
+        in >> record.ctr_hash;
+        in >> record.block_hash;
 
-        uint64_t block_hash;
-        in >> block_hash;
+        if (compressed)
+        {
+            uint8_t codec;
+            in >> codec;
+            in >> record.stored_size;
 
-        auto block_data = allocate_system<int8_t>(block_data_size);
-        BlockType* block = allocate_system<BlockType>(block_size).release();
+            record.codec = static_cast<BlockCodec>(codec);
+        }
+        else {
+            record.codec = BlockCodec::NONE;
+            record.stored_size = record.data_size;
+        }
+    }
+
+    // Blocks of a memory-mapped image are deserialized after the image
+    // has been scanned, see read_mapped_image().
+    void index_data_block(MemoryInputStreamHandler& in, bool compressed, std::vector<BlockRecord>& index)
+    {
+        BlockRecord record;
+        read_block_record_header(in, compressed, record);
 
-        in.read(block_data.get(), 0, block_data_size);
+        record.data = in.data() + in.position();
+        in.skip(record.stored_size);
 
-        MEMORIA_TRY_VOID(ProfileMetadata<Profile>::local()
-                ->get_block_operations(ctr_hash, block_hash)
-                ->deserialize(block_data.get(), block_data_size, block));
+        index.push_back(record);
+    }
+
+    // Thread-safe
+    VoidResult load_block(const BlockRecord& record, BlockMap& map, bool replace) noexcept
+    {
+        const uint8_t* data = record.data;
 
-        if (map.find(block->uuid()) == map.end())
+        UniquePtr<uint8_t> decompressed(nullptr, ::free);
+        if (record.codec != BlockCodec::NONE)
         {
-            map[block->uuid()] = new RCBlockPtr(block, references);
+            decompressed = allocate_system<uint8_t>(record.data_size);
+            MEMORIA_TRY_VOID(decompress_block(record.codec, record.data, record.stored_size, decompressed.get(), record.data_size));
+            data = decompressed.get();
         }
-        else {
-            return MEMORIA_MAKE_GENERIC_ERROR("Block {} was already registered", block->uuid());
+
+        BlockType* block = allocate_system<BlockType>(record.block_size).release();
+
+        auto res = ProfileMetadata<Profile>::local()
+                ->get_block_operations(record.ctr_hash, record.block_hash)
+                ->deserialize(data, record.data_size, block);
+
+        if (res.is_error())
+        {
+            free_system(block);
+            return res;
         }
 
-        return VoidResult::of();
-    }
+        register_loaded_block_id(block->id());
+        register_loaded_block_id(block->uuid());
 
+        return map.insert(new RCBlockPtr(block, record.references), replace);
+    }
 
-    void read_leaf_node(InputStreamHandler& in, PersistentTreeNodeMap& map)
+    void read_leaf_node(InputStreamHandler& in, PersistentTreeNodeMap& map, bool replace = false)
     {
         LeafNodeBufferT* buffer = new LeafNodeBufferT();
 
         buffer->read(in);
 
-        if (map.find(buffer->node_id()) == map.end())
+        auto ii = map.find(buffer->node_id());
+        if (ii == map.end() || replace)
         {
+            if (ii != map.end()) {
+                delete_node_buffers(ii->second);
+            }
+
             NodeBaseT* node = new LeafNodeT();
             node->populate_as_buffer(buffer);
 
@@ -1014,14 +1521,19 @@ protected:
     }
 
 
-    void read_branch_node(InputStreamHandler& in, PersistentTreeNodeMap& map)
+    void read_branch_node(InputStreamHandler& in, PersistentTreeNodeMap& map, bool replace = false)
     {
         BranchNodeBufferT* buffer = new BranchNodeBufferT();
 
         buffer->read(in);
 
-        if (map.find(buffer->node_id()) == map.end())
+        auto ii = map.find(buffer->node_id());
+        if (ii == map.end() || replace)
         {
+            if (ii != map.end()) {
+                delete_node_buffers(ii->second);
+            }
+
             NodeBaseT* node = new BranchNodeT();
             node->populate_as_buffer(buffer);
 
@@ -1035,6 +1547,19 @@ protected:
 
 
 
+    void delete_node_buffers(const std::pair<NodeBaseBufferT*, NodeBaseT*>& entry)
+    {
+        if (entry.first->is_leaf())
+        {
+            static_cast<LeafNodeBufferT*>(entry.first)->del();
+            static_cast<LeafNodeT*>(entry.second)->del();
+        }
+        else {
+            static_cast<BranchNodeBufferT*>(entry.first)->del();
+            static_cast<BranchNodeT*>(entry.second)->del();
+        }
+    }
+
     void read_history_node(InputStreamHandler& in, HistoryTreeNodeMap& map)
     {
         HistoryNodeBuffer* node = new HistoryNodeBuffer();
@@ -1150,20 +1675,210 @@ protected:
 
 
 
-    VoidResult write_metadata(OutputStreamHandler& out) noexcept
+    // History node as it is written to an image
+    struct ImageHistoryNode {
+        HistoryNode* pinned;
+        int32_t status;
+        SnapshotID snapshot_id;
+        const NodeBaseT* root;
+        BlockID root_id;
+        SnapshotID parent_id;
+        U8String metadata;
+        std::vector<SnapshotID> children;
+    };
+
+    // Everything an image contains except persistent trees, captured at
+    // one point in time. Persistent trees of committed and dropped
+    // snapshots are immutable, so they may be written later, provided
+    // their history nodes are pinned (see ThreadsMemoryStoreImpl).
+    struct ImageDescriptor {
+        bool delta{};
+        SnapshotID checkpoint_id;
+        SnapshotID parent_checkpoint_id;
+        SnapshotID master_id;
+        SnapshotID root_id;
+        std::vector<std::pair<U8String, SnapshotID>> named_branches;
+        std::vector<ImageHistoryNode> history;
+        BlockCodec codec{BlockCodec::NONE};
+        int32_t codec_level{};
+    };
+
+    // Active snapshots are not in the image, as well as their data. Must be
+    // called with the store locked. Pinned history nodes are referenced
+    // until the image is written, so their data can't be deleted.
+    Result<ImageDescriptor> describe_image(bool delta, bool pin = false) noexcept
+    {
+        using ResultT = Result<ImageDescriptor>;
+
+        if (delta && last_checkpoint_id_.is_null())
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("No full image has been stored or loaded yet, delta image can't be written");
+        }
+
+        MEMORIA_TRY_VOID(do_pack(history_tree_));
+
+        ImageDescriptor image;
+
+        image.delta = delta;
+        image.checkpoint_id = ProfileTraits<Profile>::make_random_snapshot_id();
+        image.parent_checkpoint_id = delta ? last_checkpoint_id_ : SnapshotID{};
+        image.master_id   = master_->snapshot_id();
+        image.root_id     = history_tree_->snapshot_id();
+        image.codec       = block_codec_;
+        image.codec_level = block_codec_level_;
+
+        for (auto& entry: named_branches_) {
+            image.named_branches.emplace_back(entry.first, entry.second->snapshot_id());
+        }
+
+        std::vector<HistoryNode*> nodes;
+        std::unordered_set<const HistoryNode*> described;
+
+        MEMORIA_TRY_VOID(walk_version_tree(history_tree_, [&](HistoryNode* node) noexcept {
+            ImageHistoryNode record{};
+            {
+                typename MyType::SnapshotLockGuardT lock(node->snapshot_mutex());
+
+                if (node->is_active()) {
+                    return VoidResult::of();
+                }
+
+                record.status = (int32_t)node->status();
+
+                // Data of a dropped snapshot is deleted when the snapshot
+                // is closed the last time, it may be being deleted now.
+                if (!(node->is_dropped() && node->references() == 0))
+                {
+                    record.root    = node->root();
+                    record.root_id = node->root_id();
+
+                    if (pin)
+                    {
+                        node->ref();
+                        record.pinned = node;
+                    }
+                }
+            }
+
+            record.snapshot_id = node->snapshot_id();
+            record.parent_id   = node->parent() ? node->parent()->snapshot_id() : SnapshotID{};
+            record.metadata    = node->metadata();
+
+            described.insert(node);
+            image.history.push_back(std::move(record));
+            nodes.push_back(node);
+
+            return VoidResult::of();
+        }));
+
+        for (size_t c = 0; c < nodes.size(); c++)
+        {
+            for (auto child: nodes[c]->children())
+            {
+                if (described.count(child)) {
+                    image.history[c].children.push_back(child->snapshot_id());
+                }
+            }
+        }
+
+        return ResultT::of(std::move(image));
+    }
+
+    // Writes a full image of the store, or a delta one containing only
+    // history and the persistent tree nodes and blocks created since the
+    // previous image of the chain. Delta cost is proportional to the
+    // churn, not to the data set.
+    VoidResult write_image(OutputStreamHandler& out, const ImageDescriptor& image) noexcept
+    {
+        records_ = 0;
+
+        image_codec_ = image.codec;
+        image_codec_level_ = image.codec_level;
+
+        char signature[12] = "MEMORIA";
+        for (size_t c = 7; c < sizeof(signature); c++) signature[c] = 0;
+
+        signature[9] = image.delta ? IMAGE_DELTA : IMAGE_FULL;
+
+        out.write(&signature, 0, sizeof(signature));
+
+        MEMORIA_TRY_VOID(write_checkpoint(out, image.checkpoint_id, image.parent_checkpoint_id));
+        MEMORIA_TRY_VOID(write_metadata(out, image));
+
+        RCBlockSet stored_blocks;
+
+        const SnapshotSet* stored_snapshots = image.delta ? &checkpointed_snapshots_ : nullptr;
+
+        for (const auto& history_node: image.history) {
+            MEMORIA_TRY_VOID(write_history_node(out, history_node, stored_blocks, stored_snapshots));
+        }
+
+        Checksum checksum;
+        checksum.records() = records_;
+
+        MEMORIA_TRY_VOID(write(out, checksum));
+
+        out.close();
+
+        return VoidResult::of();
+    }
+
+    // The next delta image continues the chain from this one
+    void image_stored(const ImageDescriptor& image) noexcept
+    {
+        if (!image.delta) {
+            checkpointed_snapshots_.clear();
+        }
+
+        for (const auto& history_node: image.history)
+        {
+            auto status = static_cast<typename HistoryNode::Status>(history_node.status);
+            if (status == HistoryNode::Status::COMMITTED || status == HistoryNode::Status::DROPPED) {
+                checkpointed_snapshots_.insert(history_node.snapshot_id);
+            }
+        }
+
+        last_checkpoint_id_ = image.checkpoint_id;
+    }
+
+    // No snapshots may be active
+    VoidResult write_image(OutputStreamHandler& out, bool delta) noexcept
+    {
+        MEMORIA_TRY(image, describe_image(delta));
+        MEMORIA_TRY_VOID(write_image(out, image));
+
+        image_stored(image);
+
+        return VoidResult::of();
+    }
+
+    VoidResult write_checkpoint(OutputStreamHandler& out, const SnapshotID& checkpoint_id, const SnapshotID& parent_id) noexcept
+    {
+        uint8_t type = TYPE_CHECKPOINT;
+        out << type;
+
+        out << checkpoint_id;
+        out << parent_id;
+
+        records_++;
+
+        return VoidResult::of();
+    }
+
+    VoidResult write_metadata(OutputStreamHandler& out, const ImageDescriptor& image) noexcept
     {
         uint8_t type = TYPE_METADATA;
         out << type;
 
-        out << master_->snapshot_id();
-        out << history_tree_->snapshot_id();
+        out << image.master_id;
+        out << image.root_id;
 
-        out << (int64_t) named_branches_.size();
+        out << (int64_t) image.named_branches.size();
 
-        for (auto& entry: named_branches_)
+        for (auto& entry: image.named_branches)
         {
             out << entry.first;
-            out << entry.second->snapshot_id();
+            out << entry.second;
         }
 
         records_++;
@@ -1180,53 +1895,57 @@ protected:
         return VoidResult::of();
     }
 
-    VoidResult write_history_node(OutputStreamHandler& out, const HistoryNode* history_node, RCBlockSet& stored_blocks) noexcept
+    VoidResult write_history_node(
+            OutputStreamHandler& out,
+            const ImageHistoryNode& history_node,
+            RCBlockSet& stored_blocks,
+            const SnapshotSet* stored_snapshots = nullptr
+    ) noexcept
     {
     	uint8_t type = TYPE_HISTORY_NODE;
         out << type;
-        out << (int32_t)history_node->status();
-        out << history_node->snapshot_id();
+        out << history_node.status;
+        out << history_node.snapshot_id;
 
-        if (history_node->root())
+        if (history_node.root)
         {
-            out << history_node->root()->node_id();
+            out << history_node.root->node_id();
         }
         else {
             out << BlockID{};
         }
 
-        out << history_node->root_id();
-
-        if (history_node->parent())
-        {
-            out << history_node->parent()->snapshot_id();
-        }
-        else {
-            out << SnapshotID{};
-        }
-
-        out << history_node->metadata();
+        out << history_node.root_id;
+        out << history_node.parent_id;
+        out << history_node.metadata;
 
-        out << (int64_t)history_node->children().size();
+        out << (int64_t)history_node.children.size();
 
-        for (auto child: history_node->children())
+        for (const auto& child_id: history_node.children)
         {
-            out << child->snapshot_id();
+            out << child_id;
         }
 
         records_++;
 
-        if (history_node->root())
+        if (history_node.root)
         {
-            return write_persistent_tree(out, history_node->root(), stored_blocks);
+            return write_persistent_tree(out, history_node.root, stored_blocks, stored_snapshots);
         }
 
         return VoidResult::of();
     }
 
-    VoidResult write_persistent_tree(OutputStreamHandler& out, const NodeBaseT* node, RCBlockSet& stored_blocks) noexcept
+    // Nodes and blocks of stored_snapshots are in the previous images, as
+    // well as everything reachable from such nodes.
+    VoidResult write_persistent_tree(
+            OutputStreamHandler& out,
+            const NodeBaseT* node,
+            RCBlockSet& stored_blocks,
+            const SnapshotSet* stored_snapshots = nullptr
+    ) noexcept
     {
-        if (stored_blocks.count(node) == 0)
+        if (stored_blocks.count(node) == 0 && !is_stored(node->snapshot_id(), stored_snapshots))
         {
             stored_blocks.insert(node);
 
@@ -1240,7 +1959,7 @@ protected:
                 {
                     const auto& data = leaf->data(c);
 
-                    if (stored_blocks.count(data.block_ptr()) == 0)
+                    if (stored_blocks.count(data.block_ptr()) == 0 && !is_stored(data.snapshot_id(), stored_snapshots))
                     {
                         MEMORIA_TRY_VOID(write(out, data.block_ptr()));
                         stored_blocks.insert(data.block_ptr());
@@ -1255,7 +1974,7 @@ protected:
                 for (int32_t c = 0; c < branch->size(); c++)
                 {
                     auto child = branch->data(c);
-                    MEMORIA_TRY_VOID(write_persistent_tree(out, child, stored_blocks));
+                    MEMORIA_TRY_VOID(write_persistent_tree(out, child, stored_blocks, stored_snapshots));
                 }
             }
         }
@@ -1264,6 +1983,10 @@ protected:
     }
 
 
+    static bool is_stored(const SnapshotID& snapshot_id, const SnapshotSet* stored_snapshots) noexcept {
+        return stored_snapshots && stored_snapshots->count(snapshot_id) > 0;
+    }
+
     VoidResult write(OutputStreamHandler& out, const BranchNodeBufferT* node) noexcept
     {
         uint8_t type = TYPE_BRANCH_NODE;
@@ -1287,15 +2010,12 @@ protected:
         return VoidResult::of();
     }
 
+    // Blocks are compressed by the image's codec,
+    // the ones that don't compress are stored as is.
     VoidResult write(OutputStreamHandler& out, const RCBlockPtr* block_ptr) noexcept
     {
     	auto block = block_ptr->raw_data();
 
-        uint8_t type = TYPE_DATA_BLOCK;
-        out << type;
-
-        out << block_ptr->references();
-
         auto block_size = block->memory_block_size();
 
         auto buffer = allocate_system<uint8_t>(block_size);
@@ -1304,12 +2024,40 @@ protected:
                 ->get_block_operations(block->ctr_type_hash(), block->block_type_hash())
                 ->serialize(block, buffer.get()));
 
+        UniquePtr<uint8_t> compressed(nullptr, ::free);
+        int32_t compressed_size{};
+
+        if (image_codec_ != BlockCodec::NONE)
+        {
+            size_t capacity = block_codec_bound(image_codec_, total_data_size);
+            compressed = allocate_system<uint8_t>(capacity);
+
+            MEMORIA_TRY(size, compress_block(image_codec_, image_codec_level_, buffer.get(), total_data_size, compressed.get(), capacity));
+            compressed_size = static_cast<int32_t>(size);
+        }
+
+        bool is_compressed = compressed && compressed_size < total_data_size;
+
+        uint8_t type = is_compressed ? TYPE_COMPRESSED_DATA_BLOCK : TYPE_DATA_BLOCK;
+        out << type;
+
+        out << block_ptr->references();
+
         out << total_data_size;
         out << block->memory_block_size();
         out << block->ctr_type_hash();
         out << block->block_type_hash();
 
-        out.write(buffer.get(), 0, total_data_size);
+        if (is_compressed)
+        {
+            out << static_cast<uint8_t>(image_codec_);
+            out << compressed_size;
+
+            out.write(compressed.get(), 0, compressed_size);
+        }
+        else {
+            out.write(buffer.get(), 0, total_data_size);
+        }
 
         records_++;
 
@@ -1369,6 +2117,7 @@ protected:
                 std::cout << "MEMORIA: do_remove_history_node: " << node->snapshot_id() << std::endl;
             }
 
+            snapshot_map_.erase(node->snapshot_id());
             delete node;
 
             return true;
@@ -1384,6 +2133,7 @@ protected:
                 std::cout << "MEMORIA: do_remove_history_node: " << node->snapshot_id() << std::endl;
             }
 
+            snapshot_map_.erase(node->snapshot_id());
             delete node;
 
             parent->children().push_back(child);
@@ -89,6 +89,7 @@ protected:
     using Base::records_;
     using Base::write_metadata;
     using Base::write_history_node;
+    using Base::write_image;
     using Base::write;
     using Base::do_pack;
     using Base::get_labels_for;
@@ -566,33 +567,39 @@ public:
         return reactor::engine().run_at(cpu_, [&]() noexcept -> ResultT {
 
             active_snapshots_.wait(0);
-            
-            MEMORIA_TRY_VOID(do_pack(history_tree_));
-
-            records_ = 0;
-
-            char signature[12] = "MEMORIA";
-            for (size_t c = 7; c < sizeof(signature); c++) signature[c] = 0;
-
-            output->write(&signature, 0, sizeof(signature));
-
-            MEMORIA_TRY_VOID(write_metadata(*output));
-
-            RCBlockSet stored_blocks;
+            return write_image(*output, false);
+        });
+    }
 
-            auto res2 = walk_version_tree(history_tree_, [&](const HistoryNode* history_tree_node) {
-                return write_history_node(*output, history_tree_node, stored_blocks);
-            });
-            MEMORIA_RETURN_IF_ERROR(res2);
+    virtual Result<void> store_delta(OutputStreamHandler *output, int64_t wait_duration) noexcept
+    {
+        using ResultT = Result<void>;
+        return reactor::engine().run_at(cpu_, [&]() noexcept -> ResultT {
+            active_snapshots_.wait(0);
+            return write_image(*output, true);
+        });
+    }
 
-            Checksum checksum;
-            checksum.records() = records_;
+    virtual Result<void> store_delta(U8String file_name, int64_t wait_duration) noexcept
+    {
+        auto fileh = FileOutputStreamHandler::create_buffered(file_name.to_std_string());
+        return this->store_delta(fileh.get(), wait_duration);
+    }
 
-            MEMORIA_TRY_VOID(write(*output, checksum));
+    // Snapshots of this store live in one reactor thread, so there
+    // is no other thread to write an image concurrently with them.
+    virtual VoidResult start_checkpoint(U8String file_name, bool delta) noexcept {
+        return MEMORIA_MAKE_GENERIC_ERROR("Background checkpoints are not supported by fibers in-memory store");
+    }
 
-            output->close();
+    virtual VoidResult wait_checkpoint() noexcept {
+        return VoidResult::of();
+    }
 
-            return ResultT::of();
+    virtual VoidResult set_block_compression(BlockCodec codec, int32_t level) noexcept
+    {
+        return reactor::engine().run_at(cpu_, [&]{
+            return this->do_set_block_compression(codec, level);
         });
     }
 
@@ -848,6 +855,29 @@ Result<AllocSharedPtr<IMemoryStore<Profile>>> IMemoryStore<Profile>::load(U8Stri
 }
 
 
+template <typename Profile>
+Result<AllocSharedPtr<IMemoryStore<Profile>>> IMemoryStore<Profile>::load_chain(const std::vector<U8String>& file_names) noexcept
+{
+    std::vector<std::unique_ptr<FileInputStreamHandler>> handlers;
+    std::vector<InputStreamHandler*> chain;
+
+    for (const auto& file: file_names)
+    {
+        handlers.push_back(FileInputStreamHandler::create(file.data()));
+        chain.push_back(handlers.back().get());
+    }
+
+    auto rr = store::memory::FibersMemoryStoreImpl<Profile>::load_chain(chain);
+    if (rr.is_ok()) {
+        return Result<AllocSharedPtr<IMemoryStore<Profile>>>::of(std::move(rr).get());
+    }
+    else
+    {
+        return std::move(rr).transfer_error();
+    }
+}
+
+
 template <typename Profile>
 Result<AllocSharedPtr<IMemoryStore<Profile>>> IMemoryStore<Profile>::create() noexcept
 {
@@ -22,6 +22,7 @@
 #include <memoria/core/tools/stream.hpp>
 #include <memoria/core/tools/pair.hpp>
 #include <memoria/core/tools/latch.hpp>
+#include <memoria/core/tools/recursive_shared_mutex.hpp>
 #include <memoria/core/memory/memory.hpp>
 
 #include <memoria/store/memory/common/store_base.hpp>
@@ -30,6 +31,10 @@
 
 #include <memoria/filesystem/path.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
 #include <cstdlib>
 #include <memory>
 #include <limits>
@@ -37,6 +42,10 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
 
 namespace memoria {
 namespace store {
@@ -56,11 +65,12 @@ public:
 
     using AllocatorPtr          = AllocSharedPtr<MyType>;
     
-    using MutexT			= std::recursive_mutex;
+    using MutexT			= RecursiveSharedMutex;
     using SnapshotMutexT	= std::recursive_mutex;
     using StoreMutexT		= std::mutex;
 
     using LockGuardT			= std::lock_guard<MutexT>;
+    using SharedLockGuardT		= std::shared_lock<MutexT>;
     using StoreLockGuardT		= std::lock_guard<StoreMutexT>;
     using SnapshotLockGuardT	= std::lock_guard<SnapshotMutexT>;
     
@@ -70,9 +80,20 @@ public:
     using typename Base::BlockID;
     using typename Base::RCBlockSet;
     using typename Base::Checksum;
-    
+    using typename Base::ImageDescriptor;
+    using typename Base::PersistentTreeT;
+    using typename Base::NodeBaseT;
+    using typename Base::LeafNodeT;
+    using typename Base::BranchNodeT;
+
     using Base::load;
 
+    // Persistent tree nodes freed per store_mutex_ hold by the reclaimer
+    static constexpr size_t ReclaimSliceNodes = 256;
+
+    // History nodes removed per exclusive mutex_ hold by pack()
+    static constexpr size_t PackSliceNodes = 64;
+
 protected:
     using Base::history_tree_;
     using Base::snapshot_map_;
@@ -82,6 +103,9 @@ protected:
     using Base::records_;
     using Base::write_metadata;
     using Base::write_history_node;
+    using Base::write_image;
+    using Base::describe_image;
+    using Base::image_stored;
     using Base::write;
     using Base::do_pack;
     using Base::get_labels_for;
@@ -103,10 +127,38 @@ public:
 
 private:
     
+    // Taken exclusively for history tree maintenance: pack, drop, images.
+    // Snapshot lookup, branching and branch heads updates take it shared
+    // and synchronize on the mutexes below and on history nodes.
     mutable MutexT mutex_;
     mutable StoreMutexT store_mutex_;
+
+    // Guards snapshot_map_ under shared mutex_
+    mutable std::mutex snapshot_map_mutex_;
+
+    // Guards master_ and named_branches_ under shared mutex_. It's
+    // the innermost one, history node mutexes may be held here.
+    mutable std::mutex heads_mutex_;
     
     CountDownLatch<int64_t> active_snapshots_;
+
+    // Background checkpoint, see start_checkpoint()
+    std::mutex checkpoint_mutex_;
+    std::future<VoidResult> checkpoint_;
+
+    // Background reclamation of dropped snapshots' data,
+    // see retire_snapshot_data()
+    std::mutex reclaimer_mutex_;
+    std::condition_variable reclaimer_cv_;
+    std::thread reclaimer_;
+    bool reclaimer_stop_{};
+
+    // Guarded by reclaimer_mutex_
+    std::vector<NodeBaseT*> retired_roots_;
+    ReclamationStat reclamation_stat_;
+
+    // Nodes of the snapshot being reclaimed, guarded by store_mutex_
+    std::vector<NodeBaseT*> reclaim_stack_;
  
 public:
     ThreadsMemoryStoreImpl(MaybeError& maybe_error) noexcept:
@@ -121,6 +173,12 @@ public:
     
     virtual ~ThreadsMemoryStoreImpl() noexcept
     {
+        if (checkpoint_.valid()) {
+            checkpoint_.wait();
+        }
+
+        stop_reclaimer();
+
         free_memory(history_tree_);
     }
 
@@ -180,10 +238,50 @@ public:
     	return mutex_.try_lock();
     }
     
+    // Data-less history nodes are collected under shared lock and removed
+    // in short slices under exclusive one, so large histories don't stall
+    // the store. Dropped snapshots' data is freed in background.
     Result<void> pack() noexcept
     {
-        std::lock_guard<MutexT> lock(mutex_);
-        return do_pack(history_tree_);
+        return wrap_throwing([&]() -> VoidResult {
+            std::vector<SnapshotID> candidates;
+            {
+                SharedLockGuardT lock_guard(mutex_);
+                collect_pack_candidates(candidates);
+            }
+
+            uint64_t removed = 0;
+
+            for (size_t c = 0; c < candidates.size();)
+            {
+                LockGuardT lock_guard(mutex_);
+                auto branches = this->get_named_branch_nodeset();
+
+                for (size_t end = std::min(c + PackSliceNodes, candidates.size()); c < end; c++)
+                {
+                    auto ii = snapshot_map_.find(candidates[c]);
+                    if (ii != snapshot_map_.end())
+                    {
+                        HistoryNode* node = ii->second;
+
+                        bool remove_node;
+                        {
+                            SnapshotLockGuardT snapshot_lock_guard(node->snapshot_mutex());
+                            remove_node = node->root() == nullptr && node->references() == 0 && branches.find(node) == branches.end();
+                        }
+
+                        if (remove_node && do_remove_history_node(node)) {
+                            removed++;
+                        }
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+            reclamation_stat_.packed_history_nodes += removed;
+
+            return VoidResult::of();
+        });
     }
 
 
@@ -230,7 +328,9 @@ public:
 
     VoidResult remove_named_branch(const std::string& name) noexcept
     {
-        LockGuardT lock_guard(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
+
         named_branches_.erase(U8String(name));
         return VoidResult::of();
     }
@@ -238,7 +338,9 @@ public:
     Result<std::vector<U8String>> branch_names() noexcept
     {
         using ResultT = Result<std::vector<U8String>>;
-        std::lock_guard<MutexT> lock(mutex_);
+
+        SharedLockGuardT lock_guard(mutex_);
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
 
         std::vector<U8String> branches;
 
@@ -253,12 +355,13 @@ public:
     Result<SnapshotID> branch_head(const U8String& branch_name) noexcept
     {
         using ResultT = Result<SnapshotID>;
-        std::lock_guard<MutexT> lock(mutex_);
+
+        SharedLockGuardT lock_guard(mutex_);
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
 
         auto ii = named_branches_.find(branch_name);
         if (ii != named_branches_.end())
         {
-            // TODO: need to take a lock here on the snapshot
             return ResultT::of(ii->second->snapshot_id());
         }
 
@@ -269,12 +372,13 @@ public:
     {
         using ResultT = Result<std::vector<SnapshotID>>;
 
-        std::lock_guard<MutexT> lock(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
+
         std::unordered_set<SnapshotID> ids;
 
         for (const auto& entry: named_branches_)
         {
-            // TODO: need to take a lock here on the snapshot
             ids.insert(entry.second->snapshot_id());
         }
 
@@ -338,6 +442,9 @@ public:
         using ResultT = Result<std::vector<SnapshotID>>;
         std::lock(mutex_, store_mutex_);
 
+        LockGuardT lock_guard2(mutex_, std::adopt_lock);
+        StoreLockGuardT lock_guard1(store_mutex_, std::adopt_lock);
+
         std::vector<SnapshotID> snps;
 
         MEMORIA_TRY_VOID(walk_linear_history(start_id, stop_id, [&](const auto* history_node) {
@@ -356,15 +463,13 @@ public:
     {
         using ResultT = Result<SnapshotMetadata<Profile>>;
 
-    	LockGuardT lock_guard2(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(snapshot_id);
-        if (iter != snapshot_map_.end())
-        {
-            const auto history_node = iter->second;
-
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(snapshot_id, history_node);
 
+        if (history_node)
+        {
             std::vector<SnapshotID> children;
 
         	for (const auto& node: history_node->children())
@@ -387,13 +492,13 @@ public:
     virtual Result<int32_t> snapshot_status(const SnapshotID& snapshot_id) noexcept
     {
         using ResultT = Result<int32_t>;
-        LockGuardT lock_guard2(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(snapshot_id);
-        if (iter != snapshot_map_.end())
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(snapshot_id, history_node);
+
+        if (history_node)
         {
-            const auto history_node = iter->second;
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
             return ResultT::of((int32_t)history_node->status());
         }
         else {
@@ -404,14 +509,13 @@ public:
     Result<SnapshotID> snapshot_parent(const SnapshotID& snapshot_id) noexcept
     {
         using ResultT = Result<SnapshotID>;
-        LockGuardT lock_guard2(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(snapshot_id);
-        if (iter != snapshot_map_.end())
-        {
-            const auto history_node = iter->second;
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(snapshot_id, history_node);
 
+        if (history_node)
+        {
             auto parent_id = history_node->parent() ? history_node->parent()->snapshot_id() : SnapshotID{};
             return ResultT::of(parent_id);
         }
@@ -423,13 +527,13 @@ public:
     Result<U8String> snapshot_description(const SnapshotID& snapshot_id) noexcept
     {
         using ResultT = Result<U8String>;
-        LockGuardT lock_guard2(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(snapshot_id);
-        if (iter != snapshot_map_.end())
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(snapshot_id, history_node);
+
+        if (history_node)
         {
-            const auto history_node = iter->second;
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
             return ResultT::of(history_node->metadata());
         }
         else {
@@ -443,15 +547,13 @@ public:
     Result<SnapshotApiPtr> find(const SnapshotID& snapshot_id) noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
-        LockGuardT lock_guard(mutex_);
-
-        auto iter = snapshot_map_.find(snapshot_id);
-        if (iter != snapshot_map_.end())
-        {
-            auto history_node = iter->second;
+        SharedLockGuardT lock_guard(mutex_);
 
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(snapshot_id, history_node);
 
+        if (history_node)
+        {
             if (history_node->is_committed())
             {
                 return upcast(snp_make_shared_init<SnapshotT>(history_node, this->shared_from_this()));
@@ -482,13 +584,11 @@ public:
     Result<SnapshotApiPtr> find_branch(U8StringRef name) noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
-        LockGuardT lock_guard(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-    	auto iter = named_branches_.find(name);
-        if (iter != named_branches_.end())
+        auto history_node = branch_head_node(name);
+        if (history_node)
         {
-            auto history_node = iter->second;
-
             SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
 
             if (history_node->is_committed())
@@ -524,53 +624,49 @@ public:
     Result<SnapshotApiPtr> master() noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
-        std::lock(mutex_, master_->snapshot_mutex());
+        SharedLockGuardT lock_guard(mutex_);
 
-    	LockGuardT lock_guard(mutex_, std::adopt_lock);
-    	SnapshotLockGuardT snapshot_lock_guard(master_->snapshot_mutex(), std::adopt_lock);
+        auto history_node = master_node();
+        SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
 
-        return upcast(snp_make_shared_init<SnapshotT>(master_, this->shared_from_this()));
+        return upcast(snp_make_shared_init<SnapshotT>(history_node, this->shared_from_this()));
     }
 
     SnapshotMetadata<Profile> describe_master() const noexcept
     {
-    	std::lock(mutex_, master_->snapshot_mutex());
-    	LockGuardT lock_guard2(mutex_, std::adopt_lock);
-    	SnapshotLockGuardT snapshot_lock_guard(master_->snapshot_mutex(), std::adopt_lock);
+        SharedLockGuardT lock_guard(mutex_);
+
+        auto history_node = master_node();
+        SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
 
         std::vector<SnapshotID> children;
 
-    	for (const auto& node: master_->children())
+    	for (const auto& node: history_node->children())
     	{
             children.emplace_back(node->snapshot_id());
     	}
 
-        auto parent_id = master_->parent() ? master_->parent()->snapshot_id() : SnapshotID{};
+        auto parent_id = history_node->parent() ? history_node->parent()->snapshot_id() : SnapshotID{};
 
         return SnapshotMetadata<Profile>(
-            parent_id, master_->snapshot_id(), children, master_->metadata(), master_->status()
+            parent_id, history_node->snapshot_id(), children, history_node->metadata(), history_node->status()
     	);
     }
 
     VoidResult set_master(const SnapshotID& txn_id) noexcept
     {
         using ResultT = VoidResult;
-        LockGuardT lock_guard(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(txn_id);
-        if (iter != snapshot_map_.end())
-        {
-            auto history_node = iter->second;
-
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(txn_id, history_node);
 
-            if (history_node->is_committed())
-            {
-                master_ = iter->second;
-            }
-            else if (history_node->is_data_locked())
+        if (history_node)
+        {
+            if (history_node->is_committed() || history_node->is_data_locked())
             {
-            	master_ = iter->second;
+                std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
+                master_ = history_node;
             }
             else if (history_node->is_dropped())
             {
@@ -590,23 +686,18 @@ public:
     Result<void> set_branch(U8StringRef name, const SnapshotID& txn_id) noexcept
     {
         using ResultT = Result<void>;
-        LockGuardT lock_guard(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        auto iter = snapshot_map_.find(txn_id);
-        if (iter != snapshot_map_.end())
-        {
-            auto history_node = iter->second;
+        HistoryNode* history_node;
+        auto snapshot_lock = lock_history_node(txn_id, history_node);
 
-            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
-
-        	if (history_node->is_committed())
+        if (history_node)
+        {
+            if (history_node->is_committed() || history_node->is_data_locked())
             {
+                std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
                 named_branches_[name] = history_node;
             }
-        	else if (history_node->is_data_locked())
-        	{
-        		named_branches_[name] = history_node;
-        	}
             else {
                 return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} hasn't been committed yet", txn_id);
             }
@@ -618,58 +709,256 @@ public:
         }
     }
 
-    virtual Result<void> walk_containers(ContainerWalker<Profile>* walker, const char* allocator_descr = nullptr) noexcept
+private:
+    // Returns the node locked, or nullptr. The node is locked before the map
+    // is released, so forget_snapshot() can't delete it in the meantime.
+    std::unique_lock<SnapshotMutexT> lock_history_node(const SnapshotID& snapshot_id, HistoryNode*& history_node) const noexcept
     {
-        MEMORIA_TRY_VOID(this->build_snapshot_labels_metadata());
+        std::lock_guard<std::mutex> map_lock_guard(snapshot_map_mutex_);
 
-    	LockGuardT lock_guard(mutex_);
+        auto iter = snapshot_map_.find(snapshot_id);
+        if (iter != snapshot_map_.end())
+        {
+            history_node = iter->second;
+            return std::unique_lock<SnapshotMutexT>(history_node->snapshot_mutex());
+        }
 
-        walker->beginAllocator("PersistentInMemAllocator", allocator_descr);
+        history_node = nullptr;
+        return std::unique_lock<SnapshotMutexT>();
+    }
 
-        MEMORIA_TRY_VOID(walk_containers(history_tree_, walker));
+    // Heads are committed or data-locked nodes, they are removed from
+    // the history tree only under exclusive mutex_.
+    HistoryNode* master_node() const noexcept
+    {
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
+        return master_;
+    }
 
-        walker->endAllocator();
+    HistoryNode* branch_head_node(U8StringRef name) const noexcept
+    {
+        std::lock_guard<std::mutex> heads_lock_guard(heads_mutex_);
 
-        snapshot_labels_metadata().clear();
-        return Result<void>::of();
+        auto iter = named_branches_.find(name);
+        return iter != named_branches_.end() ? iter->second : nullptr;
     }
 
-    
-private:
-    virtual VoidResult do_store(OutputStreamHandler *output) noexcept
+    void register_snapshot(HistoryNode* history_node)
     {
-        using ResultT = VoidResult;
+        std::lock_guard<std::mutex> map_lock_guard(snapshot_map_mutex_);
+        snapshot_map_[history_node->snapshot_id()] = history_node;
+    }
 
-        MEMORIA_TRY_VOID(do_pack(history_tree_));
+    // IDs of data-less history nodes, descendants first. Only active nodes
+    // are deleted under shared mutex_, so the walk skips them and locks
+    // a child before its parent is released.
+    void collect_pack_candidates(std::vector<SnapshotID>& candidates) const
+    {
+        std::vector<HistoryNode*> stack{history_tree_};
 
-        records_ = 0;
+        while (stack.size() > 0)
+        {
+            HistoryNode* node = stack.back();
+            stack.pop_back();
 
-        char signature[12] = "MEMORIA";
-        for (size_t c = 7; c < sizeof(signature); c++) signature[c] = 0;
+            SnapshotLockGuardT snapshot_lock_guard(node->snapshot_mutex());
 
-        output->write(&signature, 0, sizeof(signature));
+            if (node->root() == nullptr && node->references() == 0) {
+                candidates.push_back(node->snapshot_id());
+            }
 
-        MEMORIA_TRY_VOID(write_metadata(*output));
-        RCBlockSet stored_blocks;
+            for (auto child: node->children())
+            {
+                SnapshotLockGuardT child_lock_guard(child->snapshot_mutex());
+                if (!child->is_active()) {
+                    stack.push_back(child);
+                }
+            }
+        }
 
-        auto res2 = walk_version_tree(history_tree_, [&](const HistoryNode* history_tree_node) noexcept {
-            return write_history_node(*output, history_tree_node, stored_blocks);
-        });
-        MEMORIA_RETURN_IF_ERROR(res2);
+        std::reverse(candidates.begin(), candidates.end());
+    }
+
+    // Detaches persistent tree of a dropped and no longer referenced
+    // snapshot and hands it over to the reclaimer thread.
+    void retire_snapshot_data(HistoryNode* node) noexcept
+    {
+        NodeBaseT* root;
+        {
+            StoreLockGuardT store_lock_guard(store_mutex_);
+            SnapshotLockGuardT snapshot_lock_guard(node->snapshot_mutex());
+
+            root = node->root();
+            if (!root) {
+                return;
+            }
+
+            if (this->is_dump_snapshot_lifecycle()) {
+                std::cout << "MEMORIA: RETIRE snapshot's DATA: " << node->snapshot_id() << std::endl;
+            }
+
+            node->assign_root_no_ref(nullptr);
+            node->root_id() = BlockID{};
+        }
+
+        bool background = true;
+        {
+            std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+
+            retired_roots_.push_back(root);
+            reclamation_stat_.pending_snapshots++;
+
+            if (!reclaimer_.joinable())
+            {
+                try {
+                    reclaimer_ = std::thread([this]{
+                        run_reclaimer();
+                    });
+                }
+                catch (...) {
+                    background = false;
+                }
+            }
+        }
+
+        if (background) {
+            reclaimer_cv_.notify_one();
+        }
+        else {
+            reclaim_slice(std::numeric_limits<size_t>::max());
+        }
+    }
+
+    void run_reclaimer() noexcept
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> reclaimer_lock(reclaimer_mutex_);
+                reclaimer_cv_.wait(reclaimer_lock, [&]{
+                    return reclaimer_stop_ || reclamation_stat_.pending_snapshots > 0;
+                });
+
+                if (reclaimer_stop_) {
+                    break;
+                }
+            }
+
+            reclaim_slice(ReclaimSliceNodes);
+
+            // Let lock waiters in between slices
+            std::this_thread::yield();
+        }
+    }
+
+    // Frees up to max_nodes persistent tree nodes of retired snapshots,
+    // one snapshot at a time. Blocks may be shared with live snapshots,
+    // so the data is freed under store_mutex_, like do_drop() does.
+    void reclaim_slice(size_t max_nodes) noexcept
+    {
+        ReclamationStat slice;
+
+        StoreLockGuardT store_lock_guard(store_mutex_);
+
+        for (size_t visited = 0; visited < max_nodes;)
+        {
+            if (reclaim_stack_.empty())
+            {
+                std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+                if (retired_roots_.empty()) {
+                    break;
+                }
+
+                reclaim_stack_.push_back(retired_roots_.back());
+                retired_roots_.pop_back();
+            }
+
+            visited += PersistentTreeT::delete_nodes(reclaim_stack_, max_nodes - visited, [&](NodeBaseT* node){
+                if (node->is_leaf())
+                {
+                    LeafNodeT* leaf = PersistentTreeT::to_leaf_node(node);
+                    for (int32_t c = 0; c < leaf->size(); c++)
+                    {
+                        auto& block_descr = leaf->data(c);
+                        if (block_descr.block_ptr()->unref() == 0)
+                        {
+                            slice.reclaimed_blocks++;
+                            slice.reclaimed_bytes += block_descr.block_ptr()->raw_data()->memory_block_size();
+
+                            delete block_descr.block_ptr();
+                        }
+                    }
+
+                    slice.reclaimed_bytes += sizeof(LeafNodeT);
+                }
+                else {
+                    slice.reclaimed_bytes += sizeof(BranchNodeT);
+                }
+
+                slice.reclaimed_nodes++;
+            });
+
+            if (reclaim_stack_.empty()) {
+                slice.reclaimed_snapshots++;
+            }
+        }
+
+        std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+
+        reclamation_stat_.reclaimed_snapshots += slice.reclaimed_snapshots;
+        reclamation_stat_.reclaimed_nodes     += slice.reclaimed_nodes;
+        reclamation_stat_.reclaimed_blocks    += slice.reclaimed_blocks;
+        reclamation_stat_.reclaimed_bytes     += slice.reclaimed_bytes;
+
+        reclamation_stat_.pending_snapshots -= slice.reclaimed_snapshots;
+        reclamation_stat_.pending_nodes = reclaim_stack_.size();
+    }
+
+    // Reclaims whatever is left synchronously
+    void stop_reclaimer() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+            reclaimer_stop_ = true;
+        }
+
+        reclaimer_cv_.notify_all();
+
+        if (reclaimer_.joinable()) {
+            reclaimer_.join();
+        }
+
+        reclaim_slice(std::numeric_limits<size_t>::max());
+    }
+
+public:
+    virtual Result<void> walk_containers(ContainerWalker<Profile>* walker, const char* allocator_descr = nullptr) noexcept
+    {
+        MEMORIA_TRY_VOID(this->build_snapshot_labels_metadata());
+
+    	LockGuardT lock_guard(mutex_);
 
-        Checksum checksum;
-        checksum.records() = records_;
+        walker->beginAllocator("PersistentInMemAllocator", allocator_descr);
 
-        MEMORIA_TRY_VOID(write(*output, checksum));
+        MEMORIA_TRY_VOID(walk_containers(history_tree_, walker));
 
-        output->close();
+        walker->endAllocator();
+
+        snapshot_labels_metadata().clear();
+        return Result<void>::of();
+    }
 
-        return ResultT::of();
+    
+private:
+    virtual VoidResult do_store(OutputStreamHandler *output, bool delta = false) noexcept
+    {
+        return write_image(*output, delta);
     }
 public:
 
     virtual VoidResult store(OutputStreamHandler *output, int64_t wait_duration) noexcept
     {
+        auto checkpoint_lock = await_checkpoint();
         std::lock(mutex_, store_mutex_);
 
         LockGuardT lock_guard2(mutex_, std::adopt_lock);
@@ -698,6 +987,7 @@ public:
 
     virtual Result<void> store(const char* file, int64_t wait_duration) noexcept
     {
+        auto checkpoint_lock = await_checkpoint();
         std::lock(mutex_, store_mutex_);
 
         LockGuardT lock_guard2(mutex_, std::adopt_lock);
@@ -714,27 +1004,179 @@ public:
         return do_store(fileh.get());
     }
 
+    virtual VoidResult store_delta(OutputStreamHandler *output, int64_t wait_duration) noexcept
+    {
+        auto checkpoint_lock = await_checkpoint();
+        std::lock(mutex_, store_mutex_);
 
-    static Result<AllocSharedPtr<IMemoryStore<Profile>>> load(const char* file) noexcept
+        LockGuardT lock_guard2(mutex_, std::adopt_lock);
+        StoreLockGuardT lock_guard1(store_mutex_, std::adopt_lock);
+
+        if (wait_duration == 0) {
+            active_snapshots_.wait(0);
+        }
+        else if (!active_snapshots_.waitFor(0, wait_duration)) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Active snapshots commit/drop waiting timeout: {} ms", wait_duration);
+        }
+
+        return do_store(output, true);
+    }
+
+    virtual VoidResult store_delta(U8String file_name, int64_t wait_duration) noexcept
     {
-        auto fileh = FileInputStreamHandler::create(U8String(file).data());
-        auto rr = Base::load(fileh.get());
-        if (rr.is_ok()) {
-            return Result<AllocSharedPtr<IMemoryStore<Profile>>>::of(rr.get());
+        auto fileh = FileOutputStreamHandler::create(file_name.data());
+        return this->store_delta(fileh.get(), wait_duration);
+    }
+
+    virtual VoidResult start_checkpoint(U8String file_name, bool delta) noexcept
+    {
+        std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+
+        if (checkpoint_.valid() && checkpoint_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return MEMORIA_MAKE_GENERIC_ERROR("Another checkpoint is still running");
         }
 
-        return std::move(rr).transfer_error();
+        return wrap_throwing([&]() -> VoidResult {
+            std::shared_ptr<OutputStreamHandler> output = FileOutputStreamHandler::create(file_name.data());
+
+            std::shared_ptr<ImageDescriptor> image;
+            {
+                std::lock(mutex_, store_mutex_);
+
+                LockGuardT lock_guard2(mutex_, std::adopt_lock);
+                StoreLockGuardT lock_guard1(store_mutex_, std::adopt_lock);
+
+                MEMORIA_TRY(descr, describe_image(delta, true));
+                image = std::make_shared<ImageDescriptor>(std::move(descr));
+            }
+
+            try {
+                checkpoint_ = std::async(std::launch::async, [this, output, image]() noexcept {
+                    return run_checkpoint(*output, *image);
+                });
+            }
+            catch (...) {
+                unpin_snapshots(*image);
+                throw;
+            }
+
+            return VoidResult::of();
+        });
     }
 
-    static Result<AllocSharedPtr<IMemoryStore<Profile>>> load(const U8String& file) noexcept
+    virtual VoidResult wait_checkpoint() noexcept
+    {
+        std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+
+        if (checkpoint_.valid()) {
+            return checkpoint_.get();
+        }
+
+        return VoidResult::of();
+    }
+
+    virtual VoidResult set_block_compression(BlockCodec codec, int32_t level) noexcept
     {
-        auto fileh = FileInputStreamHandler::create(file.data());
-        auto rr = Base::load(fileh.get());
-        if (rr.is_ok()) {
-            return Result<AllocSharedPtr<IMemoryStore<Profile>>>::of(rr.get());
+        LockGuardT lock_guard(mutex_);
+        return this->do_set_block_compression(codec, level);
+    }
+
+
+private:
+    // Image writers share the records counter and the image chain state
+    std::unique_lock<std::mutex> await_checkpoint() noexcept
+    {
+        std::unique_lock<std::mutex> lock(checkpoint_mutex_);
+
+        if (checkpoint_.valid()) {
+            checkpoint_.wait();
         }
 
-        return std::move(rr).transfer_error();
+        return lock;
+    }
+
+    VoidResult run_checkpoint(OutputStreamHandler& output, const ImageDescriptor& image) noexcept
+    {
+        auto res = write_image(output, image);
+
+        if (res.is_ok())
+        {
+            LockGuardT lock_guard(mutex_);
+            image_stored(image);
+        }
+
+        unpin_snapshots(image);
+
+        return res;
+    }
+
+    // Snapshots dropped and closed while they were pinned
+    // are deleted here, as if they were closed now.
+    void unpin_snapshots(const ImageDescriptor& image) noexcept
+    {
+        for (const auto& history_node: image.history)
+        {
+            HistoryNode* node = history_node.pinned;
+            if (node)
+            {
+                bool drop = false;
+                {
+                    SnapshotLockGuardT snapshot_lock_guard(node->snapshot_mutex());
+                    drop = node->unref() == 0 && node->is_dropped();
+                }
+
+                if (drop) {
+                    retire_snapshot_data(node);
+                }
+            }
+        }
+    }
+
+public:
+    static Result<AllocSharedPtr<IMemoryStore<Profile>>> load(const char* file) noexcept
+    {
+        return load_chain(std::vector<U8String>{U8String(file)});
+    }
+
+    static Result<AllocSharedPtr<IMemoryStore<Profile>>> load(const U8String& file) noexcept
+    {
+        return load_chain(std::vector<U8String>{file});
+    }
+
+    // Image files are memory-mapped and loaded by the given number of threads
+    static Result<AllocSharedPtr<IMemoryStore<Profile>>> load_chain(
+            const std::vector<U8String>& files,
+            size_t threads = std::thread::hardware_concurrency()
+    ) noexcept
+    {
+        using ResultT = Result<AllocSharedPtr<IMemoryStore<Profile>>>;
+
+        return wrap_throwing([&]() -> ResultT {
+            namespace bip = boost::interprocess;
+
+            std::vector<bip::mapped_region> regions;
+            std::vector<Span<const uint8_t>> chain;
+
+            for (const auto& file: files)
+            {
+                bip::file_mapping mapping(file.data(), bip::read_only);
+                regions.emplace_back(mapping, bip::read_only);
+                regions.back().advise(bip::mapped_region::advice_sequential);
+
+                chain.emplace_back(
+                    static_cast<const uint8_t*>(regions.back().get_address()),
+                    regions.back().get_size()
+                );
+            }
+
+            auto rr = Base::load_chain(chain, std::max<size_t>(threads, 1));
+            if (rr.is_ok()) {
+                return ResultT::of(rr.get());
+            }
+
+            return std::move(rr).transfer_error();
+        });
     }
 
     Result<SharedPtr<AllocatorMemoryStat<Profile>>> memory_stat() noexcept
@@ -750,7 +1192,8 @@ public:
             return wrap_throwing([&]() -> VoidResult {
                 SnapshotLockGuardT snapshot_lock_guard(node->snapshot_mutex());
 
-                if (node->is_committed() || node->is_dropped())
+                // Data of dropped snapshots may already be retired
+                if ((node->is_committed() || node->is_dropped()) && node->root())
                 {
                     MEMORIA_TRY(snp, snp_make_shared_init<SnapshotT>(node, this->shared_from_this()));
                     auto snp_stat = snp->do_compute_memory_stat(visited_blocks);
@@ -764,6 +1207,11 @@ public:
         MEMORIA_TRY_VOID(this->walk_version_tree(history_tree_, history_visitor));
         alloc_stat->compute_total_size();
 
+        {
+            std::lock_guard<std::mutex> reclaimer_lock(reclaimer_mutex_);
+            alloc_stat->set_reclamation(reclamation_stat_);
+        }
+
         return ResultT::of(alloc_stat);
     }
 
@@ -869,15 +1317,28 @@ protected:
     
     virtual void forget_snapshot(HistoryNode* history_node)
     {
-    	LockGuardT lock_guard(mutex_);
+        SharedLockGuardT lock_guard(mutex_);
 
-        snapshot_map_.erase(history_node->snapshot_id());
+        {
+            std::lock_guard<std::mutex> map_lock_guard(snapshot_map_mutex_);
+            snapshot_map_.erase(history_node->snapshot_id());
+        }
 
         if (this->is_dump_snapshot_lifecycle()) {
             std::cout << "MEMORIA: FORGET snapshot from allocator: " << history_node->snapshot_id() << std::endl;
         }
 
-        history_node->remove_from_parent();
+        if (history_node->parent())
+        {
+            // Siblings are added by branch() under the parent's mutex
+            SnapshotLockGuardT parent_lock_guard(history_node->parent()->snapshot_mutex());
+            history_node->remove_from_parent();
+        }
+
+        {
+            // Wait for lookups that have found the node before it was erased
+            SnapshotLockGuardT snapshot_lock_guard(history_node->snapshot_mutex());
+        }
 
         delete history_node;
     }
@@ -930,14 +1391,14 @@ Result<AllocSharedPtr<IMemoryStore<DefaultProfile<>>>> IMemoryStore<DefaultProfi
 template <>
 Result<AllocSharedPtr<IMemoryStore<DefaultProfile<>>>> IMemoryStore<DefaultProfile<>>::load(U8String input_file) noexcept
 {
-    auto fileh = FileInputStreamHandler::create(input_file.data());
-    auto rr = store::memory::ThreadsMemoryStoreImpl<DefaultProfile<>>::load(fileh.get());
+    return store::memory::ThreadsMemoryStoreImpl<DefaultProfile<>>::load(input_file);
+}
 
-    if (rr.is_ok()) {
-        return Result<AllocSharedPtr<IMemoryStore<DefaultProfile<>>>>::of(rr.get());
-    }
 
-    return std::move(rr).transfer_error();
+template <>
+Result<AllocSharedPtr<IMemoryStore<DefaultProfile<>>>> IMemoryStore<DefaultProfile<>>::load_chain(const std::vector<U8String>& file_names) noexcept
+{
+    return store::memory::ThreadsMemoryStoreImpl<DefaultProfile<>>::load_chain(file_names);
 }
 
 
@@ -37,6 +37,7 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 
 
 
@@ -64,6 +65,7 @@ protected:
     using LockGuardT			= typename std::lock_guard<MutexT>;
     using StoreLockGuardT		= typename std::lock_guard<StoreMutexT>;
     using AllocatorLockGuardT	= typename std::lock_guard<AllocatorMutexT>;
+    using AllocatorSharedLockGuardT	= typename std::shared_lock<AllocatorMutexT>;
     
     using typename Base::BlockID;
     using typename Base::CtrID;
@@ -125,25 +127,24 @@ public:
 
     	if (drop1)
     	{
+            // Data-less unreferenced nodes are removed by pack()
+            AllocatorSharedLockGuardT lock_guard(history_node_->allocator_mutex());
+
     		do_drop();
     		history_tree_raw_->forget_snapshot(history_node_);
     	}
 
     	if (drop2)
     	{
-    		StoreLockGuardT store_lock_guard(history_node_->store_mutex());
-    		do_drop();
-
-    		// FIXME: check if absence of snapshot lock here leads to data races...
+            // Dropped snapshot's data is freed by the store in background
+            history_tree_raw_->retire_snapshot_data(history_node_);
     	}
     }
 
     SnapshotMetadata<Profile> describe() const
     {
-    	std::lock(history_node_->snapshot_mutex(), history_node_->allocator_mutex());
-
-    	AllocatorLockGuardT lock_guard2(history_node_->allocator_mutex(), std::adopt_lock);
-    	LockGuardT lock_guard1(history_node_->snapshot_mutex(), std::adopt_lock);
+    	AllocatorSharedLockGuardT lock_guard2(history_node_->allocator_mutex());
+    	LockGuardT lock_guard1(history_node_->snapshot_mutex());
 
         std::vector<SnapshotID> children;
 
@@ -235,10 +236,8 @@ public:
 
     VoidResult lock_data_for_import() noexcept
     {
-    	std::lock(history_node_->allocator_mutex(), history_node_->snapshot_mutex());
-
-    	AllocatorLockGuardT lock_guard2(history_node_->allocator_mutex(), std::adopt_lock);
-    	LockGuardT lock_guard1(history_node_->snapshot_mutex(), std::adopt_lock);
+    	AllocatorSharedLockGuardT lock_guard2(history_node_->allocator_mutex());
+    	LockGuardT lock_guard1(history_node_->snapshot_mutex());
 
     	if (history_node_->is_active())
     	{
@@ -265,52 +264,59 @@ public:
     {
         //using ResultT = Result<SnapshotApiPtr>;
 
-    	std::lock(history_node_->allocator_mutex(), history_node_->snapshot_mutex());
-
-    	AllocatorLockGuardT lock_guard2(history_node_->allocator_mutex(), std::adopt_lock);
-    	LockGuardT lock_guard1(history_node_->snapshot_mutex(), std::adopt_lock);
+        // Branches of different snapshots are created concurrently,
+        // the store is locked exclusively only by history maintenance.
+        AllocatorSharedLockGuardT lock_guard2(history_node_->allocator_mutex());
 
-        if (history_node_->is_committed())
+        HistoryNode* history_node;
         {
-            HistoryNode* history_node = new HistoryNode(history_node_);
+            LockGuardT lock_guard1(history_node_->snapshot_mutex());
 
-            if (history_tree_raw_->is_dump_snapshot_lifecycle()) {
-                std::cout << "MEMORIA: BRANCH snapshot: " << history_node->snapshot_id() << std::endl;
+            if (history_node_->is_committed())
+            {
+                history_node = new HistoryNode(history_node_);
+            }
+            else if (history_node_->is_data_locked())
+            {
+                return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} is locked, branching is not possible.", uuid());
+            }
+            else
+            {
+                return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} is still being active. Commit it first.", uuid());
             }
-
-            LockGuardT lock_guard3(history_node->snapshot_mutex());
-
-            history_tree_raw_->snapshot_map_[history_node->snapshot_id()] = history_node;
-
-            return upcast(snp_make_shared_init<MyType>(history_node, history_tree_->shared_from_this()));
         }
-        else if (history_node_->is_data_locked())
-        {
-            return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} is locked, branching is not possible.", uuid());
+
+        if (history_tree_raw_->is_dump_snapshot_lifecycle()) {
+            std::cout << "MEMORIA: BRANCH snapshot: " << history_node->snapshot_id() << std::endl;
         }
-        else
-        {
-            return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} is still being active. Commit it first.", uuid());
+
+        // The new node is not visible to lookups until it's registered
+        auto snapshot = upcast(snp_make_shared_init<MyType>(history_node, history_tree_->shared_from_this()));
+        if (snapshot.is_ok()) {
+            history_tree_raw_->register_snapshot(history_node);
         }
+
+        return snapshot;
     }
 
     bool has_parent() const noexcept
     {
-    	AllocatorLockGuardT lock_guard(history_node_->allocator_mutex());
+    	AllocatorSharedLockGuardT lock_guard(history_node_->allocator_mutex());
         return history_node_->parent() != nullptr;
     }
 
     Result<SnapshotApiPtr> parent() noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
-        std::lock(history_node_->snapshot_mutex(), history_node_->allocator_mutex());
 
-    	AllocatorLockGuardT lock_guard2(history_node_->allocator_mutex(), std::adopt_lock);
-    	LockGuardT lock_guard1(history_node_->snapshot_mutex(), std::adopt_lock);
+        // Parent links are changed only under exclusive lock
+    	AllocatorSharedLockGuardT lock_guard2(history_node_->allocator_mutex());
 
         if (history_node_->parent())
         {
             HistoryNode* history_node = history_node_->parent();
+            LockGuardT lock_guard1(history_node->snapshot_mutex());
+
             return upcast(snp_make_shared_init<MyType>(history_node, history_tree_->shared_from_this()));
         }
         else
@@ -322,7 +328,9 @@ public:
     Result<SharedPtr<SnapshotMemoryStat<Profile>>> memory_stat() noexcept
     {
         using ResultT = Result<SharedPtr<SnapshotMemoryStat<Profile>>>;
-        std::lock(history_node_->snapshot_mutex(), history_node_->allocator_mutex());
+
+        AllocatorSharedLockGuardT lock_guard2(history_node_->allocator_mutex());
+        LockGuardT lock_guard1(history_node_->snapshot_mutex());
         return ResultT::of(this->do_compute_memory_stat());
     }
 
@@ -0,0 +1,329 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/types.hpp>
+#include <memoria/store/memory/common/hashed_pool.hpp>
+
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace memoria {
+
+// Root, tables and buckets of all PublishedMap<> versions, so that parts
+// replaced by updates of different maps can be retired together.
+struct PublishedMapPart {
+    virtual ~PublishedMapPart() noexcept = default;
+};
+
+/**
+ * Immutable hash map for lookups without locks, updated by copying.
+ *
+ * Entries are spread over a two-level table of buckets by their hash. An
+ * update copies only the buckets it changes and the tables on their paths,
+ * everything else is shared with the previous version. Parts of the
+ * previous version replaced by the update are handed to the caller, who
+ * deletes them when no reader may still see that version.
+ */
+template <typename Key, typename Value, typename Hash = HashedPoolHash<Key>>
+class PublishedMap {
+    static constexpr size_t BITS   = 6;
+    static constexpr size_t FANOUT = size_t{1} << BITS;
+
+    struct Bucket: PublishedMapPart {
+        std::vector<std::pair<Key, Value>> entries;
+    };
+
+    struct Table: PublishedMapPart {
+        std::array<const Bucket*, FANOUT> buckets{};
+    };
+
+public:
+    struct Root: PublishedMapPart {
+        std::array<const Table*, FANOUT> tables{};
+    };
+
+    // Changes of one version, applied to copies of its parts. Copies are
+    // mutable until finish() publishes them as the new version, and are
+    // deleted if the update is abandoned.
+    class Update {
+        const Root* base_;
+        Root* root_{};
+        std::vector<const PublishedMapPart*> replaced_;
+
+    public:
+        Update(const Root* base) noexcept:
+            base_(base)
+        {}
+
+        Update(const Update&) = delete;
+
+        ~Update() noexcept
+        {
+            if (root_)
+            {
+                for (size_t t = 0; t < FANOUT; t++)
+                {
+                    if (is_copied(t)) {
+                        delete_table(t);
+                    }
+                }
+
+                delete root_;
+            }
+        }
+
+        void assign(const Key& key, const Value& value)
+        {
+            Bucket* bucket = bucket_for(key);
+
+            for (auto& entry: bucket->entries)
+            {
+                if (entry.first == key)
+                {
+                    entry.second = value;
+                    return;
+                }
+            }
+
+            bucket->entries.emplace_back(key, value);
+        }
+
+        void remove(const Key& key)
+        {
+            const Bucket* current = PublishedMap::bucket(root(), key);
+            if (!current || !PublishedMap::find_in(current, key)) {
+                return;
+            }
+
+            Bucket* bucket = bucket_for(key);
+            for (size_t c = 0; c < bucket->entries.size(); c++)
+            {
+                if (bucket->entries[c].first == key)
+                {
+                    bucket->entries.erase(bucket->entries.begin() + c);
+                    break;
+                }
+            }
+        }
+
+        // Number of parts finish() hands to the caller at most
+        size_t replaced() const noexcept {
+            return replaced_.size() + 1;
+        }
+
+        // Returns the new version. Replaced parts are appended to the list,
+        // which must have room for replaced() of them.
+        const Root* finish(std::vector<const PublishedMapPart*>& retired) noexcept
+        {
+            if (!root_) {
+                return base_;
+            }
+
+            for (const PublishedMapPart* part: replaced_) {
+                retired.push_back(part);
+            }
+
+            if (base_) {
+                retired.push_back(base_);
+            }
+
+            replaced_.clear();
+
+            // Empty buckets are not published
+            for (size_t t = 0; t < FANOUT; t++)
+            {
+                if (is_copied(t))
+                {
+                    Table* table = const_cast<Table*>(root_->tables[t]);
+                    for (size_t b = 0; b < FANOUT; b++)
+                    {
+                        if (table->buckets[b] && table->buckets[b]->entries.size() == 0)
+                        {
+                            if (is_copied(t, b)) {
+                                delete table->buckets[b];
+                            }
+                            table->buckets[b] = nullptr;
+                        }
+                    }
+                }
+            }
+
+            Root* root = root_;
+            root_ = nullptr;
+
+            return root;
+        }
+
+    private:
+        const Root* root() const noexcept {
+            return root_ ? root_ : base_;
+        }
+
+        const Table* base_table(size_t t) const noexcept {
+            return base_ ? base_->tables[t] : nullptr;
+        }
+
+        bool is_copied(size_t t) const noexcept {
+            return root_->tables[t] && root_->tables[t] != base_table(t);
+        }
+
+        bool is_copied(size_t t, size_t b) const noexcept
+        {
+            const Table* base = base_table(t);
+            return root_->tables[t]->buckets[b] != (base ? base->buckets[b] : nullptr);
+        }
+
+        void delete_table(size_t t) noexcept
+        {
+            const Table* table = root_->tables[t];
+            for (size_t b = 0; b < FANOUT; b++)
+            {
+                if (table->buckets[b] && is_copied(t, b)) {
+                    delete table->buckets[b];
+                }
+            }
+
+            delete table;
+        }
+
+        // Copies the bucket of the key and its path, if it's not copied yet
+        Bucket* bucket_for(const Key& key)
+        {
+            uint64_t hash = Hash()(key);
+            size_t t = hash & (FANOUT - 1);
+            size_t b = (hash >> BITS) & (FANOUT - 1);
+
+            if (!root_)
+            {
+                root_ = base_ ? new Root(*base_) : new Root();
+            }
+
+            if (!is_copied(t))
+            {
+                const Table* base = base_table(t);
+
+                replaced_.reserve(replaced_.size() + 1);
+                root_->tables[t] = base ? new Table(*base) : new Table();
+
+                if (base) {
+                    replaced_.push_back(base);
+                }
+            }
+
+            Table* table = const_cast<Table*>(root_->tables[t]);
+
+            if (!table->buckets[b] || !is_copied(t, b))
+            {
+                const Bucket* base = table->buckets[b];
+
+                replaced_.reserve(replaced_.size() + 1);
+                auto bucket = std::make_unique<Bucket>();
+                if (base) {
+                    bucket->entries = base->entries;
+                }
+
+                table->buckets[b] = bucket.release();
+
+                if (base) {
+                    replaced_.push_back(base);
+                }
+            }
+
+            return const_cast<Bucket*>(table->buckets[b]);
+        }
+    };
+
+    static const Value* find(const Root* root, const Key& key) noexcept
+    {
+        const Bucket* bucket = PublishedMap::bucket(root, key);
+        return bucket ? find_in(bucket, key) : nullptr;
+    }
+
+    template <typename Fn>
+    static void for_each(const Root* root, Fn&& fn)
+    {
+        if (root)
+        {
+            for (const Table* table: root->tables)
+            {
+                if (table)
+                {
+                    for (const Bucket* bucket: table->buckets)
+                    {
+                        if (bucket)
+                        {
+                            for (const auto& entry: bucket->entries) {
+                                fn(entry.first, entry.second);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Deletes all parts of the version. It must not share them with
+    // versions that are still in use.
+    static void destroy(const Root* root) noexcept
+    {
+        if (root)
+        {
+            for (const Table* table: root->tables)
+            {
+                if (table)
+                {
+                    for (const Bucket* bucket: table->buckets) {
+                        delete bucket;
+                    }
+
+                    delete table;
+                }
+            }
+
+            delete root;
+        }
+    }
+
+private:
+    static const Bucket* bucket(const Root* root, const Key& key) noexcept
+    {
+        if (!root) {
+            return nullptr;
+        }
+
+        uint64_t hash = Hash()(key);
+        const Table* table = root->tables[hash & (FANOUT - 1)];
+
+        return table ? table->buckets[(hash >> BITS) & (FANOUT - 1)] : nullptr;
+    }
+
+    static const Value* find_in(const Bucket* bucket, const Key& key) noexcept
+    {
+        for (const auto& entry: bucket->entries)
+        {
+            if (entry.first == key) {
+                return &entry.second;
+            }
+        }
+
+        return nullptr;
+    }
+};
+
+}
@@ -129,6 +129,7 @@ protected:
     bool snapshot_removal_{false};
 
 public:
+    struct AdoptReference {};
 
     SnapshotBase(MaybeError& maybe_error, HistoryNode* history_node, const PersistentAllocatorPtr& history_tree):
         history_node_(history_node),
@@ -156,6 +157,15 @@ public:
             history_tree_raw_->ref_active();
         }
     }
+
+    // For committed snapshots found by lock-free lookups,
+    // that have already referenced the node with try_ref().
+    SnapshotBase(MaybeError& maybe_error, HistoryNode* history_node, const PersistentAllocatorPtr& history_tree, AdoptReference):
+        history_node_(history_node),
+        history_tree_(history_tree),
+        history_tree_raw_(history_tree.get()),
+        logger_("PersistentInMemStoreSnp", Logger::DERIVED, &history_tree->logger_)
+    {}
     
     VoidResult post_init() noexcept
     {
@@ -685,6 +695,10 @@ public:
         return block->unref_block();
     }
 
+    virtual BoolResult unref_ctr_block(BlockG block, const BlockID& ctr_root_id) noexcept {
+        return block->unref_block();
+    }
+
 
 
     virtual VoidResult removeBlock(const BlockID& id) noexcept
@@ -40,6 +40,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <atomic>
 #include <mutex>
 
 
@@ -81,6 +82,10 @@ public:
         using HLockGuardT 	= typename MyType::SnapshotLockGuardT;
 
     private:
+        // Set in references_ when the node is dropped or sealed, so that
+        // lock-free lookups can't reference it anymore, see try_ref().
+        static constexpr int64_t DROPPED_REF = int64_t{1} << 62;
+
         MyType* allocator_;
 
         HistoryNode* parent_;
@@ -90,11 +95,11 @@ public:
 
         BlockID root_id_{};
 
-        Status status_;
+        std::atomic<Status> status_;
 
         SnapshotID snapshot_id_;
 
-        int64_t references_ = 0;
+        std::atomic<int64_t> references_;
 
         mutable HMutexT mutex_;
 
@@ -106,7 +111,8 @@ public:
         	allocator_(allocator),
             parent_(nullptr),
             status_(status),
-            snapshot_id_(ProfileTraits<Profile>::make_random_snapshot_id())
+            snapshot_id_(ProfileTraits<Profile>::make_random_snapshot_id()),
+            references_(initial_references(status))
         {
         }
 
@@ -114,7 +120,8 @@ public:
         	allocator_(parent->allocator_),
 			parent_(parent),
             status_(status),
-            snapshot_id_(ProfileTraits<Profile>::make_random_snapshot_id())
+            snapshot_id_(ProfileTraits<Profile>::make_random_snapshot_id()),
+            references_(initial_references(status))
         {
             if (parent_)
             {
@@ -127,7 +134,8 @@ public:
         	allocator_(allocator),
             parent_(parent),
             status_(status),
-            snapshot_id_(snapshot_id)
+            snapshot_id_(snapshot_id),
+            references_(initial_references(status))
         {
             if (parent_) {
                 root_id_ = parent->root_id();
@@ -257,6 +265,10 @@ public:
 
         void set_status(const Status& status) noexcept {
         	status_ = status;
+
+            if (status == Status::DROPPED) {
+                references_.fetch_or(DROPPED_REF);
+            }
         }
 
 
@@ -274,7 +286,7 @@ public:
         }
 
         void mark_to_clear() noexcept {
-            status_ = Status::DROPPED;
+            set_status(Status::DROPPED);
         }
 
         void lock_data() noexcept {
@@ -282,17 +294,64 @@ public:
         }
 
 
-        auto references() const noexcept
+        int64_t references() const noexcept
+        {
+        	return references_.load(std::memory_order_acquire) & ~DROPPED_REF;
+        }
+
+        int64_t ref() noexcept {
+            return (references_.fetch_add(1, std::memory_order_acq_rel) + 1) & ~DROPPED_REF;
+        }
+
+        // Lock-free counterpart of ref() for lookups that have found the node
+        // without any lock. Fails if the node has been dropped or sealed.
+        bool try_ref() noexcept
+        {
+            int64_t refs = references_.load(std::memory_order_acquire);
+            while (!(refs & DROPPED_REF))
+            {
+                if (references_.compare_exchange_weak(refs, refs + 1, std::memory_order_acq_rel)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Returns the number of remaining references. If it's zero, dropped
+        // is set when the node's data is to be released by the caller.
+        int64_t unref(bool* dropped = nullptr) noexcept
         {
-        	return references_;
+            int64_t refs = references_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+            if (dropped) {
+                *dropped = (refs & DROPPED_REF) != 0;
+            }
+
+            return refs & ~DROPPED_REF;
+        }
+
+        bool is_referenceable() const noexcept {
+            return !(references_.load(std::memory_order_acquire) & DROPPED_REF);
         }
 
-        auto ref() noexcept {
-            return ++references_;
+        // Makes an unreferenced node unreachable for try_ref(),
+        // so that it can be removed from the history.
+        bool seal() noexcept
+        {
+            int64_t refs = references_.load(std::memory_order_acquire);
+            while ((refs & ~DROPPED_REF) == 0)
+            {
+                if (references_.compare_exchange_weak(refs, refs | DROPPED_REF, std::memory_order_acq_rel)) {
+                    return true;
+                }
+            }
+
+            return false;
         }
 
-        auto unref() noexcept {
-            return --references_;
+    private:
+        static int64_t initial_references(Status status) noexcept {
+            return status == Status::DROPPED ? DROPPED_REF : 0;
         }
     };
 
@@ -1103,7 +1162,7 @@ protected:
     	for (const auto& branch: named_branches_)
     	{
     		auto node = branch.second;
-            if (node->root_id().is_null() && node->references() == 0)
+            if (node->root_id().is_null() && node->seal())
     		{
     			do_remove_history_node(node);
     		}
@@ -1124,7 +1183,8 @@ protected:
                 std::cout << "MEMORIA: do_remove_history_node: " << node->snapshot_id() << std::endl;
             }
 
-            delete node;
+            snapshot_map_.erase(node->snapshot_id());
+            self().retire_history_node(node);
 
             return true;
         }
@@ -1139,7 +1199,8 @@ protected:
                 std::cout << "MEMORIA: do_remove_history_node: " << node->snapshot_id() << std::endl;
             }
 
-            delete node;
+            snapshot_map_.erase(node->snapshot_id());
+            self().retire_history_node(node);
 
             parent->children().push_back(child);
             child->parent() = parent;
@@ -1158,17 +1219,17 @@ protected:
             parent = parent->parent();
         }
 
-        if (parent)
+        std::unordered_set<U8String> branch_set_;
+        for (auto& pair: named_branches_)
         {
-            std::unordered_set<U8String> branch_set_;
-            for (auto& pair: named_branches_)
+            if (pair.second == node)
             {
-                if (pair.second == node)
-                {
-                    branch_set_.insert(pair.first);
-                }
+                branch_set_.insert(pair.first);
             }
+        }
 
+        if (parent)
+        {
             for(auto& branch_name: branch_set_)
             {
                 named_branches_[branch_name] = parent;
@@ -1179,6 +1240,12 @@ protected:
                 master_ = parent;
             }
         }
+
+        // Branches of the node are either moved or left dropped
+        for(auto& branch_name: branch_set_)
+        {
+            self().branch_changed(branch_name);
+        }
     }
 
     VoidResult walk_linear_history(
@@ -25,11 +25,14 @@
 #include <memoria/core/memory/memory.hpp>
 
 #include <memoria/store/memory_cow/common/store_base_cow.hpp>
+#include <memoria/store/memory_cow/common/published_map.hpp>
+#include <memoria/store/swmr/common/reader_epochs.hpp>
 
 #include <memoria/store/memory_cow/threads/threads_snapshot_cow_impl.hpp>
 
 #include <memoria/filesystem/path.hpp>
 
+#include <atomic>
 #include <cstdlib>
 #include <memory>
 #include <limits>
@@ -107,6 +110,45 @@ private:
     mutable StoreMutexT store_mutex_;
     
     CountDownLatch<int64_t> active_snapshots_;
+
+    using SnapshotsMap = PublishedMap<SnapshotID, HistoryNode*>;
+    using BranchesMap  = PublishedMap<U8String, HistoryNode*>;
+
+    // Committed snapshots and branch heads for lock-free lookups.
+    // Immutable, replaced by publish_directory() under mutex_. The new
+    // directory shares its maps' parts with the replaced one, except
+    // the parts with changed entries.
+    struct SnapshotDirectory {
+        const typename SnapshotsMap::Root* snapshots{};
+        const typename BranchesMap::Root* branches{};
+        HistoryNode* master{};
+    };
+
+    // Replaced directory, its maps' parts replaced in the new one, and
+    // history nodes removed from the history at the same time. Deleted
+    // when no lookup may still see them. A directory that shares nothing
+    // with the new one owns its maps.
+    struct RetiredSet {
+        uint64_t epoch;
+        const SnapshotDirectory* directory;
+        bool owns_maps;
+        std::vector<const PublishedMapPart*> parts;
+        std::vector<HistoryNode*> nodes;
+    };
+
+    std::atomic<const SnapshotDirectory*> directory_{};
+    std::atomic<uint64_t> epoch_{};
+    SWMRReaderEpochs reader_epochs_;
+
+    // Guarded by mutex_
+    std::vector<HistoryNode*> removed_nodes_;
+    std::vector<RetiredSet> retired_;
+
+    // Entries to update by the next publish_directory(), guarded by
+    // mutex_. The directory is rebuilt if changes are not known.
+    std::unordered_set<SnapshotID> changed_snapshots_;
+    std::unordered_set<U8String> changed_branches_;
+    bool rebuild_directory_{true};
  
 public:
     ThreadsMemoryStoreImpl(MaybeError& maybe_error) noexcept:
@@ -122,6 +164,13 @@ public:
     virtual ~ThreadsMemoryStoreImpl() noexcept
     {
         free_memory(history_tree_);
+
+        destroy_directory(directory_.load());
+        for (auto node: removed_nodes_) {
+            delete node;
+        }
+
+        reclaim(SWMRReaderEpochs::FREE);
     }
 
 
@@ -183,7 +232,11 @@ public:
     Result<void> pack() noexcept
     {
         std::lock_guard<MutexT> lock(mutex_);
-        return do_pack(history_tree_);
+
+        MEMORIA_TRY_VOID(do_pack(history_tree_));
+        publish_directory();
+
+        return VoidResult::of();
     }
 
 
@@ -232,6 +285,8 @@ public:
     {
         LockGuardT lock_guard(mutex_);
         named_branches_.erase(U8String(name));
+        branch_changed(U8String(name));
+        publish_directory();
         return VoidResult::of();
     }
 
@@ -443,6 +498,15 @@ public:
     Result<SnapshotApiPtr> find(const SnapshotID& snapshot_id) noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
+        auto published = ref_published([&](const SnapshotDirectory& directory) -> HistoryNode* {
+            auto node = SnapshotsMap::find(directory.snapshots, snapshot_id);
+            return node ? *node : nullptr;
+        });
+
+        if (published) {
+            return open_published(published);
+        }
+
         LockGuardT lock_guard(mutex_);
 
         auto iter = snapshot_map_.find(snapshot_id);
@@ -475,6 +539,15 @@ public:
     Result<SnapshotApiPtr> find_branch(U8StringRef name) noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
+        auto published = ref_published([&](const SnapshotDirectory& directory) -> HistoryNode* {
+            auto node = BranchesMap::find(directory.branches, name);
+            return node ? *node : nullptr;
+        });
+
+        if (published) {
+            return open_published(published);
+        }
+
         LockGuardT lock_guard(mutex_);
 
     	auto iter = named_branches_.find(name);
@@ -504,6 +577,14 @@ public:
     Result<SnapshotApiPtr> master() noexcept
     {
         //using ResultT = Result<SnapshotApiPtr>;
+        auto published = ref_published([&](const SnapshotDirectory& directory) {
+            return directory.master;
+        });
+
+        if (published) {
+            return open_published(published);
+        }
+
         std::lock(mutex_, master_->snapshot_mutex());
 
     	LockGuardT lock_guard(mutex_, std::adopt_lock);
@@ -547,6 +628,7 @@ public:
             if (history_node->is_committed())
             {
                 master_ = iter->second;
+                publish_directory();
             }
             else if (history_node->is_dropped())
             {
@@ -578,6 +660,8 @@ public:
         	if (history_node->is_committed())
             {
                 named_branches_[name] = history_node;
+                branch_changed(name);
+                publish_directory();
             }
             else {
                 return MEMORIA_MAKE_GENERIC_ERROR("Snapshot {} hasn't been committed yet", txn_id);
@@ -590,6 +674,229 @@ public:
         }
     }
 
+private:
+    // Lock-free lookup of a committed snapshot. The directory and its nodes
+    // are not deleted while the reader is in its epoch, and after that the
+    // reference keeps the snapshot and its blocks. Returns nullptr if the
+    // snapshot is not published or is being dropped, the caller falls back
+    // to locking lookup then.
+    template <typename Fn>
+    HistoryNode* ref_published(Fn&& lookup) noexcept
+    {
+        auto slot = reader_epochs_.enter(epoch_.load());
+        if (!slot.is_ok()) {
+            return nullptr;
+        }
+
+        HistoryNode* history_node{};
+
+        const SnapshotDirectory* directory = directory_.load();
+        if (directory)
+        {
+            history_node = lookup(*directory);
+            if (history_node && !history_node->try_ref()) {
+                history_node = nullptr;
+            }
+        }
+
+        reader_epochs_.leave(slot.get());
+
+        return history_node;
+    }
+
+    Result<SnapshotApiPtr> open_published(HistoryNode* history_node) noexcept
+    {
+        return upcast(snp_make_shared_init<SnapshotT>(
+            history_node, this->shared_from_this(), typename SnapshotT::AdoptReference{}
+        ));
+    }
+
+    // Must be called after the snapshot is committed or dropped
+    void publish_snapshot(const SnapshotID& snapshot_id) noexcept
+    {
+        LockGuardT lock_guard(mutex_);
+
+        snapshot_changed(snapshot_id);
+        publish_directory();
+    }
+
+    // Must be called after committed snapshots or branch heads are changed,
+    // with the changed entries marked by snapshot_changed() and
+    // branch_changed(). Only their buckets are copied to the new directory.
+    void publish_directory() noexcept
+    {
+        LockGuardT lock_guard(mutex_);
+
+        const SnapshotDirectory* current = directory_.load();
+        bool rebuild = rebuild_directory_ || !current;
+
+        const SnapshotDirectory* directory{};
+        std::vector<const PublishedMapPart*> parts;
+
+        try {
+            typename SnapshotsMap::Update snapshots(rebuild ? nullptr : current->snapshots);
+            typename BranchesMap::Update branches(rebuild ? nullptr : current->branches);
+
+            if (rebuild)
+            {
+                for (const auto& entry: snapshot_map_)
+                {
+                    if (is_published(entry.second)) {
+                        snapshots.assign(entry.first, entry.second);
+                    }
+                }
+
+                for (const auto& entry: named_branches_)
+                {
+                    if (is_published(entry.second)) {
+                        branches.assign(entry.first, entry.second);
+                    }
+                }
+            }
+            else {
+                for (const auto& snapshot_id: changed_snapshots_)
+                {
+                    auto ii = snapshot_map_.find(snapshot_id);
+                    if (ii != snapshot_map_.end() && is_published(ii->second)) {
+                        snapshots.assign(snapshot_id, ii->second);
+                    }
+                    else {
+                        snapshots.remove(snapshot_id);
+                    }
+                }
+
+                for (const auto& name: changed_branches_)
+                {
+                    auto ii = named_branches_.find(name);
+                    if (ii != named_branches_.end() && is_published(ii->second)) {
+                        branches.assign(name, ii->second);
+                    }
+                    else {
+                        branches.remove(name);
+                    }
+                }
+            }
+
+            auto new_directory = std::make_unique<SnapshotDirectory>();
+            parts.reserve(snapshots.replaced() + branches.replaced());
+
+            new_directory->snapshots = snapshots.finish(parts);
+            new_directory->branches  = branches.finish(parts);
+
+            if (is_published(master_)) {
+                new_directory->master = master_;
+            }
+
+            directory = new_directory.release();
+        }
+        catch (...) {
+            // Lookups will take locks until the next update
+            parts.clear();
+            rebuild = true;
+        }
+
+        changed_snapshots_.clear();
+        changed_branches_.clear();
+        rebuild_directory_ = !directory;
+
+        const SnapshotDirectory* previous = directory_.exchange(directory);
+
+        // Readers that may see the previous directory have entered
+        // with an epoch not greater than this one.
+        uint64_t epoch = epoch_.fetch_add(1);
+
+        if (previous || removed_nodes_.size())
+        {
+            retired_.push_back(RetiredSet{epoch, previous, rebuild, std::move(parts), std::move(removed_nodes_)});
+            removed_nodes_.clear();
+        }
+
+        reclaim(reader_epochs_.min_epoch());
+    }
+
+    static bool is_published(const HistoryNode* history_node) noexcept {
+        return history_node && history_node->is_committed() && history_node->is_referenceable();
+    }
+
+    void snapshot_changed(const SnapshotID& snapshot_id) noexcept
+    {
+        try {
+            changed_snapshots_.insert(snapshot_id);
+        }
+        catch (...) {
+            rebuild_directory_ = true;
+        }
+    }
+
+    // Also called by adjust_named_references()
+    void branch_changed(const U8String& name) noexcept
+    {
+        try {
+            changed_branches_.insert(name);
+        }
+        catch (...) {
+            rebuild_directory_ = true;
+        }
+    }
+
+    // Called by do_remove_history_node(), the node is
+    // retired when the next directory is published.
+    void retire_history_node(HistoryNode* history_node) noexcept
+    {
+        snapshot_changed(history_node->snapshot_id());
+
+        for (const auto& entry: named_branches_)
+        {
+            if (entry.second == history_node) {
+                branch_changed(entry.first);
+            }
+        }
+
+        removed_nodes_.push_back(history_node);
+    }
+
+    static void destroy_directory(const SnapshotDirectory* directory) noexcept
+    {
+        if (directory)
+        {
+            SnapshotsMap::destroy(directory->snapshots);
+            BranchesMap::destroy(directory->branches);
+            delete directory;
+        }
+    }
+
+    void reclaim(uint64_t min_epoch) noexcept
+    {
+        size_t kept = 0;
+        for (size_t c = 0; c < retired_.size(); c++)
+        {
+            RetiredSet& retired = retired_[c];
+            if (retired.epoch < min_epoch)
+            {
+                if (retired.owns_maps) {
+                    destroy_directory(retired.directory);
+                }
+                else {
+                    delete retired.directory;
+                }
+
+                for (auto part: retired.parts) {
+                    delete part;
+                }
+
+                for (auto node: retired.nodes) {
+                    delete node;
+                }
+            }
+            else {
+                retired_[kept++] = std::move(retired);
+            }
+        }
+
+        retired_.resize(kept);
+    }
+
+public:
     virtual Result<void> walk_containers(ContainerWalker<Profile>* walker, const char* allocator_descr = nullptr) noexcept
     {
         MEMORIA_TRY_VOID(this->build_snapshot_labels_metadata());
@@ -613,6 +920,7 @@ private:
         using ResultT = VoidResult;
 
         MEMORIA_TRY_VOID(do_pack(history_tree_));
+        publish_directory();
 
         records_ = 0;
 
@@ -686,6 +994,31 @@ public:
         return do_store(fileh.get());
     }
 
+    virtual VoidResult store_delta(OutputStreamHandler *output, int64_t wait_duration) noexcept {
+        return MEMORIA_MAKE_GENERIC_ERROR("Delta images are not supported by copy-on-write in-memory store");
+    }
+
+    virtual VoidResult store_delta(U8String file_name, int64_t wait_duration) noexcept {
+        return MEMORIA_MAKE_GENERIC_ERROR("Delta images are not supported by copy-on-write in-memory store");
+    }
+
+    virtual VoidResult start_checkpoint(U8String file_name, bool delta) noexcept {
+        return MEMORIA_MAKE_GENERIC_ERROR("Background checkpoints are not supported by copy-on-write in-memory store");
+    }
+
+    virtual VoidResult wait_checkpoint() noexcept {
+        return VoidResult::of();
+    }
+
+    virtual VoidResult set_block_compression(BlockCodec codec, int32_t level) noexcept
+    {
+        if (codec != BlockCodec::NONE) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Block compression is not supported by copy-on-write in-memory store");
+        }
+
+        return VoidResult::of();
+    }
+
 
     static Result<AllocSharedPtr<IMemoryStore<Profile>>> load(const char* file) noexcept
     {
@@ -870,7 +1203,7 @@ protected:
         {
         	SnapshotLockGuardT lock_guard(node->snapshot_mutex());
 
-            if (node->root_id().is_null() && node->references() == 0 && branches.find(node) == branches.end())
+            if (node->root_id().is_null() && branches.find(node) == branches.end() && node->seal())
         	{
         		remove_node = true;
         	}
@@ -97,28 +97,32 @@ public:
         Base(maybe_error, history_node, history_tree)
     {
     }
+
+    ThreadsSnapshot(MaybeError& maybe_error, HistoryNode* history_node, const PersistentAllocatorPtr& history_tree, typename Base::AdoptReference adopt):
+        Base(maybe_error, history_node, history_tree, adopt)
+    {
+    }
  
     virtual ~ThreadsSnapshot() noexcept
     {
     	bool drop1 = false;
     	bool drop2 = false;
 
-    	{
-    		LockGuardT snapshot_lock_guard(history_node_->snapshot_mutex());
-
-            if (history_node_->unref() == 0 && history_node_->root_id().isSet())
-    		{
-    			if (history_node_->is_active())
-    			{
-    				drop1 = true;
-                    history_tree_raw_->unref_active();
-    			}
-    			else if(history_node_->is_dropped())
-    			{
-    				drop2 = true;
-    			}
-    		}
-    	}
+        // Lock-free, read-only snapshots of the same commit are closed
+        // concurrently. Only one release may see zero with the node dropped.
+        bool dropped = false;
+        if (history_node_->unref(&dropped) == 0 && history_node_->root_id().isSet())
+        {
+            if (dropped)
+            {
+                drop2 = true;
+            }
+            else if (history_node_->is_active())
+            {
+                drop1 = true;
+                history_tree_raw_->unref_active();
+            }
+        }
 
     	if (drop1)
     	{
@@ -155,22 +159,27 @@ public:
 
     VoidResult commit() noexcept
     {
-    	LockGuardT lock_guard(history_node_->snapshot_mutex());
-
-        if (history_node_->is_active())
         {
-            MEMORIA_TRY_VOID(this->flush_open_containers());
+            LockGuardT lock_guard(history_node_->snapshot_mutex());
 
-            history_node_->commit();
-            history_tree_raw_->unref_active();
+            if (history_node_->is_active())
+            {
+                MEMORIA_TRY_VOID(this->flush_open_containers());
 
-            if (history_tree_raw_->is_dump_snapshot_lifecycle()) {
-                std::cout << "MEMORIA: COMMIT snapshot: " << history_node_->snapshot_id() << std::endl;
+                history_node_->commit();
+                history_tree_raw_->unref_active();
+
+                if (history_tree_raw_->is_dump_snapshot_lifecycle()) {
+                    std::cout << "MEMORIA: COMMIT snapshot: " << history_node_->snapshot_id() << std::endl;
+                }
+            }
+            else {
+                return MEMORIA_MAKE_GENERIC_ERROR("Invalid state: {} for snapshot {}", (int32_t)history_node_->status(), uuid());
             }
         }
-        else {
-            return MEMORIA_MAKE_GENERIC_ERROR("Invalid state: {} for snapshot {}", (int32_t)history_node_->status(), uuid());
-        }
+
+        // Store's mutex is taken after snapshot's one is released
+        history_tree_raw_->publish_snapshot(history_node_->snapshot_id());
 
         return Result<void>::of();
     }
@@ -195,6 +204,7 @@ public:
             }
 
             history_node_->mark_to_clear();
+            history_tree_raw_->publish_snapshot(history_node_->snapshot_id());
 
             if (history_tree_raw_->is_dump_snapshot_lifecycle()) {
                 std::cout << "MEMORIA: MARK snapshot DROPPED: " << history_node_->snapshot_id() << std::endl;
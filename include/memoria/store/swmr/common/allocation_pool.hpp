@@ -1,4 +1,3 @@
-
 // Copyright 2020 Victor Smirnov
 //
 // Licensed under the Apache License, Version 2.0 (the "License");
@@ -13,148 +12,277 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#pragma once
+
 #include <memoria/api/allocation_map/allocation_map_api.hpp>
 #include <memoria/core/tools/arena_buffer.hpp>
 
-namespace memoria {
-
+#include <algorithm>
 
+namespace memoria {
 
+// Free extents of a writable commit, per allocation level.
+//
+// Extents of a level are kept sorted by position and are consumed from the
+// front, so blocks allocated one after another (a container being written
+// sequentially) are adjacent in the file. Taking a block is O(1): the front
+// extent is shrunk in place or the level's head is advanced, the buffer is
+// compacted only when most of it has been consumed. When a level runs dry,
+// units of the nearest non-empty level above are split, buddy-style.
 template <typename Profile, int32_t Levels>
 class AllocationPool {
     using AlcMetadata = AllocationMetadata<Profile>;
 
-    ArenaBuffer<AlcMetadata> buffer_;
+    struct Level {
+        ArenaBuffer<AlcMetadata> extents;
+        size_t head{};
+        int64_t total{};
+        bool sorted{true};
+    };
 
-    int64_t totals_[Levels];
-    ArenaBuffer<AlcMetadata> levels_[Levels];
+    // Level-0 range [start, end)
+    struct Range {
+        int64_t start;
+        int64_t end;
 
-public:
-    AllocationPool() noexcept {
-        for (int32_t c = 0; c < Levels; c++) {
-            totals_[c] = 0;
+        bool operator<(const Range& other) const noexcept {
+            return start < other.start;
         }
-    }
+    };
+
+    static constexpr size_t COMPACTION_THRESHOLD = 64;
+
+    Level levels_[Levels];
+
+public:
+    AllocationPool() noexcept {}
 
     void add(const AlcMetadata& meta) noexcept
     {
-        levels_[meta.level()].append_value(meta);
-        totals_[meta.level()] += meta.size();
+        if (meta.size() <= 0) {
+            return;
+        }
+
+        Level& level = levels_[meta.level()];
+
+        if (level.head < level.extents.size())
+        {
+            // ArenaBuffer's head() is the last element
+            AlcMetadata& last = level.extents.head();
+            if (last.position() + last.size() == meta.position())
+            {
+                last = AlcMetadata{last.position(), last.size() + meta.size(), meta.level()};
+                level.total += meta.size();
+                return;
+            }
+            else if (meta.position() < last.position()) {
+                level.sorted = false;
+            }
+        }
+
+        level.extents.append_value(meta);
+        level.total += meta.size();
     }
 
-    Optional<AlcMetadata> allocate_one(int32_t level) noexcept
+    // Adds extents found in the allocation map, skipping units
+    // that overlap with extents already in the pool or with in-flight
+    // ones, taken from the pool but not yet marked in the map. All of
+    // them are free in the allocation map.
+    void add_unreserved(Span<const AlcMetadata> extents, Span<const AlcMetadata> in_flight = {}) noexcept
     {
-        buffer_.clear();
-        allocate(level, 1, buffer_);
+        ArenaBuffer<Range> reserved;
+        for (int32_t ll = 0; ll < Levels; ll++)
+        {
+            const Level& level = levels_[ll];
+            for (size_t c = level.head; c < level.extents.size(); c++)
+            {
+                const AlcMetadata& alc = level.extents[c];
+                reserved.append_value(Range{alc.level0_position(), (alc.position() + alc.size()) << ll});
+            }
+        }
 
-        if (buffer_.size() > 0) {
-            return buffer_.tail();
+        for (const AlcMetadata& alc: in_flight) {
+            reserved.append_value(Range{alc.level0_position(), (alc.position() + alc.size()) << alc.level()});
         }
-        else {
+
+        reserved.sort();
+
+        for (const AlcMetadata& alc: extents)
+        {
+            int32_t ll = alc.level();
+            int64_t pos = alc.position();
+            int64_t end = pos + alc.size();
+
+            Span<const Range> ranges = reserved.span();
+            const Range* rr = std::upper_bound(ranges.begin(), ranges.end(), Range{pos << ll, 0});
+            if (rr != ranges.begin()) {
+                rr--;
+            }
+
+            for (; rr != ranges.end() && pos < end; rr++)
+            {
+                int64_t first = rr->start >> ll;
+                int64_t last  = (rr->end - 1) >> ll;
+
+                if (first >= end) {
+                    break;
+                }
+                else if (last < pos) {
+                    continue;
+                }
+
+                if (first > pos) {
+                    add(AlcMetadata{pos, first - pos, ll});
+                }
+
+                pos = last + 1;
+            }
+
+            if (pos < end) {
+                add(AlcMetadata{pos, end - pos, ll});
+            }
+        }
+    }
+
+    Optional<AlcMetadata> allocate_one(int32_t level) noexcept
+    {
+        if (levels_[level].total == 0 && !split_from_above(level, 1)) {
             return Optional<AlcMetadata>{};
         }
+
+        AlcMetadata alc = take_front(level, 1);
+        return alc;
     }
 
     void allocate(int32_t level, int64_t amount, ArenaBuffer<AlcMetadata>& buffer) noexcept
     {
-        if (totals_[level] < amount)
+        if (available(level) < amount) {
+            return;
+        }
+
+        while (amount > 0)
         {
-            if (!populate_level_from_above(level, amount - totals_[level])) {
-                return;
+            if (levels_[level].total == 0) {
+                split_from_above(level, amount);
             }
+
+            AlcMetadata alc = take_front(level, amount);
+            amount -= alc.size();
+            buffer.append_value(alc);
+        }
+    }
+
+    // Units of the level that can be allocated, including
+    // ones obtainable by splitting the levels above.
+    int64_t available(int32_t level) const noexcept
+    {
+        int64_t sum{};
+        for (int32_t ll = level; ll < Levels; ll++) {
+            sum += levels_[ll].total << (ll - level);
         }
+        return sum;
+    }
 
-        size_t cnt{};
+    // Upper bound of the level's units overlapping with the pool's
+    // extents and with in-flight ones
+    int64_t reserved(int32_t level, Span<const AlcMetadata> in_flight = {}) const noexcept
+    {
         int64_t sum{};
-        for (auto& alc: levels_[level].span())
+        for (int32_t ll = 0; ll < Levels; ll++)
+        {
+            const Level& lvl = levels_[ll];
+            if (ll >= level) {
+                sum += lvl.total << (ll - level);
+            }
+            else {
+                size_t extents = lvl.extents.size() - lvl.head;
+                sum += (lvl.total >> (level - ll)) + 2 * static_cast<int64_t>(extents);
+            }
+        }
+
+        for (const AlcMetadata& alc: in_flight)
         {
-            if (alc.size() + sum <= amount) {
-                sum += alc.size();
-                totals_[level] -= alc.size();
-                cnt++;
-                buffer.append_value(alc);
+            if (alc.level() >= level) {
+                sum += alc.size() << (alc.level() - level);
             }
             else {
-                int64_t remainder = amount - sum;
-                sum = amount;
-                buffer.append_value(alc.take(remainder));
-                totals_[level] -= remainder;
-                break;
+                sum += (alc.size() >> (level - alc.level())) + 2;
             }
         }
 
-        levels_[level].remove(0, cnt);
+        return sum;
     }
 
-    void clear() noexcept {
+    void clear() noexcept
+    {
         for (int32_t ll = 0; ll < Levels; ll++)
         {
-            levels_[ll].clear();
-            totals_[ll].clear();
+            levels_[ll].extents.clear();
+            levels_[ll].head   = 0;
+            levels_[ll].total  = 0;
+            levels_[ll].sorted = true;
         }
     }
 
-    ArenaBuffer<AlcMetadata>& level_buffer(int32_t ll) noexcept {
-        return levels_[ll];
-    }
-
 private:
-    bool populate_level_from_above(int32_t level, int64_t amount) noexcept
+    AlcMetadata take_front(int32_t ll, int64_t amount) noexcept
     {
-        int64_t available{};
-        for (int32_t ll = level + 1; ll < Levels; ll++) {
-            available += totals_[ll] << (ll - level);
+        Level& level = levels_[ll];
+
+        if (!level.sorted)
+        {
+            Span<AlcMetadata> extents = level.extents.span();
+            std::sort(extents.begin() + level.head, extents.end());
+            level.sorted = true;
         }
 
-        if (available >= amount)
+        AlcMetadata& front = level.extents[level.head];
+
+        AlcMetadata alc;
+        if (front.size() > amount)
         {
-            int64_t sum{};
+            alc = AlcMetadata{front.position(), amount, ll};
+            front = AlcMetadata{front.position() + amount, front.size() - amount, ll};
+        }
+        else {
+            alc = front;
+            level.head++;
 
-            for (int32_t ll = level + 1; ll < Levels && sum < amount; ll++)
+            if (level.head == level.extents.size())
             {
-                size_t cc;
-                for (cc = 0; cc < levels_[ll].size(); cc++)
-                {
-                    int64_t ll0_remainder = amount - sum;
-
-                    auto& avl_alc = levels_[ll][cc];
-                    int64_t avl_size = avl_alc.size();
-                    int64_t ll0_avl_size = avl_size << (ll - level);
-
-                    if (ll0_avl_size >= ll0_remainder)
-                    {
-                        totals_[ll] -= avl_alc.size();
-                        levels_[level].append_value(avl_alc.take_all_for(level));
-                        sum += ll0_avl_size;
-                    }
-                    else {
-                        int64_t scale_mask = 1ll << ((ll - level + 1) - 1);
-                        int64_t ll_remainder = (
-                                    (ll0_remainder >> (ll - level)) +
-                                    ((ll0_remainder & scale_mask) != 0)
-                        ) << (ll - level);
-
-                        levels_[level].append_value(avl_alc.take_for(ll_remainder, level));
-
-                        totals_[ll] -= ll_remainder;
-
-                        break;
-                    }
-                }
-
-                if (cc < levels_[ll].size()) {
-                    levels_[ll].remove(0, cc);
-                }
-                else {
-                    levels_[ll].clear();
-                }
+                level.extents.clear();
+                level.head = 0;
+            }
+            else if (level.head >= COMPACTION_THRESHOLD && level.head * 2 >= level.extents.size())
+            {
+                level.extents.remove(0, level.head);
+                level.head = 0;
             }
-
-            return true;
         }
-        else {
-            return false;
+
+        level.total -= alc.size();
+        return alc;
+    }
+
+    // Splits units of the nearest non-empty level above into
+    // units of this level, enough for the amount if possible.
+    bool split_from_above(int32_t level, int64_t amount) noexcept
+    {
+        bool split{};
+
+        for (int32_t ll = level + 1; ll < Levels && levels_[level].total < amount; ll++)
+        {
+            int32_t scale = ll - level;
+            while (levels_[ll].total > 0 && levels_[level].total < amount)
+            {
+                int64_t units = ((amount - levels_[level].total) + (1ll << scale) - 1) >> scale;
+                AlcMetadata alc = take_front(ll, units);
+                add(AlcMetadata{alc.position() << scale, alc.size() << scale, level});
+                split = true;
+            }
         }
+
+        return split;
     }
 };
 
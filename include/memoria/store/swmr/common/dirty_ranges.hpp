@@ -0,0 +1,128 @@
+
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/tools/arena_buffer.hpp>
+#include <memoria/core/tools/span.hpp>
+
+namespace memoria {
+
+// File ranges written by one or more commits, that have to be flushed
+// before the superblock referencing them.
+class DirtyRanges {
+public:
+    struct Range {
+        uint64_t offset;
+        uint64_t size;
+
+        uint64_t end() const noexcept {
+            return offset + size;
+        }
+
+        bool operator<(const Range& other) const noexcept {
+            return offset < other.offset;
+        }
+    };
+
+private:
+    ArenaBuffer<Range> ranges_;
+
+public:
+    DirtyRanges() noexcept {}
+
+    void add(uint64_t offset, uint64_t size) noexcept
+    {
+        // Blocks are mostly allocated sequentially, so it's
+        // worth trying to extend the last range first.
+        if (ranges_.size() > 0 && ranges_.head().end() == offset) {
+            ranges_.head().size += size;
+        }
+        else {
+            ranges_.append_value(Range{offset, size});
+        }
+    }
+
+    void add_all(const DirtyRanges& other) noexcept {
+        ranges_.append_values(other.ranges_.span());
+    }
+
+    void clear() noexcept {
+        ranges_.clear();
+    }
+
+    size_t size() const noexcept {
+        return ranges_.size();
+    }
+
+    bool empty() const noexcept {
+        return ranges_.size() == 0;
+    }
+
+    uint64_t bytes() const noexcept
+    {
+        uint64_t sum = 0;
+        for (const Range& range: ranges_.span()) {
+            sum += range.size;
+        }
+        return sum;
+    }
+
+    Span<const Range> ranges() const noexcept {
+        return ranges_.span();
+    }
+
+    // Rounds ranges to page boundaries, sorts them and merges
+    // overlapping and adjacent ones.
+    void coalesce(uint64_t page_size) noexcept
+    {
+        if (ranges_.size() == 0) {
+            return;
+        }
+
+        for (Range& range: ranges_.span())
+        {
+            uint64_t start = range.offset - range.offset % page_size;
+            uint64_t end   = range.end() + (page_size - range.end() % page_size) % page_size;
+
+            range.offset = start;
+            range.size   = end - start;
+        }
+
+        ranges_.sort();
+
+        size_t last = 0;
+        for (size_t c = 1; c < ranges_.size(); c++)
+        {
+            Range& prev = ranges_[last];
+            const Range& range = ranges_[c];
+
+            if (range.offset <= prev.end())
+            {
+                if (range.end() > prev.end()) {
+                    prev.size = range.end() - prev.offset;
+                }
+            }
+            else {
+                ranges_[++last] = range;
+            }
+        }
+
+        ranges_.remove(last + 1, ranges_.size());
+    }
+};
+
+}
@@ -0,0 +1,207 @@
+
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/core/tools/result.hpp>
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+
+namespace memoria {
+
+// Sequence IDs of commits being read. A reader takes a slot with a lower
+// bound of the head commit's sequence ID *before* it looks at the head,
+// and keeps the slot until the commit is closed. So the writer can find the
+// oldest commit that may still be read without blocking readers: commits
+// older than min_epoch() and blocks they only reference can be reclaimed.
+//
+// Slots are allocated by pages. When all slots are taken, a reader links
+// a new page to the end of the chain, so the number of readers is not
+// limited. Pages are not freed before the object is destroyed.
+class SWMRReaderEpochs {
+public:
+    static constexpr uint64_t FREE = std::numeric_limits<uint64_t>::max();
+
+private:
+    // Slots are written by different threads, so each one
+    // has its own cache line.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{FREE};
+    };
+
+    struct Page {
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<Page*> next{};
+
+        Page(size_t size): slots(new Slot[size]) {}
+    };
+
+    size_t page_size_;
+    Page first_page_;
+
+    // Number of pages linked to the chain, it may lag behind.
+    std::atomic<size_t> pages_{1};
+
+public:
+    SWMRReaderEpochs(size_t page_size = 256):
+        page_size_(page_size),
+        first_page_(page_size)
+    {}
+
+    ~SWMRReaderEpochs() noexcept
+    {
+        Page* page = first_page_.next.load();
+        while (page)
+        {
+            Page* next = page->next.load();
+            delete page;
+            page = next;
+        }
+    }
+
+    size_t page_size() const noexcept {
+        return page_size_;
+    }
+
+    size_t size() const noexcept {
+        return pages_.load() * page_size_;
+    }
+
+    // Seq-cst CAS here and seq-cst loads in min_epoch() pair with the
+    // writer's store of the head commit and the reader's load of it:
+    // either the writer sees the slot or the reader sees the new head.
+    Result<size_t> enter(uint64_t epoch) noexcept
+    {
+        using ResultT = Result<size_t>;
+
+        // Threads start from different slots to avoid CAS contention
+        thread_local size_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+        size_t pages = pages_.load(std::memory_order_acquire);
+        size_t start = hint % (pages * page_size_);
+
+        size_t page_num = start / page_size_;
+        const Page* page = page_at(page_num);
+
+        for (size_t c = 0; c < pages; c++)
+        {
+            for (size_t d = 0; d < page_size_; d++)
+            {
+                size_t idx = (start + d) % page_size_;
+                Slot& slot = page->slots[idx];
+
+                uint64_t expected = FREE;
+                if (slot.epoch.load(std::memory_order_relaxed) == FREE &&
+                        slot.epoch.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst))
+                {
+                    hint = page_num * page_size_ + idx;
+                    return ResultT::of(hint);
+                }
+            }
+
+            page = page->next.load(std::memory_order_acquire);
+            if (++page_num == pages || !page)
+            {
+                page = &first_page_;
+                page_num = 0;
+            }
+        }
+
+        MEMORIA_TRY(slot, add_page(epoch));
+        hint = slot;
+
+        return ResultT::of(slot);
+    }
+
+    // The epoch may only be raised
+    void update(size_t slot, uint64_t epoch) noexcept {
+        slot_at(slot).epoch.store(epoch, std::memory_order_release);
+    }
+
+    void leave(size_t slot) noexcept {
+        slot_at(slot).epoch.store(FREE, std::memory_order_release);
+    }
+
+    // Returns FREE if there are no readers
+    uint64_t min_epoch() const noexcept
+    {
+        uint64_t min = FREE;
+        for (const Page* page = &first_page_; page; page = page->next.load(std::memory_order_seq_cst))
+        {
+            for (size_t c = 0; c < page_size_; c++)
+            {
+                uint64_t epoch = page->slots[c].epoch.load(std::memory_order_seq_cst);
+                if (epoch < min) {
+                    min = epoch;
+                }
+            }
+        }
+
+        return min;
+    }
+
+private:
+    const Page* page_at(size_t page_num) const noexcept
+    {
+        const Page* page = &first_page_;
+        for (size_t c = 0; c < page_num; c++) {
+            page = page->next.load(std::memory_order_acquire);
+        }
+        return page;
+    }
+
+    Slot& slot_at(size_t slot) noexcept {
+        return page_at(slot / page_size_)->slots[slot % page_size_];
+    }
+
+    // The new page's first slot is taken before the page is linked, so
+    // the slot is visible to min_epoch() together with the page.
+    Result<size_t> add_page(uint64_t epoch) noexcept
+    {
+        using ResultT = Result<size_t>;
+
+        Page* new_page = new (std::nothrow) Page(page_size_);
+        if (!new_page) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Can't allocate a page of {} reader slots", page_size_);
+        }
+
+        new_page->slots[0].epoch.store(epoch, std::memory_order_relaxed);
+
+        Page* page = &first_page_;
+        size_t page_num = 0;
+        while (true)
+        {
+            Page* next{};
+            if (page->next.compare_exchange_strong(next, new_page, std::memory_order_seq_cst)) {
+                break;
+            }
+
+            page = next;
+            page_num++;
+        }
+
+        pages_.fetch_add(1, std::memory_order_release);
+
+        return ResultT::of((page_num + 1) * page_size_);
+    }
+};
+
+}
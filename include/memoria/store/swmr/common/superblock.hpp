@@ -19,9 +19,14 @@
 #include <memoria/profiles/common/common.hpp>
 #include <memoria/core/tools/result.hpp>
 #include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/md5.hpp>
+#include <memoria/core/memory/ptr_cast.hpp>
 #include <memoria/core/strings/format.hpp>
 #include <memoria/core/packed/tools/packed_allocator.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 namespace memoria {
 
 template <typename Profile>
@@ -31,8 +36,11 @@ class SWMRSuperblock {
     using CommitID   = int64_t;
     using SequenceID = uint64_t;
 
+    static constexpr const char* MAGIC_PREFIX = "MEMORIA SWMR MAPPED STORE.";
+
     char magic_buffer_[256];
-    char reserved_[4 * 8];
+    char reserved_[3 * 8];
+    uint64_t checksum_;
     SequenceID sequence_id_;
     CommitID commit_id_;
     uint64_t file_size_;
@@ -126,11 +134,28 @@ public:
     VoidResult build_superblock_description() noexcept
     {
         return set_description(
-            "MEMORIA SWMR MAPPED STORE. VERSION:{}; CommitID:{}, SequenceID:{}, SuperblockFilePos:{}, FileSize:{}",
-            0, commit_id_, sequence_id_, superblock_file_pos_, file_size_
+            "{} VERSION:{}; CommitID:{}, SequenceID:{}, SuperblockFilePos:{}, FileSize:{}",
+            MAGIC_PREFIX, 0, commit_id_, sequence_id_, superblock_file_pos_, file_size_
         );
     }
 
+    // Must be called after the last change of the superblock's
+    // fields, before it's written to the file's header.
+    void update_checksum() noexcept {
+        checksum_ = compute_checksum();
+    }
+
+    // Checks the superblock read from the file: it may be
+    // uninitialized or partially written.
+    bool is_valid(uint64_t file_size) const noexcept
+    {
+        return std::strncmp(magic_buffer_, MAGIC_PREFIX, std::strlen(MAGIC_PREFIX)) == 0 &&
+                checksum_ == compute_checksum() &&
+                superblock_size_ >= sizeof(SWMRSuperblock) &&
+                superblock_file_pos_ + superblock_size_ <= file_size &&
+                file_size_ <= file_size;
+    }
+
 
     template <typename... Args>
     VoidResult set_description(const char* fmt, Args&&... args) noexcept
@@ -149,6 +174,32 @@ public:
     }
 
 private:
+    // Covers all fields but the allocator's data
+    uint64_t compute_checksum() const noexcept
+    {
+        const uint8_t* begin = ptr_cast<const uint8_t>(this);
+        const uint8_t* checksum_begin = ptr_cast<const uint8_t>(&checksum_);
+        const uint8_t* checksum_end = checksum_begin + sizeof(checksum_);
+        const uint8_t* end = ptr_cast<const uint8_t>(&allocator_);
+
+        MD5Hash md5;
+        add_to_hash(md5, begin, checksum_begin);
+        add_to_hash(md5, checksum_end, end);
+        md5.compute();
+
+        return md5.result().hash64();
+    }
+
+    static void add_to_hash(MD5Hash& md5, const uint8_t* begin, const uint8_t* end) noexcept
+    {
+        for (const uint8_t* ptr = begin; ptr < end; ptr += sizeof(uint32_t))
+        {
+            uint32_t value{};
+            std::memcpy(&value, ptr, std::min<size_t>(sizeof(uint32_t), end - ptr));
+            md5.add(value);
+        }
+    }
+
     static int32_t allocator_block_size(size_t superblock_size) noexcept
     {
         int32_t sb_size = sizeof(SWMRSuperblock);
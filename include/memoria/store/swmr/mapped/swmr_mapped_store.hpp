@@ -18,6 +18,8 @@
 
 #include <memoria/store/swmr/mapped/swmr_mapped_store_readonly_commit.hpp>
 #include <memoria/store/swmr/mapped/swmr_mapped_store_writable_commit.hpp>
+#include <memoria/store/swmr/common/dirty_ranges.hpp>
+#include <memoria/store/swmr/common/reader_epochs.hpp>
 
 #include <memoria/core/tools/span.hpp>
 #include <memoria/core/memory/ptr_cast.hpp>
@@ -27,8 +29,22 @@
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace memoria {
 
@@ -39,8 +55,18 @@ class MappedSWMRStore: public ISWMRStore<Profile>, public EnableSharedFromThis<M
     using typename Base::ReadOnlyCommitPtr;
     using typename Base::WritableCommitPtr;
     using typename Base::CommitID;
+    using typename Base::SequenceID;
+
+    using CommitDescriptorT   = CommitDescriptor<Profile>;
+    using Superblock          = SWMRSuperblock<Profile>;
+    using ReadOnlyCommit      = MappedSWMRStoreReadOnlyCommit<Profile>;
+    using WritableCommit      = MappedSWMRStoreWritableCommit<Profile>;
+    using AllocationMetadataT = AllocationMetadata<Profile>;
 
-    using CommitDescriptorT = CommitDescriptor<Profile>;
+    struct DeferredDeallocations {
+        SequenceID sequence_id;
+        ArenaBuffer<AllocationMetadataT> allocations;
+    };
 
     static constexpr size_t BASIC_BLOCK_SIZE = 4096;
     static constexpr size_t HEADER_SIZE = BASIC_BLOCK_SIZE * 2;
@@ -48,23 +74,92 @@ class MappedSWMRStore: public ISWMRStore<Profile>, public EnableSharedFromThis<M
     static constexpr int32_t ALLOCATION_MAP_SIZE_STEP = ICtrApi<AllocationMap, Profile>::ALLOCATION_SIZE;
     static constexpr size_t MB = 1024*1024;
 
+    // ALLOCATION_MAP_SIZE_STEP is in basic blocks, the file is
+    // created and grown in multiples of it.
+    static constexpr uint64_t FILE_SIZE_STEP = ALLOCATION_MAP_SIZE_STEP * BASIC_BLOCK_SIZE;
+
+    // Address space reserved for the file mapping, so it can grow
+    // in place. It's just a reservation, no memory is committed.
+    static constexpr uint64_t ADDRESS_SPACE_RESERVE = 1ull << 40;
+
     mutable std::recursive_mutex reader_mutex_;
     mutable std::recursive_mutex writer_mutex_;
 
-    CommitDescriptorT* head_ptr_;
+    // The head commit is changed by the writer only. Readers open it
+    // without locks: head_sequence_id_ is a lower bound of its sequence
+    // ID, used to enter reader_epochs_ before the head is read.
+    std::atomic<CommitDescriptorT*> head_ptr_{};
+    std::atomic<SequenceID> head_sequence_id_{};
+
+    SWMRReaderEpochs reader_epochs_;
+
+    // Guarded by reader_mutex_
     CommitDescriptorsList<Profile> commit_list_;
+    std::unordered_map<CommitID, CommitDescriptorT*> persistent_commits_;
     std::unordered_set<CommitID> removing_persistent_commits_;
 
+    // Former head commits, deleted when no reader can see them
+    std::vector<CommitDescriptorT*> retired_commits_;
+
+    // Immutable copy of persistent_commits_ for lock-free lookups in
+    // open(CommitID). It's replaced by the writer before the head is
+    // changed, and the previous one is retired like a head commit.
+    using PersistentCommitsIndex = std::unordered_map<CommitID, CommitDescriptorT*>;
+
+    struct RetiredIndex {
+        SequenceID sequence_id;
+        const PersistentCommitsIndex* index;
+    };
+
+    std::atomic<const PersistentCommitsIndex*> persistent_index_{};
+    std::vector<RetiredIndex> retired_indexes_;
+
+    // Guarded by writer_mutex_
+    bool writer_active_{false};
+
     template <typename> friend class MappedSWMRStoreReadonlyCommit;
     template <typename> friend class MappedSWMRStoreWritableCommit;
 
     U8String file_name_;
     uint64_t file_size_;
     boost::interprocess::file_mapping file_;
-    boost::interprocess::mapped_region region_;
+
+    // The file is mapped by segments, one per growth step, placed one
+    // after another in the reserved address range. Existing segments
+    // never move, so commits may keep using their buffers while the file
+    // grows. file_size_ and buffer_ are guarded by mapping_mutex_.
+    uint8_t* reserved_address_{};
+    uint64_t reserved_size_{};
+    mutable std::mutex mapping_mutex_;
 
     Span<uint8_t> buffer_;
 
+    // Group commit and async durability state, see SWMRDurability.
+    // Everything below is guarded by durability_mutex_.
+    mutable std::mutex durability_mutex_;
+    std::condition_variable durability_cv_;
+
+    SWMRDurability durability_{SWMRDurability::SYNC};
+
+    Superblock* published_superblock_{};
+    DirtyRanges published_ranges_;
+    SequenceID durable_sequence_id_{};
+    size_t header_slot_{};
+    bool flushing_{false};
+    uint64_t flushes_{};
+
+    // Error of the last flush and the sequence ID it was flushing. Cleared
+    // by the next successful flush, which retries the failed commits.
+    Optional<U8String> flush_error_;
+    SequenceID failed_sequence_id_{};
+
+    std::thread flusher_;
+    bool stop_flusher_{false};
+
+    // Blocks freed by commits that are not durable yet. They are still
+    // referenced from the durable superblock, so can't be reused before.
+    std::vector<DeferredDeallocations> deferred_deallocations_;
+
 public:
     MappedSWMRStore(MaybeError& maybe_error, U8String file_name, uint64_t file_size_mb):
         file_name_(file_name),
@@ -78,104 +173,892 @@ public:
             MEMORIA_TRY_VOID(make_file(file_name, file_size_));
 
             file_ =  boost::interprocess::file_mapping(file_name_.data(), boost::interprocess::read_write);
-            region_ = boost::interprocess::mapped_region(file_, boost::interprocess::read_write, 0, file_size_);
-            buffer_ = Span<uint8_t>(ptr_cast<uint8_t>(region_.get_address()), file_size_);
+
+            MEMORIA_TRY_VOID(reserve_address_space(std::max(file_size_, ADDRESS_SPACE_RESERVE)));
+            MEMORIA_TRY_VOID(map_segment(0, file_size_));
+
+            buffer_ = Span<uint8_t>(reserved_address_, file_size_);
 
             return VoidResult::of();
         });
+    }
+
+    MappedSWMRStore(MaybeError& maybe_error, U8String file_name):
+        file_name_(file_name),
+        file_size_()
+    {
+        wrap_construction(maybe_error, [&]() -> VoidResult {
+            if (!filesystem::exists(file_name.to_std_string())) {
+                return MEMORIA_MAKE_GENERIC_ERROR("Provided file {} does not exist", file_name);
+            }
+
+            file_size_ = filesystem::file_size(file_name.to_std_string());
+            if (file_size_ < HEADER_SIZE) {
+                return MEMORIA_MAKE_GENERIC_ERROR("Provided file {} is too small: {} bytes", file_name, file_size_);
+            }
+
+            file_ =  boost::interprocess::file_mapping(file_name_.data(), boost::interprocess::read_write);
+
+            MEMORIA_TRY_VOID(reserve_address_space(std::max(file_size_, ADDRESS_SPACE_RESERVE)));
+            MEMORIA_TRY_VOID(map_segment(0, file_size_));
 
-        //MappedSWMRStoreReadOnlyCommit<Profile> cm1(maybe_error, this->shared_from_this(), buffer_, nullptr);
-        //MappedSWMRStoreWritableCommit<Profile> cm2(maybe_error, this->shared_from_this(), buffer_, nullptr, nullptr);
+            buffer_ = Span<uint8_t>(reserved_address_, file_size_);
 
-        //MappedSWMRStoreWritableCommit<Profile> cm3(maybe_error, this->shared_from_this(), buffer_, nullptr, InitStoreTag{});
+            return VoidResult::of();
+        });
     }
 
-    MappedSWMRStore(MaybeError& maybe_error, U8String file_name):
-        file_name_(file_name)
+
+    virtual ~MappedSWMRStore() noexcept
+    {
+        stop_flusher();
+        flush().terminate_if_error();
+
+        commit_list_.clear_and_dispose([](CommitDescriptorT* descriptor){
+            delete descriptor;
+        });
+
+        delete persistent_index_.load();
+        for (const RetiredIndex& retired: retired_indexes_) {
+            delete retired.index;
+        }
+
+        // Segments are unmapped together with the reservation
+        if (reserved_address_) {
+            ::munmap(reserved_address_, reserved_size_);
+        }
+    }
+
+    // Must be called once by create_mapped_swmr_store(): the
+    // initial commit needs shared_from_this().
+    VoidResult init_store() noexcept
     {
-//        wrap_construction(maybe_error, [&](){
-//            file_ =  boost::interprocess::file_mapping(file_name_.data(), boost::interprocess::read_write);
-//            region_ = boost::interprocess::mapped_region(file_, boost::interprocess::read_write);
-//            buffer_ = Span<uint8_t>(ptr_cast<uint8_t>(region_.get_address()), file_size);
-//        });
+        MEMORIA_TRY_VOID(acquire_writer());
 
-//        MappedSWMRStoreReadOnlyCommit<Profile> cm1(maybe_error, this->shared_from_this(), buffer_, nullptr);
-//        MappedSWMRStoreWritableCommit<Profile> cm2(maybe_error, this->shared_from_this(), buffer_, nullptr, nullptr);
+        MaybeError maybe_error;
+        auto commit = snp_make_shared<WritableCommit>(
+            maybe_error, this->shared_from_this(), buffer(), new CommitDescriptorT(), InitStoreTag{}
+        );
 
-//        MappedSWMRStoreWritableCommit<Profile> cm3(maybe_error, this->shared_from_this(), buffer_, nullptr, InitStoreTag{});
+        if (maybe_error) {
+            return std::move(maybe_error.get());
+        }
+
+        return commit->finish_store_initialization();
     }
 
+    // Must be called once by open_mapped_swmr_store(). The header slot
+    // with the latest valid superblock points to the head commit,
+    // persistent commits are listed in its history.
+    VoidResult recover() noexcept
+    {
+        const Superblock* header{};
+        for (size_t slot = 0; slot < HEADER_SIZE / BASIC_BLOCK_SIZE; slot++)
+        {
+            const Superblock* candidate = ptr_cast<const Superblock>(buffer_.data() + slot * BASIC_BLOCK_SIZE);
+            if (candidate->is_valid(file_size_) && (!header || candidate->sequence_id() > header->sequence_id()))
+            {
+                header = candidate;
+                header_slot_ = slot;
+            }
+        }
+
+        if (!header) {
+            return MEMORIA_MAKE_GENERIC_ERROR("No valid superblock found in the file {}", file_name_);
+        }
+
+        Superblock* head_sb = ptr_cast<Superblock>(buffer_.data() + header->superblock_file_pos());
+        if (!head_sb->is_valid(file_size_) || head_sb->sequence_id() != header->sequence_id()) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Superblock of the head commit {} is corrupted", header->commit_id());
+        }
+
+        durable_sequence_id_ = head_sb->sequence_id();
+
+        CommitDescriptorT* head_descriptor = new CommitDescriptorT(head_sb);
+        commit_list_.push_back(*head_descriptor);
+        set_head(head_descriptor);
+
+        MEMORIA_TRY(head, open_head_commit());
+
+        MEMORIA_TRY_VOID(head->for_each_history_entry([&](CommitID commit_id, uint64_t sb_pos, bool persistent) -> VoidResult {
+            if (persistent)
+            {
+                Superblock* sb = ptr_cast<Superblock>(buffer_.data() + sb_pos);
+                if (!sb->is_valid(file_size_) || sb->commit_id() != commit_id) {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Superblock of the persistent commit {} is corrupted", commit_id);
+                }
+
+                CommitDescriptorT* descriptor;
+                if (commit_id == head_sb->commit_id()) {
+                    descriptor = head_descriptor;
+                }
+                else {
+                    descriptor = new CommitDescriptorT(sb);
+                    commit_list_.push_back(*descriptor);
+                }
+
+                descriptor->set_persistent(true);
+                persistent_commits_[commit_id] = descriptor;
+            }
+
+            return VoidResult::of();
+        }));
+
+        publish_persistent_commits();
+
+        return VoidResult::of();
+    }
 
     virtual Result<std::vector<CommitID>> persistent_commits() noexcept
     {
         using ResultT = Result<std::vector<CommitID>>;
-        return ResultT::of();
+
+        std::vector<CommitID> commits;
+        {
+            std::lock_guard<std::recursive_mutex> lk(reader_mutex_);
+            for (const auto& entry: persistent_commits_) {
+                commits.push_back(entry.first);
+            }
+        }
+
+        std::sort(commits.begin(), commits.end());
+
+        return ResultT::of(std::move(commits));
     }
 
     virtual Result<ReadOnlyCommitPtr> open(CommitID commit_id) noexcept
     {
         using ResultT = Result<ReadOnlyCommitPtr>;
-        return ResultT::of();
+
+        // Like open(), the epoch protects the head descriptor and the
+        // persistent commits index loaded after it. Persistent commits
+        // are not reclaimed, so the epoch is raised for the head only.
+        MEMORIA_TRY(slot, reader_epochs_.enter(head_sequence_id_.load()));
+
+        CommitDescriptorT* descriptor = head_ptr_.load();
+        if (descriptor && descriptor->superblock()->commit_id() == commit_id) {
+            reader_epochs_.update(slot, descriptor->sequence_id());
+        }
+        else {
+            descriptor = find_persistent(commit_id);
+            if (!descriptor)
+            {
+                reader_epochs_.leave(slot);
+                return MEMORIA_MAKE_GENERIC_ERROR("Commit {} is not found or is not persistent", commit_id);
+            }
+        }
+
+        MEMORIA_TRY(commit, open_readonly(descriptor, slot));
+        return ResultT::of(std::move(commit));
     }
 
     virtual Result<ReadOnlyCommitPtr> open() noexcept
     {
         using ResultT = Result<ReadOnlyCommitPtr>;
-        return ResultT::of();
+
+        // The head may change after head_sequence_id_ is read, so the
+        // epoch is raised to the head's one after it's loaded.
+        MEMORIA_TRY(slot, reader_epochs_.enter(head_sequence_id_.load()));
+
+        CommitDescriptorT* descriptor = head_ptr_.load();
+        if (!descriptor)
+        {
+            reader_epochs_.leave(slot);
+            return MEMORIA_MAKE_GENERIC_ERROR("Store {} has no commits", file_name_);
+        }
+
+        reader_epochs_.update(slot, descriptor->sequence_id());
+
+        MEMORIA_TRY(commit, open_readonly(descriptor, slot));
+        return ResultT::of(std::move(commit));
     }
 
     virtual BoolResult drop_persistent_commit(CommitID commit_id) noexcept {
         return BoolResult::of();
     }
 
-    virtual VoidResult rollback_last_commit() noexcept {
-        return VoidResult::of();
+    // Makes the parent of the head commit the head again. Blocks of the
+    // rolled back commit may be reused by the next commits, so read-only
+    // commits opened on it must be closed before.
+    virtual VoidResult rollback_last_commit() noexcept
+    {
+        MEMORIA_TRY_VOID(acquire_writer());
+
+        auto res = rollback_head();
+        release_writer();
+
+        return res;
     }
 
+    // Only one writable commit may be active at a time, begin() fails
+    // if there is one.
     virtual Result<WritableCommitPtr> begin() noexcept
     {
         using ResultT = Result<WritableCommitPtr>;
-        return ResultT::of();
+
+        MEMORIA_TRY_VOID(acquire_writer());
+
+        // Only the writer changes the head
+        CommitDescriptorT* head = head_ptr_.load();
+        auto slot = reader_epochs_.enter(head->sequence_id());
+        if (slot.is_error())
+        {
+            release_writer();
+            return std::move(slot).transfer_error();
+        }
+
+        // On failure the commit releases the writer, the epoch
+        // slot and the descriptor in its destructor.
+        MaybeError maybe_error;
+        auto commit = snp_make_shared<WritableCommit>(
+            maybe_error, this->shared_from_this(), buffer(), head, slot.get(), new CommitDescriptorT()
+        );
+
+        if (maybe_error) {
+            return std::move(maybe_error.get());
+        }
+
+        return ResultT::of(std::move(commit));
     }
 
-    virtual VoidResult close() noexcept {
+    virtual VoidResult close() noexcept
+    {
+        stop_flusher();
+        MEMORIA_TRY_VOID(flush());
         return VoidResult::of();
     }
 
-    static void init_profile_metadata() noexcept {
+    virtual VoidResult set_durability(SWMRDurability durability) noexcept
+    {
+        // Commits of the previous mode are flushed with its rules
+        stop_flusher();
+        MEMORIA_TRY_VOID(flush());
+
+        {
+            std::lock_guard<std::mutex> lk(durability_mutex_);
+            durability_ = durability;
+        }
+
+        if (durability == SWMRDurability::ASYNC) {
+            return start_flusher();
+        }
 
+        return VoidResult::of();
+    }
+
+    virtual SWMRDurability durability() noexcept
+    {
+        std::lock_guard<std::mutex> lk(durability_mutex_);
+        return durability_;
+    }
+
+    virtual SequenceID durable_sequence_id() noexcept
+    {
+        std::lock_guard<std::mutex> lk(durability_mutex_);
+        return durable_sequence_id_;
+    }
+
+    virtual Result<SequenceID> flush() noexcept
+    {
+        using ResultT = Result<SequenceID>;
+
+        SequenceID sequence_id;
+        {
+            std::lock_guard<std::mutex> lk(durability_mutex_);
+            sequence_id = published_superblock_ ? published_superblock_->sequence_id() : durable_sequence_id_;
+        }
+
+        MEMORIA_TRY_VOID(wait_durable(sequence_id));
+        return ResultT::of(sequence_id);
+    }
+
+    // Group commit: the first waiter that finds no flush in progress
+    // becomes the leader and flushes everything published so far, the
+    // others wait for it. Commits published during the flush are
+    // batched into the next one. Waiters of a failed flush get its
+    // error, the next wait for them flushes again.
+    virtual VoidResult wait_durable(SequenceID sequence_id) noexcept
+    {
+        std::unique_lock<std::mutex> lk(durability_mutex_);
+
+        while (durable_sequence_id_ < sequence_id)
+        {
+            if (flushing_)
+            {
+                uint64_t flushes = flushes_;
+                while (flushes_ == flushes) {
+                    durability_cv_.wait(lk);
+                }
+
+                if (flush_error_ && failed_sequence_id_ >= sequence_id) {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Commit data flush failed: {}", flush_error_.get());
+                }
+            }
+            else if (published_superblock_ && published_superblock_->sequence_id() >= sequence_id) {
+                MEMORIA_TRY_VOID(flush_published(lk));
+            }
+            else {
+                return MEMORIA_MAKE_GENERIC_ERROR("Commit with sequence ID {} has not been published yet", sequence_id);
+            }
+        }
+
+        return VoidResult::of();
+    }
+
+    // Called by the writable commit when its data and superblock are
+    // complete, with file ranges the commit has written. In SYNC mode the
+    // superblock is written to the header here. Otherwise it's written
+    // by the group commit leader or by the flusher, after the commit
+    // has released the writer. Returns the mode the commit is published
+    // with, GROUP commits wait_durable() after finish_commit().
+    Result<SWMRDurability> publish_commit(Superblock* superblock, const DirtyRanges& dirty_ranges) noexcept
+    {
+        using ResultT = Result<SWMRDurability>;
+
+        SWMRDurability durability;
+        {
+            std::lock_guard<std::mutex> lk(durability_mutex_);
+            published_superblock_ = superblock;
+            published_ranges_.add_all(dirty_ranges);
+            durability = durability_;
+        }
+
+        if (durability == SWMRDurability::ASYNC) {
+            durability_cv_.notify_all();
+        }
+        else if (durability == SWMRDurability::SYNC) {
+            MEMORIA_TRY_VOID(wait_durable(superblock->sequence_id()));
+        }
+
+        return ResultT::of(durability);
+    }
+
+    void defer_deallocations(SequenceID sequence_id, Span<const AllocationMetadataT> allocations) noexcept
+    {
+        std::lock_guard<std::mutex> lk(durability_mutex_);
+
+        deferred_deallocations_.emplace_back();
+        deferred_deallocations_.back().sequence_id = sequence_id;
+        deferred_deallocations_.back().allocations.append_values(allocations);
+    }
+
+    // Moves deallocations of the commits that are durable now, and which
+    // parents are not read anymore, to the buffer.
+    void take_reclaimable_deallocations(ArenaBuffer<AllocationMetadataT>& buffer) noexcept
+    {
+        SequenceID min_epoch = reader_epochs_.min_epoch();
+
+        std::lock_guard<std::mutex> lk(durability_mutex_);
+
+        size_t cnt = 0;
+        for (; cnt < deferred_deallocations_.size(); cnt++)
+        {
+            auto& entry = deferred_deallocations_[cnt];
+            if (entry.sequence_id <= durable_sequence_id_ && entry.sequence_id <= min_epoch) {
+                buffer.append_values(entry.allocations.span());
+            }
+            else {
+                break;
+            }
+        }
+
+        deferred_deallocations_.erase(deferred_deallocations_.begin(), deferred_deallocations_.begin() + cnt);
+    }
+
+    // System containers are created by their type declarations,
+    // so their factories must be registered.
+    static void init_profile_metadata() noexcept
+    {
+        ICtrApi<Map<ProfileCtrID<Profile>, ProfileBlockID<Profile>>, Profile>::init_profile_metadata();
+        ICtrApi<Map<BigInt, BigInt>, Profile>::init_profile_metadata();
+        ICtrApi<AllocationMap, Profile>::init_profile_metadata();
     }
 
     VoidResult flush_data() noexcept
     {
-        if (!region_.flush(HEADER_SIZE, buffer_.size() - HEADER_SIZE, false)) {
+        if (!flush_mapped(HEADER_SIZE, file_size() - HEADER_SIZE)) {
+            return make_generic_error("DataFlush operation failed");
+        }
+
+        return VoidResult::of();
+    }
+
+    // Flushes only the given (coalesced) ranges. Every synchronous
+    // msync() is a device cache flush, so one per extent is much
+    // slower than a full flush. Instead, writeback is started for each
+    // extent and then waited for by a single fdatasync(). Without
+    // sync_file_range() it's one msync() over the span of the ranges.
+    VoidResult flush_data(const DirtyRanges& ranges) noexcept
+    {
+        auto extents = ranges.ranges();
+        if (extents.size() == 0) {
+            return VoidResult::of();
+        }
+
+#ifdef __linux__
+        int fd = file_.get_mapping_handle().handle;
+
+        for (const auto& extent: extents)
+        {
+            if (::sync_file_range(fd, extent.offset, extent.size, SYNC_FILE_RANGE_WRITE)) {
+                return make_generic_error("DataFlush operation failed for range {}:{}: {}", extent.offset, extent.size, std::strerror(errno));
+            }
+        }
+
+        if (::fdatasync(fd)) {
+            return make_generic_error("DataFlush operation failed: {}", std::strerror(errno));
+        }
+#else
+        uint64_t start = extents[0].offset;
+        uint64_t end   = extents[extents.size() - 1].end();
+
+        if (!flush_mapped(start, end - start)) {
             return make_generic_error("DataFlush operation failed");
         }
+#endif
 
         return VoidResult::of();
     }
 
     VoidResult flush_header() noexcept
     {
-        if (!region_.flush(0, HEADER_SIZE, false)) {
+        if (!flush_mapped(0, HEADER_SIZE)) {
             return make_generic_error("HeaderFlush operation failed");
         }
         return VoidResult::of();
     }
 
+    // Called by the writable commit after publish_commit(): the
+    // commit becomes the head one.
+    void finish_commit(CommitDescriptorT* descriptor, bool persistent) noexcept
+    {
+        CommitDescriptorT* prev_head;
+        {
+            std::lock_guard<std::recursive_mutex> lk(reader_mutex_);
+
+            commit_list_.push_back(*descriptor);
+
+            if (persistent)
+            {
+                descriptor->set_persistent(true);
+                persistent_commits_[descriptor->superblock()->commit_id()] = descriptor;
+                publish_persistent_commits();
+            }
+
+            prev_head = head_ptr_.load();
+            set_head(descriptor);
+
+            if (prev_head && !prev_head->is_persistent()) {
+                retired_commits_.push_back(prev_head);
+            }
+
+            reclaim_retired_commits();
+        }
+
+        release_writer();
+    }
+
+    // Called by the writable commit on rollback
+    void abort_commit(CommitDescriptorT* descriptor) noexcept
+    {
+        delete descriptor;
+        release_writer();
+    }
+
+    // Called by read-only commits on destruction
+    void close_readonly(size_t reader_slot) noexcept {
+        reader_epochs_.leave(reader_slot);
+    }
+
+    Span<uint8_t> buffer() const noexcept
+    {
+        std::lock_guard<std::mutex> lk(mapping_mutex_);
+        return buffer_;
+    }
+
+    uint64_t file_size() const noexcept
+    {
+        std::lock_guard<std::mutex> lk(mapping_mutex_);
+        return file_size_;
+    }
+
+    // Called by the writer when the allocation map is out of space.
+    // Extends the file by at least min_increment bytes, rounded up to
+    // FILE_SIZE_STEP, and maps the new part right after the
+    // existing ones. Returns the new buffer, covering the whole file.
+    Result<Span<uint8_t>> grow_file(uint64_t min_increment) noexcept
+    {
+        using ResultT = Result<Span<uint8_t>>;
+
+        std::lock_guard<std::mutex> lk(mapping_mutex_);
+
+        uint64_t increment = divUp(min_increment, FILE_SIZE_STEP) * FILE_SIZE_STEP;
+        uint64_t new_file_size = file_size_ + increment;
+
+        if (new_file_size > reserved_size_) {
+            return MEMORIA_MAKE_GENERIC_ERROR(
+                "Can't grow file {} to {} bytes, only {} bytes of address space is reserved",
+                file_name_, new_file_size, reserved_size_
+            );
+        }
+
+        MEMORIA_TRY_VOID(make_file(file_name_, new_file_size));
+        MEMORIA_TRY_VOID(map_segment(file_size_, increment));
+
+        file_size_ = new_file_size;
+        buffer_ = Span<uint8_t>(reserved_address_, file_size_);
+
+        return ResultT::of(buffer_);
+    }
+
 
 private:
 
+    VoidResult acquire_writer() noexcept
+    {
+        std::lock_guard<std::recursive_mutex> lk(writer_mutex_);
+
+        if (writer_active_) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Another writable commit is active in the store {}", file_name_);
+        }
+
+        writer_active_ = true;
+        return VoidResult::of();
+    }
+
+    void release_writer() noexcept
+    {
+        std::lock_guard<std::recursive_mutex> lk(writer_mutex_);
+        writer_active_ = false;
+    }
+
+    // The commit takes the reader's epoch slot
+    Result<SnpSharedPtr<ReadOnlyCommit>> open_readonly(CommitDescriptorT* descriptor, size_t reader_slot) noexcept
+    {
+        using ResultT = Result<SnpSharedPtr<ReadOnlyCommit>>;
+
+        MaybeError maybe_error;
+        auto commit = snp_make_shared<ReadOnlyCommit>(
+            maybe_error, this->shared_from_this(), buffer(), descriptor, reader_slot
+        );
+
+        if (maybe_error) {
+            return std::move(maybe_error.get());
+        }
+
+        return ResultT::of(std::move(commit));
+    }
+
+    // Head commit's descriptor must be set up, the writer must be
+    // acquired or the store must not be shared yet.
+    Result<SnpSharedPtr<ReadOnlyCommit>> open_head_commit() noexcept
+    {
+        CommitDescriptorT* head = head_ptr_.load();
+        MEMORIA_TRY(slot, reader_epochs_.enter(head->sequence_id()));
+        return open_readonly(head, slot);
+    }
+
+    // Publishes the new head for readers: the head pointer first, so
+    // head_sequence_id_ is never greater than the head's sequence ID.
+    void set_head(CommitDescriptorT* descriptor) noexcept
+    {
+        head_ptr_.store(descriptor);
+        head_sequence_id_.store(descriptor->sequence_id());
+    }
+
+    // Must be called with reader_mutex_ held, before the new head is set.
+    // Copy failures are fatal, like other allocation failures of the writer.
+    void publish_persistent_commits() noexcept
+    {
+        const PersistentCommitsIndex* prev = persistent_index_.exchange(new PersistentCommitsIndex(persistent_commits_));
+
+        // Readers that have loaded it have an epoch not greater than
+        // the current head's sequence ID.
+        if (prev) {
+            retired_indexes_.push_back(RetiredIndex{head_sequence_id_.load(), prev});
+        }
+    }
+
+    // The caller must be in its reader epoch
+    CommitDescriptorT* find_persistent(CommitID commit_id) const noexcept
+    {
+        const PersistentCommitsIndex* index = persistent_index_.load();
+        if (index)
+        {
+            auto ii = index->find(commit_id);
+            if (ii != index->end()) {
+                return ii->second;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Must be called with reader_mutex_ held, after the new head is set.
+    // A reader with an epoch less than or equal to the retired commit's
+    // sequence ID may have loaded it, see SWMRReaderEpochs.
+    void reclaim_retired_commits() noexcept
+    {
+        if (retired_commits_.size() > 0 || retired_indexes_.size() > 0)
+        {
+            SequenceID min_epoch = reader_epochs_.min_epoch();
+
+            size_t idx_cnt = 0;
+            for (const RetiredIndex& retired: retired_indexes_)
+            {
+                if (retired.sequence_id < min_epoch) {
+                    delete retired.index;
+                }
+                else {
+                    retired_indexes_[idx_cnt++] = retired;
+                }
+            }
+
+            retired_indexes_.resize(idx_cnt);
+
+            size_t cnt = 0;
+            for (CommitDescriptorT* descriptor: retired_commits_)
+            {
+                if (descriptor->sequence_id() < min_epoch)
+                {
+                    commit_list_.erase(commit_list_.iterator_to(*descriptor));
+                    delete descriptor;
+                }
+                else {
+                    retired_commits_[cnt++] = descriptor;
+                }
+            }
+
+            retired_commits_.resize(cnt);
+        }
+    }
+
+    // The parent's superblock is published again with the next sequence ID,
+    // so it becomes the latest one in the header.
+    VoidResult rollback_head() noexcept
+    {
+        MEMORIA_TRY_VOID(flush());
+
+        CommitDescriptorT* head = head_ptr_.load();
+        Superblock* head_sb = head->superblock();
+
+        MEMORIA_TRY(head_commit, open_head_commit());
+        MEMORIA_TRY(parent_sb_pos, head_commit->find_history_entry(head_sb->commit_id() - 1));
+
+        if (!parent_sb_pos) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Commit {} has no parent to roll back to", head_sb->commit_id());
+        }
+
+        Superblock* parent_sb = ptr_cast<Superblock>(buffer_.data() + parent_sb_pos.get());
+        if (!parent_sb->is_valid(file_size())) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Superblock of the commit {} is corrupted", head_sb->commit_id() - 1);
+        }
+
+        parent_sb->sequence_id() = head_sb->sequence_id() + 1;
+        MEMORIA_TRY_VOID(parent_sb->build_superblock_description());
+        parent_sb->update_checksum();
+
+        {
+            // Blocks released by the head commit are referenced by the parent
+            std::lock_guard<std::mutex> lk(durability_mutex_);
+            while (deferred_deallocations_.size() > 0 && deferred_deallocations_.back().sequence_id >= head_sb->sequence_id()) {
+                deferred_deallocations_.pop_back();
+            }
+        }
+
+        DirtyRanges ranges;
+        ranges.add(parent_sb_pos.get(), parent_sb->superblock_size());
+
+        MEMORIA_TRY_VOID(publish_commit(parent_sb, ranges));
+        MEMORIA_TRY_VOID(wait_durable(parent_sb->sequence_id()));
+
+        {
+            std::lock_guard<std::recursive_mutex> lk(reader_mutex_);
+
+            // Readers that see the new head must not find the rolled
+            // back commit in the index
+            if (head->is_persistent())
+            {
+                persistent_commits_.erase(head_sb->commit_id());
+                head->set_persistent(false);
+                publish_persistent_commits();
+            }
+
+            auto ii = persistent_commits_.find(parent_sb->commit_id());
+            if (ii != persistent_commits_.end()) {
+                set_head(ii->second);
+            }
+            else {
+                CommitDescriptorT* descriptor = new CommitDescriptorT(parent_sb);
+                commit_list_.push_back(*descriptor);
+                set_head(descriptor);
+            }
+
+            retired_commits_.push_back(head);
+            reclaim_retired_commits();
+        }
+
+        return VoidResult::of();
+    }
+
+    VoidResult reserve_address_space(uint64_t size) noexcept
+    {
+        void* addr = ::mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            return MEMORIA_MAKE_GENERIC_ERROR("Can't reserve {} bytes of address space: {}", size, std::strerror(errno));
+        }
+
+        reserved_address_ = ptr_cast<uint8_t>(addr);
+        reserved_size_    = size;
+
+        return VoidResult::of();
+    }
+
+    // Maps the file range over the reserved address range at the same offset.
+    // Raw mmap() is used here instead of mapped_region, because the latter
+    // unmaps its range on destruction, leaving a hole in the reservation.
+    VoidResult map_segment(uint64_t offset, uint64_t size) noexcept
+    {
+        void* addr = ::mmap(
+            reserved_address_ + offset, size,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+            file_.get_mapping_handle().handle, offset
+        );
+
+        if (addr == MAP_FAILED) {
+            return MEMORIA_MAKE_GENERIC_ERROR(
+                "Can't map {} bytes of file {} at offset {}: {}",
+                size, file_name_, offset, std::strerror(errno)
+            );
+        }
+
+        return VoidResult::of();
+    }
+
+    // Segments are adjacent, so the range may span several of them.
+    bool flush_mapped(uint64_t offset, uint64_t size) noexcept
+    {
+        uint64_t page_offset = offset % BASIC_BLOCK_SIZE;
+        return ::msync(reserved_address_ + offset - page_offset, size + page_offset, MS_SYNC) == 0;
+    }
+
+    // Must be called with durability_mutex_ held. The lock is released for
+    // the time of I/O.
+    VoidResult flush_published(std::unique_lock<std::mutex>& lk) noexcept
+    {
+        Superblock* superblock = published_superblock_;
+        DirtyRanges ranges;
+        ranges.add_all(published_ranges_);
+        published_ranges_.clear();
+
+        // Never overwrite the slot with the latest durable superblock
+        size_t slot = 1 - header_slot_;
+        flushing_ = true;
+
+        lk.unlock();
+
+        ranges.coalesce(BASIC_BLOCK_SIZE);
+        auto res = write_superblock(superblock, slot, ranges);
+
+        lk.lock();
+
+        flushing_ = false;
+        flushes_++;
+
+        if (res.is_ok())
+        {
+            durable_sequence_id_ = superblock->sequence_id();
+            header_slot_ = slot;
+            flush_error_ = Optional<U8String>{};
+        }
+        else {
+            // Data of the commits is still in the mapping, so the ranges
+            // are flushed again by the next attempt
+            published_ranges_.add_all(ranges);
+            flush_error_ = res.memoria_error()->what();
+            failed_sequence_id_ = superblock->sequence_id();
+        }
+
+        durability_cv_.notify_all();
+
+        return res;
+    }
+
+    VoidResult write_superblock(const Superblock* superblock, size_t slot, const DirtyRanges& ranges) noexcept
+    {
+        MEMORIA_TRY_VOID(flush_data(ranges));
+
+        std::memcpy(reserved_address_ + slot * BASIC_BLOCK_SIZE, superblock, BASIC_BLOCK_SIZE);
+
+        return flush_header();
+    }
+
+    bool has_unflushed_commits() const noexcept {
+        return published_superblock_ && published_superblock_->sequence_id() > durable_sequence_id_;
+    }
+
+    VoidResult start_flusher() noexcept
+    {
+        return wrap_throwing([&](){
+            flusher_ = std::thread([this](){
+                flusher_loop();
+            });
+        });
+    }
+
+    void stop_flusher() noexcept
+    {
+        if (flusher_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lk(durability_mutex_);
+                stop_flusher_ = true;
+            }
+
+            durability_cv_.notify_all();
+            flusher_.join();
+
+            stop_flusher_ = false;
+        }
+    }
+
+    // ASYNC mode: flushes as soon as there is something to flush, so
+    // commits published during a flush are batched into the next one.
+    // Errors are reported to waiters via flush_error_. After a failed
+    // flush, the next attempt is made for a new commit or by a waiter.
+    void flusher_loop() noexcept
+    {
+        std::unique_lock<std::mutex> lk(durability_mutex_);
+
+        while (!stop_flusher_)
+        {
+            if (!flushing_ && has_unflushed_commits() && (!flush_error_ || published_superblock_->sequence_id() > failed_sequence_id_)) {
+                auto res = flush_published(lk);
+                (void)res;
+            }
+            else {
+                durability_cv_.wait(lk);
+            }
+        }
+    }
+
     static uint64_t compute_file_size(uint64_t file_size_mb) noexcept
     {
-        uint64_t allocation_size_mb = ALLOCATION_MAP_SIZE_STEP / MB;
-        return (file_size_mb / allocation_size_mb) * allocation_size_mb * MB;
+        uint64_t file_size = (file_size_mb * MB / FILE_SIZE_STEP) * FILE_SIZE_STEP;
+        return std::max(file_size, FILE_SIZE_STEP);
     }
 
     static VoidResult make_file(const U8String& name, uint64_t file_size) noexcept {
         return wrap_throwing([&](){
             std::filebuf fbuf;
-            fbuf.open(name.to_std_string(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            // Opening in 'in | out' mode doesn't create the file, but keeps
+            // its content when the file is grown.
+            auto mode = std::ios_base::out | std::ios_base::binary;
+            if (filesystem::exists(name.to_std_string())) {
+                mode |= std::ios_base::in;
+            }
+
+            fbuf.open(name.to_std_string(), mode);
             //Set the size
             fbuf.pubseekoff(file_size - 1, std::ios_base::beg);
             fbuf.sputc(0);
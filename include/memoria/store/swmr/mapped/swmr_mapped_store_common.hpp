@@ -46,18 +46,27 @@ constexpr UUID HistoryCtrID = UUID(6072171355687536395ull, 10396296713479379631u
 
 template <typename Profile> class MappedSWMRStore;
 
+// Descriptors of the head commit and of persistent commits are kept by
+// the store. Other ones are retired when a new head is published, and
+// deleted when no reader may see them, see SWMRReaderEpochs.
 template <typename Profile>
 class CommitDescriptor: public boost::intrusive::list_base_hook<> {
     using Superblock = SWMRSuperblock<Profile>;
     using BlockID = ProfileBlockID<Profile>;
+    using SequenceID = uint64_t;
 
     std::atomic<int32_t> uses_{1};
     Superblock* superblock_;
+    bool persistent_{false};
 public:
     CommitDescriptor() noexcept:
         superblock_(nullptr)
     {}
 
+    CommitDescriptor(Superblock* superblock) noexcept:
+        superblock_(superblock)
+    {}
+
     Superblock* superblock() noexcept {
         return superblock_;
     }
@@ -65,6 +74,18 @@ public:
     void set_superblock(Superblock* superblock) noexcept {
         superblock_ = superblock;
     }
+
+    bool is_persistent() const noexcept {
+        return persistent_;
+    }
+
+    void set_persistent(bool persistent) noexcept {
+        persistent_ = persistent;
+    }
+
+    SequenceID sequence_id() const noexcept {
+        return superblock_->sequence_id();
+    }
 };
 
 template <typename Profile>
@@ -170,33 +191,29 @@ public:
         return MEMORIA_MAKE_GENERIC_ERROR("setRoot() is not implemented for ReadOnly commits");
     }
 
+    // System containers are created before the directory
     virtual BoolResult hasRoot(const CtrID& ctr_id) noexcept
     {
-        if (ctr_id != DirectoryCtrID)
-        {
-            MEMORIA_TRY(iter, directory_ctr_->find(ctr_id));
-
-            if (iter->is_found(ctr_id))
-            {
-                return BoolResult::of(true);
-            }
-        }
-        else {
-            return BoolResult::of(true);
-        }
-
-        return BoolResult::of(false);
+        MEMORIA_TRY(root_id, getRootID(ctr_id));
+        return BoolResult::of(root_id.is_set());
     }
 
     virtual Result<CtrID> createCtrName() noexcept {
         return Result<CtrID>::of(ProfileTraits<Profile>::make_random_ctr_id());
     }
 
+    // Block IDs are file offsets of the blocks
     virtual Result<BlockG> getBlock(const BlockID& id) noexcept
     {
         using ResultT = Result<BlockG>;
-        BlockType* block = ptr_cast<BlockType>(buffer_.data() + id.value());
-        return ResultT::of(BlockG{block});
+
+        if (id.is_set())
+        {
+            BlockType* block = ptr_cast<BlockType>(buffer_.data() + id.value());
+            return ResultT::of(BlockG{block});
+        }
+
+        return ResultT::of(BlockG{});
     }
 
     virtual VoidResult removeBlock(const BlockID& id) noexcept {
@@ -503,6 +520,9 @@ public:
     virtual BoolResult unref_block(BlockG block) noexcept {
         return MEMORIA_MAKE_GENERIC_ERROR("unref_block() is not implemented for ReadOnly commits");
     }
+    virtual BoolResult unref_ctr_block(BlockG block, const BlockID& ctr_root_id) noexcept {
+        return MEMORIA_MAKE_GENERIC_ERROR("unref_ctr_block() is not implemented for ReadOnly commits");
+    }
 
     virtual VoidResult unref_ctr_root(const BlockID& root_block_id) noexcept {
         return MEMORIA_MAKE_GENERIC_ERROR("unref_ctr_root() is not implemented for ReadOnly commits");
@@ -34,11 +34,17 @@ class MappedSWMRStoreReadOnlyCommit:
     using typename Base::AllocatorT;
 
     using typename Base::DirectoryCtrType;
+    using typename Base::HistoryCtr;
+    using typename Base::CommitID;
 
     using Base::directory_ctr_;
+    using Base::store_;
+    using Base::commit_descriptor_;
 
     using Base::internal_find_by_root_typed;
 
+    size_t reader_slot_;
+
 public:
     using Base::find;
     using Base::getBlock;
@@ -47,9 +53,11 @@ public:
             MaybeError& maybe_error,
             SharedPtr<Store> store,
             Span<uint8_t> buffer,
-            CommitDescriptorT* commit_descriptor
+            CommitDescriptorT* commit_descriptor,
+            size_t reader_slot
     ) noexcept:
-        Base(maybe_error, store, buffer, commit_descriptor)
+        Base(maybe_error, store, buffer, commit_descriptor),
+        reader_slot_(reader_slot)
     {
         wrap_construction(maybe_error, [&]() -> VoidResult {
             auto root_block_id = commit_descriptor->superblock()->directory_root_id();
@@ -70,9 +78,65 @@ public:
         });
     }
 
+    // The commit owns its reader epoch slot
+    virtual ~MappedSWMRStoreReadOnlyCommit() noexcept {
+        store_->close_readonly(reader_slot_);
+    }
+
+    // Calls fn(commit_id, superblock_file_pos, persistent) for each commit
+    // in the history of this one, in commit ID order.
+    template <typename Fn>
+    VoidResult for_each_history_entry(Fn&& fn) noexcept
+    {
+        MEMORIA_TRY(history_ctr, find_history_ctr());
+        if (history_ctr)
+        {
+            MEMORIA_TRY(ii, history_ctr->iterator());
+            while (!ii->is_end())
+            {
+                int64_t value = ii->value().view();
+                MEMORIA_TRY_VOID(fn(ii->key().view(), value >= 0 ? value : -value, value >= 0));
+                MEMORIA_TRY_VOID(ii->next());
+            }
+        }
+
+        return VoidResult::of();
+    }
 
+    // Returns the superblock file position of the commit from
+    // this commit's history, if it's there
+    Result<Optional<uint64_t>> find_history_entry(CommitID commit_id) noexcept
+    {
+        using ResultT = Result<Optional<uint64_t>>;
+
+        MEMORIA_TRY(history_ctr, find_history_ctr());
+        if (history_ctr)
+        {
+            MEMORIA_TRY(ii, history_ctr->find(commit_id));
+            if (ii->is_found(commit_id))
+            {
+                int64_t value = ii->value().view();
+                return ResultT::of(static_cast<uint64_t>(value >= 0 ? value : -value));
+            }
+        }
+
+        return ResultT::of();
+    }
 
 protected:
+    Result<CtrSharedPtr<HistoryCtr>> find_history_ctr() noexcept
+    {
+        using ResultT = Result<CtrSharedPtr<HistoryCtr>>;
+
+        if (commit_descriptor_->superblock()->history_root_id().is_set())
+        {
+            MEMORIA_TRY(ctr_ref, this->find(HistoryCtrID));
+            return ResultT::of(memoria_static_pointer_cast<HistoryCtr>(ctr_ref));
+        }
+
+        return ResultT::of();
+    }
+
 
     virtual SnpSharedPtr<AllocatorT> self_ptr() noexcept {
         return this->shared_from_this();
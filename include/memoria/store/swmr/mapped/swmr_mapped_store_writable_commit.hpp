@@ -20,6 +20,9 @@
 #include <memoria/store/swmr/mapped/swmr_mapped_store_readonly_commit.hpp>
 
 #include <memoria/store/swmr/common/allocation_pool.hpp>
+#include <memoria/store/swmr/common/dirty_ranges.hpp>
+
+#include <algorithm>
 
 
 template <typename Profile>
@@ -29,6 +32,23 @@ namespace memoria {
 
 struct InitStoreTag{};
 
+
+inline std::map<int64_t, uint64_t>& dbg_hashes() { static std::map<int64_t, uint64_t> v; return v; }
+inline UUID& dbg_snp() { static UUID v; return v; }
+inline std::vector<uint8_t>& dbg_units() { static std::vector<uint8_t> v(1<<22); return v; }
+template <typename Span_>
+inline void dbg_track(Span_ span, bool set, const char* where) {
+    auto& v = dbg_units();
+    for (auto& a: span) {
+        int64_t p0 = a.position() << a.level();
+        int64_t n0 = a.size() << a.level();
+        for (int64_t u = p0; u < p0 + n0; u++) {
+            if (set && v[u]) fprintf(stderr, "DBG DOUBLE-SET %s unit=%ld (alc pos=%ld size=%ld level=%d)\n", where, (long)u, (long)a.position(), (long)a.size(), (int)a.level());
+            if (!set && !v[u]) fprintf(stderr, "DBG CLEAR-UNSET %s unit=%ld (alc pos=%ld size=%ld level=%d)\n", where, (long)u, (long)a.position(), (long)a.size(), (int)a.level());
+            v[u] = set;
+        }
+    }
+}
 template <typename Profile>
 class MappedSWMRStoreWritableCommit:
         public MappedSWMRStoreCommitBase<Profile>,
@@ -47,6 +67,7 @@ class MappedSWMRStoreWritableCommit:
     using typename Base::BlockG;
     using typename Base::BlockType;
 
+    using SequenceID = typename ISWMRStoreWritableCommit<Profile>::SequenceID;
 
     using typename Base::AllocationMapCtr;
     using typename Base::AllocationMapCtrType;
@@ -67,6 +88,25 @@ class MappedSWMRStoreWritableCommit:
     };
     using CountersCache       = std::unordered_map<BlockID, CounterValue>;
 
+    // Refcount change of a block made by this commit. Whether the counter
+    // drops to zero is known at the flush only.
+    struct RefcountDelta {
+        int64_t delta;
+        bool unref;
+        bool ctr_root;
+    };
+    using RefcountDeltas      = std::unordered_map<BlockID, RefcountDelta>;
+
+    struct RefcountUpdate {
+        BlockID block_id;
+        int64_t delta;
+        bool ctr_root;
+
+        bool operator<(const RefcountUpdate& other) const noexcept {
+            return block_id.value() < other.block_id.value();
+        }
+    };
+
     static constexpr int32_t BASIC_BLOCK_SIZE            = Store::BASIC_BLOCK_SIZE;
     static constexpr int32_t SUPERBLOCK_SIZE             = BASIC_BLOCK_SIZE;
     static constexpr int32_t ALLOCATION_LEVELS           = Store::ALLOCATION_MAP_LEVELS;
@@ -88,23 +128,38 @@ class MappedSWMRStoreWritableCommit:
     using Base::instance_map_;
     using Base::buffer_;
     using Base::store_;
+    using Base::commit_descriptor_;
 
 
     AllocationPool<Profile, 9> allocation_pool_;
 
     bool committed_{false};
+    bool rolled_back_{false};
     bool allocator_initialization_mode_{false};
-    bool refcounter_update_mode_{false};
+    bool allocation_map_update_mode_{false};
 
     ParentCommit parent_commit_;
 
 
 
     CountersCache counters_cache_;
+    RefcountDeltas refcount_deltas_;
+
+    // Internal container instances, one per container type, releasing
+    // children of blocks whose counters drop to zero at the flush. Nodes
+    // of containers of the same type are released the same way.
+    std::unordered_map<uint64_t, CtrSharedPtr<CtrReferenceable<Profile>>> release_ctrs_;
+
+    // Blocks removed while released blocks are processed, see release_blocks()
+    bool bulk_removal_mode_{false};
+    ArenaBuffer<AllocationMetadataT> removed_blocks_;
 
     ArenaBuffer<AllocationMetadataT> awaiting_allocations_;
     ArenaBuffer<AllocationMetadataT> postponed_deallocations_;
 
+    // File ranges written by this commit
+    DirtyRanges dirty_ranges_;
+
     bool persistent_{false};
 
 public:
@@ -114,27 +169,42 @@ public:
             SharedPtr<Store> store,
             Span<uint8_t> buffer,
             CommitDescriptorT* parent_commit_descriptor,
+            size_t parent_reader_slot,
             CommitDescriptorT* commit_descriptor
     ) noexcept:
         Base(maybe_error, store, buffer, commit_descriptor)
     {
         wrap_construction(maybe_error, [&]() -> VoidResult {
             parent_commit_ = snp_make_shared<MappedSWMRStoreReadOnlyCommit<Profile>>(
-                maybe_error, store, buffer, parent_commit_descriptor
+                maybe_error, store, buffer, parent_commit_descriptor, parent_reader_slot
             );
 
             MEMORIA_TRY(parent_allocation_map_ctr, parent_commit_->find(AllocationMapCtrID));
             parent_allocation_map_ctr_ = memoria_static_pointer_cast<AllocationMapCtr>(parent_allocation_map_ctr);
+
+            // The superblock is allocated with the allocation map, so
+            // until then the commit looks at the parent's one.
+            Superblock* parent_sb = parent_commit_descriptor->superblock();
+            superblock_ = parent_sb;
+
+            auto ctr_ref = this->template internal_find_by_root_typed<AllocationMapCtrType>(parent_sb->allocator_root_id());
+            MEMORIA_RETURN_IF_ERROR(ctr_ref);
+            allocation_map_ctr_ = ctr_ref.get();
+
+            // The allocation pool of a new commit is empty. Growing the
+            // store updates the superblock, so the superblock itself is
+            // taken from the space the store already has.
+            MEMORIA_TRY_VOID(with_allocation_map_update([&]() noexcept {
+                return internal_populate_allocation_pool(SUPERBLOCK_ALLOCATION_LEVEL, 1, 0, false);
+            }));
+
+            MEMORIA_TRY(superblock, allocate_superblock(parent_sb, parent_sb->commit_id() + 1));
+            superblock_ = superblock;
+            commit_descriptor->set_superblock(superblock);
+
             return VoidResult::of();
         });
 
-        internal_init_system_ctr<AllocationMapCtrType>(
-            maybe_error,
-            allocation_map_ctr_,
-            superblock_->allocator_root_id(),
-            AllocationMapCtrID
-        );
-
         internal_init_system_ctr<RefcountersCtrType>(
             maybe_error,
             refcounters_ctr_,
@@ -170,12 +240,13 @@ public:
             int64_t avaialble = (buffer_.size() / (BASIC_BLOCK_SIZE << (ALLOCATION_LEVELS - 1)));
             allocation_pool_.add(AllocationMetadataT{0, avaialble, ALLOCATION_LEVELS - 1});
 
+            // File header's blocks
             int64_t reserved = SUPERBLOCKS_RESERVED;
-            ArenaBuffer<AllocationMetadataT> allocations;
-            allocation_pool_.allocate(SUPERBLOCK_ALLOCATION_LEVEL, reserved, allocations);
+            allocation_pool_.allocate(SUPERBLOCK_ALLOCATION_LEVEL, reserved, awaiting_allocations_);
 
             CommitID commit_id = 1;
             MEMORIA_TRY(superblock, allocate_superblock(nullptr, commit_id, buffer.size()));
+            superblock_ = superblock;
             commit_descriptor->set_superblock(superblock);
 
             allocator_initialization_mode_ = true;
@@ -188,9 +259,30 @@ public:
         });
     }
 
+    virtual ~MappedSWMRStoreWritableCommit() noexcept
+    {
+        if (is_active()) {
+            rollback().terminate_if_error();
+        }
+    }
+
     VoidResult finish_store_initialization() noexcept
     {
         MEMORIA_TRY_VOID(allocation_map_ctr_->expand(buffer_.size() / BASIC_BLOCK_SIZE));
+
+        // Read-only commits and the next writers expect all
+        // system containers to be present.
+        MEMORIA_TRY(refcounters_ctr, this->template internal_create_by_name_typed<RefcountersCtrType>(RefcountersCtrID));
+        refcounters_ctr_ = refcounters_ctr;
+
+        MEMORIA_TRY(history_ctr, this->template internal_create_by_name_typed<HistoryCtrType>(HistoryCtrID));
+        history_ctr_ = history_ctr;
+
+        MEMORIA_TRY(directory_ctr, this->template internal_create_by_name_typed<DirectoryCtrType>(DirectoryCtrID));
+        directory_ctr_ = directory_ctr;
+
+        allocator_initialization_mode_ = false;
+
         return commit();
     }
 
@@ -198,6 +290,10 @@ public:
         return Base::commit_id();
     }
 
+    virtual SequenceID sequence_id() noexcept {
+        return superblock_->sequence_id();
+    }
+
     virtual Result<CtrSharedPtr<CtrReferenceable<Profile>>> create(const LDTypeDeclarationView& decl, const CtrID& ctr_id) noexcept
     {
         MEMORIA_TRY_VOID(checkIfConainersCreationAllowed());
@@ -226,30 +322,90 @@ public:
                 MEMORIA_TRY_VOID(history_ctr_->assign_key(superblock_->commit_id(), sb_pos * (persistent_ ? 1 : -1)));
             }
 
-            while (counters_cache_.size() > 0)
+            MEMORIA_TRY_VOID(flush_counters());
+
+            ArenaBuffer<AllocationMetadataT> reclaimable;
+            store_->take_reclaimable_deallocations(reclaimable);
+
+            if (reclaimable.size() > 0)
             {
-                CountersCache counters_cache = std::move(counters_cache_);
-                counters_cache_ = CountersCache{};
+                MEMORIA_TRY_VOID(with_allocation_map_update([&]() noexcept {
+                    dbg_track(reclaimable.span(), false, "reclaim");
+                    return allocation_map_ctr_->setup_bits(reclaimable.span(), false); // clear bits
+                }));
+            }
 
-                for (auto entry: counters_cache)
+            // Updates of the allocation map and of the counters container
+            // change counters of their own blocks
+            do {
+                MEMORIA_TRY_VOID(flush_awaiting_allocations());
+                MEMORIA_TRY_VOID(flush_counters());
+            }
+            while (awaiting_allocations_.size() > 0);
+
+            {
+                dbg_snp() = superblock_->commit_uuid();
+                struct H: BTreeTraverseNodeHandler<Profile> {
+                    std::set<int64_t> seen; long bad{};
+                    std::map<int64_t, uint64_t> hashes;
+                    void chk(const BlockType* b) {
+                        {
+                            const uint8_t* d = ptr_cast<const uint8_t>(b); uint64_t hh = 1469598103934665603ull;
+                            for (int32_t c = 0; c < b->memory_block_size(); c++) { hh = (hh ^ d[c]) * 1099511628211ull; }
+                            hashes[b->id().value()] = hh;
+                            auto ii = dbg_hashes().find(b->id().value());
+                            if (ii != dbg_hashes().end() && ii->second != hh && b->snapshot_id() != dbg_snp()) {
+                                if (bad++ < 10) fprintf(stderr, "DBG SHARED-CHANGED block=%ld\n", (long)b->id().value());
+                            }
+                        }
+                        int64_t u0 = b->id().value() / BASIC_BLOCK_SIZE;
+                        int64_t n = b->memory_block_size() / BASIC_BLOCK_SIZE;
+                        for (int64_t u = u0; u < u0 + n; u++) if (!dbg_units()[u]) { if (bad++ < 10) fprintf(stderr, "DBG LIVE-FREE unit=%ld block=%ld\n", (long)u, (long)b->id().value()); }
+                    }
+                    VoidResult process_branch_node(const BlockType* b) noexcept { chk(b); return VoidResult::of(); }
+                    VoidResult process_leaf_node(const BlockType* b) noexcept { chk(b); return VoidResult::of(); }
+                    VoidResult process_directory_leaf_node(const BlockType* b) noexcept { chk(b); return VoidResult::of(); }
+                    BoolResult proceed_with(const BlockID& id) const noexcept { return BoolResult::of(true); }
+                } h;
+                MEMORIA_TRY_VOID(this->traverse_ctr(superblock_->directory_root_id(), h));
+                MEMORIA_TRY_VOID(this->traverse_ctr(superblock_->allocator_root_id(), h));
+                MEMORIA_TRY_VOID(this->traverse_ctr(superblock_->counters_root_id(), h));
+                if (superblock_->history_root_id().is_set()) MEMORIA_TRY_VOID(this->traverse_ctr(superblock_->history_root_id(), h));
                 {
-                    MEMORIA_TRY_VOID(internal_update_counters_entry(entry.first, entry.second.value));
+                    int64_t units = buffer_.size() / BASIC_BLOCK_SIZE; long mism{};
+                    for (int32_t ll = 0; ll < ALLOCATION_LEVELS; ll++)
+                    for (int64_t u = 0; u < (units >> ll); u++) {
+                        MEMORIA_TRY(st, allocation_map_ctr_->get_allocation_status(ll, u));
+                        bool m = st && st.get() != AllocationMapEntryStatus::FREE;
+                        bool t = false; for (int64_t q = u << ll; q < ((u + 1) << ll); q++) t = t || dbg_units()[q];
+                        if (m != t && mism++ < 10) fprintf(stderr, "DBG MAP-MISMATCH level=%d unit=%ld map=%d trk=%d\n", ll, (long)u, (int)m, (int)t);
+                    }
                 }
+                fprintf(stderr, "DBG VALIDATED bad=%ld\n", h.bad);
+                dbg_hashes() = h.hashes;
             }
 
             if (postponed_deallocations_.size() > 0)
             {
-                MEMORIA_TRY_VOID(allocation_map_ctr_->setup_bits(postponed_deallocations_, false)); // clear bits
+                // These blocks are still visible to readers of the previous
+                // commits, and to recovery until this commit is durable. So
+                // they are released by one of the next writers.
+                store_->defer_deallocations(superblock_->sequence_id(), postponed_deallocations_.span());
+                postponed_deallocations_.clear();
             }
 
-            MEMORIA_TRY_VOID(store_->flush_data());
-
             MEMORIA_TRY_VOID(superblock_->build_superblock_description());
+            superblock_->update_checksum();
 
-            size_t sb_slot = superblock_->sequence_id() % 2;
-            std::memcpy(buffer_.data() + sb_slot * BASIC_BLOCK_SIZE, superblock_, BASIC_BLOCK_SIZE);
+            MEMORIA_TRY(durability, store_->publish_commit(superblock_, dirty_ranges_));
 
-            MEMORIA_TRY_VOID(store_->flush_header());
+            committed_ = true;
+            store_->finish_commit(commit_descriptor_, persistent_);
+
+            // The writer is released, so next commits may share the flush
+            if (durability == SWMRDurability::GROUP) {
+                return store_->wait_durable(superblock_->sequence_id());
+            }
         }
         else {
             return MEMORIA_MAKE_GENERIC_ERROR("Transaction {} has been already committed", commit_id());
@@ -308,7 +464,14 @@ public:
         }
     }
 
-    virtual VoidResult rollback() noexcept {
+    virtual VoidResult rollback() noexcept
+    {
+        if (is_active())
+        {
+            rolled_back_ = true;
+            store_->abort_commit(commit_descriptor_);
+        }
+
         return VoidResult::of();
     }
 
@@ -333,7 +496,11 @@ public:
     }
 
     virtual bool is_active() const noexcept {
-        return !committed_;
+        return !committed_ && !rolled_back_;
+    }
+
+    virtual bool isActive() const noexcept {
+        return is_active();
     }
 
     virtual bool is_marked_to_clear() const noexcept {
@@ -477,20 +644,15 @@ public:
 
         int64_t block_pos = block->id_value();
         int64_t allocator_block_pos = block_pos / BASIC_BLOCK_SIZE;
-        int64_t ll_allocator_block_pos = allocator_block_pos >> level;
 
-        MEMORIA_TRY(status, parent_allocation_map_ctr_->get_allocation_status(level, ll_allocator_block_pos));
-
-        AllocationMetadataT meta[1] = {AllocationMetadataT{allocator_block_pos, 1, level}};
-        if ((!status) || status.get() == AllocationMapEntryStatus::FREE)
+        AllocationMetadataT meta[1] = {AllocationMetadataT{allocator_block_pos >> level, 1, level}};
+        if (bulk_removal_mode_)
         {
-            MEMORIA_TRY_VOID(allocation_map_ctr_->setup_bits(meta, false)); // clear bits
-        }
-        else {
-            postponed_deallocations_.append_value(meta[0]);
+            removed_blocks_.append_value(meta[0]);
+            return VoidResult::of();
         }
 
-        return VoidResult::of();
+        return remove_blocks(Span<AllocationMetadataT>(meta, 1));
     }
 
     virtual Result<BlockG> createBlock(int32_t initial_size) noexcept
@@ -505,22 +667,12 @@ public:
 
         int32_t scale_factor = initial_size / BASIC_BLOCK_SIZE;
         int32_t level = Log2(scale_factor);
-        Optional<AllocationMetadataT> allocation = allocation_pool_.allocate_one(level);
-
-        if (!allocation) {
-            if (!allocator_initialization_mode_) {
-                MEMORIA_TRY_VOID(populate_allocation_pool(level, 1, allocation_prefetch_size(level)));
-            }
-            else {
-                return MEMORIA_MAKE_GENERIC_ERROR("Internal block allocation error while initilizing the store");
-            }
-        }
-
-        awaiting_allocations_.append_value(allocation.get());
+        MEMORIA_TRY(allocation, allocate_block(level));
 
-        uint64_t id = allocation.get().level0_position();
+        uint64_t id = allocation.level0_position() * BASIC_BLOCK_SIZE;
 
-        uint8_t* block_addr = buffer_.data() + id * BASIC_BLOCK_SIZE;
+        uint8_t* block_addr = buffer_.data() + id;
+        dirty_ranges_.add(id, initial_size);
 
         std::memset(block_addr, 0, initial_size);
 
@@ -543,26 +695,17 @@ public:
         int32_t scale_factor = block_size / BASIC_BLOCK_SIZE;
         int32_t level = Log2(scale_factor);
 
-        Optional<AllocationMetadataT> allocation = allocation_pool_.allocate_one(level);
+        MEMORIA_TRY(allocation, allocate_block(level));
 
-        if (!allocation) {
-            if (!allocator_initialization_mode_) {
-                MEMORIA_TRY_VOID(populate_allocation_pool(level, 1, allocation_prefetch_size(level)));
-            }
-            else {
-                return MEMORIA_MAKE_GENERIC_ERROR("Internal block allocation error while initilizing the store");
-            }
-        }
-
-        awaiting_allocations_.append_value(allocation.get());
-
-        uint64_t id = allocation.get().level0_position();
+        uint64_t id = allocation.level0_position() * BASIC_BLOCK_SIZE;
 
-        uint8_t* block_addr = buffer_.data() + id * BASIC_BLOCK_SIZE;
+        uint8_t* block_addr = buffer_.data() + id;
+        dirty_ranges_.add(id, block_size);
 
         std::memcpy(block_addr, block.block(), block_size);
 
-        BlockType* new_block = new (block_addr) BlockType();
+        // The copy keeps the header of the source block
+        BlockType* new_block = ptr_cast<BlockType>(block_addr);
         new_block->id() = BlockID{id};
         new_block->id_value() = id;
         new_block->snapshot_id() = superblock_->commit_uuid();
@@ -574,18 +717,13 @@ public:
     {
         BlockID block_id = block->id();
 
-        if (MMA_UNLIKELY(!refcounters_ctr_)) {
+        // Blocks created before the counters container have
+        // their counters in the cache until the flush
+        if (MMA_UNLIKELY(!refcounters_ctr_ || counters_cache_.count(block_id))) {
             internal_ref_counter_cache(block_id, amount);
         }
-        else if (MMA_LIKELY(!refcounter_update_mode_)) {
-            return internal_ref_block(block_id, amount);
-        }
         else {
-            MEMORIA_TRY(success, internal_try_ref_block(block_id, amount));
-            if (!success)
-            {
-                internal_ref_counter_cache(block_id, amount);
-            }
+            refcount_deltas_[block_id].delta += amount;
         }
 
         return VoidResult::of();
@@ -598,26 +736,37 @@ public:
         if (MMA_UNLIKELY((bool)cached)) {
             return BoolResult::of(cached.get());
         }
-        else if (MMA_LIKELY(!refcounter_update_mode_))
-        {
-            return internal_unref_block(block_id, true);
-        }
         else if (MMA_LIKELY((bool)refcounters_ctr_))
         {
-            MEMORIA_TRY(zero_refs, internal_unref_block(block_id, false));
-            if (zero_refs){
-                counters_cache_[block_id] = CounterValue{0};
-            }
-            return zero_refs_result;
+            // Blocks whose counters drop to zero are released at the flush
+            internal_unref_block_delta(block_id, false);
+            return BoolResult::of(false);
         }
         else {
             return MEMORIA_MAKE_GENERIC_ERROR("Internal error. Counters container hasn't been initialized yet");
         }
     }
 
+    virtual BoolResult unref_ctr_block(BlockG block, const BlockID& ctr_root_id) noexcept
+    {
+        if (MMA_LIKELY((bool)refcounters_ctr_)) {
+            MEMORIA_TRY_VOID(register_release_ctr(block->ctr_type_hash(), ctr_root_id));
+        }
+
+        return unref_block(block);
+    }
+
     virtual VoidResult unref_ctr_root(const BlockID& root_block_id) noexcept
     {
         MEMORIA_TRY(block, this->getBlock(root_block_id));
+
+        // The root is released at the flush by its own container
+        if (MMA_LIKELY(refcounters_ctr_ && !counters_cache_.count(root_block_id)))
+        {
+            internal_unref_block_delta(root_block_id, true);
+            return VoidResult::of();
+        }
+
         MEMORIA_TRY(zero_references, unref_block(block));
         if (zero_references)
         {
@@ -685,20 +834,69 @@ private:
     }
 
 private:
+    Result<AllocationMetadataT> allocate_block(int32_t level) noexcept
+    {
+        using ResultT = Result<AllocationMetadataT>;
+
+        Optional<AllocationMetadataT> allocation = allocation_pool_.allocate_one(level);
+
+        if (!allocation) {
+            if (!allocator_initialization_mode_) {
+                MEMORIA_TRY_VOID(populate_allocation_pool(level, 1, allocation_prefetch_size(level)));
+                allocation = allocation_pool_.allocate_one(level);
+            }
+
+            if (!allocation) {
+                return MEMORIA_MAKE_GENERIC_ERROR("Internal block allocation error at level {}", level);
+            }
+        }
+        else if (
+                 !allocator_initialization_mode_ &&
+                 !allocation_map_update_mode_ &&
+                 allocation_pool_.available(level) < allocation_low_watermark(level)
+        )
+        {
+            // Refill the pool ahead of demand, while the allocation map
+            // isn't being updated, so that the pool rarely runs dry
+            // in the middle of an allocation map update.
+            MEMORIA_TRY_VOID(populate_allocation_pool(level, 1, allocation_prefetch_size(level)));
+        }
+
+        awaiting_allocations_.append_value(allocation.get());
+
+        return ResultT::of(allocation.get());
+    }
+
+    // The pool may run dry in the middle of an allocation map update,
+    // when iterators of the map are in use. So the map is not changed
+    // here, except for growing the store outside of map updates.
     VoidResult populate_allocation_pool(int32_t level, int64_t minimal_amount, int64_t prefetch = 0) noexcept
     {
-        MEMORIA_TRY_VOID(flush_awaiting_allocations());
+        bool grow = !allocation_map_update_mode_;
+        return with_allocation_map_update([&]() noexcept {
+            return internal_populate_allocation_pool(level, minimal_amount, prefetch, grow);
+        });
+    }
 
+    VoidResult internal_populate_allocation_pool(int32_t level, int64_t minimal_amount, int64_t prefetch, bool grow = true) noexcept
+    {
         int64_t ranks[ALLOCATION_LEVELS] = {0,};
         MEMORIA_TRY_VOID(allocation_map_ctr_->unallocated(ranks));
 
-        if (ranks[level] >= minimal_amount)
+        // Extents in the pool and allocated blocks awaiting
+        // the map update are still free in the allocation map
+        Span<const AllocationMetadataT> in_flight = awaiting_allocations_.span();
+        auto unreserved = [&](int32_t ll) {
+            int64_t value = ranks[ll] - allocation_pool_.reserved(ll, in_flight);
+            return value > 0 ? value : 0;
+        };
+
+        if (unreserved(level) >= minimal_amount)
         {
             int64_t desireable = minimal_amount + prefetch;
 
             int32_t target_level = level;
-            int32_t target_desirable = desireable;
-
+            int64_t target_desirable = desireable;
 
             if (MMA_LIKELY(desireable > 1))
             {
@@ -707,28 +905,71 @@ private:
                     int64_t scale_factor = 1ll << (ll - level);
                     int64_t ll_desirable = divUp(desireable, scale_factor);
                     int64_t ll_required  = divUp(minimal_amount, scale_factor);
+                    int64_t ll_available = unreserved(ll);
 
-                    if (ranks[ll] >= ll_required && ll_desirable > 1)
+                    if (ll_available >= ll_required && ll_desirable > 1)
                     {
                         target_level = ll;
-                        target_desirable = ranks[ll] >= ll_desirable ? ll_desirable : ranks[ll];
+                        target_desirable = ll_available >= ll_desirable ? ll_desirable : ll_available;
                         break;
                     }
                 }
             }
 
-            return allocation_map_ctr_->find_unallocated(
-                0, target_level, target_desirable, allocation_pool_.level_buffer(target_level)
-            );
+            int64_t requested = std::min(ranks[target_level], target_desirable + allocation_pool_.reserved(target_level, in_flight));
+
+            ArenaBuffer<AllocationMetadataT> extents;
+            MEMORIA_TRY_VOID(allocation_map_ctr_->find_unallocated(0, target_level, requested, extents));
+
+            // find_unallocated() reports level-0 positions
+            for (AllocationMetadataT& alc: extents.span()) {
+                alc = AllocationMetadataT{alc.position() >> target_level, alc.size(), target_level};
+            }
+
+            allocation_pool_.add_unreserved(extents.span(), in_flight);
         }
-        else {
-            return MEMORIA_MAKE_GENERIC_ERROR(
-                "No enough free space among {}K blocks. Requested = {} blocks, available = {}",
-                (BASIC_BLOCK_SIZE / 1024) << level,
-                minimal_amount,
-                ranks[level]
-            );
+
+        if (grow && allocation_pool_.available(level) < minimal_amount) {
+            return grow_store((minimal_amount << level) * BASIC_BLOCK_SIZE);
         }
+
+        return VoidResult::of();
+    }
+
+    // Extends the file and the allocation map in this commit. The new
+    // area is given to the allocation pool directly, because expanding
+    // the allocation map needs blocks itself. Readers of other commits
+    // are not affected: existing mapping is not moved.
+    VoidResult grow_store(uint64_t min_increment) noexcept
+    {
+        uint64_t old_size = buffer_.size();
+        fprintf(stderr, "GROW old=%lu inc=%lu\n", (unsigned long)old_size, (unsigned long)min_increment);
+
+        MEMORIA_TRY(buffer, store_->grow_file(min_increment));
+        buffer_ = buffer;
+
+        constexpr int32_t top_level = ALLOCATION_LEVELS - 1;
+        constexpr uint64_t top_level_block_size = BASIC_BLOCK_SIZE << top_level;
+
+        uint64_t increment = buffer_.size() - old_size;
+
+        allocation_pool_.add(AllocationMetadataT{
+            static_cast<int64_t>(old_size / top_level_block_size),
+            static_cast<int64_t>(increment / top_level_block_size),
+            top_level
+        });
+
+        bool initialization_mode = allocator_initialization_mode_;
+        allocator_initialization_mode_ = true;
+
+        auto res = allocation_map_ctr_->expand(increment / BASIC_BLOCK_SIZE);
+
+        allocator_initialization_mode_ = initialization_mode;
+        MEMORIA_RETURN_IF_ERROR(res);
+
+        superblock_->file_size() = buffer_.size();
+
+        return VoidResult::of();
     }
 
     Result<Superblock*> allocate_superblock(const Superblock* parent_sb, int64_t commit_id, uint64_t file_size = 0) noexcept
@@ -742,12 +983,14 @@ private:
             uint64_t pos = (available.tail().position() << SUPERBLOCK_ALLOCATION_LEVEL) * BASIC_BLOCK_SIZE;
 
             Superblock* superblock = new (buffer_.data() + pos) Superblock();
+            dirty_ranges_.add(pos, SUPERBLOCK_SIZE);
+            awaiting_allocations_.append_value(available.tail());
             if (parent_sb)
             {
                 MEMORIA_TRY_VOID(superblock->init_from(*parent_sb, pos, commit_id));
             }
             else {
-                MEMORIA_TRY_VOID(superblock->init(file_size, pos, commit_id, SUPERBLOCK_SIZE));
+                MEMORIA_TRY_VOID(superblock->init(pos, file_size, commit_id, SUPERBLOCK_SIZE));
             }
 
             MEMORIA_TRY_VOID(superblock->build_superblock_description());
@@ -765,90 +1008,201 @@ private:
         return l0_prefetch_size >> level;
     }
 
+    int64_t allocation_low_watermark(int32_t level) noexcept {
+        return allocation_prefetch_size(level) / 4;
+    }
+
 
-    BoolResult internal_try_ref_block(const BlockID& block_id, int64_t amount = 1) noexcept
+    void internal_unref_block_delta(const BlockID& block_id, bool ctr_root) noexcept
     {
-        using DatumT = Datum<BigInt>;
+        RefcountDelta& entry = refcount_deltas_[block_id];
+        entry.delta--;
+        entry.unref = true;
+        entry.ctr_root = entry.ctr_root || ctr_root;
+    }
 
-        bool success = true;
-        auto res = refcounters_ctr_->with_value(block_id.value(), [&](Optional<DatumT> value) noexcept {
-            if (value) {
-                auto new_value = value.get().view() + amount;
-                return Optional<DatumT>{DatumT(new_value)};
-            }
-            else {
-                success = false;
-                return Optional<DatumT>{};
+    // Instances are created from the roots of the containers, so they don't
+    // depend on them. Called before the block is unreferenced, its
+    // container's root is not released yet.
+    VoidResult register_release_ctr(uint64_t ctr_hash, const BlockID& ctr_root_id) noexcept
+    {
+        if (release_ctrs_.find(ctr_hash) == release_ctrs_.end() && ctr_root_id.is_set())
+        {
+            MEMORIA_TRY(root, getBlock(ctr_root_id));
+
+            auto ctr_intf = ProfileMetadata<Profile>::local()->get_container_operations(ctr_hash);
+            MEMORIA_TRY(ctr, ctr_intf->new_ctr_instance(root, this));
+
+            release_ctrs_[ctr_hash] = ctr;
+        }
+
+        return VoidResult::of();
+    }
+
+    // Applies accumulated refcount changes and counters cache entries until
+    // nothing is left: releasing blocks and updating the counters container
+    // add new ones.
+    VoidResult flush_counters() noexcept
+    {
+        while (refcount_deltas_.size() > 0 || counters_cache_.size() > 0)
+        {
+            MEMORIA_TRY_VOID(flush_refcount_deltas());
+
+            while (counters_cache_.size() > 0)
+            {
+                CountersCache counters_cache = std::move(counters_cache_);
+                counters_cache_ = CountersCache{};
+
+                for (auto entry: counters_cache)
+                {
+                    MEMORIA_TRY_VOID(internal_update_counters_entry(entry.first, entry.second.value));
+                }
             }
-        });
-        MEMORIA_RETURN_IF_ERROR(res);
+        }
+
+        release_ctrs_.clear();
 
-        return BoolResult::of(success);
+        return VoidResult::of();
     }
 
-    VoidResult internal_ref_block(const BlockID& block_id, int64_t amount = 1) noexcept
+    // Applies accumulated refcount changes in block ID order, so consecutive
+    // updates hit the same, already cloned, leaf of the counters container.
+    // The same pass finds blocks whose counters drop to zero, they are
+    // released after it. Unrefs of their children add deltas for the next
+    // round, as do refs and unrefs of the container's own blocks made by
+    // updating it.
+    VoidResult flush_refcount_deltas() noexcept
     {
-        refcounter_update_mode_ = true;
         using DatumT = Datum<BigInt>;
 
-        auto res = refcounters_ctr_->with_value(block_id.value(), [&](Optional<DatumT> value) noexcept {
-            if (value) {
-                auto new_value = value.get().view() + amount;
-                return Optional<DatumT>{DatumT(new_value)};
+        while (refcount_deltas_.size() > 0)
+        {
+            // Blocks created and released by this commit have no counters
+            // and zero delta, but still have to be released.
+            ArenaBuffer<RefcountUpdate> updates;
+            for (const auto& entry: refcount_deltas_)
+            {
+                if (entry.second.delta != 0 || entry.second.unref) {
+                    updates.append_value(RefcountUpdate{entry.first, entry.second.delta, entry.second.ctr_root});
+                }
             }
-            else {
-                return Optional<DatumT>{DatumT(1)};
+            refcount_deltas_.clear();
+
+            updates.sort();
+
+            ArenaBuffer<RefcountUpdate> released;
+
+            for (const RefcountUpdate& update: updates.span())
+            {
+                int64_t counter_value{};
+
+                auto res = refcounters_ctr_->with_value(update.block_id.value(), [&](Optional<DatumT> value) noexcept {
+                    counter_value = (value ? value.get().view() : 0) + update.delta;
+                    if (counter_value > 0) {
+                        return Optional<DatumT>{DatumT(counter_value)};
+                    }
+                    else {
+                        return Optional<DatumT>{};
+                    }
+                });
+                MEMORIA_RETURN_IF_ERROR(res);
+
+                if (counter_value < 0) {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Internal error. Negative counter for block ID {}: {}", update.block_id, counter_value);
+                }
+                else if (counter_value == 0) {
+                    released.append_value(update);
+                }
             }
-        });
 
-        refcounter_update_mode_ = false;
+            MEMORIA_TRY_VOID(release_blocks(released.span()));
+        }
 
-        MEMORIA_RETURN_IF_ERROR(res);
         return VoidResult::of();
     }
 
-    BoolResult internal_unref_block(const BlockID& block_id, bool delete_on_zero) noexcept
+    // Children of the blocks are unreferenced by containers of the blocks'
+    // types. The blocks themselves are collected and removed at once.
+    VoidResult release_blocks(Span<const RefcountUpdate> released) noexcept
     {
-        refcounter_update_mode_ = true;
+        if (released.size() == 0) {
+            return VoidResult::of();
+        }
 
-        bool no_counter = false;
-        int64_t counter_value{};
+        bulk_removal_mode_ = true;
 
-        using DatumT = Datum<BigInt>;
-        auto res = refcounters_ctr_->with_value(block_id.value(), [&](Optional<DatumT> value) noexcept {
-            if (value)
+        auto res = [&]() noexcept -> VoidResult {
+            for (const RefcountUpdate& update: released)
             {
-                counter_value = value.get().view() - 1;
+                MEMORIA_TRY(block, getBlock(update.block_id));
 
-                if (counter_value == 0 && delete_on_zero) {
-                    return Optional<DatumT>{};
+                auto ctr_hash = block->ctr_type_hash();
+                if (update.ctr_root)
+                {
+                    // The container is dropped, its root is the last
+                    // chance to get an instance of its type.
+                    MEMORIA_TRY_VOID(register_release_ctr(ctr_hash, update.block_id));
                 }
-                else {
-                    return Optional<DatumT>{DatumT(counter_value)};
+
+                auto ii = release_ctrs_.find(ctr_hash);
+                if (ii == release_ctrs_.end()) {
+                    return MEMORIA_MAKE_GENERIC_ERROR("Internal error. No container to release block {}", update.block_id);
                 }
+
+                MEMORIA_TRY_VOID(ii->second->internal_unref_cascade(update.block_id));
             }
-            else {
-                no_counter = true;
-                return Optional<DatumT>{};
-            }
-        });
-        refcounter_update_mode_ = false;
-        MEMORIA_RETURN_IF_ERROR(res);
 
-        if (no_counter) {
-            return MEMORIA_MAKE_GENERIC_ERROR("Internal error. No counter for block ID {}", block_id);
-        }
+            return VoidResult::of();
+        }();
 
-        if (counter_value < 0) {
-            return MEMORIA_MAKE_GENERIC_ERROR("Internal error. Negative counter for block ID {}: {}", block_id, counter_value);
-        }
+        bulk_removal_mode_ = false;
+        MEMORIA_RETURN_IF_ERROR(res);
+
+        ArenaBuffer<AllocationMetadataT> removed;
+        removed.append_values(removed_blocks_.span());
+        removed_blocks_.clear();
 
-        return BoolResult::of(counter_value == 0);
+        return remove_blocks(removed.span());
     }
 
+    // Blocks the parent commit doesn't use are freed with one allocation
+    // map update, others are postponed. The initial commit has no parent.
+    VoidResult remove_blocks(Span<AllocationMetadataT> blocks) noexcept
+    {
+        ArenaBuffer<AllocationMetadataT> free_blocks;
 
+        for (const AllocationMetadataT& meta: blocks)
+        {
+            if (!parent_allocation_map_ctr_)
+            {
+                free_blocks.append_value(meta);
+                continue;
+            }
 
+            MEMORIA_TRY(status, parent_allocation_map_ctr_->get_allocation_status(meta.level(), meta.position()));
 
+            if ((!status) || status.get() == AllocationMapEntryStatus::FREE) {
+                free_blocks.append_value(meta);
+            }
+            else {
+                postponed_deallocations_.append_value(meta);
+            }
+        }
+
+        if (free_blocks.size() > 0)
+        {
+            std::sort(free_blocks.data(), free_blocks.data() + free_blocks.size(), [](const AllocationMetadataT& a, const AllocationMetadataT& b) {
+                return a.level0_position() < b.level0_position();
+            });
+
+            MEMORIA_TRY_VOID(with_allocation_map_update([&]() noexcept {
+                dbg_track(free_blocks.span(), false, "remove");
+                return allocation_map_ctr_->setup_bits(free_blocks.span(), false); // clear bits
+            }));
+        }
+
+        return VoidResult::of();
+    }
 
     void internal_ref_counter_cache(const BlockID& block_id, int64_t amount) noexcept
     {
@@ -892,13 +1246,37 @@ private:
 
     VoidResult flush_awaiting_allocations() noexcept
     {
-        if (awaiting_allocations_.size() > 0 && allocation_map_ctr_)
-        {
-            awaiting_allocations_.sort();
-            MEMORIA_TRY_VOID(allocation_map_ctr_->setup_bits(awaiting_allocations_.span(), true)); // set bits
-            awaiting_allocations_.clear();
-        }
+        return with_allocation_map_update([&]() noexcept -> VoidResult {
+            // Updating the allocation map may allocate new blocks
+            while (awaiting_allocations_.size() > 0 && allocation_map_ctr_)
+            {
+                ArenaBuffer<AllocationMetadataT> allocations;
+                allocations.append_values(awaiting_allocations_.span());
+                awaiting_allocations_.clear();
 
+                allocations.sort();
+                dbg_track(allocations.span(), true, "set");
+                MEMORIA_TRY_VOID(allocation_map_ctr_->setup_bits(allocations.span(), true)); // set bits
+            }
+
+            return VoidResult::of();
+        });
+    }
+
+    // Blocks allocated while the allocation map is being updated
+    // must not trigger refilling of the allocation pool, it
+    // updates the allocation map too.
+    template <typename Fn>
+    VoidResult with_allocation_map_update(Fn&& fn) noexcept
+    {
+        bool update_mode = allocation_map_update_mode_;
+        allocation_map_update_mode_ = true;
+
+        auto res = fn();
+
+        allocation_map_update_mode_ = update_mode;
+
+        MEMORIA_RETURN_IF_ERROR(res);
         return VoidResult::of();
     }
 };
@@ -0,0 +1,135 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Bitmap primitives over ranges of different lengths: PopCount(),
+// Select1FW()/Select0FW() of the last set (clear) bit of the range, and
+// CountOneFw()/CountOneBw() over a range of ones, i.e. full scans. Each is
+// run with the portable code and dispatched to POPCNT/BMI2/AVX2, where
+// available. Ranges start at one of 8 offsets, changing from call to call,
+// so that calls can't be hoisted out of the loop.
+//
+// Usage: bitmap_bm [max_range = 65536]
+
+#include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/bitmap_select.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int64_t BITS_PER_RUN = 1ll << 30;
+
+RngInt64 rng;
+
+// Keeps results of the inlined calls alive.
+volatile int64_t sink;
+
+// Nanoseconds per call
+template <typename Fn>
+double measure(size_t range, Fn&& fn)
+{
+    int64_t calls = std::max<int64_t>(BITS_PER_RUN / range, 1000);
+
+    uint64_t t0 = getTimeInNanos();
+
+    int64_t sum = 0;
+    for (int64_t c = 0; c < calls; c++) {
+        sum += fn(c & 7);
+    }
+
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / calls;
+}
+
+template <typename Fn>
+void run(const char* name, size_t range, Fn&& fn)
+{
+    CpuFeatures::set_portable(true);
+    double portable = measure(range, fn);
+
+    CpuFeatures::set_portable(false);
+    double dispatched = measure(range, fn);
+
+    std::cout << name << " range=" << range
+              << " ns/call: portable=" << portable
+              << " dispatched=" << dispatched
+              << " Gbit/s: portable=" << (range / portable)
+              << " dispatched=" << (range / dispatched)
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t max_range = argc > 1 ? std::atoll(argv[1]) : 65536;
+
+    std::cout << "CPU: popcnt=" << CpuFeatures::get().popcnt()
+              << " bmi2=" << CpuFeatures::get().bmi2()
+              << " avx2=" << CpuFeatures::get().avx2() << std::endl;
+
+    std::vector<uint64_t> random((max_range + 8) / 64 + 1);
+    for (auto& word: random) {
+        word = rng();
+    }
+
+    std::vector<uint64_t> ones(random.size(), static_cast<uint64_t>(-1));
+    std::vector<uint64_t> zeroes(random.size(), 0);
+
+    for (size_t range = 64; range <= max_range; range *= 4)
+    {
+        std::vector<size_t> ranks1(8), ranks0(8);
+        for (size_t start = 0; start < 8; start++)
+        {
+            ranks1[start] = PopCount(random.data(), start, start + range);
+            ranks0[start] = range - ranks1[start];
+        }
+
+        run("PopCount   ", range, [&](size_t start){
+            return PopCount(random.data(), start, start + range);
+        });
+
+        run("Select1FW  ", range, [&](size_t start){
+            return Select1FW(random.data(), start, start + range, ranks1[start]).local_pos();
+        });
+
+        run("Select0FW  ", range, [&](size_t start){
+            return Select0FW(random.data(), start, start + range, ranks0[start]).local_pos();
+        });
+
+        run("CountOneFw ", range, [&](size_t start){
+            return CountOneFw(ones.data(), start, start + range);
+        });
+
+        run("CountOneBw ", range, [&](size_t start){
+            return CountOneBw(ones.data(), start + range, start);
+        });
+
+        run("CountZeroFw", range, [&](size_t start){
+            return CountZeroFw(zeroes.data(), start, start + range);
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares StaticPool and HashedPool on the access pattern of
+// SnapshotBase: findBlock() lookups of live handles mixed with
+// releaseBlock()/createBlock() churn.
+
+#include <memoria/store/memory/common/static_pool.hpp>
+#include <memoria/store/memory/common/hashed_pool.hpp>
+
+#include <memoria/core/tools/uuid.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+struct SharedStub {
+    UUID id_;
+    void* block_;
+    int32_t references_;
+    int32_t state_;
+
+    void init() noexcept
+    {
+        id_         = UUID{};
+        block_      = nullptr;
+        references_ = 0;
+        state_      = 0;
+    }
+};
+
+constexpr int64_t OPS = 10000000;
+
+template <typename Pool>
+void run(const char* name, int32_t live)
+{
+    Pool pool;
+    std::vector<UUID> ids(live);
+
+    for (auto& id: ids)
+    {
+        id = UUID::make_random();
+        pool.allocate(id)->id_ = id;
+    }
+
+    RngInt64 rng;
+    int64_t found = 0;
+
+    uint64_t t0 = getTimeInNanos();
+
+    for (int64_t c = 0; c < OPS; c++)
+    {
+        size_t idx = static_cast<size_t>(rng(live));
+
+        // 1 of 8 operations replaces handle, the rest are lookups
+        if ((c & 0x7) == 0)
+        {
+            pool.release(ids[idx]);
+            ids[idx] = UUID::make(ids[idx].hi(), ids[idx].lo() + 1);
+            pool.allocate(ids[idx])->id_ = ids[idx];
+        }
+        else {
+            found += pool.get(ids[idx]) != nullptr;
+        }
+    }
+
+    uint64_t t1 = getTimeInNanos();
+
+    std::cout << name << " live=" << live
+              << " ns/op=" << static_cast<double>(t1 - t0) / OPS
+              << " (" << found << ")" << std::endl;
+}
+
+}
+
+int main()
+{
+    run<StaticPool<UUID, SharedStub, 256>>("StaticPool<256>  ", 16);
+    run<HashedPool<UUID, SharedStub>>     ("HashedPool       ", 16);
+
+    run<StaticPool<UUID, SharedStub, 256>>("StaticPool<256>  ", 64);
+    run<HashedPool<UUID, SharedStub>>     ("HashedPool       ", 64);
+
+    run<StaticPool<UUID, SharedStub, 256>>("StaticPool<256>  ", 256);
+    run<HashedPool<UUID, SharedStub>>     ("HashedPool       ", 256);
+
+    run<StaticPool<UUID, SharedStub, 1024>>("StaticPool<1024> ", 1024);
+    run<HashedPool<UUID, SharedStub>>      ("HashedPool       ", 1024);
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Loading of sorted entries into a new Map<BigInt, BigInt>: a single
+// append() versus bulk_load() with the input split into one part per
+// thread, from 1 to max_threads threads.
+//
+// Usage: map_bulk_load_bm [entries = 100000000] [max_threads = 32]
+
+#include <memoria/core/datatypes/datatypes.hpp>
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+#include <memoria/memoria.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+using Profile = DefaultProfile<>;
+using MapType = Map<BigInt, BigInt>;
+using ProducerFn = typename ICtrApi<MapType, Profile>::ProducerFn;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t BATCH_SIZE = 4096;
+
+ProducerFn make_producer(int64_t from, int64_t to)
+{
+    return [=](auto& keys, auto& values, size_t pos) {
+        int64_t start = from + static_cast<int64_t>(pos);
+        int64_t end = std::min(to, start + BATCH_SIZE);
+
+        for (int64_t key = start; key < end; key++)
+        {
+            keys.append(key);
+            values.append(key);
+        }
+
+        return end >= to;
+    };
+}
+
+template <typename Fn>
+void measure(const char* name, size_t threads, int64_t entries, Fn&& fn)
+{
+    auto store = IMemoryStore<Profile>::create().get_or_throw();
+    auto snp = store->master().get_or_throw()->branch().get_or_throw();
+    auto ctr = create(snp, MapType()).get_or_throw();
+
+    auto start = Clock::now();
+    fn(ctr);
+    snp->commit().get_or_throw();
+    auto end = Clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    std::cout << name
+              << " threads=" << threads
+              << " entries/s=" << static_cast<int64_t>(entries / secs)
+              << " size=" << ctr->size().get_or_throw()
+              << std::endl;
+}
+
+void run(int64_t entries, size_t max_threads)
+{
+    measure("append", 1, entries, [&](auto& ctr) {
+        ctr->append(make_producer(0, entries)).get_or_throw();
+    });
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        measure("bulk_load", threads, entries, [&](auto& ctr) {
+            std::vector<ProducerFn> producers;
+            for (size_t c = 0; c < threads; c++) {
+                producers.push_back(make_producer(entries * c / threads, entries * (c + 1) / threads));
+            }
+
+            ctr->bulk_load(producers, threads).get_or_throw();
+        });
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t entries    = argc > 1 ? std::atoll(argv[1]) : 100000000;
+    size_t max_threads = argc > 2 ? std::atoll(argv[2]) : 32;
+
+    StaticLibraryCtrs<>::init();
+
+    try {
+        run(entries, max_threads);
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
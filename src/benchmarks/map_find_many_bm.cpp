@@ -0,0 +1,145 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Random point lookups in a Map<BigInt, BigInt> with even keys, so about
+// half of the probes miss: find() per key versus find_many() per batch.
+//
+// Usage: map_find_many_bm [entries = 1000000] [probes = 1000000] [batch = 1024]
+
+#include <memoria/core/datatypes/datatypes.hpp>
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+#include <memoria/core/tools/bitmap.hpp>
+#include <memoria/memoria.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+using Profile = DefaultProfile<>;
+using MapType = Map<BigInt, BigInt>;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+void measure(const char* name, int64_t probes, Fn&& fn)
+{
+    auto start = Clock::now();
+    int64_t checksum = fn();
+    auto end = Clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    std::cout << name
+              << " lookups/s=" << static_cast<int64_t>(probes / secs)
+              << " checksum=" << checksum
+              << std::endl;
+}
+
+void run(int64_t entries, int64_t probes, size_t batch)
+{
+    auto store = IMemoryStore<Profile>::create().get_or_throw();
+    auto snp = store->master().get_or_throw()->branch().get_or_throw();
+    auto ctr = create(snp, MapType()).get_or_throw();
+
+    ctr->append([&](auto& keys, auto& values, size_t pos) {
+        int64_t end = std::min<int64_t>(entries, pos + 4096);
+        for (int64_t c = pos; c < end; c++)
+        {
+            keys.append(c * 2);
+            values.append(c);
+        }
+        return end >= entries;
+    }).get_or_throw();
+
+    std::mt19937_64 rng(entries);
+    std::uniform_int_distribution<int64_t> dist(0, entries * 2);
+
+    std::vector<int64_t> keys(probes);
+    for (auto& key: keys) {
+        key = dist(rng);
+    }
+
+    measure("find", probes, [&]{
+        int64_t sum = 0;
+
+        for (int64_t key: keys)
+        {
+            auto ii = ctr->find(key).get_or_throw();
+            if (ii->is_found(key)) {
+                sum += ii->value().view();
+            }
+        }
+
+        return sum;
+    });
+
+    measure("find_many", probes, [&]{
+        int64_t sum = 0;
+
+        std::vector<int64_t> values(batch);
+        std::vector<uint64_t> found((batch + 63) / 64);
+
+        for (size_t start = 0; start < keys.size(); start += batch)
+        {
+            size_t size = std::min(batch, keys.size() - start);
+
+            ctr->find_many(
+                Span<const int64_t>(keys.data() + start, size),
+                Span<int64_t>(values.data(), size),
+                Span<uint64_t>(found.data(), found.size())
+            ).get_or_throw();
+
+            const uint64_t* found_bits = found.data();
+            for (size_t c = 0; c < size; c++)
+            {
+                if (GetBit(found_bits, c)) {
+                    sum += values[c];
+                }
+            }
+        }
+
+        return sum;
+    });
+
+    snp->commit().get_or_throw();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t entries = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    int64_t probes  = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    size_t batch    = argc > 3 ? std::atoll(argv[3]) : 1024;
+
+    StaticLibraryCtrs<>::init();
+
+    try {
+        run(entries, probes, batch);
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
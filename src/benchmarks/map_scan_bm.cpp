@@ -0,0 +1,124 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Full scan of a Map<BigInt, BigInt>: element-at-a-time through the
+// iterator's key()/value()/next() versus leaf-at-a-time through the
+// scanner, which hands out keys and values of a leaf as spans.
+//
+// Usage: map_scan_bm [entries = 1000000] [passes = 10]
+
+#include <memoria/core/datatypes/datatypes.hpp>
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+#include <memoria/memoria.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace memoria;
+
+namespace {
+
+using Profile = DefaultProfile<>;
+using MapType = Map<BigInt, BigInt>;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+void measure(const char* name, int64_t entries, int64_t passes, Fn&& fn)
+{
+    int64_t checksum = 0;
+
+    auto start = Clock::now();
+    for (int64_t c = 0; c < passes; c++) {
+        checksum += fn();
+    }
+    auto end = Clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    double rate = static_cast<double>(entries * passes) / secs;
+
+    std::cout << name
+              << " entries/s=" << static_cast<int64_t>(rate)
+              << " MB/s=" << static_cast<int64_t>(rate * 2 * sizeof(int64_t) / (1024 * 1024))
+              << " checksum=" << checksum
+              << std::endl;
+}
+
+void run(int64_t entries, int64_t passes)
+{
+    auto store = IMemoryStore<Profile>::create().get_or_throw();
+    auto snp = store->master().get_or_throw()->branch().get_or_throw();
+    auto ctr = create(snp, MapType()).get_or_throw();
+
+    for (int64_t c = 0; c < entries; c++) {
+        ctr->assign_key(c, c).get_or_throw();
+    }
+
+    measure("per-element", entries, passes, [&]{
+        int64_t sum = 0;
+
+        auto ii = ctr->iterator().get_or_throw();
+        while (!ii->is_end())
+        {
+            sum += ii->key().view() + ii->value().view();
+            ii->next().get_or_throw();
+        }
+
+        return sum;
+    });
+
+    measure("per-leaf", entries, passes, [&]{
+        int64_t sum = 0;
+
+        auto scanner = ctr->scanner();
+        while (!scanner.is_end())
+        {
+            auto keys   = scanner.keys();
+            auto values = scanner.values();
+
+            for (size_t c = 0; c < keys.size(); c++) {
+                sum += keys[c] + values[c];
+            }
+
+            scanner.next_leaf().get_or_throw();
+        }
+
+        return sum;
+    });
+
+    snp->commit().get_or_throw();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t entries = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    int64_t passes  = argc > 2 ? std::atoll(argv[2]) : 10;
+
+    StaticLibraryCtrs<>::init();
+
+    try {
+        run(entries, passes);
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// In-memory store commit throughput from N threads. Each thread works
+// on its own named branch and container: find_branch(), branch(), a few
+// updates, commit() and set_as_branch(), so threads contend only on
+// the store's history bookkeeping.
+//
+// Usage: memory_store_commit_bm [max_threads = 32] [seconds = 3] [updates_per_commit = 10]
+
+#include <memoria/core/datatypes/datatypes.hpp>
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+#include <memoria/memoria.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+using Profile = DefaultProfile<>;
+using MapType = Map<BigInt, BigInt>;
+
+void run(size_t threads, int64_t seconds, int64_t updates)
+{
+    auto store = IMemoryStore<Profile>::create().get_or_throw();
+
+    std::vector<ProfileCtrID<Profile>> ctr_ids;
+    for (size_t c = 0; c < threads; c++)
+    {
+        auto snp = store->master().get_or_throw()->branch().get_or_throw();
+        auto ctr = create(snp, MapType()).get_or_throw();
+        ctr_ids.push_back(ctr->name());
+
+        snp->commit().get_or_throw();
+        snp->set_as_branch(U8String("branch-") + std::to_string(c)).get_or_throw();
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> commits{0};
+
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c < threads; c++)
+    {
+        workers.emplace_back([&, c]{
+            U8String branch_name = U8String("branch-") + std::to_string(c);
+
+            int64_t cnt = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                auto snp = store->find_branch(branch_name).get_or_throw()->branch().get_or_throw();
+                auto ctr = find<MapType>(snp, ctr_ids[c]).get_or_throw();
+
+                for (int64_t u = 0; u < updates; u++) {
+                    int64_t key = cnt * updates + u;
+                    ctr->assign_key(key, key).get_or_throw();
+                }
+
+                snp->commit().get_or_throw();
+                snp->set_as_branch(branch_name).get_or_throw();
+                cnt++;
+            }
+
+            commits += cnt;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    std::cout << "threads=" << threads
+              << " commits/s=" << (commits / seconds)
+              << " commits/s/thread=" << (commits / seconds / static_cast<int64_t>(threads))
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t max_threads = argc > 1 ? std::atoll(argv[1]) : 32;
+    int64_t seconds    = argc > 2 ? std::atoll(argv[2]) : 3;
+    int64_t updates    = argc > 3 ? std::atoll(argv[3]) : 10;
+
+    StaticLibraryCtrs<>::init();
+
+    try {
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            run(threads, seconds, updates);
+        }
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// In-memory store startup time: a Map<BigInt, BigInt> image of the given
+// size is written with store() and loaded back by the streaming loader
+// and by the memory-mapped one, that deserializes blocks on all hardware
+// threads. Image size per entry is measured on a small store first.
+//
+// Usage: memory_store_load_bm [file = memory_store_load_bm.mma] [size_gb = 1] [size_gb...]
+
+#include <memoria/core/datatypes/datatypes.hpp>
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/memoria.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace memoria;
+
+namespace {
+
+using Profile = DefaultProfile<>;
+using MapType = Map<BigInt, BigInt>;
+
+constexpr int64_t CALIBRATION_ENTRIES = 1024 * 1024;
+
+int64_t file_size(const std::string& file_name)
+{
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return file.tellg();
+}
+
+void fill(AllocSharedPtr<IMemoryStore<Profile>> store, int64_t entries)
+{
+    auto snp = store->master().get_or_throw()->branch().get_or_throw();
+    auto ctr = create(snp, MapType()).get_or_throw();
+
+    ctr->append([&](auto& keys, auto& values, size_t batch_start) {
+        size_t batch_size = 8192;
+        size_t limit = std::min<size_t>(batch_size, entries - batch_start);
+
+        for (size_t c = 0; c < limit; c++) {
+            keys.append(batch_start + c);
+            values.append(batch_start + c);
+        }
+
+        return limit != batch_size;
+    }).get_or_throw();
+
+    snp->commit().get_or_throw();
+    snp->set_as_master().get_or_throw();
+}
+
+template <typename Fn>
+void measure(const char* name, Fn&& load_fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    auto store = load_fn();
+    uint64_t t1 = getTimeInNanos();
+
+    std::cout << "  " << name << ": load_ms=" << (t1 - t0) / 1000000 << std::endl;
+}
+
+void run(const std::string& file_name, int64_t size_gb, double bytes_per_entry)
+{
+    int64_t entries = static_cast<int64_t>((size_gb << 30) / bytes_per_entry);
+
+    {
+        auto store = IMemoryStore<Profile>::create().get_or_throw();
+        fill(store, entries);
+        store->store(file_name).get_or_throw();
+    }
+
+    std::cout << "size_gb=" << size_gb
+              << " entries=" << entries
+              << " image_mb=" << (file_size(file_name) >> 20)
+              << std::endl;
+
+    measure("streaming  ", [&]{
+        auto fileh = FileInputStreamHandler::create(file_name.c_str());
+        return IMemoryStore<Profile>::load(fileh.get()).get_or_throw();
+    });
+
+    measure("mapped     ", [&]{
+        return IMemoryStore<Profile>::load(file_name).get_or_throw();
+    });
+
+    std::remove(file_name.c_str());
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    StaticLibraryCtrs<>::init();
+
+    std::string file_name = argc > 1 ? argv[1] : "memory_store_load_bm.mma";
+
+    try {
+        double bytes_per_entry;
+        {
+            auto store = IMemoryStore<Profile>::create().get_or_throw();
+            fill(store, CALIBRATION_ENTRIES);
+            store->store(file_name).get_or_throw();
+            bytes_per_entry = file_size(file_name) / static_cast<double>(CALIBRATION_ENTRIES);
+        }
+
+        if (argc > 2)
+        {
+            for (int c = 2; c < argc; c++) {
+                run(file_name, std::atoll(argv[c]), bytes_per_entry);
+            }
+        }
+        else {
+            run(file_name, 1, bytes_per_entry);
+        }
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Prefix-sum searches in a PkdFQTree with 32- and 64-bit values:
+// find_ge() from the beginning, find_ge_fw() and find_ge_bw() from a random
+// position, with the scalar loops (portable) and dispatched to the AVX2
+// kernels, where available. Targets are random, so searches end anywhere
+// in the tree.
+//
+// Usage: pkd_fqtree_find_bm [size = 1024]
+
+#include <memoria/core/packed/tree/fse/packed_fse_quick_tree.hpp>
+#include <memoria/core/packed/tools/packed_struct_ptrs.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int64_t CALLS = 1000000;
+
+RngInt64 rng;
+
+// Keeps results of the inlined searches alive.
+volatile int64_t sink;
+
+struct Query {
+    int32_t start;
+    int64_t target;
+};
+
+template <typename Fn>
+double measure(Fn&& fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    int64_t sum = fn();
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / CALLS;
+}
+
+template <typename T>
+void bm(const char* name, int32_t size)
+{
+    using Tree = PkdFQTreeT<T, 1>;
+
+    auto tree = MakeSharedPackedStructByBlock<Tree>(Tree::block_size(size));
+
+    std::vector<T> values(size);
+    for (auto& value: values) {
+        value = static_cast<T>(rng(100) + 1);
+    }
+
+    tree->insert_entries(0, size, [&](int32_t, int32_t idx) noexcept {
+        return values[idx];
+    }).get_or_throw();
+
+    T total = tree->sum(0);
+
+    std::vector<Query> queries(4096);
+    for (auto& query: queries)
+    {
+        query.start  = rng(size);
+        query.target = rng(total / 2) + 1;
+    }
+
+    auto run = [&](auto&& fn) {
+        return measure([&]{
+            int64_t sum = 0;
+            for (int64_t c = 0; c < CALLS; c++) {
+                sum += fn(queries[c & (queries.size() - 1)]);
+            }
+            return sum;
+        });
+    };
+
+    auto find_ge = [&](const Query& q) {
+        return tree->find_ge(0, static_cast<T>(q.target)).local_pos();
+    };
+
+    auto find_ge_fw = [&](const Query& q) {
+        return tree->find_ge_fw(0, q.start, static_cast<T>(q.target)).local_pos();
+    };
+
+    auto find_ge_bw = [&](const Query& q) {
+        return tree->find_ge_bw(0, q.start, static_cast<T>(q.target)).local_pos();
+    };
+
+    CpuFeatures::set_portable(true);
+    double ge_portable = run(find_ge);
+    double fw_portable = run(find_ge_fw);
+    double bw_portable = run(find_ge_bw);
+
+    CpuFeatures::set_portable(false);
+    double ge_simd = run(find_ge);
+    double fw_simd = run(find_ge_fw);
+    double bw_simd = run(find_ge_bw);
+
+    std::cout << name << " size=" << size
+              << " ns/find_ge: portable=" << ge_portable << " dispatched=" << ge_simd
+              << " ns/find_ge_fw: portable=" << fw_portable << " dispatched=" << fw_simd
+              << " ns/find_ge_bw: portable=" << bw_portable << " dispatched=" << bw_simd
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int32_t size = argc > 1 ? std::atoi(argv[1]) : 1024;
+
+    std::cout << "CPU: avx2=" << CpuFeatures::get().avx2() << std::endl;
+
+    try {
+        bm<int32_t>("int32", size);
+        bm<int64_t>("int64", size);
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
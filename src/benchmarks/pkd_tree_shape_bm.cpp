@@ -0,0 +1,275 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Sweeps the shape of PkdFQTree<int64_t> and PkdVQTree<int64_t> (default
+// codec): branching factor, values per branch (bytes per window for
+// PkdVQTree) and block size. For each block size, trees of all shapes get
+// the number of small random values filling 7/8 of the block with the
+// default shape, and are measured with find_ge() to a random target,
+// sum(0, end) to a random position, and single-entry insert and remove at
+// random positions. Each measurement is the best of REPEATS runs.
+//
+// For each tree and block size, the shape with the lowest geometric mean of
+// times relative to the default shape is reported in the form of the
+// PkdFQTreeShapeProvider/PkdVLETreeShapeProvider values to use with
+// MEMORIA_TUNED_PACKED_TREE_SHAPES.
+//
+// Usage: pkd_tree_shape_bm [max_block_size = 65536]
+
+#include <memoria/core/packed/tree/fse/packed_fse_quick_tree.hpp>
+#include <memoria/core/packed/tree/vle/packed_vle_quick_tree.hpp>
+#include <memoria/core/packed/tools/packed_struct_ptrs.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int64_t CALLS   = 200000;
+constexpr int32_t ROUNDS  = 200;
+constexpr int32_t BATCH   = 32;
+constexpr int32_t REPEATS = 5;
+
+RngInt64 rng;
+
+// Keeps results of the inlined calls alive.
+volatile int64_t sink;
+
+template <int32_t BF, int32_t VPB>
+struct Shape {
+    static constexpr int32_t BranchingFactor = BF;
+    static constexpr int32_t ValuesPerBranch = VPB;
+};
+
+template <int32_t BF, int32_t VPB>
+using FQTree = PkdFQTreeT<int64_t, 1, int64_t, BF, VPB>;
+
+template <int32_t BF, int32_t VPB>
+using VQTree = PkdVQTreeT<int64_t, 1, ValueCodec, int64_t, BF, VPB>;
+
+struct Timings {
+    int32_t branching_factor;
+    int32_t values_per_branch;
+    int32_t size;
+
+    double find_ge;
+    double sum;
+    double insert;
+    double remove;
+};
+
+template <typename Fn>
+double measure(Fn&& fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    int64_t sum = 0;
+    for (int64_t c = 0; c < CALLS; c++) {
+        sum += fn(c & 4095);
+    }
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / CALLS;
+}
+
+// The largest number of entries with block_size(entries) fitting the block
+template <typename Tree>
+int32_t capacity(int32_t block_size)
+{
+    int32_t lo = 0, hi = block_size;
+    while (lo < hi)
+    {
+        int32_t mid = (lo + hi + 1) / 2;
+        if (Tree::block_size(mid) <= block_size) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+template <typename Tree>
+Timings bm_once(int32_t size)
+{
+    auto tree = MakeSharedPackedStructByBlock<Tree>(Tree::block_size(size + BATCH));
+
+    tree->insert_entries(0, size, [&](int32_t, int32_t) noexcept {
+        return rng(100) + 1;
+    }).get_or_throw();
+
+    int64_t total = tree->sum(0);
+
+    std::vector<int32_t> positions(4096);
+    std::vector<int64_t> targets(4096);
+    for (size_t c = 0; c < positions.size(); c++)
+    {
+        positions[c] = rng(size);
+        targets[c]   = rng(total) + 1;
+    }
+
+    Timings tt;
+
+    tt.branching_factor  = Tree::BranchingFactor;
+    tt.values_per_branch = Tree::ValuesPerBranch;
+    tt.size = size;
+
+    tt.find_ge = measure([&](int64_t c) {
+        return tree->find_ge(0, targets[c]).local_pos();
+    });
+
+    tt.sum = measure([&](int64_t c) {
+        return tree->sum(0, positions[c]);
+    });
+
+    uint64_t insert_time = 0;
+    uint64_t remove_time = 0;
+
+    for (int32_t round = 0; round < ROUNDS; round++)
+    {
+        uint64_t t0 = getTimeInNanos();
+        for (int32_t c = 0; c < BATCH; c++)
+        {
+            tree->insert_entries(rng(size + c), 1, [&](int32_t, int32_t) noexcept {
+                return rng(100) + 1;
+            }).get_or_throw();
+        }
+
+        uint64_t t1 = getTimeInNanos();
+        for (int32_t c = BATCH; c > 0; c--)
+        {
+            int32_t pos = rng(size + c);
+            tree->remove(pos, pos + 1).get_or_throw();
+        }
+
+        uint64_t t2 = getTimeInNanos();
+
+        insert_time += t1 - t0;
+        remove_time += t2 - t1;
+    }
+
+    tt.insert = static_cast<double>(insert_time) / (ROUNDS * BATCH);
+    tt.remove = static_cast<double>(remove_time) / (ROUNDS * BATCH);
+
+    return tt;
+}
+
+template <typename Tree>
+Timings bm(int32_t size)
+{
+    Timings tt = bm_once<Tree>(size);
+
+    for (int32_t c = 1; c < REPEATS; c++)
+    {
+        Timings next = bm_once<Tree>(size);
+
+        tt.find_ge = std::min(tt.find_ge, next.find_ge);
+        tt.sum     = std::min(tt.sum, next.sum);
+        tt.insert  = std::min(tt.insert, next.insert);
+        tt.remove  = std::min(tt.remove, next.remove);
+    }
+
+    return tt;
+}
+
+double score(const Timings& tt, const Timings& base)
+{
+    return std::pow(
+        (tt.find_ge / base.find_ge) * (tt.sum / base.sum) * (tt.insert / base.insert) * (tt.remove / base.remove),
+        0.25
+    );
+}
+
+template <template <int32_t, int32_t> class TreeT, typename DefaultShape, typename... Shapes>
+void sweep(const char* name, const char* provider, int32_t max_block_size)
+{
+    for (int32_t block_size = 4096; block_size <= max_block_size; block_size *= 2)
+    {
+        using DefaultTree = TreeT<DefaultShape::BranchingFactor, DefaultShape::ValuesPerBranch>;
+
+        int32_t size = capacity<DefaultTree>(block_size) * 7 / 8 - BATCH;
+
+        std::vector<Timings> timings;
+        (void)std::initializer_list<int>{
+            (timings.push_back(bm<TreeT<Shapes::BranchingFactor, Shapes::ValuesPerBranch>>(size)), 0)...
+        };
+
+        // The default shape is one of the swept ones
+        Timings base = *std::find_if(timings.begin(), timings.end(), [](const Timings& tt) {
+            return tt.branching_factor == DefaultShape::BranchingFactor
+                    && tt.values_per_branch == DefaultShape::ValuesPerBranch;
+        });
+
+        const Timings* best = &base;
+
+        for (const Timings& tt: timings)
+        {
+            std::cout << name << " block_size=" << block_size << " size=" << tt.size
+                      << " bf=" << tt.branching_factor << " vpb=" << tt.values_per_branch
+                      << " ns: find_ge=" << tt.find_ge << " sum=" << tt.sum
+                      << " insert=" << tt.insert << " remove=" << tt.remove
+                      << " score=" << score(tt, base)
+                      << std::endl;
+
+            if (score(tt, base) < score(*best, base)) {
+                best = &tt;
+            }
+        }
+
+        std::cout << name << " block_size=" << block_size << " best: "
+                  << provider << "::BranchingFactor = " << best->branching_factor << ", "
+                  << provider << "::ValuesPerBranch = " << best->values_per_branch
+                  << " (score=" << score(*best, base) << ")" << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int32_t max_block_size = argc > 1 ? std::atoi(argv[1]) : 65536;
+
+    try {
+        sweep<
+            FQTree, Shape<32, 32>,
+            Shape<8, 32>,  Shape<16, 32>,  Shape<32, 32>,  Shape<64, 32>,
+            Shape<8, 64>,  Shape<16, 64>,  Shape<32, 64>,  Shape<64, 64>,
+            Shape<8, 128>, Shape<16, 128>, Shape<32, 128>, Shape<64, 128>
+        >("fqtree", "PkdFQTreeShapeProvider<int64_t>", max_block_size);
+
+        sweep<
+            VQTree, Shape<32, 128>,
+            Shape<8, 64>,  Shape<16, 64>,  Shape<32, 64>,  Shape<64, 64>,
+            Shape<8, 128>, Shape<16, 128>, Shape<32, 128>, Shape<64, 128>,
+            Shape<8, 256>, Shape<16, 256>, Shape<32, 256>, Shape<64, 256>
+        >("vqtree", "PkdVLETreeShapeProvider<ValueCodec<int64_t>>", max_block_size);
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Sums and prefix-sum searches in a PkdVQTree with the I7 codec and with
+// the default codec for int64_t: sum(0, end) to a random position,
+// find_ge() from the beginning, find_ge_fw() and find_ge_bw() from a random
+// position. Each is run with code-by-code decoding (portable) and
+// dispatched to the AVX2 block decoder, where available. Values are either
+// all small (single-byte codes), or 1 in 8 of them is large.
+//
+// Usage: pkd_vqtree_bm [size = 1024]
+
+#include <memoria/core/packed/tree/vle/packed_vle_quick_tree.hpp>
+#include <memoria/core/packed/tools/packed_struct_ptrs.hpp>
+#include <memoria/core/bignum/primitive_codec.hpp>
+#include <memoria/core/tools/i7_codec.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int64_t CALLS = 1000000;
+
+RngInt64 rng;
+
+// Keeps results of the inlined calls alive.
+volatile int64_t sink;
+
+struct Query {
+    int32_t start;
+    int64_t target;
+};
+
+template <typename Fn>
+double measure(Fn&& fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    int64_t sum = fn();
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / CALLS;
+}
+
+template <typename Tree>
+void bm(const char* name, int32_t size, bool mixed)
+{
+    std::vector<int64_t> values(size);
+    for (auto& value: values) {
+        value = mixed && rng(8) == 0 ? rng(1000000) + 1 : rng(100) + 1;
+    }
+
+    auto tree = MakeSharedPackedStructByBlock<Tree>(Tree::block_size(size * 5));
+
+    tree->insert_entries(0, size, [&](int32_t, int32_t idx) noexcept {
+        return values[idx];
+    }).get_or_throw();
+
+    int64_t total = tree->sum(0);
+
+    std::vector<Query> queries(4096);
+    for (auto& query: queries)
+    {
+        query.start  = rng(size);
+        query.target = rng(total / 2) + 1;
+    }
+
+    auto run = [&](auto&& fn) {
+        return measure([&]{
+            int64_t sum = 0;
+            for (int64_t c = 0; c < CALLS; c++) {
+                sum += fn(queries[c & (queries.size() - 1)]);
+            }
+            return sum;
+        });
+    };
+
+    auto sum = [&](const Query& q) {
+        return tree->sum(0, q.start);
+    };
+
+    auto find_ge = [&](const Query& q) {
+        return tree->find_ge(0, q.target).local_pos();
+    };
+
+    auto find_ge_fw = [&](const Query& q) {
+        return tree->find_ge_fw(0, q.start, q.target).local_pos();
+    };
+
+    auto find_ge_bw = [&](const Query& q) {
+        return tree->find_ge_bw(0, q.start, q.target).local_pos();
+    };
+
+    CpuFeatures::set_portable(true);
+    double sum_portable = run(sum);
+    double ge_portable  = run(find_ge);
+    double fw_portable  = run(find_ge_fw);
+    double bw_portable  = run(find_ge_bw);
+
+    CpuFeatures::set_portable(false);
+    double sum_simd = run(sum);
+    double ge_simd  = run(find_ge);
+    double fw_simd  = run(find_ge_fw);
+    double bw_simd  = run(find_ge_bw);
+
+    std::cout << name << (mixed ? " mixed" : " small") << " size=" << size
+              << " ns/sum: portable=" << sum_portable << " dispatched=" << sum_simd
+              << " ns/find_ge: portable=" << ge_portable << " dispatched=" << ge_simd
+              << " ns/find_ge_fw: portable=" << fw_portable << " dispatched=" << fw_simd
+              << " ns/find_ge_bw: portable=" << bw_portable << " dispatched=" << bw_simd
+              << std::endl;
+}
+
+template <typename T>
+using I7 = UByteI7Codec<T>;
+
+}
+
+int main(int argc, char** argv)
+{
+    int32_t size = argc > 1 ? std::atoi(argv[1]) : 1024;
+
+    std::cout << "CPU: avx2=" << CpuFeatures::get().avx2() << std::endl;
+
+    try {
+        for (bool mixed: {false, true})
+        {
+            bm<PkdVQTreeT<int64_t, 1, I7>>("i7   ", size, mixed);
+            bm<PkdVQTreeT<int64_t, 1>>("int64", size, mixed);
+        }
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Commit latency and memory use of the in-memory store's persistent tree
+// for random (UUID) and sequential block IDs.
+//
+// Usage: ptree_block_id_bm [total_blocks = 10M] [blocks_per_commit = 10K]
+
+#include "ptree_bm_common.hpp"
+
+#include <memoria/profiles/default/default.hpp>
+
+#include <memoria/core/tools/uuid.hpp>
+#include <memoria/core/tools/time.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+using namespace memoria;
+using namespace memoria::bm;
+
+namespace {
+
+using ProfileT = ProfileTraits<DefaultProfile<>>;
+
+using Types       = PTreeTypes<32, 32 * 32>;
+using LeafNodeT   = Types::LeafNodeT;
+using BranchNodeT = Types::BranchNodeT;
+using NodeBaseT   = Types::NodeBaseT;
+using SnapshotT   = Types::SnapshotT;
+using PTreeT      = Types::PTreeT;
+
+constexpr int32_t NodeSize = Types::NodeSize;
+
+template <typename IDGen>
+void run(const char* name, int64_t total_blocks, int64_t per_commit, IDGen&& gen)
+{
+    RCBlockStub block;
+
+    SnapshotT* prev = Types::make_root_snapshot();
+
+    uint64_t total_time = 0;
+    uint64_t max_time   = 0;
+    int64_t commits     = 0;
+    int64_t copied_nodes = 0;
+
+    for (int64_t blocks = 0; blocks < total_blocks; blocks += per_commit)
+    {
+        SnapshotT* snp = new SnapshotT(prev);
+
+        uint64_t t0 = getTimeInNanos();
+
+        PTreeT tree(snp);
+        for (int64_t c = 0; c < per_commit; c++)
+        {
+            tree.assign(gen(), ValueStub{&block});
+        }
+
+        snp->committed_ = true;
+
+        uint64_t t1 = getTimeInNanos();
+
+        total_time += t1 - t0;
+        max_time = std::max(max_time, t1 - t0);
+        commits++;
+
+        tree.walk_tree([&](NodeBaseT*){
+            copied_nodes++;
+        });
+
+        // Only the last snapshot is kept alive, like after pack()
+        Types::delete_snapshot(prev);
+
+        prev = snp;
+    }
+
+    int64_t leaves   = 0;
+    int64_t branches = 0;
+    int64_t entries  = 0;
+
+    Types::for_each_node(prev->root(), [&](NodeBaseT* node){
+        if (node->is_leaf()) {
+            leaves++;
+            entries += node->size();
+        }
+        else {
+            branches++;
+        }
+    });
+
+    std::cout << name
+              << ": commits=" << commits
+              << " avg_commit_us=" << (total_time / commits / 1000)
+              << " max_commit_us=" << (max_time / 1000)
+              << " copied_nodes_per_commit=" << (copied_nodes / commits)
+              << " leaves=" << leaves
+              << " branches=" << branches
+              << " leaf_fill=" << (100.0 * entries / (leaves * NodeSize)) << "%"
+              << " ptree_MB=" << ((leaves * sizeof(LeafNodeT) + branches * sizeof(BranchNodeT)) / (1024 * 1024))
+              << std::endl;
+
+    Types::delete_snapshot(prev);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t total_blocks = argc > 1 ? std::atoll(argv[1]) : 10000000;
+    int64_t per_commit   = argc > 2 ? std::atoll(argv[2]) : 10000;
+
+    run("random    ", total_blocks, per_commit, []{
+        return ProfileT::make_random_block_id();
+    });
+
+    uint64_t seq = 1;
+    run("sequential", total_blocks, per_commit, [&]{
+        return ProfileT::make_sequential_block_id(seq++);
+    });
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Stand-ins for the in-memory store's block and history node types, so that
+// PersistentTree can be benchmarked without a store.
+
+#pragma once
+
+#include <memoria/core/tools/assert.hpp>
+#include <memoria/store/memory/common/persistent_tree.hpp>
+
+#include <memoria/core/tools/uuid.hpp>
+
+#include <mutex>
+
+namespace memoria {
+namespace bm {
+
+struct BlockStub {
+    using BlockID = UUID;
+};
+
+struct RCBlockStub {
+    int64_t refs_{};
+
+    void ref() {refs_++;}
+    int64_t unref() {return --refs_;}
+};
+
+struct ValueStub {
+    RCBlockStub* block_{};
+
+    RCBlockStub* block_ptr() const {return block_;}
+};
+
+// Minimal subset of MemoryStoreBase::HistoryNode the tree needs.
+template <typename NodeBaseT>
+struct SnapshotStub {
+    using MutexT = std::recursive_mutex;
+
+    SnapshotStub* parent_;
+    NodeBaseT* root_{};
+    UUID root_id_{};
+    UUID snapshot_id_{UUID::make_random()};
+    bool committed_{};
+    MutexT mutex_;
+
+    SnapshotStub(SnapshotStub* parent): parent_(parent) {}
+
+    bool is_active() const {return !committed_;}
+    bool is_committed() const {return committed_;}
+    bool is_dropped() const {return false;}
+
+    SnapshotStub* parent() {return parent_;}
+    MutexT& snapshot_mutex() {return mutex_;}
+
+    NodeBaseT* root() {return root_;}
+    UUID& root_id() {return root_id_;}
+    const UUID& snapshot_id() const {return snapshot_id_;}
+
+    UUID new_node_id() {return UUID::make_random();}
+
+    void set_root(NodeBaseT* new_root)
+    {
+        if (root_) root_->unref();
+        root_ = new_root;
+        if (root_) root_->ref();
+    }
+
+    void assign_root_no_ref(NodeBaseT* new_root) {
+        root_ = new_root;
+    }
+};
+
+template <int32_t NodeIndexSize_, int32_t NodeSize_, typename Key = UUID>
+struct PTreeTypes {
+    static constexpr int32_t NodeIndexSize = NodeIndexSize_;
+    static constexpr int32_t NodeSize      = NodeSize_;
+
+    using LeafNodeT   = store::memory::LeafNode<Key, ValueStub, NodeSize, NodeIndexSize, UUID, UUID>;
+    using BranchNodeT = store::memory::BranchNode<Key, NodeSize, NodeIndexSize, UUID, UUID>;
+    using NodeBaseT   = typename BranchNodeT::NodeBaseT;
+    using SnapshotT   = SnapshotStub<NodeBaseT>;
+    using PTreeT      = store::memory::PersistentTree<BranchNodeT, LeafNodeT, SnapshotT, BlockStub>;
+
+    template <typename Fn>
+    static void for_each_node(NodeBaseT* node, Fn&& fn)
+    {
+        fn(node);
+
+        if (node->is_branch())
+        {
+            auto branch = PTreeT::to_branch_node(node);
+            for (int32_t c = 0; c < branch->size(); c++)
+            {
+                for_each_node(branch->data(c), fn);
+            }
+        }
+    }
+
+    static SnapshotT* make_root_snapshot()
+    {
+        SnapshotT* snp = new SnapshotT(nullptr);
+        snp->set_root(new LeafNodeT(snp->snapshot_id(), snp->new_node_id()));
+        snp->committed_ = true;
+        return snp;
+    }
+
+    static void delete_snapshot(SnapshotT* snp)
+    {
+        PTreeT(snp).delete_tree([](LeafNodeT*){});
+        delete snp;
+    }
+};
+
+}}
@@ -0,0 +1,232 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Persistent tree node key search: scalar variants vs runtime-dispatched
+// SIMD, per node and end-to-end (PersistentTree::find(), that is what
+// SnapshotBase::findBlock() does), across NodeSize values.
+//
+// UUID nodes use the kernels only in MEMORIA_SEQUENTIAL_BLOCK_IDS builds,
+// otherwise 'dispatched' is the same as 'scalar' for them.
+//
+// Usage: ptree_key_search_bm [tree_size = 1M]
+
+#include "ptree_bm_common.hpp"
+
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+using namespace memoria;
+using namespace memoria::bm;
+
+namespace {
+
+constexpr int64_t LOOKUPS = 4000000;
+
+RngInt64 rng;
+
+// Keeps results of the inlined (scalar) searches alive.
+volatile int64_t sink;
+
+template <typename Key> Key random_key(bool sequential);
+
+// Sequential block IDs (see MEMORIA_SEQUENTIAL_BLOCK_IDS) have zero
+// high half, so UUID comparison can not stop at the first word.
+template <>
+UUID random_key<UUID>(bool sequential) {
+    return UUID::make(sequential ? 0 : rng(), rng());
+}
+
+template <>
+uint64_t random_key<uint64_t>(bool) {
+    return rng();
+}
+
+template <typename Fn>
+double measure(Fn&& fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    int64_t sum = fn();
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / LOOKUPS;
+}
+
+template <typename Key, int32_t NodeSize>
+void node_bm(const char* key_name, bool sequential = false)
+{
+    using Types = PTreeTypes<32, NodeSize, Key>;
+    using LeafNodeT = typename Types::LeafNodeT;
+
+    std::vector<Key> keys(NodeSize);
+    for (auto& key: keys) {
+        key = random_key<Key>(sequential);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    LeafNodeT* leaf = new LeafNodeT(UUID{}, UUID{});
+    for (const auto& key: keys) {
+        leaf->insert(leaf->size(), key, ValueStub{});
+    }
+
+    std::vector<Key> probes(4096);
+    for (auto& probe: probes) {
+        probe = keys[rng(NodeSize)];
+    }
+
+    for (const auto& probe: probes)
+    {
+        int32_t expected = leaf->find_key3(probe);
+        if (leaf->find_key(probe) != expected || leaf->find_key_scalar(probe) != expected) {
+            std::cout << "find_key mismatch" << std::endl;
+            std::abort();
+        }
+    }
+
+    auto run = [&](auto&& find) {
+        return measure([&]{
+            int64_t sum = 0;
+            for (int64_t c = 0; c < LOOKUPS; c++) {
+                sum += find(probes[c & (probes.size() - 1)]);
+            }
+            return sum;
+        });
+    };
+
+    double linear = run([&](const Key& k){return leaf->find_key_scalar(k);});
+    double count  = run([&](const Key& k){return leaf->find_key2(k);});
+    double binary = run([&](const Key& k){return leaf->find_key3(k);});
+
+    CpuFeatures::set_portable(true);
+    double portable = run([&](const Key& k){return leaf->find_key(k);});
+
+    CpuFeatures::set_portable(false);
+    double simd = run([&](const Key& k){return leaf->find_key(k);});
+
+    std::cout << "node " << key_name << " NodeSize=" << NodeSize
+              << " ns/search: linear=" << linear
+              << " count=" << count
+              << " lower_bound=" << binary
+              << " scalar=" << portable
+              << " dispatched=" << simd
+              << std::endl;
+
+    delete leaf;
+}
+
+template <int32_t NodeSize>
+void tree_bm(int64_t tree_size, bool sequential)
+{
+    using Types = PTreeTypes<32, NodeSize>;
+
+    RCBlockStub block;
+
+    auto root = Types::make_root_snapshot();
+    auto snp  = new typename Types::SnapshotT(root);
+
+    std::vector<UUID> ids(tree_size);
+
+    {
+        typename Types::PTreeT tree(snp);
+        for (auto& id: ids)
+        {
+            id = random_key<UUID>(sequential);
+            tree.assign(id, ValueStub{&block});
+        }
+    }
+
+    snp->committed_ = true;
+
+    std::vector<UUID> probes(1 << 16);
+    for (auto& probe: probes) {
+        probe = ids[rng(tree_size)];
+    }
+
+    typename Types::PTreeT tree(snp);
+
+    auto run = [&]{
+        return measure([&]{
+            int64_t sum = 0;
+            for (int64_t c = 0; c < LOOKUPS; c++) {
+                sum += tree.find(probes[c & (probes.size() - 1)]).is_initialized();
+            }
+            return sum;
+        });
+    };
+
+    // Interleaved rounds, the best one is taken: the tree is much
+    // larger than caches, so single runs are noisy.
+    double portable = std::numeric_limits<double>::max();
+    double simd     = std::numeric_limits<double>::max();
+
+    for (int32_t round = 0; round < 3; round++)
+    {
+        CpuFeatures::set_portable(true);
+        portable = std::min(portable, run());
+
+        CpuFeatures::set_portable(false);
+        simd = std::min(simd, run());
+    }
+
+    std::cout << "tree " << (sequential ? "seq " : "rand") << " NodeSize=" << NodeSize << " blocks=" << tree_size
+              << " find() Mops/s: scalar=" << (1000.0 / portable)
+              << " dispatched=" << (1000.0 / simd)
+              << std::endl;
+
+    Types::delete_snapshot(snp);
+    Types::delete_snapshot(root);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t tree_size = argc > 1 ? std::atoll(argv[1]) : 1000000;
+
+    std::cout << "CPU: sse4.2=" << CpuFeatures::get().sse42()
+              << " avx2=" << CpuFeatures::get().avx2() << std::endl;
+
+    node_bm<UUID, 256>("uuid");
+    node_bm<UUID, 512>("uuid");
+    node_bm<UUID, 1024>("uuid");
+    node_bm<UUID, 2048>("uuid");
+
+    node_bm<UUID, 256>("seq ", true);
+    node_bm<UUID, 512>("seq ", true);
+    node_bm<UUID, 1024>("seq ", true);
+    node_bm<UUID, 2048>("seq ", true);
+
+    node_bm<uint64_t, 256>("u64 ");
+    node_bm<uint64_t, 512>("u64 ");
+    node_bm<uint64_t, 1024>("u64 ");
+    node_bm<uint64_t, 2048>("u64 ");
+
+    for (bool sequential: {false, true})
+    {
+        tree_bm<256>(tree_size, sequential);
+        tree_bm<512>(tree_size, sequential);
+        tree_bm<1024>(tree_size, sequential);
+        tree_bm<2048>(tree_size, sequential);
+    }
+
+    return 0;
+}
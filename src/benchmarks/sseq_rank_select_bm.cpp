@@ -0,0 +1,184 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Rank and select over packed symbol sequences, per alphabet size (2-8
+// bits per symbol): symbol-at-a-time loop (what SeqRankFn/SeqSelectFn
+// used to do) vs SymbolMatchFn with portable broadword code vs SymbolMatchFn
+// dispatched to AVX2, where available. Ranges are random sub-ranges of a
+// block of the given size, select looks for a random occurrence within it.
+//
+// Usage: sseq_rank_select_bm [block_size = 1024]
+
+#include <memoria/core/packed/sseq/sseq_fn/pkd_f_sseq_match_fn.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int64_t CALLS = 1000000;
+
+RngInt64 rng;
+
+// Keeps results of the inlined searches alive.
+volatile int64_t sink;
+
+struct Query {
+    int32_t start;
+    int32_t end;
+    int32_t symbol;
+    int32_t rank;
+};
+
+template <typename Fn>
+double measure(Fn&& fn)
+{
+    uint64_t t0 = getTimeInNanos();
+    int64_t sum = fn();
+    uint64_t t1 = getTimeInNanos();
+
+    sink = sum;
+
+    return static_cast<double>(t1 - t0) / CALLS;
+}
+
+template <int32_t BitsPerSymbol>
+void bm(int32_t block_size)
+{
+    using MatchFn = SymbolMatchFn<BitsPerSymbol>;
+    using Value   = typename MatchFn::Value;
+
+    constexpr int32_t AlphabetSize = 1 << BitsPerSymbol;
+
+    std::vector<int32_t> symbols(block_size);
+    for (auto& symbol: symbols) {
+        symbol = rng(AlphabetSize);
+    }
+
+    std::vector<Value> buffer(BitsPerSymbol == 8 ? block_size : (block_size * BitsPerSymbol + 63) / 64 + 1);
+    Value* data = buffer.data();
+    for (int32_t c = 0; c < block_size; c++) {
+        SetBits(data, c * BitsPerSymbol, static_cast<Value>(symbols[c]), BitsPerSymbol);
+    }
+
+    std::vector<Query> queries(4096);
+    for (auto& query: queries)
+    {
+        query.start  = rng(block_size / 2);
+        query.end    = block_size / 2 + rng(block_size / 2 + 1);
+        query.symbol = symbols[query.start + rng(query.end - query.start)];
+
+        int32_t cnt = MatchFn::rank_portable(buffer.data(), query.start, query.end, query.symbol);
+        query.rank = 1 + rng(cnt);
+    }
+
+    auto rank_loop = [&](const Query& q) {
+        int32_t cnt = 0;
+        for (int32_t c = q.start; c < q.end; c++) {
+            cnt += GetBits(buffer.data(), c * BitsPerSymbol, BitsPerSymbol) == static_cast<Value>(q.symbol);
+        }
+        return cnt;
+    };
+
+    auto select_loop = [&](const Query& q) {
+        int32_t cnt = 0;
+        for (int32_t c = q.start; c < q.end; c++)
+        {
+            if (GetBits(buffer.data(), c * BitsPerSymbol, BitsPerSymbol) == static_cast<Value>(q.symbol) && ++cnt == q.rank) {
+                return c;
+            }
+        }
+        return q.end;
+    };
+
+    for (const auto& q: queries)
+    {
+        int32_t rank = rank_loop(q);
+        int32_t pos  = select_loop(q);
+
+        for (bool portable: {true, false})
+        {
+            CpuFeatures::set_portable(portable);
+            if (MatchFn::rank(buffer.data(), q.start, q.end, q.symbol) != rank ||
+                    (int32_t)MatchFn::select(buffer.data(), q.start, q.end, q.symbol, q.rank).local_pos() != pos)
+            {
+                std::cout << "rank/select mismatch for " << BitsPerSymbol << "-bit symbols" << std::endl;
+                std::abort();
+            }
+        }
+    }
+
+    auto run = [&](auto&& fn) {
+        return measure([&]{
+            int64_t sum = 0;
+            for (int64_t c = 0; c < CALLS; c++) {
+                sum += fn(queries[c & (queries.size() - 1)]);
+            }
+            return sum;
+        });
+    };
+
+    auto rank_fn = [&](const Query& q) {
+        return MatchFn::rank(buffer.data(), q.start, q.end, q.symbol);
+    };
+
+    auto select_fn = [&](const Query& q) {
+        return MatchFn::select(buffer.data(), q.start, q.end, q.symbol, q.rank).local_pos();
+    };
+
+    double rank_symbol   = run(rank_loop);
+    double select_symbol = run(select_loop);
+
+    CpuFeatures::set_portable(true);
+    double rank_portable   = run(rank_fn);
+    double select_portable = run(select_fn);
+
+    CpuFeatures::set_portable(false);
+    double rank_simd   = run(rank_fn);
+    double select_simd = run(select_fn);
+
+    std::cout << "bits=" << BitsPerSymbol << " block=" << block_size
+              << " ns/rank: per-symbol=" << rank_symbol
+              << " broadword=" << rank_portable
+              << " dispatched=" << rank_simd
+              << " ns/select: per-symbol=" << select_symbol
+              << " broadword=" << select_portable
+              << " dispatched=" << select_simd
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int32_t block_size = argc > 1 ? std::atoi(argv[1]) : 1024;
+
+    std::cout << "CPU: avx2=" << CpuFeatures::get().avx2() << std::endl;
+
+    bm<2>(block_size);
+    bm<3>(block_size);
+    bm<4>(block_size);
+    bm<5>(block_size);
+    bm<6>(block_size);
+    bm<7>(block_size);
+    bm<8>(block_size);
+
+    return 0;
+}
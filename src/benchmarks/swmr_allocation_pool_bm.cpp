@@ -0,0 +1,124 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// SWMR AllocationPool throughput: allocations per commit from a pool
+// filled the way a writable commit fills it: one large top-level extent
+// (a grown file), or many small level-0 extents (a fragmented allocation
+// map) followed by a top-level one. Mixed mode allocates 1/8 of blocks
+// at higher levels, so levels are split. Also reports the share of
+// allocations adjacent to the previous one of the same level.
+//
+// Usage: swmr_allocation_pool_bm [allocations_per_commit = 1M] [commits = 10]
+
+#include <memoria/store/swmr/common/allocation_pool.hpp>
+#include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
+
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace memoria;
+
+namespace {
+
+constexpr int32_t LEVELS = 9;
+
+using Profile     = MemoryCoWProfile<>;
+using AlcMetadata = AllocationMetadata<Profile>;
+using Pool        = AllocationPool<Profile, LEVELS>;
+
+enum class Fill {CONTIGUOUS, FRAGMENTED};
+
+void fill(Pool& pool, Fill mode, int64_t allocations)
+{
+    // Enough space for the mixed mode too
+    int64_t top_units = (allocations * 4) >> (LEVELS - 1);
+
+    if (mode == Fill::CONTIGUOUS) {
+        pool.add(AlcMetadata{0, top_units, LEVELS - 1});
+    }
+    else {
+        RngInt64 rng;
+        int64_t pos{};
+        int64_t end = top_units << (LEVELS - 1);
+        while (pos < end)
+        {
+            int64_t size = 1 + rng(8);
+            pool.add(AlcMetadata{pos, size, 0});
+            pos += size + 1 + rng(8);
+        }
+
+        // For higher levels
+        pool.add(AlcMetadata{top_units, top_units, LEVELS - 1});
+    }
+}
+
+void run(const char* name, Fill mode, bool mixed, int64_t allocations, int64_t commits)
+{
+    uint64_t total_time{};
+    int64_t adjacent{};
+    int64_t allocated{};
+
+    for (int64_t commit = 0; commit < commits; commit++)
+    {
+        Pool pool;
+        fill(pool, mode, allocations);
+
+        int64_t last_end[LEVELS];
+        for (int32_t ll = 0; ll < LEVELS; ll++) {
+            last_end[ll] = -1;
+        }
+
+        uint64_t t0 = getTimeInNanos();
+
+        for (int64_t c = 0; c < allocations; c++)
+        {
+            int32_t level = mixed && (c & 7) == 7 ? 1 + (c >> 3) % 3 : 0;
+
+            Optional<AlcMetadata> alc = pool.allocate_one(level);
+            if (!alc) {
+                break;
+            }
+
+            adjacent += alc.get().position() == last_end[level];
+            last_end[level] = alc.get().position() + 1;
+            allocated++;
+        }
+
+        total_time += getTimeInNanos() - t0;
+    }
+
+    std::cout << name
+              << ": allocations=" << allocated
+              << " Mallocs/s=" << (allocated * 1000.0 / total_time)
+              << " adjacent=" << (adjacent * 100.0 / allocated) << "%"
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int64_t allocations = argc > 1 ? std::atoll(argv[1]) : 1024 * 1024;
+    int64_t commits     = argc > 2 ? std::atoll(argv[2]) : 10;
+
+    run("contiguous, level 0", Fill::CONTIGUOUS, false, allocations, commits);
+    run("contiguous, mixed  ", Fill::CONTIGUOUS, true,  allocations, commits);
+    run("fragmented, level 0", Fill::FRAGMENTED, false, allocations, commits);
+    run("fragmented, mixed  ", Fill::FRAGMENTED, true,  allocations, commits);
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Commit flush latency of MappedSWMRStore-like file: full data region
+// msync() vs flushing only dirty ranges of the commit, one msync() per
+// range and writeback per range + single fdatasync() (what the store
+// does on Linux). Each commit writes a few sequential runs of 4K blocks
+// at random positions and a superblock.
+//
+// Usage: swmr_flush_bm [file = swmr_flush_bm.data] [file_size_mb = 2048]
+//                      [blocks_per_commit = 64] [commits = 200]
+
+#include <memoria/store/swmr/common/dirty_ranges.hpp>
+
+#include <memoria/core/tools/time.hpp>
+#include <memoria/core/tools/random.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+constexpr uint64_t BLOCK_SIZE  = 4096;
+constexpr uint64_t HEADER_SIZE = BLOCK_SIZE * 2;
+constexpr uint64_t RUN_BLOCKS  = 8;
+
+// Log2 histogram of latencies in microseconds
+class LatencyHistogram {
+    std::vector<uint64_t> buckets_;
+    std::vector<uint64_t> values_;
+public:
+    LatencyHistogram(): buckets_(32) {}
+
+    void add(uint64_t nanos)
+    {
+        uint64_t us = nanos / 1000;
+        size_t bucket = 0;
+        while ((2ull << bucket) <= us && bucket < buckets_.size() - 1) {
+            bucket++;
+        }
+
+        buckets_[bucket]++;
+        values_.push_back(us);
+    }
+
+    uint64_t percentile(double p)
+    {
+        std::sort(values_.begin(), values_.end());
+        return values_[static_cast<size_t>(p * (values_.size() - 1))];
+    }
+
+    void dump(const char* name)
+    {
+        std::cout << name << ": p50=" << percentile(0.5) << "us"
+                  << " p99=" << percentile(0.99) << "us"
+                  << " max=" << values_.back() << "us" << std::endl;
+
+        for (size_t c = 0; c < buckets_.size(); c++)
+        {
+            if (buckets_[c] > 0) {
+                std::cout << "    [" << (c ? 1ull << c : 0) << ", " << (2ull << c) << ") us: " << buckets_[c] << std::endl;
+            }
+        }
+    }
+};
+
+template <typename FlushFn>
+void run(const char* name, boost::interprocess::mapped_region& region, int64_t blocks_per_commit, int64_t commits, FlushFn&& flush_fn)
+{
+    RngInt64 rng;
+
+    uint8_t* data = static_cast<uint8_t*>(region.get_address());
+    uint64_t file_blocks = region.get_size() / BLOCK_SIZE;
+
+    LatencyHistogram histogram;
+
+    for (int64_t commit = 0; commit < commits; commit++)
+    {
+        DirtyRanges ranges;
+
+        for (int64_t c = 0; c < blocks_per_commit; c += RUN_BLOCKS)
+        {
+            uint64_t start = HEADER_SIZE / BLOCK_SIZE + rng(file_blocks - HEADER_SIZE / BLOCK_SIZE - RUN_BLOCKS);
+            for (uint64_t b = start; b < start + RUN_BLOCKS; b++)
+            {
+                data[b * BLOCK_SIZE] = static_cast<uint8_t>(commit);
+                ranges.add(b * BLOCK_SIZE, BLOCK_SIZE);
+            }
+        }
+
+        data[(commit % 2) * BLOCK_SIZE] = static_cast<uint8_t>(commit);
+
+        uint64_t t0 = getTimeInNanos();
+        if (!flush_fn(ranges)) {
+            std::cout << "Flush failed" << std::endl;
+            std::exit(1);
+        }
+        histogram.add(getTimeInNanos() - t0);
+    }
+
+    histogram.dump(name);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string file_name     = argc > 1 ? argv[1] : "swmr_flush_bm.data";
+    uint64_t file_size_mb     = argc > 2 ? std::atoll(argv[2]) : 2048;
+    int64_t blocks_per_commit = argc > 3 ? std::atoll(argv[3]) : 64;
+    int64_t commits           = argc > 4 ? std::atoll(argv[4]) : 200;
+
+    uint64_t file_size = file_size_mb * 1024 * 1024;
+
+    {
+        std::ofstream file(file_name, std::ios_base::binary | std::ios_base::trunc);
+        file.seekp(file_size - 1);
+        file.put(0);
+    }
+
+    {
+        boost::interprocess::file_mapping file(file_name.c_str(), boost::interprocess::read_write);
+        boost::interprocess::mapped_region region(file, boost::interprocess::read_write, 0, file_size);
+
+        // Touch all pages, like a long running store does
+        uint8_t* data = static_cast<uint8_t*>(region.get_address());
+        for (uint64_t c = 0; c < file_size; c += BLOCK_SIZE) {
+            data[c] = 1;
+        }
+        region.flush(0, file_size, false);
+
+        std::cout << "File: " << file_name << " size=" << file_size_mb << "MB"
+                  << " blocks_per_commit=" << blocks_per_commit
+                  << " commits=" << commits << std::endl;
+
+        run("full data flush ", region, blocks_per_commit, commits, [&](DirtyRanges&) {
+            return region.flush(HEADER_SIZE, file_size - HEADER_SIZE, false) && region.flush(0, HEADER_SIZE, false);
+        });
+
+        run("msync per range ", region, blocks_per_commit, commits, [&](DirtyRanges& ranges) {
+            ranges.coalesce(BLOCK_SIZE);
+            for (const auto& range: ranges.ranges())
+            {
+                if (!region.flush(range.offset, range.size, false)) {
+                    return false;
+                }
+            }
+            return region.flush(0, HEADER_SIZE, false);
+        });
+
+#ifdef __linux__
+        int fd = file.get_mapping_handle().handle;
+
+        run("range writeback ", region, blocks_per_commit, commits, [&](DirtyRanges& ranges) {
+            ranges.coalesce(BLOCK_SIZE);
+            for (const auto& range: ranges.ranges())
+            {
+                if (::sync_file_range(fd, range.offset, range.size, SYNC_FILE_RANGE_WRITE)) {
+                    return false;
+                }
+            }
+            return ::fdatasync(fd) == 0 && region.flush(0, HEADER_SIZE, false);
+        });
+#endif
+    }
+
+    std::remove(file_name.c_str());
+
+    return 0;
+}
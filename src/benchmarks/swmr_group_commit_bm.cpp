@@ -0,0 +1,145 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// MappedSWMRStore commit throughput with SYNC, GROUP and ASYNC durability,
+// N threads committing in turns. Only one writable commit may be active,
+// so a thread retries begin() until the writer is released. In GROUP mode
+// commits waiting for their flush let the next writers in, and share the
+// next flush with them.
+//
+// Usage: swmr_group_commit_bm [file = swmr_group_commit_bm.data]
+//                             [max_threads = 16] [seconds = 3]
+//                             [file_size_mb = 1024]
+
+#include <memoria/api/store/swmr_store_api.hpp>
+#include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/memoria.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+using StorePtr = SharedPtr<ISWMRStore<MemoryCoWProfile<>>>;
+
+const char* mode_name(SWMRDurability durability)
+{
+    switch (durability)
+    {
+        case SWMRDurability::SYNC:  return "SYNC ";
+        case SWMRDurability::GROUP: return "GROUP";
+        default:                    return "ASYNC";
+    }
+}
+
+void run(StorePtr store, SWMRDurability durability, size_t threads, int64_t seconds)
+{
+    store->set_durability(durability).get_or_throw();
+
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> commits{0};
+    std::atomic<int64_t> retries{0};
+    std::atomic<int64_t> commit_time{0};
+
+    std::vector<std::thread> writers;
+    for (size_t c = 0; c < threads; c++)
+    {
+        writers.emplace_back([&]{
+            int64_t cnt = 0;
+            int64_t busy = 0;
+            int64_t time = 0;
+
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                auto commit = store->begin();
+                if (commit.is_error())
+                {
+                    busy++;
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                uint64_t t0 = getTimeInNanos();
+                commit.get()->commit().get_or_throw();
+                time += static_cast<int64_t>(getTimeInNanos() - t0);
+
+                cnt++;
+            }
+
+            commits += cnt;
+            retries += busy;
+            commit_time += time;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+
+    for (auto& writer: writers) {
+        writer.join();
+    }
+
+    // Not counted, ASYNC commits may be still flushing
+    store->flush().get_or_throw();
+
+    int64_t total = commits.load();
+
+    std::cout << mode_name(durability)
+              << " threads=" << threads
+              << " commits/s=" << (total / seconds)
+              << " avg_commit_us=" << (total ? commit_time.load() / total / 1000 : 0)
+              << " begin_retries=" << retries.load()
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string file_name = argc > 1 ? argv[1] : "swmr_group_commit_bm.data";
+    size_t max_threads    = argc > 2 ? std::atoll(argv[2]) : 16;
+    int64_t seconds       = argc > 3 ? std::atoll(argv[3]) : 3;
+    uint64_t file_size_mb = argc > 4 ? std::atoll(argv[4]) : 1024;
+
+    std::remove(file_name.c_str());
+
+    try {
+        auto store = create_mapped_swmr_store(file_name, file_size_mb).get_or_throw();
+
+        for (SWMRDurability durability: {SWMRDurability::SYNC, SWMRDurability::GROUP, SWMRDurability::ASYNC})
+        {
+            for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+                run(store, durability, threads, seconds);
+            }
+        }
+
+        store->close().get_or_throw();
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    std::remove(file_name.c_str());
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// MappedSWMRStore read-only commit open/close throughput from N threads,
+// while a writer commits continuously (ASYNC durability, so the writer is
+// not bound by disk flushes).
+//
+// Usage: swmr_readers_bm [file = swmr_readers_bm.data] [max_threads = 32]
+//                        [seconds = 3] [file_size_mb = 1024]
+
+#include <memoria/api/store/swmr_store_api.hpp>
+#include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/memoria.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace memoria;
+
+namespace {
+
+using StorePtr = SharedPtr<ISWMRStore<MemoryCoWProfile<>>>;
+
+void run(StorePtr store, size_t threads, int64_t seconds)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> opens{0};
+    std::atomic<int64_t> commits{0};
+
+    std::vector<std::thread> readers;
+    for (size_t c = 0; c < threads; c++)
+    {
+        readers.emplace_back([&]{
+            int64_t cnt = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                auto commit = store->open().get_or_throw();
+                cnt += commit->commit_id() > 0;
+            }
+
+            opens += cnt;
+        });
+    }
+
+    std::thread writer([&]{
+        int64_t cnt = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            auto commit = store->begin().get_or_throw();
+            commit->commit().get_or_throw();
+            cnt++;
+        }
+
+        commits += cnt;
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+
+    for (auto& reader: readers) {
+        reader.join();
+    }
+
+    writer.join();
+
+    std::cout << "threads=" << threads
+              << " opens/s=" << (opens / seconds)
+              << " opens/s/thread=" << (opens / seconds / static_cast<int64_t>(threads))
+              << " commits/s=" << (commits / seconds)
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string file_name = argc > 1 ? argv[1] : "swmr_readers_bm.data";
+    size_t max_threads    = argc > 2 ? std::atoll(argv[2]) : 32;
+    int64_t seconds       = argc > 3 ? std::atoll(argv[3]) : 3;
+    uint64_t file_size_mb = argc > 4 ? std::atoll(argv[4]) : 1024;
+
+    std::remove(file_name.c_str());
+
+    try {
+        auto store = create_mapped_swmr_store(file_name, file_size_mb).get_or_throw();
+        store->set_durability(SWMRDurability::ASYNC).get_or_throw();
+
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            run(store, threads, seconds);
+        }
+
+        store->close().get_or_throw();
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    std::remove(file_name.c_str());
+
+    return 0;
+}
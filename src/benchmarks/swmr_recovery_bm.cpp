@@ -0,0 +1,88 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// MappedSWMRStore recovery time: the store is filled with empty commits,
+// every persistent_step-th of them persistent, closed and opened again.
+// Opening picks the head superblock from the header and reads the whole
+// commit history to find persistent commits.
+//
+// Usage: swmr_recovery_bm [file = swmr_recovery_bm.data] [commits = 100K]
+//                         [persistent_step = 100] [file_size_mb = 1024]
+
+#include <memoria/api/store/swmr_store_api.hpp>
+#include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
+#include <memoria/core/tools/time.hpp>
+#include <memoria/memoria.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace memoria;
+
+int main(int argc, char** argv)
+{
+    std::string file_name   = argc > 1 ? argv[1] : "swmr_recovery_bm.data";
+    int64_t commits         = argc > 2 ? std::atoll(argv[2]) : 100000;
+    int64_t persistent_step = argc > 3 ? std::atoll(argv[3]) : 100;
+    uint64_t file_size_mb   = argc > 4 ? std::atoll(argv[4]) : 1024;
+
+    std::remove(file_name.c_str());
+
+    try {
+        {
+            auto store = create_mapped_swmr_store(file_name, file_size_mb).get_or_throw();
+
+            // Durability of each commit is not what is measured here
+            store->set_durability(SWMRDurability::ASYNC).get_or_throw();
+
+            uint64_t t0 = getTimeInNanos();
+
+            for (int64_t c = 0; c < commits; c++)
+            {
+                auto commit = store->begin().get_or_throw();
+                commit->set_persistent(c % persistent_step == 0).get_or_throw();
+                commit->commit().get_or_throw();
+            }
+
+            store->close().get_or_throw();
+
+            std::cout << "Filled: commits=" << commits
+                      << " persistent_step=" << persistent_step
+                      << " time_ms=" << (getTimeInNanos() - t0) / 1000000 << std::endl;
+        }
+
+        uint64_t t0 = getTimeInNanos();
+
+        auto store = open_mapped_swmr_store(file_name).get_or_throw();
+
+        uint64_t t1 = getTimeInNanos();
+
+        auto persistent = store->persistent_commits().get_or_throw();
+        auto head = store->open().get_or_throw();
+
+        std::cout << "Recovered: head=" << head->commit_id()
+                  << " persistent_commits=" << persistent.size()
+                  << " recovery_ms=" << (t1 - t0) / 1000000.0 << std::endl;
+    }
+    catch (MemoriaThrowable& th) {
+        th.dump(std::cout);
+        return 1;
+    }
+
+    std::remove(file_name.c_str());
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memoria/core/tools/block_codec.hpp>
+
+#ifdef MEMORIA_HAS_LZ4
+#   include <lz4.h>
+#   include <lz4hc.h>
+#endif
+
+#ifdef MEMORIA_HAS_ZSTD
+#   include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
+namespace memoria {
+
+namespace {
+
+#ifdef MEMORIA_HAS_ZSTD
+
+// Contexts are expensive to create, blocks are small
+struct ZstdContexts {
+    ZSTD_CCtx* cctx;
+    ZSTD_DCtx* dctx;
+
+    ZstdContexts():
+        cctx(ZSTD_createCCtx()),
+        dctx(ZSTD_createDCtx())
+    {}
+
+    ~ZstdContexts() noexcept
+    {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+ZstdContexts& zstd_contexts()
+{
+    thread_local ZstdContexts contexts;
+    return contexts;
+}
+
+#endif
+
+detail::ResultErrors codec_not_available(BlockCodec codec) noexcept {
+    return MEMORIA_MAKE_GENERIC_ERROR("Block codec {} is not available in this build", block_codec_name(codec));
+}
+
+}
+
+const char* block_codec_name(BlockCodec codec) noexcept
+{
+    switch (codec)
+    {
+        case BlockCodec::NONE: return "NONE";
+        case BlockCodec::LZ4:  return "LZ4";
+        case BlockCodec::ZSTD: return "ZSTD";
+    }
+
+    return "UNKNOWN";
+}
+
+bool is_block_codec_available(BlockCodec codec) noexcept
+{
+    switch (codec)
+    {
+        case BlockCodec::NONE: return true;
+#ifdef MEMORIA_HAS_LZ4
+        case BlockCodec::LZ4:  return true;
+#endif
+#ifdef MEMORIA_HAS_ZSTD
+        case BlockCodec::ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+size_t block_codec_bound(BlockCodec codec, size_t size) noexcept
+{
+    switch (codec)
+    {
+#ifdef MEMORIA_HAS_LZ4
+        case BlockCodec::LZ4:  return LZ4_compressBound(static_cast<int>(size));
+#endif
+#ifdef MEMORIA_HAS_ZSTD
+        case BlockCodec::ZSTD: return ZSTD_compressBound(size);
+#endif
+        default: return size;
+    }
+}
+
+Result<size_t> compress_block(
+        BlockCodec codec,
+        int32_t level,
+        const uint8_t* src,
+        size_t size,
+        uint8_t* dst,
+        size_t capacity
+) noexcept
+{
+    using ResultT = Result<size_t>;
+
+    switch (codec)
+    {
+#ifdef MEMORIA_HAS_LZ4
+        case BlockCodec::LZ4: {
+            if (size > LZ4_MAX_INPUT_SIZE) {
+                return MEMORIA_MAKE_GENERIC_ERROR("Block of {} bytes is too large for LZ4", size);
+            }
+
+            int cap = static_cast<int>(std::min<size_t>(capacity, std::numeric_limits<int>::max()));
+
+            int result = level > 0 ?
+                LZ4_compress_HC(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst), static_cast<int>(size), cap, level) :
+                LZ4_compress_default(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst), static_cast<int>(size), cap);
+
+            if (result <= 0) {
+                return MEMORIA_MAKE_GENERIC_ERROR("LZ4 compression failed for block of {} bytes", size);
+            }
+
+            return ResultT::of(static_cast<size_t>(result));
+        }
+#endif
+#ifdef MEMORIA_HAS_ZSTD
+        case BlockCodec::ZSTD: {
+            size_t result = ZSTD_compressCCtx(
+                zstd_contexts().cctx, dst, capacity, src, size, level != 0 ? level : ZSTD_CLEVEL_DEFAULT
+            );
+
+            if (ZSTD_isError(result)) {
+                return MEMORIA_MAKE_GENERIC_ERROR("ZSTD compression failed: {}", ZSTD_getErrorName(result));
+            }
+
+            return ResultT::of(result);
+        }
+#endif
+        default: return codec_not_available(codec);
+    }
+}
+
+VoidResult decompress_block(
+        BlockCodec codec,
+        const uint8_t* src,
+        size_t compressed_size,
+        uint8_t* dst,
+        size_t size
+) noexcept
+{
+    switch (codec)
+    {
+#ifdef MEMORIA_HAS_LZ4
+        case BlockCodec::LZ4: {
+            int result = LZ4_decompress_safe(
+                reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                static_cast<int>(compressed_size), static_cast<int>(size)
+            );
+
+            if (result < 0 || static_cast<size_t>(result) != size) {
+                return MEMORIA_MAKE_GENERIC_ERROR("LZ4 decompression failed: {} bytes decompressed, {} expected", result, size);
+            }
+
+            return VoidResult::of();
+        }
+#endif
+#ifdef MEMORIA_HAS_ZSTD
+        case BlockCodec::ZSTD: {
+            size_t result = ZSTD_decompressDCtx(zstd_contexts().dctx, dst, size, src, compressed_size);
+
+            if (ZSTD_isError(result)) {
+                return MEMORIA_MAKE_GENERIC_ERROR("ZSTD decompression failed: {}", ZSTD_getErrorName(result));
+            }
+            else if (result != size) {
+                return MEMORIA_MAKE_GENERIC_ERROR("ZSTD decompression failed: {} bytes decompressed, {} expected", result, size);
+            }
+
+            return VoidResult::of();
+        }
+#endif
+        default: return codec_not_available(codec);
+    }
+}
+
+}
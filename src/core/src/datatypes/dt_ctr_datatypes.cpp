@@ -51,6 +51,7 @@ MMA_DEFINE_DEFAULT_DATATYPE_OPS(Map<BigInt, BigInt>);
 MMA_DEFINE_DEFAULT_DATATYPE_OPS(Multimap<UUID, UTinyInt>);
 MMA_DEFINE_DEFAULT_DATATYPE_OPS(Multimap<Varchar, Varchar>);
 MMA_DEFINE_DEFAULT_DATATYPE_OPS(AllocationMap);
+MMA_DEFINE_DEFAULT_DATATYPE_OPS(Map<UUID, MemCoWBlockID<uint64_t>>);
 
 void InitCtrDatatypes()
 {
@@ -70,6 +71,7 @@ void InitCtrDatatypes()
     register_notctr_operations<Multimap<UUID, UTinyInt>>();
     register_notctr_operations<Multimap<Varchar, Varchar>>();
     register_notctr_operations<AllocationMap>();
+    register_notctr_operations<Map<UUID, MemCoWBlockID<uint64_t>>>();
 }
 
 }
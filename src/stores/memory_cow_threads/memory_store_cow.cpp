@@ -54,6 +54,13 @@ Result<AllocSharedPtr<IMemoryStore<MemoryCoWProfile<>>>> IMemoryStore<MemoryCoWP
 }
 
 
+template <>
+Result<AllocSharedPtr<IMemoryStore<MemoryCoWProfile<>>>> IMemoryStore<MemoryCoWProfile<>>::load_chain(const std::vector<U8String>& file_names) noexcept
+{
+    return MEMORIA_MAKE_GENERIC_ERROR("Delta images are not supported by copy-on-write in-memory store");
+}
+
+
 template <>
 Result<AllocSharedPtr<IMemoryStore<MemoryCoWProfile<>>>> IMemoryStore<MemoryCoWProfile<>>::create() noexcept
 {
@@ -16,6 +16,9 @@
 #include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
 #include <memoria/store/swmr/mapped/swmr_mapped_store.hpp>
 
+#include <memoria/containers/map/map_impl.hpp>
+#include <memoria/core/strings/string.hpp>
+
 namespace memoria {
 
 using Profile = MemoryCoWProfile<>;
@@ -24,6 +27,14 @@ template class MappedSWMRStore<Profile>;
 template class MappedSWMRStoreWritableCommit<Profile>;
 template class MappedSWMRStoreReadOnlyCommit<Profile>;
 
+// System containers: the directory, refcounters and the commit history.
+// The allocation map is instantiated with other containers.
+using DirectoryCtrName = Map<ProfileCtrID<Profile>, ProfileBlockID<Profile>>;
+using CountersCtrName  = Map<BigInt, BigInt>;
+
+MMA_INSTANTIATE_CTR_BTSS(DirectoryCtrName, Profile)
+MMA_INSTANTIATE_CTR_BTSS(CountersCtrName, Profile)
+
 
 
 #if !defined(MEMORIA_BUILD_MEMORY_STORE_COW)
@@ -61,6 +72,8 @@ Result<SharedPtr<ISWMRStore<MemoryCoWProfile<>>>> open_mapped_swmr_store(U8Strin
         return std::move(maybe_error.get());
     }
 
+    MEMORIA_TRY_VOID(ptr->recover());
+
     return ResultT::of(ptr);
 }
 
@@ -75,6 +88,8 @@ Result<SharedPtr<ISWMRStore<MemoryCoWProfile<>>>> create_mapped_swmr_store(U8Str
         return std::move(maybe_error.get());
     }
 
+    MEMORIA_TRY_VOID(ptr->init_store());
+
     return ResultT::of(ptr);
 }
 
@@ -0,0 +1,349 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include "bitmap_test_base.hpp"
+
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+// Randomized equivalence of the PDEP/POPCNT/Harley-Seal bitmap kernels
+// with the portable code. Every check is done twice: with the kernels
+// the CPU supports, and with CpuFeatures::set_portable(true).
+class BitmapSelectSimdTest: public BitmapTestBase<uint64_t> {
+
+    using T = uint64_t;
+
+    using MyType = BitmapSelectSimdTest;
+    using Base = BitmapTestBase<T>;
+
+    static constexpr size_t CELLS = 160;
+    static constexpr size_t BITSIZE = CELLS * 64;
+
+    size_t  start_{};
+    size_t  stop_{};
+    size_t  rank_{};
+
+    uint64_t value_{};
+
+    std::vector<T> bitmap_;
+
+public:
+    MMA_STATE_FILEDS(start_, stop_, rank_, value_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testSelectWord, testFindCell, testPopCount, testSelect1FW, testSelect0FW)
+    }
+
+    void tear_down() noexcept
+    {
+        CpuFeatures::set_portable(false);
+    }
+
+    uint64_t randomWord()
+    {
+        uint64_t value = (static_cast<uint64_t>(getBIRandom()) << 32) ^ static_cast<uint64_t>(getBIRandom());
+
+        // Sparse, dense and uniform words
+        switch (getRandom(3))
+        {
+            case 0: return value & static_cast<uint64_t>(getBIRandom()) & static_cast<uint64_t>(getBIRandom());
+            case 1: return value | static_cast<uint64_t>(getBIRandom()) | (static_cast<uint64_t>(getBIRandom()) << 32);
+            default: return value;
+        }
+    }
+
+    void makeBitmap()
+    {
+        bitmap_.resize(CELLS);
+
+        size_t c = 0;
+        while (c < CELLS)
+        {
+            // Runs of empty and full cells between random ones
+            size_t run = 1 + getRandom(8);
+            int32_t kind = getRandom(4);
+
+            for (size_t d = 0; d < run && c < CELLS; d++, c++)
+            {
+                bitmap_[c] = kind == 0 ? 0 : (kind == 1 ? static_cast<T>(-1) : randomWord());
+            }
+        }
+    }
+
+    // The per-cell loops Select1FW/Select0FW used before the cell scan
+    // was added, with the portable single-word select.
+    SelectResult selectFWCells(size_t start, size_t stop, size_t rank, bool zero)
+    {
+        const T* buffer = bitmap_.data();
+
+        const size_t bitsize    = TypeBitsize<T>();
+        const size_t mask       = TypeBitmask<T>();
+        const size_t divisor    = TypeBitmaskPopCount(mask);
+
+        size_t prefix   = bitsize - (start & mask);
+
+        size_t suffix;
+        size_t start_cell;
+        size_t stop_cell;
+
+        if (start + prefix >= stop)
+        {
+            prefix      = stop - start;
+            suffix      = 0;
+            start_cell  = 0;
+            stop_cell   = 0;
+        }
+        else
+        {
+            suffix      = stop & mask;
+            start_cell  = (start + prefix) >> divisor;
+            stop_cell   = stop >> divisor;
+        }
+
+        size_t total = 0;
+
+        T prefix_bits = zero ? GetBitsNeg0(buffer, start, prefix) : GetBits0(buffer, start, prefix);
+
+        size_t result = SelectFWPortable(prefix_bits, rank - total);
+        if (result < 100)
+        {
+            return SelectResult(start + result, rank, true);
+        }
+        else {
+            total += result - 100;
+        }
+
+        for (size_t cell = start_cell; cell < stop_cell; cell++)
+        {
+            result = SelectFWPortable(zero ? ~buffer[cell] : buffer[cell], rank - total);
+
+            if (result < 100)
+            {
+                return SelectResult((cell << divisor) + result, rank, true);
+            }
+            else {
+                total += result - 100;
+            }
+        }
+
+        if (suffix > 0)
+        {
+            size_t start0 = stop_cell << divisor;
+
+            T suffix_bits = zero ? GetBitsNeg0(buffer, start0, suffix) : GetBits0(buffer, start0, suffix);
+
+            result = SelectFWPortable(suffix_bits, rank - total);
+
+            if (result < 100)
+            {
+                return SelectResult(start0 + result, rank, true);
+            }
+            else {
+                return SelectResult(stop, total + result - 100, false);
+            }
+        }
+        else {
+            return SelectResult(stop, total, false);
+        }
+    }
+
+    size_t popCount(size_t start, size_t stop)
+    {
+        size_t total = 0;
+        for (size_t c = start; c < stop; c++)
+        {
+            total += GetBit(bitmap_.data(), c);
+        }
+
+        return total;
+    }
+
+    template <typename Fn>
+    void forBothPaths(Fn&& fn)
+    {
+        CpuFeatures::set_portable(false);
+        fn();
+
+        CpuFeatures::set_portable(true);
+        fn();
+
+        CpuFeatures::set_portable(false);
+    }
+
+    void assertSelectWord(uint64_t value, size_t rank)
+    {
+        value_ = value;
+        rank_  = rank;
+
+        assert_equals(SelectFWPortable(value_, rank_), SelectFW(value_, rank_), "FW {} {}", value_, rank_);
+        assert_equals(SelectBWPortable(value_, rank_), SelectBW(value_, rank_), "BW {} {}", value_, rank_);
+
+#ifdef MMA_X86_SIMD
+        if (rank_ > 0 && CpuFeatures::get().bmi2() && CpuFeatures::get().popcnt())
+        {
+            assert_equals(SelectFWPortable(value_, rank_), SelectFWBMI2(value_, rank_), "FW BMI2 {} {}", value_, rank_);
+            assert_equals(SelectBWPortable(value_, rank_), SelectBWBMI2(value_, rank_), "BW BMI2 {} {}", value_, rank_);
+        }
+#endif
+    }
+
+    void testSelectWord()
+    {
+        forBothPaths([&]{
+            assertSelectWord(0, 0);
+            assertSelectWord(0, 1);
+            assertSelectWord(static_cast<uint64_t>(-1), 64);
+            assertSelectWord(static_cast<uint64_t>(-1), 65);
+            assertSelectWord(1ull << 63, 1);
+
+            for (int32_t c = 0; c < 10000; c++)
+            {
+                uint64_t value = randomWord();
+
+                // Includes rank == 0 and ranks above the popcount
+                for (size_t rank = 0; rank <= 66; rank++)
+                {
+                    assertSelectWord(value, rank);
+                }
+            }
+        });
+    }
+
+    void assertFindCell(size_t start, size_t size, size_t rank, bool zero)
+    {
+        start_ = start;
+        stop_  = start + size;
+        rank_  = rank;
+
+        size_t total1 = 3;
+        size_t total2 = 3;
+
+        // The generic template is the portable per-cell scan
+        size_t cell1 = intrnl2::FindCellFW<T>(bitmap_.data() + start_, size, rank_, total1, zero);
+        size_t cell2 = intrnl2::FindCellFW(bitmap_.data() + start_, size, rank_, total2, zero);
+
+        assert_equals(cell1, cell2, "cell {} {} {} {}", start_, stop_, rank_, zero);
+        assert_equals(total1, total2, "total {} {} {} {}", start_, stop_, rank_, zero);
+    }
+
+    void testFindCell()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 200; c++)
+            {
+                makeBitmap();
+
+                for (int32_t d = 0; d < 50; d++)
+                {
+                    size_t start = getRandom(CELLS);
+                    size_t size  = getRandom(CELLS - start + 1);
+                    bool zero    = getRandom(2);
+
+                    size_t popcnt = zero ? size * 64 - popCount(start * 64, (start + size) * 64) : popCount(start * 64, (start + size) * 64);
+
+                    assertFindCell(start, size, 0, zero);
+                    assertFindCell(start, size, popcnt + 3, zero);
+                    assertFindCell(start, size, popcnt + 4, zero);
+                    assertFindCell(start, size, popcnt + 100, zero);
+                    assertFindCell(start, size, getRandom(popcnt + 4) + 1, zero);
+                }
+            }
+        });
+    }
+
+    void testPopCount()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 100; c++)
+            {
+                makeBitmap();
+
+                for (int32_t d = 0; d < 100; d++)
+                {
+                    // Long ranges go through the Harley-Seal kernel
+                    start_ = getRandom(BITSIZE);
+                    stop_  = start_ + getRandom(BITSIZE - start_ + 1);
+
+                    assert_equals(popCount(start_, stop_), PopCount(bitmap_.data(), start_, stop_), "{} {}", start_, stop_);
+                    assert_equals(popCount(0, CELLS * 64), PopCntCells(bitmap_.data(), CELLS));
+                }
+            }
+        });
+    }
+
+    void assertSelectFW(size_t start, size_t stop, size_t rank, bool zero)
+    {
+        start_ = start;
+        stop_  = stop;
+        rank_  = rank;
+
+        SelectResult result1 = selectFWCells(start_, stop_, rank_, zero);
+        SelectResult result2 = zero ? Select0FW(bitmap_.data(), start_, stop_, rank_) : Select1FW(bitmap_.data(), start_, stop_, rank_);
+
+        assert_equals(result1.is_found(),  result2.is_found(), "{} {} {} {}", start_, stop_, rank_, zero);
+        assert_equals(result1.local_pos(), result2.local_pos(), "{} {} {} {}", start_, stop_, rank_, zero);
+        assert_equals(result1.rank(),      result2.rank(), "{} {} {} {}", start_, stop_, rank_, zero);
+    }
+
+    void testSelectFW(bool zero)
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 100; c++)
+            {
+                makeBitmap();
+
+                for (int32_t d = 0; d < 200; d++)
+                {
+                    // Misaligned range ends
+                    size_t start = getRandom(BITSIZE);
+                    size_t stop  = start + 1 + getRandom(BITSIZE - start);
+
+                    size_t popcnt = popCount(start, stop);
+                    size_t total  = zero ? (stop - start) - popcnt : popcnt;
+
+                    assertSelectFW(start, stop, 0, zero);
+                    assertSelectFW(start, stop, total, zero);
+                    assertSelectFW(start, stop, total + 1, zero);
+                    assertSelectFW(start, stop, total + 100, zero);
+                    assertSelectFW(start, stop, getRandom(total + 1) + 1, zero);
+                }
+            }
+        });
+    }
+
+    void testSelect1FW()
+    {
+        testSelectFW(false);
+    }
+
+    void testSelect0FW()
+    {
+        testSelectFW(true);
+    }
+};
+
+
+#define MMA_BITMAP_SELECT_SIMD_SUITE() \
+MMA_CLASS_SUITE(BitmapSelectSimdTest, "BitmapSelectSimdSuite")
+
+
+}}
@@ -25,6 +25,7 @@
 #include "bitmap_rank_test.hpp"
 #include "bitmap_count_test.hpp"
 #include "bitmap_select_test.hpp"
+#include "bitmap_select_simd_test.hpp"
 #include "bitmap_speed_test.hpp"
 
 
@@ -43,6 +44,7 @@ MMA_BITMAP_COUNT_SUITE(BitmapCountSuite32, uint32_t);
 MMA_BITMAP_COUNT_SUITE(BitmapCountSuite64, uint64_t);
 
 MMA_BITMAP_SELECT_SUITE();
+MMA_BITMAP_SELECT_SIMD_SUITE();
 
 MMA_BITMAP_SPEED_SUITE(BitmapSpeedSuite64, uint64_t);
 
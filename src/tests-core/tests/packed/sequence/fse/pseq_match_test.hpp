@@ -0,0 +1,235 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/core/packed/sseq/sseq_fn/pkd_f_sseq_match_fn.hpp>
+#include <memoria/core/tools/bitmap.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+// SymbolMatchFn<> rank and select with the kernels the CPU supports, and
+// under CpuFeatures::set_portable(true), against a per-symbol scan. Ranges
+// start and end at random symbols, so window and word boundaries fall
+// anywhere in them. Symbols of 3, 5 and 7 bits straddle word boundaries.
+template <int32_t Bits>
+class PackedSymbolMatchTest: public TestState {
+
+    using MyType = PackedSymbolMatchTest<Bits>;
+    using Base   = TestState;
+
+    using MatchFn = SymbolMatchFn<Bits>;
+    using Value   = typename MatchFn::Value;
+
+    static constexpr int32_t Symbols = 1 << Bits;
+    static constexpr int32_t Size    = 4000;
+
+    int32_t start_{};
+    int32_t end_{};
+    int32_t symbol_{};
+    int32_t rank_{};
+
+    std::vector<Value> buffer_;
+
+public:
+    MMA_STATE_FILEDS(start_, end_, symbol_, rank_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testRank, testSelect)
+    }
+
+    void tear_down() noexcept
+    {
+        CpuFeatures::set_portable(false);
+    }
+
+    int32_t symbol(int32_t pos) const
+    {
+        return symbol(pos, BoolValue<Bits == 8>());
+    }
+
+    int32_t symbol(int32_t pos, BoolValue<true>) const {
+        return buffer_[pos];
+    }
+
+    int32_t symbol(int32_t pos, BoolValue<false>) const {
+        return static_cast<int32_t>(GetBits(buffer_.data(), static_cast<size_t>(pos) * Bits, Bits));
+    }
+
+    void setSymbol(int32_t pos, int32_t value) {
+        setSymbol(pos, value, BoolValue<Bits == 8>());
+    }
+
+    void setSymbol(int32_t pos, int32_t value, BoolValue<true>) {
+        buffer_[pos] = static_cast<Value>(value);
+    }
+
+    void setSymbol(int32_t pos, int32_t value, BoolValue<false>)
+    {
+        Value* buffer = buffer_.data();
+        SetBits(buffer, static_cast<size_t>(pos) * Bits, static_cast<uint64_t>(value), Bits);
+    }
+
+    void fillRandom()
+    {
+        int32_t values_per_word = sizeof(Value) * 8 / Bits;
+
+        // One spare word after the symbols
+        buffer_.assign(Size / values_per_word + 2, 0);
+
+        int32_t pos = 0;
+        while (pos < Size)
+        {
+            // Runs of a frequent symbol between random ones
+            int32_t run   = 1 + getRandom(Bits * 16);
+            int32_t value = getRandom(2) ? Symbols - 1 : getRandom(Symbols);
+            bool random   = getRandom(2);
+
+            for (int32_t c = 0; c < run && pos < Size; c++, pos++)
+            {
+                setSymbol(pos, random ? getRandom(Symbols) : value);
+            }
+        }
+    }
+
+    int32_t rank(int32_t start, int32_t end, int32_t symbol_value) const
+    {
+        int32_t cnt = 0;
+        for (int32_t c = start; c < end; c++)
+        {
+            cnt += symbol(c) == symbol_value;
+        }
+
+        return cnt;
+    }
+
+    SelectResult select(int32_t start, int32_t end, int32_t symbol_value, int32_t rank) const
+    {
+        int32_t cnt = 0;
+        for (int32_t c = start; c < end; c++)
+        {
+            cnt += symbol(c) == symbol_value;
+            if (rank > 0 && cnt == rank)
+            {
+                return SelectResult(c, rank, true);
+            }
+        }
+
+        return SelectResult(end, cnt, false);
+    }
+
+    template <typename Fn>
+    void forBothPaths(Fn&& fn)
+    {
+        CpuFeatures::set_portable(false);
+        fn();
+
+        CpuFeatures::set_portable(true);
+        fn();
+
+        CpuFeatures::set_portable(false);
+    }
+
+    void assertRank(int32_t start, int32_t end, int32_t symbol_value)
+    {
+        start_  = start;
+        end_    = end;
+        symbol_ = symbol_value;
+
+        int32_t expected = rank(start_, end_, symbol_);
+
+        assert_equals(expected, MatchFn::rank_portable(buffer_.data(), start_, end_, symbol_), "portable {} {} {}", start_, end_, symbol_);
+        assert_equals(expected, MatchFn::rank(buffer_.data(), start_, end_, symbol_), "{} {} {}", start_, end_, symbol_);
+    }
+
+    void assertSelect(int32_t start, int32_t end, int32_t symbol_value, int32_t rank)
+    {
+        start_  = start;
+        end_    = end;
+        symbol_ = symbol_value;
+        rank_   = rank;
+
+        SelectResult expected = select(start_, end_, symbol_, rank_);
+        SelectResult portable = MatchFn::select_portable(buffer_.data(), start_, end_, symbol_, rank_);
+        SelectResult result   = MatchFn::select(buffer_.data(), start_, end_, symbol_, rank_);
+
+        assert_equals(expected.is_found(),  portable.is_found(), "portable {} {} {} {}", start_, end_, symbol_, rank_);
+        assert_equals(expected.local_pos(), portable.local_pos(), "portable {} {} {} {}", start_, end_, symbol_, rank_);
+        assert_equals(expected.rank(),      portable.rank(), "portable {} {} {} {}", start_, end_, symbol_, rank_);
+
+        assert_equals(expected.is_found(),  result.is_found(), "{} {} {} {}", start_, end_, symbol_, rank_);
+        assert_equals(expected.local_pos(), result.local_pos(), "{} {} {} {}", start_, end_, symbol_, rank_);
+        assert_equals(expected.rank(),      result.rank(), "{} {} {} {}", start_, end_, symbol_, rank_);
+    }
+
+    void testRank()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t start = 0; start < 2 * MatchFn::SymbolsPerWindow + 2; start++)
+                {
+                    assertRank(start, Size - start, Symbols - 1);
+                    assertRank(start, start + getRandom(3 * MatchFn::SymbolsPerWindow), getRandom(Symbols));
+                }
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    int32_t start = getRandom(Size);
+                    int32_t end   = start + getRandom(Size - start + 1);
+
+                    assertRank(start, end, getRandom(2) ? Symbols - 1 : getRandom(Symbols));
+                }
+            }
+        });
+    }
+
+    void testSelect()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    int32_t start = getRandom(Size);
+                    int32_t end   = start + getRandom(Size - start + 1);
+                    int32_t symbol_value = getRandom(2) ? Symbols - 1 : getRandom(Symbols);
+
+                    int32_t total = rank(start, end, symbol_value);
+
+                    assertSelect(start, end, symbol_value, 0);
+                    assertSelect(start, end, symbol_value, 1);
+                    assertSelect(start, end, symbol_value, total);
+                    assertSelect(start, end, symbol_value, total + 1);
+                    assertSelect(start, end, symbol_value, getRandom(total + 1) + 1);
+                }
+            }
+        });
+    }
+};
+
+}}
@@ -26,6 +26,7 @@
 #include "pseq_rank_test.hpp"
 #include "pseq_select_test.hpp"
 #include "pseq_speed_test.hpp"
+#include "pseq_match_test.hpp"
 
 namespace memoria {
 namespace tests {
@@ -189,6 +190,14 @@ auto Suite16 = register_class_suite<PackedSearchableSequenceSpeedTest<
                         Seq8ToolsFn
         >>("PSeq.Speed.8.VLE");
 
+
+auto Suite17 = register_class_suite<PackedSymbolMatchTest<2>>("PSeq.Match.2");
+auto Suite18 = register_class_suite<PackedSymbolMatchTest<3>>("PSeq.Match.3");
+auto Suite19 = register_class_suite<PackedSymbolMatchTest<4>>("PSeq.Match.4");
+auto Suite20 = register_class_suite<PackedSymbolMatchTest<5>>("PSeq.Match.5");
+auto Suite21 = register_class_suite<PackedSymbolMatchTest<7>>("PSeq.Match.7");
+auto Suite22 = register_class_suite<PackedSymbolMatchTest<8>>("PSeq.Match.8");
+
 }
 
 
@@ -26,6 +26,7 @@
 #include "packed_tree_find_test.hpp"
 #include "packed_tree_sum_test.hpp"
 #include "packed_tree_misc_test.hpp"
+#include "packed_vle_decoder_test.hpp"
 
 namespace memoria {
 namespace tests {
@@ -41,6 +42,9 @@ MMA_CLASS_SUITE(Suite2, "Tree.Find.4.FSQ");
 using Suite3 = PackedTreeSumTest<PkdFQTreeT<int64_t, 4>>;
 MMA_CLASS_SUITE(Suite3, "Tree.Sum.4.FSQ");
 
+using Suite3_1 = PackedTreeFindTest<PkdFQTreeT<int32_t, 4>>;
+MMA_CLASS_SUITE(Suite3_1, "Tree.Find.4.FSQ.Int32");
+
 
 using Suite4 = PackedTreeMiscTest<PkdVQTreeT<int64_t, 4, UByteI7Codec>>;
 MMA_CLASS_SUITE(Suite4, "Tree.Misc.4.VLQ.I7");
@@ -71,6 +75,13 @@ using Suite12 = PackedTreeFindTest<PkdVDTreeT<int64_t, 4, UInt64EliasCodec>>;
 MMA_CLASS_SUITE(Suite12, "Tree.Find.4.VLD.Elias");
 
 
+using Suite13 = PackedVLEDecoderTest<ValueCodec<int64_t>>;
+MMA_CLASS_SUITE(Suite13, "Tree.VLEDecoder.Int64");
+
+using Suite14 = PackedVLEDecoderTest<ValueCodec<uint64_t>>;
+MMA_CLASS_SUITE(Suite14, "Tree.VLEDecoder.UInt64");
+
+
 
 //using Suite18 = PackedTreeMiscTest<PkdFQTreeT<UnsignedAccumulator<256>, 4, UnsignedAccumulator<128>>>;
 //MMA_CLASS_SUITE(Suite18, "Tree.Misc.UAcc128.FSQ");
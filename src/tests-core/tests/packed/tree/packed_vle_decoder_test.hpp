@@ -0,0 +1,306 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/core/packed/tree/vle/packed_vle_block_decoder.hpp>
+#include <memoria/core/tools/cpu_features.hpp>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+// PkdVLEBlockDecoder<> skip, sum, decode and find, with the AVX2 kernels
+// and under CpuFeatures::set_portable(true), against the *_portable loops.
+// Blocks mix runs of single-byte codes of all lengths, including the
+// negative ones of ValueCodec<int64_t>, with multi-byte codes.
+template <typename Codec>
+class PackedVLEDecoderTest: public TestState {
+
+    using MyType = PackedVLEDecoderTest<Codec>;
+    using Base   = TestState;
+
+    using Value      = typename Codec::V;
+    using BufferType = typename Codec::BufferType;
+    using Decoder    = PkdVLEBlockDecoder<Codec, Value>;
+
+    static constexpr int32_t Values  = 3000;
+    static constexpr size_t  Padding = 64;
+
+    size_t  pos_{};
+    size_t  limit_{};
+    int32_t max_{};
+    int64_t target_{};
+
+    std::vector<BufferType> buffer_;
+    std::vector<size_t>     offsets_;
+    std::vector<Value>      values_;
+
+public:
+    MMA_STATE_FILEDS(pos_, limit_, max_, target_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testSkip, testSum, testDecode, testFind)
+    }
+
+    void tear_down() noexcept
+    {
+        CpuFeatures::set_portable(false);
+    }
+
+    Value singleByteValue() {
+        return singleByteValue(BoolValue<std::is_signed<Value>::value>());
+    }
+
+    // -126..125, bytes 0..251
+    Value singleByteValue(BoolValue<true>) {
+        return getRandom(252) - 126;
+    }
+
+    // 0..246, bytes 1..247
+    Value singleByteValue(BoolValue<false>) {
+        return getRandom(247);
+    }
+
+    Value multiByteValue()
+    {
+        Value value = static_cast<Value>(250 + getBIRandom(getRandom(2) ? 100000 : 1000000000000ll));
+        return std::is_signed<Value>::value && getRandom(2) ? -value : value;
+    }
+
+    Value smallValue() {
+        return smallValue(BoolValue<std::is_signed<Value>::value>());
+    }
+
+    Value smallValue(BoolValue<true>) {
+        return getRandom(4) ? getRandom(126) : singleByteValue();
+    }
+
+    Value smallValue(BoolValue<false>) {
+        return singleByteValue();
+    }
+
+    void fillRandom()
+    {
+        values_.clear();
+
+        while (values_.size() < Values)
+        {
+            // Runs of single-byte codes shorter and longer than a chunk,
+            // separated by one or more multi-byte codes.
+            int32_t run = getRandom(4) ? getRandom(80) : getRandom(8);
+            for (int32_t c = 0; c < run; c++) {
+                values_.push_back(smallValue());
+            }
+
+            int32_t multi = 1 + (getRandom(4) == 0 ? getRandom(3) : 0);
+            for (int32_t c = 0; c < multi; c++) {
+                values_.push_back(multiByteValue());
+            }
+        }
+
+        Codec codec;
+
+        size_t size = 0;
+        for (const Value& value: values_) {
+            size += codec.length(value);
+        }
+
+        // Bytes past the codes are single-byte codes, kernels must not
+        // take them.
+        buffer_.assign(size + Padding, 1);
+        offsets_.clear();
+
+        size_t pos = 0;
+        for (const Value& value: values_)
+        {
+            offsets_.push_back(pos);
+            pos += codec.encode(buffer_.data(), value, pos);
+        }
+
+        offsets_.push_back(pos);
+    }
+
+    // Random code boundaries pos <= limit
+    void randomRange()
+    {
+        size_t start = getRandom(values_.size() + 1);
+        size_t end   = getRandom(4) ? values_.size() : start + getRandom(values_.size() - start + 1);
+
+        pos_   = offsets_[start];
+        limit_ = offsets_[end];
+        max_   = getRandom(2) ? static_cast<int32_t>(values_.size()) : getRandom(200);
+    }
+
+    template <typename Fn>
+    void forBothPaths(Fn&& fn)
+    {
+        CpuFeatures::set_portable(false);
+        fn();
+
+        CpuFeatures::set_portable(true);
+        fn();
+
+        CpuFeatures::set_portable(false);
+    }
+
+    void testSkip()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    randomRange();
+
+                    int32_t cnt1 = -1, cnt2 = -1;
+                    size_t pos1 = Decoder::skip_portable(buffer_.data(), pos_, limit_, max_, cnt1);
+                    size_t pos2 = Decoder::skip(buffer_.data(), pos_, limit_, max_, cnt2);
+
+                    assert_equals(pos1, pos2, "{} {} {}", pos_, limit_, max_);
+                    assert_equals(cnt1, cnt2, "{} {} {}", pos_, limit_, max_);
+                }
+            }
+        });
+    }
+
+    void testSum()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    randomRange();
+
+                    Value sum1 = 5, sum2 = 5;
+                    int32_t cnt1 = -1, cnt2 = -1;
+
+                    size_t pos1 = Decoder::sum_portable(buffer_.data(), pos_, limit_, max_, cnt1, sum1);
+                    size_t pos2 = Decoder::sum(buffer_.data(), pos_, limit_, max_, cnt2, sum2);
+
+                    assert_equals(pos1, pos2, "{} {} {}", pos_, limit_, max_);
+                    assert_equals(cnt1, cnt2, "{} {} {}", pos_, limit_, max_);
+                    assert_equals(sum1, sum2, "{} {} {}", pos_, limit_, max_);
+                }
+            }
+        });
+    }
+
+    void testDecode()
+    {
+        forBothPaths([&]{
+            std::vector<Value> values1(Values * 2);
+            std::vector<Value> values2(Values * 2);
+
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    randomRange();
+
+                    int32_t cnt1 = -1, cnt2 = -1;
+
+                    size_t pos1 = Decoder::decode_portable(buffer_.data(), pos_, limit_, values1.data(), max_, cnt1);
+                    size_t pos2 = Decoder::decode(buffer_.data(), pos_, limit_, values2.data(), max_, cnt2);
+
+                    assert_equals(pos1, pos2, "{} {} {}", pos_, limit_, max_);
+                    assert_equals(cnt1, cnt2, "{} {} {}", pos_, limit_, max_);
+
+                    for (int32_t e = 0; e < cnt1; e++) {
+                        assert_equals(values1[e], values2[e], "{} {} {} {}", pos_, limit_, max_, e);
+                    }
+                }
+            }
+        });
+    }
+
+    template <bool Strict>
+    void assertFind(Value start_sum, Value target)
+    {
+        target_ = static_cast<int64_t>(target);
+
+        Value sum1 = start_sum, sum2 = start_sum;
+        int32_t cnt1 = -1, cnt2 = -1;
+        bool found1 = false, found2 = true;
+
+        size_t pos1 = Decoder::template find_portable<Strict>(buffer_.data(), pos_, limit_, sum1, target, cnt1, found1);
+        size_t pos2 = Decoder::template find<Strict>(buffer_.data(), pos_, limit_, sum2, target, cnt2, found2);
+
+        assert_equals(found1, found2, "{} {} {} {}", pos_, limit_, target_, Strict);
+        assert_equals(pos1, pos2, "{} {} {} {}", pos_, limit_, target_, Strict);
+        assert_equals(cnt1, cnt2, "{} {} {} {}", pos_, limit_, target_, Strict);
+        assert_equals(sum1, sum2, "{} {} {} {}", pos_, limit_, target_, Strict);
+    }
+
+    void testFind()
+    {
+        forBothPaths([&]{
+            for (int32_t c = 0; c < 20; c++)
+            {
+                fillRandom();
+
+                for (int32_t d = 0; d < 500; d++)
+                {
+                    randomRange();
+
+                    // Prefix sums of the range: targets hit them exactly,
+                    // fall between them and go past the end
+                    size_t start = std::lower_bound(offsets_.begin(), offsets_.end(), pos_) - offsets_.begin();
+                    size_t end   = std::lower_bound(offsets_.begin(), offsets_.end(), limit_) - offsets_.begin();
+
+                    Value start_sum = getRandom(100);
+                    Value prefix = start_sum;
+
+                    size_t idx = start + (end > start ? getRandom(end - start) : 0);
+                    for (size_t e = start; e < idx; e++) {
+                        prefix += values_[e];
+                    }
+
+                    assertFind<false>(start_sum, prefix);
+                    assertFind<true>(start_sum, prefix);
+                    assertFind<false>(start_sum, prefix + 1);
+                    assertFind<true>(start_sum, prefix - 1);
+
+                    assertFind<false>(start_sum, start_sum);
+                    assertFind<true>(start_sum, start_sum);
+
+                    Value total = start_sum;
+                    for (size_t e = start; e < end; e++) {
+                        total += values_[e];
+                    }
+
+                    assertFind<false>(start_sum, total + 1000000);
+                    assertFind<true>(start_sum, total + 1000000);
+                }
+            }
+        });
+    }
+};
+
+}}
@@ -0,0 +1,266 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include "set_test.hpp"
+
+#include <memoria/core/tools/bitmap.hpp>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+// Set::find_many(), that is ctr_find_max_ge_many(), against the set's
+// contents: batches of sorted, unsorted and repeated keys, keys missing
+// from the set, below its minimum and above its maximum, and batches of
+// sizes around the found bitmap's word boundaries.
+template <
+    typename DataType,
+    typename CxxValueType,
+    typename ProfileT = DefaultProfile<>,
+    typename StoreT   = IMemoryStorePtr<ProfileT>
+>
+class SetFindManyTest: public BTTestBase<Set<DataType>, ProfileT, StoreT>
+{
+    using MyType = SetFindManyTest;
+
+    using Base   = BTTestBase<Set<DataType>, ProfileT, StoreT>;
+
+    using typename Base::CtrApi;
+
+    using CxxElementViewType  = DTTViewType<DataType>;
+    using ValueTools          = internal_set::ValueTools<CxxValueType>;
+
+    int64_t size_{20000};
+    int32_t batches_{200};
+
+    using Base::branch;
+    using Base::commit;
+    using Base::getRandom;
+
+public:
+    MMA_STATE_FILEDS(size_, batches_)
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testEmpty, testFindMany, testAfterRemove)
+    }
+
+    static const UUID& view(const UUID& value) noexcept {
+        return value;
+    }
+
+    static U8StringView view(const U8String& value) noexcept {
+        return value.view();
+    }
+
+    CtrSharedPtr<CtrApi> createSet()
+    {
+        auto snp = branch();
+
+        auto ctr = create<Set<DataType>>(snp, Set<DataType>{}).get_or_throw();
+        ctr->set_new_block_size(1024).get_or_throw();
+
+        return ctr;
+    }
+
+    void populate(CtrSharedPtr<CtrApi>& ctr, std::vector<CxxValueType>& entries)
+    {
+        for (int64_t c = 0; c < size_; c++)
+        {
+            entries.push_back(ValueTools::generate_random());
+            ctr->insert(view(entries.back())).get_or_throw();
+        }
+
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+        assert_equals((int64_t)entries.size(), ctr->size().get_or_throw());
+    }
+
+    void assertFindMany(CtrSharedPtr<CtrApi>& ctr, const std::set<CxxValueType>& entries, const std::vector<CxxValueType>& keys)
+    {
+        std::vector<CxxElementViewType> views;
+        for (const auto& key: keys) {
+            views.push_back(view(key));
+        }
+
+        // Stale bits must be cleared
+        std::vector<uint64_t> found(keys.size() / 64 + 1, static_cast<uint64_t>(-1));
+
+        ctr->find_many(
+            Span<const CxxElementViewType>(views.data(), views.size()),
+            Span<uint64_t>(found.data(), found.size())
+        ).get_or_throw();
+
+        for (size_t c = 0; c < keys.size(); c++)
+        {
+            bool expected = entries.count(keys[c]) > 0;
+            assert_equals(expected, (bool)GetBit(found.data(), c), "{} {} {}", c, keys.size(), keys[c]);
+            assert_equals(expected, ctr->contains(views[c]).get_or_throw(), "{}", keys[c]);
+        }
+
+        for (size_t c = keys.size(); c < found.size() * 64; c++) {
+            assert_equals(0, GetBit(found.data(), c), "{} {}", c, keys.size());
+        }
+    }
+
+    std::vector<CxxValueType> randomKeys(const std::vector<CxxValueType>& entries, size_t size, bool sorted)
+    {
+        std::vector<CxxValueType> keys;
+
+        int32_t present = getRandom(5);
+        for (size_t c = 0; c < size; c++)
+        {
+            if (entries.size() > 0 && getRandom(4) < present) {
+                keys.push_back(entries[getRandom(entries.size())]);
+            }
+            else if (keys.size() > 0 && getRandom(8) == 0) {
+                // Repeated key
+                keys.push_back(keys[getRandom(keys.size())]);
+            }
+            else {
+                keys.push_back(ValueTools::generate_random());
+            }
+        }
+
+        if (sorted) {
+            std::sort(keys.begin(), keys.end());
+        }
+
+        return keys;
+    }
+
+    void assertRandomBatches(CtrSharedPtr<CtrApi>& ctr, const std::vector<CxxValueType>& entries)
+    {
+        std::set<CxxValueType> entries_set(entries.begin(), entries.end());
+
+        size_t sizes[] = {0, 1, 2, 63, 64, 65, 128, 1000};
+
+        for (int32_t c = 0; c < batches_; c++)
+        {
+            size_t size = getRandom(2) ? sizes[getRandom(8)] : getRandom(3000);
+            assertFindMany(ctr, entries_set, randomKeys(entries, size, getRandom(2)));
+        }
+
+        if (entries.size() > 0)
+        {
+            // All keys, in order and reversed
+            assertFindMany(ctr, entries_set, entries);
+
+            std::vector<CxxValueType> keys(entries.rbegin(), entries.rend());
+            assertFindMany(ctr, entries_set, keys);
+
+            // Runs of keys from the same leaves
+            keys.clear();
+            for (int32_t c = 0; c < 20; c++)
+            {
+                size_t start = getRandom(entries.size());
+                size_t end   = std::min(entries.size(), start + getRandom(200));
+
+                keys.insert(keys.end(), entries.begin() + start, entries.begin() + end);
+            }
+
+            assertFindMany(ctr, entries_set, keys);
+
+            // Every other key is below the minimum or above the maximum
+            // of the set
+            keys.clear();
+            for (int32_t c = 0; c < 100; c++)
+            {
+                keys.push_back(getRandom(2) ? entries.front() : entries.back());
+                keys.push_back(ValueTools::generate_random());
+            }
+
+            for (const auto& key: keys)
+            {
+                if (key < entries.front() || entries.back() < key)
+                {
+                    std::vector<CxxValueType> outside{key, entries.back(), key};
+                    assertFindMany(ctr, entries_set, outside);
+                }
+            }
+
+            assertFindMany(ctr, entries_set, keys);
+        }
+    }
+
+    void testEmpty()
+    {
+        auto ctr = createSet();
+
+        std::vector<CxxValueType> entries;
+        assertRandomBatches(ctr, entries);
+
+        // The found bitmap is too small
+        std::vector<CxxValueType> keys = randomKeys(entries, 65, false);
+        std::vector<CxxElementViewType> views;
+        for (const auto& key: keys) {
+            views.push_back(view(key));
+        }
+
+        uint64_t found{};
+        assert_equals(true, ctr->find_many(
+            Span<const CxxElementViewType>(views.data(), views.size()),
+            Span<uint64_t>(&found, 1)
+        ).is_error());
+
+        commit();
+    }
+
+    void testFindMany()
+    {
+        auto ctr = createSet();
+
+        std::vector<CxxValueType> entries;
+        populate(ctr, entries);
+
+        assertRandomBatches(ctr, entries);
+
+        commit();
+    }
+
+    void testAfterRemove()
+    {
+        auto ctr = createSet();
+
+        std::vector<CxxValueType> entries;
+        populate(ctr, entries);
+
+        // Leaves are merged and the tree gets lower
+        std::vector<CxxValueType> remaining;
+        for (const auto& key: entries)
+        {
+            if (getRandom(10) == 0) {
+                remaining.push_back(key);
+            }
+            else {
+                ctr->remove(view(key)).get_or_throw();
+            }
+        }
+
+        assert_equals((int64_t)remaining.size(), ctr->size().get_or_throw());
+
+        assertRandomBatches(ctr, remaining);
+
+        commit();
+    }
+};
+
+}}
@@ -15,6 +15,7 @@
 
 
 #include "set_test.hpp"
+#include "set_find_many_test.hpp"
 
 
 
@@ -26,6 +27,9 @@ namespace {
 auto Suite1 = register_class_suite<SetTest<UUID, UUID>>("Set.UUID");
 auto Suite2 = register_class_suite<SetTest<Varchar, U8String>>("Set.Varchar");
 
+auto Suite3 = register_class_suite<SetFindManyTest<UUID, UUID>>("Set.UUID.FindMany");
+auto Suite4 = register_class_suite<SetFindManyTest<Varchar, U8String>>("Set.Varchar.FindMany");
+
 }
 
 }}
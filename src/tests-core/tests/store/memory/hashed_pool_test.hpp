@@ -0,0 +1,230 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/store/memory/common/hashed_pool.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+namespace _ {
+
+struct HashedPoolTestObject {
+    uint64_t id{};
+    int32_t inits{};
+
+    void init() noexcept {
+        inits++;
+    }
+};
+
+// All IDs hash to the last few slots of the table, so probe sequences
+// are long and wrap around its end.
+struct HashedPoolClusteredHash {
+    uint64_t operator()(const uint64_t& id) const noexcept {
+        return static_cast<uint64_t>(-1) - id % 5;
+    }
+};
+
+}
+
+template <typename Hash>
+class HashedPoolTest: public TestState {
+
+    using MyType = HashedPoolTest<Hash>;
+    using Base   = TestState;
+
+    using Object = _::HashedPoolTestObject;
+    using Pool   = HashedPool<uint64_t, Object, Hash>;
+
+    int64_t ops_{100000};
+    int32_t max_ids_{2000};
+
+public:
+    MMA_STATE_FILEDS(ops_, max_ids_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testRandomOps, testReleaseAll, testClear, testReleaseUnknown)
+    }
+
+    uint64_t randomId() {
+        // ID{} is the empty slot marker
+        return 1 + getRandom(max_ids_);
+    }
+
+    static const void* ptr(const Object* object) noexcept {
+        return object;
+    }
+
+    Object* allocate(Pool& pool, std::unordered_map<uint64_t, Object*>& objects, uint64_t id)
+    {
+        Object* object = pool.allocate(id);
+        object->id = id;
+        objects[id] = object;
+        return object;
+    }
+
+    void assertContents(Pool& pool, const std::unordered_map<uint64_t, Object*>& objects)
+    {
+        assert_equals(static_cast<int32_t>(objects.size()), pool.getUsage());
+
+        for (const auto& entry: objects)
+        {
+            Object* object = pool.get(entry.first);
+
+            // Objects don't move while they are in the pool
+            assert_equals(ptr(entry.second), ptr(object), "{}", entry.first);
+            assert_equals(entry.first, object->id, "{}", entry.first);
+        }
+    }
+
+    void testRandomOps()
+    {
+        Pool pool;
+        std::unordered_map<uint64_t, Object*> objects;
+
+        for (int64_t c = 0; c < ops_; c++)
+        {
+            uint64_t id = randomId();
+            auto ii = objects.find(id);
+
+            if (ii == objects.end())
+            {
+                assert_equals(ptr(nullptr), ptr(pool.get(id)), "{}", id);
+
+                allocate(pool, objects, id);
+            }
+            else {
+                assert_equals(ptr(ii->second), ptr(pool.get(id)), "{}", id);
+
+                // Grow and shrink in turns
+                if ((c / 10000) % 2 == 0 ? getRandom(3) == 0 : getRandom(3) != 0)
+                {
+                    pool.release(id);
+                    objects.erase(ii);
+
+                    assert_equals(ptr(nullptr), ptr(pool.get(id)), "{}", id);
+                }
+            }
+
+            if (c % 1000 == 0) {
+                assertContents(pool, objects);
+            }
+        }
+
+        assertContents(pool, objects);
+        assert_ge(pool.getMax(), pool.getUsage());
+    }
+
+    void testReleaseAll()
+    {
+        Pool pool;
+        std::unordered_map<uint64_t, Object*> objects;
+
+        std::vector<uint64_t> ids;
+        for (int32_t c = 1; c <= max_ids_; c++)
+        {
+            allocate(pool, objects, c);
+            ids.push_back(c);
+        }
+
+        assertContents(pool, objects);
+
+        // Holes are punched in the middle of probe sequences
+        for (size_t c = ids.size(); c > 0; c--)
+        {
+            std::swap(ids[c - 1], ids[getRandom(c)]);
+        }
+
+        for (size_t c = 0; c < ids.size(); c++)
+        {
+            pool.release(ids[c]);
+            objects.erase(ids[c]);
+
+            if (c % 100 == 0) {
+                assertContents(pool, objects);
+            }
+        }
+
+        assert_equals(0, pool.getUsage());
+        assert_equals(max_ids_, pool.getMax());
+    }
+
+    void testClear()
+    {
+        Pool pool;
+        std::unordered_map<uint64_t, Object*> objects;
+
+        for (int32_t c = 1; c <= 500; c++) {
+            allocate(pool, objects, c);
+        }
+
+        int32_t capacity = pool.getCapacity() + pool.getUsage();
+
+        pool.clear();
+
+        assert_equals(0, pool.getUsage());
+        for (int32_t c = 1; c <= 500; c++) {
+            assert_equals(ptr(nullptr), ptr(pool.get(c)), "{}", c);
+        }
+
+        // Objects are reused, no chunks are added
+        objects.clear();
+        for (int32_t c = 501; c <= 1000; c++) {
+            allocate(pool, objects, c);
+        }
+
+        assertContents(pool, objects);
+        assert_equals(capacity, pool.getCapacity() + pool.getUsage());
+
+        // and initialized again
+        for (const auto& entry: objects) {
+            assert_equals(2, entry.second->inits, "{}", entry.first);
+        }
+    }
+
+    void testReleaseUnknown()
+    {
+        Pool pool;
+        std::unordered_map<uint64_t, Object*> objects;
+
+        for (int32_t c = 1; c <= 100; c++) {
+            allocate(pool, objects, c);
+        }
+
+        assert_throws<Exception>([&]{
+            pool.release(101);
+        });
+
+        pool.release(50);
+        objects.erase(50);
+
+        assert_throws<Exception>([&]{
+            pool.release(50);
+        });
+
+        assertContents(pool, objects);
+    }
+};
+
+}}
@@ -0,0 +1,309 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+#include <memoria/tests/tools.hpp>
+
+#include <memoria/profiles/default/default.hpp>
+#include <memoria/api/store/memory_store_api.hpp>
+#include <memoria/api/map/map_api.hpp>
+
+#include <map>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+// IMemoryStore::store_delta() and load_chain(): a full image followed by
+// delta images is loaded back with all snapshots of the chain, including
+// ones written by earlier images and dropped since.
+class MemoryStoreDeltaTest: public TestState {
+
+    using MyType = MemoryStoreDeltaTest;
+    using Base   = TestState;
+
+    using Profile  = DefaultProfile<>;
+    using Store    = IMemoryStore<Profile>;
+    using StorePtr = typename Store::StorePtr;
+    using MapType  = Map<BigInt, BigInt>;
+
+    using Entries = std::map<int64_t, int64_t>;
+
+    struct SnapshotEntries {
+        UUID snapshot_id;
+        Entries entries;
+    };
+
+    int32_t deltas_{6};
+    int32_t updates_{3000};
+
+    UUID ctr_id_{UUID::parse("c3e1f2b4-5a8d-4e1b-9f0a-7d6c5b4a3921")};
+
+public:
+    MMA_STATE_FILEDS(deltas_, updates_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testChain, testDroppedSnapshots, testContinueChain, testBrokenChain)
+    }
+
+    U8String imageFile(const char* name, int32_t num)
+    {
+        filesystem::path path = this->working_directory_;
+        path.append(format_u8("{}-{}.mma1", name, num).to_std_string());
+
+        return path.string();
+    }
+
+    // Commits a snapshot of random updates on top of the master
+    UUID commitUpdates(StorePtr& store, Entries& entries)
+    {
+        auto snp = store->master().get_or_throw()->branch().get_or_throw();
+
+        auto ctr = find_or_create<MapType>(snp, MapType{}, ctr_id_).get_or_throw();
+
+        for (int32_t c = 0; c < updates_; c++)
+        {
+            int64_t key = getRandom(updates_ * 2);
+            if (getRandom(4) == 0)
+            {
+                ctr->remove_key(key).get_or_throw();
+                entries.erase(key);
+            }
+            else {
+                int64_t value = getBIRandom();
+                ctr->assign_key(key, value).get_or_throw();
+                entries[key] = value;
+            }
+        }
+
+        snp->commit().get_or_throw();
+        snp->set_as_master().get_or_throw();
+
+        return snp->uuid();
+    }
+
+    void assertSnapshot(StorePtr& store, const SnapshotEntries& expected)
+    {
+        auto snp = store->find(expected.snapshot_id).get_or_throw();
+        auto ctr = find<MapType>(snp, ctr_id_).get_or_throw();
+
+        assert_equals(expected.entries.size(), ctr->size().get_or_throw());
+
+        auto ii = ctr->iterator().get_or_throw();
+        for (const auto& entry: expected.entries)
+        {
+            assert_equals(false, ii->is_end());
+            assert_equals(entry.first, ii->key().view());
+            assert_equals(entry.second, ii->value().view(), "{}", entry.first);
+
+            ii->next().get_or_throw();
+        }
+    }
+
+    void assertLoaded(StorePtr& store, StorePtr& loaded, const std::vector<SnapshotEntries>& snapshots)
+    {
+        tests::check(loaded, "Loaded store structure checking", MMA_SRC);
+
+        for (const auto& snapshot: snapshots) {
+            assertSnapshot(loaded, snapshot);
+        }
+
+        assert_equals(store->master().get_or_throw()->uuid(), loaded->master().get_or_throw()->uuid());
+
+        // Nothing but the live data is in the loaded store
+        assert_equals(
+            store->memory_stat().get_or_throw()->total_size(),
+            loaded->memory_stat().get_or_throw()->total_size()
+        );
+    }
+
+    void testChain()
+    {
+        StorePtr store = Store::create().get_or_throw();
+
+        // No full image to continue
+        assert_equals(true, store->store_delta(imageFile("chain", 1)).is_error());
+
+        std::vector<SnapshotEntries> snapshots;
+        std::vector<U8String> files;
+
+        Entries entries;
+
+        snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+
+        files.push_back(imageFile("chain", 0));
+        store->store(files.back()).get_or_throw();
+
+        for (int32_t c = 1; c <= deltas_; c++)
+        {
+            // Several snapshots per delta
+            for (int32_t d = 0; d < c % 3 + 1; d++) {
+                snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+            }
+
+            files.push_back(imageFile("chain", c));
+            store->store_delta(files.back()).get_or_throw();
+
+            StorePtr loaded = Store::load_chain(files).get_or_throw();
+            assertLoaded(store, loaded, snapshots);
+        }
+
+        // A delta with no changes
+        files.push_back(imageFile("chain", deltas_ + 1));
+        store->store_delta(files.back()).get_or_throw();
+
+        StorePtr loaded = Store::load_chain(files).get_or_throw();
+        assertLoaded(store, loaded, snapshots);
+    }
+
+    void testDroppedSnapshots()
+    {
+        StorePtr store = Store::create().get_or_throw();
+
+        std::vector<SnapshotEntries> snapshots;
+        std::vector<U8String> files;
+
+        Entries entries;
+
+        for (int32_t c = 0; c < 3; c++) {
+            snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+        }
+
+        files.push_back(imageFile("dropped", 0));
+        store->store(files.back()).get_or_throw();
+
+        std::vector<UUID> dropped;
+
+        for (int32_t c = 1; c <= deltas_; c++)
+        {
+            snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+            snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+
+            // Snapshots of earlier images and of this one are dropped
+            for (int32_t d = 0; d < 2 && snapshots.size() > 2; d++)
+            {
+                size_t idx = getRandom(snapshots.size() - 1);
+
+                store->find(snapshots[idx].snapshot_id).get_or_throw()->drop().get_or_throw();
+                dropped.push_back(snapshots[idx].snapshot_id);
+
+                snapshots.erase(snapshots.begin() + idx);
+            }
+
+            store->pack().get_or_throw();
+
+            files.push_back(imageFile("dropped", c));
+            store->store_delta(files.back()).get_or_throw();
+
+            StorePtr loaded = Store::load_chain(files).get_or_throw();
+            assertLoaded(store, loaded, snapshots);
+
+            for (const UUID& snapshot_id: dropped) {
+                assert_equals(true, loaded->find(snapshot_id).is_error(), "{}", snapshot_id);
+            }
+        }
+    }
+
+    void testContinueChain()
+    {
+        StorePtr store = Store::create().get_or_throw();
+
+        std::vector<SnapshotEntries> snapshots;
+        std::vector<U8String> files;
+
+        Entries entries;
+
+        snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+        files.push_back(imageFile("continue", 0));
+        store->store(files.back()).get_or_throw();
+
+        snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+        files.push_back(imageFile("continue", 1));
+        store->store_delta(files.back()).get_or_throw();
+
+        // The loaded store writes the next delta of the chain
+        for (int32_t c = 2; c <= deltas_; c++)
+        {
+            store = Store::load_chain(files).get_or_throw();
+
+            snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+            files.push_back(imageFile("continue", c));
+            store->store_delta(files.back()).get_or_throw();
+        }
+
+        StorePtr loaded = Store::load_chain(files).get_or_throw();
+        assertLoaded(store, loaded, snapshots);
+
+        // A full image starts a new chain
+        snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+
+        std::vector<U8String> files2;
+        files2.push_back(imageFile("continue2", 0));
+        store->store(files2.back()).get_or_throw();
+
+        snapshots.push_back(SnapshotEntries{commitUpdates(store, entries), entries});
+        files2.push_back(imageFile("continue2", 1));
+        store->store_delta(files2.back()).get_or_throw();
+
+        loaded = Store::load_chain(files2).get_or_throw();
+        assertLoaded(store, loaded, snapshots);
+    }
+
+    void testBrokenChain()
+    {
+        StorePtr store = Store::create().get_or_throw();
+
+        Entries entries;
+        commitUpdates(store, entries);
+
+        U8String full1 = imageFile("broken", 0);
+        store->store(full1).get_or_throw();
+
+        std::vector<U8String> deltas;
+        for (int32_t c = 1; c <= 3; c++)
+        {
+            commitUpdates(store, entries);
+
+            deltas.push_back(imageFile("broken", c));
+            store->store_delta(deltas.back()).get_or_throw();
+        }
+
+        U8String full2 = imageFile("broken", 4);
+        store->store(full2).get_or_throw();
+
+        assert_equals(true, Store::load_chain(std::vector<U8String>{}).is_error());
+
+        // Must start from a full image
+        assert_equals(true, Store::load_chain(std::vector<U8String>{deltas[0]}).is_error());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{deltas[0], full1}).is_error());
+
+        // and continue with deltas of it, in order
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full1, full2}).is_error());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full1, deltas[1]}).is_error());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full1, deltas[0], deltas[2]}).is_error());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full1, deltas[1], deltas[0]}).is_error());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full2, deltas[0]}).is_error());
+
+        // Deltas of a chain may be loaded partially
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full1, deltas[0], deltas[1]}).is_ok());
+        assert_equals(true, Store::load_chain(std::vector<U8String>{full2}).is_ok());
+    }
+};
+
+}}
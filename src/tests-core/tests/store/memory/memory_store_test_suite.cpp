@@ -0,0 +1,40 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hashed_pool_test.hpp"
+#include "memory_store_delta_test.hpp"
+#include "published_map_test.hpp"
+
+namespace memoria {
+namespace tests {
+
+namespace {
+
+using Suite1 = HashedPoolTest<HashedPoolHash<uint64_t>>;
+MMA_CLASS_SUITE(Suite1, "Store.Memory.HashedPool");
+
+using Suite2 = HashedPoolTest<_::HashedPoolClusteredHash>;
+MMA_CLASS_SUITE(Suite2, "Store.Memory.HashedPool.Clustered");
+
+MMA_CLASS_SUITE(MemoryStoreDeltaTest, "Store.Memory.DeltaImages");
+
+using Suite3 = PublishedMapTest<HashedPoolHash<uint64_t>>;
+MMA_CLASS_SUITE(Suite3, "Store.Memory.PublishedMap");
+
+using Suite4 = PublishedMapTest<_::PublishedMapClusteredHash>;
+MMA_CLASS_SUITE(Suite4, "Store.Memory.PublishedMap.Clustered");
+
+}
+
+}}
@@ -0,0 +1,237 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/store/memory_cow/common/published_map.hpp>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+namespace _ {
+
+// All keys go to a few buckets of the same table
+struct PublishedMapClusteredHash {
+    uint64_t operator()(const uint64_t& key) const noexcept {
+        return key % 3;
+    }
+};
+
+}
+
+template <typename Hash>
+class PublishedMapTest: public TestState {
+
+    using MyType = PublishedMapTest<Hash>;
+    using Base   = TestState;
+
+    using Map     = PublishedMap<uint64_t, uint64_t, Hash>;
+    using Root    = typename Map::Root;
+    using Entries = std::unordered_map<uint64_t, uint64_t>;
+    using Parts   = std::vector<const PublishedMapPart*>;
+
+    // A version, its contents and parts it doesn't share with the next one
+    struct Version {
+        const Root* root;
+        Entries entries;
+        Parts replaced;
+    };
+
+    int32_t updates_{2000};
+    int32_t max_keys_{5000};
+
+public:
+    MMA_STATE_FILEDS(updates_, max_keys_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testVersions, testRemoveAll, testAbandoned)
+    }
+
+    void assertContents(const Root* root, const Entries& entries)
+    {
+        size_t size{};
+        Map::for_each(root, [&](const uint64_t& key, const uint64_t& value) {
+            auto ii = entries.find(key);
+            assert_equals(true, ii != entries.end(), "{}", key);
+            assert_equals(ii->second, value, "{}", key);
+            size++;
+        });
+
+        assert_equals(entries.size(), size);
+
+        for (const auto& entry: entries)
+        {
+            const uint64_t* value = Map::find(root, entry.first);
+            assert_equals(true, value != nullptr, "{}", entry.first);
+            assert_equals(entry.second, *value, "{}", entry.first);
+        }
+    }
+
+    void deleteParts(const Parts& parts)
+    {
+        for (auto part: parts) {
+            delete part;
+        }
+    }
+
+    // Random assigns and removes, including removes of missing keys
+    const Root* update(const Root* root, Entries& entries, Parts& replaced)
+    {
+        typename Map::Update update(root);
+
+        int32_t changes = 1 + getRandom(getRandom(10) ? 10 : 500);
+        for (int32_t c = 0; c < changes; c++)
+        {
+            uint64_t key = getRandom(max_keys_);
+            if (getRandom(3) == 0)
+            {
+                update.remove(key);
+                entries.erase(key);
+            }
+            else {
+                uint64_t value = getBIRandom();
+                update.assign(key, value);
+                entries[key] = value;
+            }
+        }
+
+        replaced.reserve(update.replaced());
+        return update.finish(replaced);
+    }
+
+    void testVersions()
+    {
+        // Previous versions stay intact while they are not retired
+        std::deque<Version> versions;
+        versions.push_back(Version{nullptr, Entries{}, Parts{}});
+
+        for (int32_t c = 0; c < updates_; c++)
+        {
+            Version& last = versions.back();
+
+            Entries entries = last.entries;
+            const Root* root = update(last.root, entries, last.replaced);
+
+            versions.push_back(Version{root, std::move(entries), Parts{}});
+
+            if (versions.size() > 8)
+            {
+                deleteParts(versions.front().replaced);
+                versions.pop_front();
+            }
+
+            if (c % 10 == 0)
+            {
+                for (const auto& version: versions) {
+                    assertContents(version.root, version.entries);
+                }
+            }
+        }
+
+        for (size_t c = 0; c < versions.size() - 1; c++) {
+            deleteParts(versions[c].replaced);
+        }
+
+        Map::destroy(versions.back().root);
+    }
+
+    void testRemoveAll()
+    {
+        Entries entries;
+        Parts replaced;
+
+        const Root* root{};
+        {
+            typename Map::Update update(root);
+            for (int32_t c = 0; c < max_keys_; c++)
+            {
+                update.assign(c, c * 2);
+                entries[c] = c * 2;
+            }
+
+            root = update.finish(replaced);
+        }
+
+        assertContents(root, entries);
+
+        // Keys are removed in several updates, the last one
+        // leaves no buckets
+        for (int32_t step = 0; step < 4; step++)
+        {
+            typename Map::Update update(root);
+            for (int32_t c = step; c < max_keys_; c += 4)
+            {
+                update.remove(c);
+                entries.erase(c);
+            }
+
+            replaced.reserve(replaced.size() + update.replaced());
+            root = update.finish(replaced);
+
+            assertContents(root, entries);
+        }
+
+        assert_equals(true, Map::find(root, 0) == nullptr);
+
+        deleteParts(replaced);
+        Map::destroy(root);
+    }
+
+    void testAbandoned()
+    {
+        Entries entries;
+        Parts replaced;
+
+        const Root* root = update(nullptr, entries, replaced);
+        assert_equals(0, replaced.size());
+
+        for (int32_t c = 0; c < 100; c++)
+        {
+            // Copies of an abandoned update are deleted, its base
+            // is not changed
+            {
+                typename Map::Update update(root);
+                for (int32_t d = 0; d < 50; d++)
+                {
+                    update.assign(getRandom(max_keys_), getBIRandom());
+                    update.remove(getRandom(max_keys_));
+                }
+            }
+
+            assertContents(root, entries);
+
+            // An update without changes returns its base
+            typename Map::Update update(root);
+            update.remove(max_keys_ + 1);
+
+            Parts none;
+            assert_equals(true, update.finish(none) == root);
+            assert_equals(0, none.size());
+        }
+
+        deleteParts(replaced);
+        Map::destroy(root);
+    }
+};
+
+}}
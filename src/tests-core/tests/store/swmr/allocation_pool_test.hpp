@@ -0,0 +1,325 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/profiles/memory_cow/memory_cow_profile.hpp>
+#include <memoria/store/swmr/common/allocation_pool.hpp>
+
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+class AllocationPoolTest: public TestState {
+
+    using MyType = AllocationPoolTest;
+    using Base   = TestState;
+
+    using Profile     = MemoryCoWProfile<>;
+    using AlcMetadata = AllocationMetadata<Profile>;
+
+    static constexpr int32_t Levels = 4;
+
+    using Pool = AllocationPool<Profile, Levels>;
+
+    // Level-0 units of the random test
+    enum class Unit: uint8_t {FREE, POOLED, ALLOCATED};
+
+    int64_t units_{1 << 14};
+
+public:
+    MMA_STATE_FILEDS(units_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testSequential, testHeadIndex, testUnsortedAdd, testSplitFromAbove, testAddUnreserved, testRandom)
+    }
+
+    void assertExtent(const AlcMetadata& alc, int64_t position, int64_t size, int32_t level)
+    {
+        assert_equals(position, alc.position());
+        assert_equals(size, alc.size());
+        assert_equals(level, alc.level());
+    }
+
+    void testSequential()
+    {
+        Pool pool;
+
+        assert_equals(false, (bool)pool.allocate_one(0));
+
+        // Adjacent extents are merged
+        pool.add(AlcMetadata{100, 10, 0});
+        pool.add(AlcMetadata{110, 10, 0});
+        pool.add(AlcMetadata{200, 5, 0});
+        pool.add(AlcMetadata{0, 0, 0});
+
+        assert_equals(25, pool.available(0));
+        assert_equals(0, pool.available(1));
+
+        for (int64_t c = 0; c < 20; c++) {
+            assertExtent(pool.allocate_one(0).get(), 100 + c, 1, 0);
+        }
+
+        ArenaBuffer<AlcMetadata> buffer;
+
+        // Not enough units: nothing is allocated
+        pool.allocate(0, 6, buffer);
+        assert_equals(0, buffer.size());
+        assert_equals(5, pool.available(0));
+
+        pool.allocate(0, 5, buffer);
+        assert_equals(1, buffer.size());
+        assertExtent(buffer[0], 200, 5, 0);
+
+        assert_equals(0, pool.available(0));
+        assert_equals(false, (bool)pool.allocate_one(0));
+    }
+
+    void testHeadIndex()
+    {
+        Pool pool;
+
+        // Many single-unit extents, so the head moves past the compaction
+        // threshold several times, with extents added behind the head
+        int64_t next = 0;
+        for (int32_t c = 0; c < 100; c++, next += 2) {
+            pool.add(AlcMetadata{next, 1, 0});
+        }
+
+        int64_t expected = 0;
+        for (int32_t round = 0; round < 10; round++)
+        {
+            for (int32_t c = 0; c < 90; c++, expected += 2) {
+                assertExtent(pool.allocate_one(0).get(), expected, 1, 0);
+            }
+
+            for (int32_t c = 0; c < 90; c++, next += 2) {
+                pool.add(AlcMetadata{next, 1, 0});
+            }
+
+            assert_equals(100, pool.available(0));
+        }
+
+        ArenaBuffer<AlcMetadata> buffer;
+        pool.allocate(0, 100, buffer);
+
+        assert_equals(100, buffer.size());
+        for (int32_t c = 0; c < 100; c++, expected += 2) {
+            assertExtent(buffer[c], expected, 1, 0);
+        }
+
+        assert_equals(0, pool.available(0));
+    }
+
+    void testUnsortedAdd()
+    {
+        Pool pool;
+
+        pool.add(AlcMetadata{50, 2, 1});
+        pool.add(AlcMetadata{10, 2, 1});
+        pool.add(AlcMetadata{30, 2, 1});
+        pool.add(AlcMetadata{12, 2, 1});
+
+        // Extents are taken in position order
+        assertExtent(pool.allocate_one(1).get(), 10, 1, 1);
+        assertExtent(pool.allocate_one(1).get(), 11, 1, 1);
+
+        // Added before the remaining extents
+        pool.add(AlcMetadata{20, 1, 1});
+
+        int64_t positions[] = {12, 13, 20, 30, 31, 50, 51};
+        for (int64_t pos: positions) {
+            assertExtent(pool.allocate_one(1).get(), pos, 1, 1);
+        }
+
+        assert_equals(0, pool.available(0));
+    }
+
+    void testSplitFromAbove()
+    {
+        Pool pool;
+
+        pool.add(AlcMetadata{10, 2, 3});
+        pool.add(AlcMetadata{3, 1, 1});
+
+        assert_equals(16 + 2, pool.available(0));
+        assert_equals(8 + 1, pool.available(1));
+        assert_equals(2, pool.available(3));
+
+        // Level 0 is empty, the nearest non-empty level is 1
+        assertExtent(pool.allocate_one(0).get(), 6, 1, 0);
+        assertExtent(pool.allocate_one(0).get(), 7, 1, 0);
+
+        // Then one unit of level 3 is split, not both
+        assertExtent(pool.allocate_one(0).get(), 80, 1, 0);
+        assert_equals(1, pool.available(3));
+        assert_equals(15, pool.available(0));
+
+        // The rest of the split unit is taken first
+        ArenaBuffer<AlcMetadata> buffer;
+        pool.allocate(0, 9, buffer);
+
+        int64_t total{};
+        int64_t expected = 81;
+        for (size_t c = 0; c < buffer.size(); c++)
+        {
+            assert_equals(expected, buffer[c].position());
+            assert_equals(0, buffer[c].level());
+
+            expected += buffer[c].size();
+            total += buffer[c].size();
+        }
+
+        assert_equals(9, total);
+        assert_equals(6, pool.available(0));
+        assert_equals(0, pool.available(3));
+
+        // Level 2 from what is left of level 0 is not possible
+        assert_equals(false, (bool)pool.allocate_one(2));
+    }
+
+    void testAddUnreserved()
+    {
+        Pool pool;
+
+        // Level-0 units 4..7 are already in the pool
+        pool.add(AlcMetadata{4, 4, 0});
+
+        // Level-1 units 0..7 cover level-0 units 0..15, units 2 and 3
+        // overlap with the pool
+        AlcMetadata extents[] = {AlcMetadata{0, 8, 1}, AlcMetadata{2, 2, 3}};
+        pool.add_unreserved(Span<const AlcMetadata>(extents, 2));
+
+        assert_equals(6 + 8, pool.available(1));
+        assert_equals(2, pool.available(3));
+        assert_equals(4 + 12 + 16, pool.available(0));
+
+        // Nothing is added twice
+        pool.add_unreserved(Span<const AlcMetadata>(extents, 2));
+        assert_equals(6 + 8, pool.available(1));
+
+        int64_t positions[] = {0, 1, 4, 5, 6, 7};
+        for (int64_t pos: positions) {
+            assertExtent(pool.allocate_one(1).get(), pos, 1, 1);
+        }
+
+        assertExtent(pool.allocate_one(0).get(), 4, 1, 0);
+    }
+
+    void testRandom()
+    {
+        for (int32_t round = 0; round < 20; round++)
+        {
+            Pool pool;
+            std::vector<Unit> units(units_, Unit::FREE);
+
+            int64_t pooled{};
+
+            for (int32_t c = 0; c < 5000; c++)
+            {
+                if (getRandom(3) == 0)
+                {
+                    int32_t level = getRandom(Levels);
+                    int64_t size  = 1 + getRandom(8);
+                    int64_t pos   = getBIRandom((units_ >> level) - size);
+
+                    int64_t start = pos << level;
+                    int64_t end   = (pos + size) << level;
+
+                    bool free = true;
+                    for (int64_t u = start; u < end && free; u++) {
+                        free = units[u] == Unit::FREE;
+                    }
+
+                    if (free)
+                    {
+                        pool.add(AlcMetadata{pos, size, level});
+
+                        for (int64_t u = start; u < end; u++) {
+                            units[u] = Unit::POOLED;
+                        }
+
+                        pooled += end - start;
+                    }
+                }
+                else {
+                    int32_t level  = getRandom(Levels);
+                    int64_t amount = 1 + getRandom(16);
+
+                    int64_t available = pool.available(level);
+
+                    ArenaBuffer<AlcMetadata> buffer;
+                    pool.allocate(level, amount, buffer);
+
+                    if (available < amount)
+                    {
+                        assert_equals(0, buffer.size());
+                        continue;
+                    }
+
+                    int64_t total{};
+                    for (const AlcMetadata& alc: buffer.span())
+                    {
+                        assert_equals(level, alc.level());
+                        total += alc.size();
+
+                        int64_t start = alc.level0_position();
+                        int64_t end   = (alc.position() + alc.size()) << level;
+
+                        for (int64_t u = start; u < end; u++)
+                        {
+                            assert_equals((int32_t)Unit::POOLED, (int32_t)units[u], "{} {}", c, u);
+                            units[u] = Unit::ALLOCATED;
+                        }
+
+                        pooled -= end - start;
+                    }
+
+                    assert_equals(amount, total);
+                    assert_equals(available - amount, pool.available(level));
+                }
+
+                assert_equals(pooled, pool.available(0));
+
+                if (c % 500 != 0) {
+                    continue;
+                }
+
+                for (int32_t level = 0; level < Levels; level++)
+                {
+                    int64_t units_at_level{};
+                    for (int64_t u = 0; u < units_; u += 1ll << level)
+                    {
+                        bool pooled_unit = false;
+                        for (int64_t v = u; v < u + (1ll << level); v++) {
+                            pooled_unit = pooled_unit || units[v] == Unit::POOLED;
+                        }
+
+                        units_at_level += pooled_unit;
+                    }
+
+                    assert_le(units_at_level, pool.reserved(level), "reserved");
+                }
+            }
+        }
+    }
+};
+
+}}
@@ -0,0 +1,193 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/store/swmr/common/dirty_ranges.hpp>
+
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+class DirtyRangesTest: public TestState {
+
+    using MyType = DirtyRangesTest;
+    using Base   = TestState;
+
+    using Range = DirtyRanges::Range;
+
+    uint64_t page_size_{4096};
+    uint64_t pages_{1024};
+
+public:
+    MMA_STATE_FILEDS(page_size_, pages_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testAdd, testAddAll, testCoalesce, testCoalesceRandom)
+    }
+
+    void assertRange(const Range& range, uint64_t offset, uint64_t size)
+    {
+        assert_equals(offset, range.offset);
+        assert_equals(size, range.size);
+    }
+
+    void testAdd()
+    {
+        DirtyRanges ranges;
+        assert_equals(true, ranges.empty());
+
+        // Adjacent ranges extend the last one
+        ranges.add(8192, 100);
+        ranges.add(8292, 200);
+        ranges.add(8492, 4096);
+
+        assert_equals(1, ranges.size());
+        assertRange(ranges.ranges()[0], 8192, 4396);
+
+        // Others are appended, even if they overlap
+        ranges.add(0, 100);
+        ranges.add(50, 100);
+        ranges.add(4096, 10);
+
+        assert_equals(4, ranges.size());
+        assertRange(ranges.ranges()[1], 0, 100);
+        assertRange(ranges.ranges()[2], 50, 100);
+        assertRange(ranges.ranges()[3], 4096, 10);
+
+        // Only the last one is extended
+        ranges.add(4106, 10);
+        ranges.add(8192 + 4396, 10);
+
+        assert_equals(5, ranges.size());
+        assertRange(ranges.ranges()[0], 8192, 4396);
+        assertRange(ranges.ranges()[3], 4096, 20);
+        assertRange(ranges.ranges()[4], 8192 + 4396, 10);
+
+        assert_equals(4396 + 100 + 100 + 20 + 10, ranges.bytes());
+
+        ranges.clear();
+        assert_equals(true, ranges.empty());
+        assert_equals(0, ranges.bytes());
+    }
+
+    void testAddAll()
+    {
+        DirtyRanges ranges1;
+        ranges1.add(0, 10);
+
+        DirtyRanges ranges2;
+        ranges2.add(10, 20);
+        ranges2.add(100, 20);
+
+        // Ranges are appended as they are, not merged
+        ranges1.add_all(ranges2);
+
+        assert_equals(3, ranges1.size());
+        assertRange(ranges1.ranges()[0], 0, 10);
+        assertRange(ranges1.ranges()[1], 10, 20);
+        assertRange(ranges1.ranges()[2], 100, 20);
+
+        assert_equals(2, ranges2.size());
+    }
+
+    void testCoalesce()
+    {
+        DirtyRanges ranges;
+        ranges.coalesce(page_size_);
+        assert_equals(true, ranges.empty());
+
+        // Unsorted, overlapping, adjacent after rounding, and nested
+        ranges.add(5 * 4096 + 10, 10);
+        ranges.add(0, 4096);
+        ranges.add(4095, 2);
+        ranges.add(10 * 4096, 3 * 4096);
+        ranges.add(11 * 4096 + 1, 10);
+        ranges.add(2 * 4096 + 4095, 1);
+        ranges.add(20 * 4096, 4096);
+
+        ranges.coalesce(4096);
+
+        assert_equals(4, ranges.size());
+        assertRange(ranges.ranges()[0], 0, 3 * 4096);
+        assertRange(ranges.ranges()[1], 5 * 4096, 4096);
+        assertRange(ranges.ranges()[2], 10 * 4096, 3 * 4096);
+        assertRange(ranges.ranges()[3], 20 * 4096, 4096);
+
+        // Idempotent
+        ranges.coalesce(4096);
+        assert_equals(4, ranges.size());
+        assert_equals(8 * 4096, ranges.bytes());
+    }
+
+    void testCoalesceRandom()
+    {
+        for (int32_t c = 0; c < 1000; c++)
+        {
+            DirtyRanges ranges;
+            std::vector<bool> dirty(pages_);
+
+            int32_t num = 1 + getRandom(100);
+            for (int32_t d = 0; d < num; d++)
+            {
+                uint64_t offset = getBIRandom(page_size_ * (pages_ - 8));
+                uint64_t size   = 1 + getBIRandom(getRandom(4) ? page_size_ : page_size_ * 8);
+
+                ranges.add(offset, size);
+
+                for (uint64_t page = offset / page_size_; page * page_size_ < offset + size; page++) {
+                    dirty[page] = true;
+                }
+            }
+
+            ranges.coalesce(page_size_);
+
+            // Sorted, page-aligned, separated by clean pages and covering
+            // exactly the dirty ones
+            std::vector<bool> covered(pages_);
+            uint64_t prev_end = 0;
+
+            for (size_t d = 0; d < ranges.size(); d++)
+            {
+                const Range& range = ranges.ranges()[d];
+
+                assert_equals(0, range.offset % page_size_, "{}", d);
+                assert_equals(0, range.size % page_size_, "{}", d);
+                assert_gt(range.size, 0ull, "Empty range");
+
+                if (d > 0) {
+                    assert_lt(prev_end, range.offset, "Adjacent ranges");
+                }
+
+                prev_end = range.end();
+
+                for (uint64_t page = range.offset / page_size_; page < range.end() / page_size_; page++) {
+                    covered[page] = true;
+                }
+            }
+
+            for (uint64_t page = 0; page < pages_; page++) {
+                assert_equals(dirty[page], covered[page], "{} {}", c, page);
+            }
+        }
+    }
+};
+
+}}
@@ -0,0 +1,152 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memoria/tests/tests.hpp>
+#include <memoria/tests/assertions.hpp>
+
+#include <memoria/store/swmr/common/reader_epochs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace memoria {
+namespace tests {
+
+class ReaderEpochsTest: public TestState {
+
+    using MyType = ReaderEpochsTest;
+    using Base   = TestState;
+
+    int32_t threads_{8};
+    int32_t ops_{20000};
+
+public:
+    MMA_STATE_FILEDS(threads_, ops_);
+
+    static void init_suite(TestSuite& suite)
+    {
+        MMA_CLASS_TESTS(suite, testGrowth, testConcurrent)
+    }
+
+    void testGrowth()
+    {
+        SWMRReaderEpochs epochs(16);
+
+        assert_equals(SWMRReaderEpochs::FREE, epochs.min_epoch());
+        assert_equals(16, epochs.size());
+
+        // Many more readers than slots in a page
+        std::vector<size_t> slots;
+        for (uint64_t c = 0; c < 100; c++) {
+            slots.push_back(epochs.enter(1000 - c).get_or_throw());
+        }
+
+        assert_equals(901, epochs.min_epoch());
+        assert_ge(epochs.size(), 100);
+
+        std::vector<size_t> sorted = slots;
+        std::sort(sorted.begin(), sorted.end());
+        assert_equals(true, std::unique(sorted.begin(), sorted.end()) == sorted.end());
+
+        // Slots of all pages are updated and left
+        for (size_t c = 0; c < slots.size(); c++) {
+            epochs.update(slots[c], 2000 + c);
+        }
+
+        assert_equals(2000, epochs.min_epoch());
+
+        for (size_t c = 0; c < 50; c++) {
+            epochs.leave(slots[c]);
+        }
+
+        assert_equals(2050, epochs.min_epoch());
+
+        // Free slots are reused, no pages are added
+        size_t size = epochs.size();
+        for (size_t c = 0; c < 50; c++) {
+            slots[c] = epochs.enter(3000).get_or_throw();
+        }
+
+        assert_equals(size, epochs.size());
+        assert_equals(2050, epochs.min_epoch());
+
+        for (size_t slot: slots) {
+            epochs.leave(slot);
+        }
+
+        assert_equals(SWMRReaderEpochs::FREE, epochs.min_epoch());
+    }
+
+    // Readers hold a varying number of slots, so pages are added while
+    // other threads scan them. The writer's epoch is always held by one
+    // of the threads, so min_epoch() never goes above it.
+    void testConcurrent()
+    {
+        SWMRReaderEpochs epochs(4);
+
+        size_t pinned = epochs.enter(1).get_or_throw();
+
+        std::atomic<int32_t> errors{};
+        std::vector<std::thread> threads;
+
+        for (int32_t t = 0; t < threads_; t++)
+        {
+            threads.emplace_back([&, t]{
+                std::vector<size_t> slots;
+                for (int32_t c = 0; c < ops_; c++)
+                {
+                    if (slots.size() < 10 && (slots.empty() || (c + t) % 3 != 0))
+                    {
+                        auto slot = epochs.enter(100 + t);
+                        if (slot.is_error()) {
+                            errors++;
+                            continue;
+                        }
+
+                        slots.push_back(slot.get());
+                    }
+                    else {
+                        epochs.leave(slots.back());
+                        slots.pop_back();
+                    }
+
+                    if (epochs.min_epoch() != 1) {
+                        errors++;
+                    }
+                }
+
+                for (size_t slot: slots) {
+                    epochs.leave(slot);
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        assert_equals(0, errors.load());
+        assert_equals(1, epochs.min_epoch());
+
+        epochs.leave(pinned);
+        assert_equals(SWMRReaderEpochs::FREE, epochs.min_epoch());
+    }
+};
+
+}}
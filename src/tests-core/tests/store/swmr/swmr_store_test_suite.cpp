@@ -0,0 +1,30 @@
+// Copyright 2020 Victor Smirnov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dirty_ranges_test.hpp"
+#include "allocation_pool_test.hpp"
+#include "reader_epochs_test.hpp"
+
+namespace memoria {
+namespace tests {
+
+namespace {
+
+MMA_CLASS_SUITE(DirtyRangesTest, "Store.SWMR.DirtyRanges");
+MMA_CLASS_SUITE(AllocationPoolTest, "Store.SWMR.AllocationPool");
+MMA_CLASS_SUITE(ReaderEpochsTest, "Store.SWMR.ReaderEpochs");
+
+}
+
+}}